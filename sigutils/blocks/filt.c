@@ -50,6 +50,15 @@ su_block_rrc_ctor(struct sigutils_block *block, void **private, va_list ap)
     goto done;
   }
 
+  /*
+   * Wide matched filters are cheaper in the frequency domain. Nothing
+   * feeds back on this block's output, so it can take the latency.
+   */
+  if (!su_iir_filt_set_fir_mode(filt, SU_FIR_FILT_MODE_AUTO)) {
+    SU_ERROR("Failed to set RRC filter mode\n");
+    goto done;
+  }
+
   ok = su_block_set_property_ref(
       block,
       SU_PROPERTY_TYPE_FLOAT,
@@ -92,7 +101,6 @@ su_block_rrc_acquire(
   su_iir_filt_t *filt;
   SUSDIFF size;
   SUSDIFF got;
-  int i = 0;
 
   SUCOMPLEX *start;
 
@@ -103,8 +111,7 @@ su_block_rrc_acquire(
   do {
     if ((got = su_block_port_read(in, start, size)) > 0) {
       /* Got data, process in place */
-      for (i = 0; i < got; ++i)
-        start[i] = su_iir_filt_feed(filt, start[i]);
+      su_iir_filt_feed_bulk(filt, start, start, got);
 
       /* Increment position */
       if (su_stream_advance_contiguous(out, got) != got) {
@@ -0,0 +1,182 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+#include <stdlib.h>
+
+#define SU_LOG_LEVEL "resampler-block"
+
+#include "log.h"
+#include "block.h"
+#include "resampler.h"
+
+struct su_block_resampler {
+  su_resampler_t resampler;
+  SUCOMPLEX *in;  /* Input samples */
+  SUCOMPLEX *out; /* Output samples, before being written to the stream */
+  SUSCOUNT in_size;
+};
+
+typedef struct su_block_resampler su_block_resampler_t;
+
+SUPRIVATE void
+su_block_resampler_destroy(su_block_resampler_t *rs)
+{
+  if (rs->in != NULL)
+    free(rs->in);
+
+  if (rs->out != NULL)
+    free(rs->out);
+
+  su_resampler_finalize(&rs->resampler);
+
+  free(rs);
+}
+
+/*
+ * Resampler constructor: interpolation and decimation factors, as
+ * unsigned int. Output rate is interp / decim times the input rate.
+ */
+SUPRIVATE SUBOOL
+su_block_resampler_ctor(
+    struct sigutils_block *block,
+    void **private,
+    va_list ap)
+{
+  su_block_resampler_t *rs = NULL;
+  unsigned int interp;
+  unsigned int decim;
+  SUBOOL ok = SU_FALSE;
+
+  interp = va_arg(ap, unsigned int);
+  decim  = va_arg(ap, unsigned int);
+
+  if ((rs = calloc(1, sizeof (su_block_resampler_t))) == NULL) {
+    SU_ERROR("Cannot allocate resampler state\n");
+    goto done;
+  }
+
+  if (!su_resampler_init_rational(
+      &rs->resampler,
+      interp,
+      decim,
+      SU_RESAMPLER_DEFAULT_TAPS)) {
+    SU_ERROR("Failed to initialize resampler\n");
+    goto done;
+  }
+
+  /* Never produce more than what fits in the output stream */
+  rs->in_size = su_resampler_get_max_input(
+      &rs->resampler,
+      SU_BLOCK_STREAM_BUFFER_SIZE);
+
+  if (rs->in_size == 0) {
+    SU_ERROR("Interpolation %d is too big\n", interp);
+    goto done;
+  }
+
+  if (rs->in_size > SU_BLOCK_STREAM_BUFFER_SIZE)
+    rs->in_size = SU_BLOCK_STREAM_BUFFER_SIZE;
+
+  if ((rs->in = malloc(rs->in_size * sizeof (SUCOMPLEX))) == NULL)
+    goto done;
+
+  if ((rs->out = malloc(
+      SU_BLOCK_STREAM_BUFFER_SIZE * sizeof (SUCOMPLEX))) == NULL)
+    goto done;
+
+  ok = SU_TRUE;
+
+done:
+  if (!ok) {
+    if (rs != NULL)
+      su_block_resampler_destroy(rs);
+  }
+  else
+    *private = rs;
+
+  return ok;
+}
+
+SUPRIVATE void
+su_block_resampler_dtor(void *private)
+{
+  su_block_resampler_t *rs;
+
+  rs = (su_block_resampler_t *) private;
+
+  if (rs != NULL)
+    su_block_resampler_destroy(rs);
+}
+
+SUPRIVATE SUSDIFF
+su_block_resampler_acquire(
+    void *priv,
+    su_stream_t *out,
+    unsigned int port_id,
+    su_block_port_t *in)
+{
+  su_block_resampler_t *rs;
+  SUSDIFF got;
+  SUSDIFF produced = 0;
+
+  rs = (su_block_resampler_t *) priv;
+
+  /*
+   * Output size is not known in advance, and may not fit in the
+   * contiguous part of the stream. Outputs go through a separate buffer.
+   */
+  do {
+    if ((got = su_block_port_read(in, rs->in, rs->in_size)) > 0) {
+      /* Got data */
+      produced = su_resampler_feed_bulk(
+          &rs->resampler,
+          rs->in,
+          got,
+          rs->out);
+    } else if (got == SU_BLOCK_PORT_READ_ERROR_PORT_DESYNC) {
+      SU_WARNING("Resampler slow, samples lost\n");
+      if (!su_block_port_resync(in)) {
+        SU_ERROR("Failed to resync\n");
+        return -1;
+      }
+    } else if (got < 0) {
+      SU_ERROR("su_block_port_read: error %d\n", got);
+      return -1;
+    }
+
+    /* Returning 0 means end of stream: wait for a whole output sample */
+  } while (got == SU_BLOCK_PORT_READ_ERROR_PORT_DESYNC
+      || (got > 0 && produced == 0));
+
+  if (got <= 0)
+    return got;
+
+  su_stream_write(out, rs->out, produced);
+
+  return produced;
+}
+
+struct sigutils_block_class su_block_class_RESAMPLER = {
+    "resampler", /* name */
+    1,           /* in_size */
+    1,           /* out_size */
+    su_block_resampler_ctor,    /* constructor */
+    su_block_resampler_dtor,    /* destructor */
+    su_block_resampler_acquire  /* acquire */
+};
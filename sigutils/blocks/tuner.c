@@ -24,14 +24,14 @@
 
 #include "log.h"
 #include "block.h"
-#include "ncqo.h"
+#include "mixer.h"
 #include "iir.h"
 #include "taps.h"
 
-/* A tuner is just a NCQO + Low pass filter */
+/* A tuner is just a mixer + Low pass filter */
 struct sigutils_tuner {
   su_iir_filt_t bpf;   /* Bandpass filter */
-  su_ncqo_t  lo;       /* Local oscillator */
+  su_mixer_t lo;       /* Local oscillator */
   SUFLOAT    if_off;   /* Intermediate frequency offset */
 
   /* Filter params */
@@ -43,6 +43,11 @@ struct sigutils_tuner {
   unsigned int rq_h_size;
   SUFLOAT      rq_if_off;
   SUFLOAT      rq_fc; /* Center frequency (1 ~ fs/2), hcps */
+  unsigned int rq_decimation;
+
+  /* Decimation */
+  unsigned int decimation;
+  SUCOMPLEX   *buffer; /* Input samples, if decimation > 1 */
 };
 
 typedef struct sigutils_tuner su_tuner_t;
@@ -59,13 +64,20 @@ su_tuner_filter_has_changed(su_tuner_t *tu)
 SUPRIVATE SUBOOL
 su_tuner_lo_has_changed(su_tuner_t *tu)
 {
-  return su_ncqo_get_freq(&tu->lo) != tu->if_off - tu->rq_fc;
+  return su_mixer_get_freq(&tu->lo) != tu->if_off - tu->rq_fc;
 }
 
-SUPRIVATE SUCOMPLEX
-su_tuner_feed(su_tuner_t *tu, SUCOMPLEX samp)
+/* Mixes buf in place. Returns the number of outputs written to out */
+SUPRIVATE SUSCOUNT
+su_tuner_feed_bulk(
+    su_tuner_t *tu,
+    SUCOMPLEX *buf,
+    SUSCOUNT size,
+    SUCOMPLEX *out)
 {
-  return su_iir_filt_feed(&tu->bpf, samp * su_ncqo_read(&tu->lo));
+  su_mixer_mix(&tu->lo, buf, buf, size);
+
+  return su_iir_filt_feed_bulk_decim(&tu->bpf, buf, out, size);
 }
 
 SUPRIVATE SUCOMPLEX
@@ -87,6 +99,18 @@ su_tuner_update_filter(su_tuner_t *tu)
       tu->rq_if_off))
     goto fail;
 
+  /*
+   * Long brickwall filters are cheaper in the frequency domain, unless
+   * decimating: dropped outputs are never computed in direct form.
+   */
+  if (!su_iir_filt_set_fir_mode(
+      &bpf_new,
+      tu->decimation > 1 ? SU_FIR_FILT_MODE_DIRECT : SU_FIR_FILT_MODE_AUTO))
+    goto fail;
+
+  if (!su_iir_filt_set_decimation(&bpf_new, tu->decimation))
+    goto fail;
+
   tu->bw     = tu->rq_bw;
   tu->h_size = tu->rq_h_size;
   tu->if_off = tu->rq_if_off;
@@ -105,13 +129,52 @@ fail:
 SUPRIVATE void
 su_tuner_update_lo(su_tuner_t *tu)
 {
-  su_ncqo_set_freq(&tu->lo, tu->if_off - tu->rq_fc);
+  su_mixer_set_freq(&tu->lo, tu->if_off - tu->rq_fc);
+}
+
+SUPRIVATE SUBOOL
+su_tuner_update_decimation(su_tuner_t *tu)
+{
+  if (tu->rq_decimation < 1
+      || tu->rq_decimation > SU_BLOCK_STREAM_BUFFER_SIZE) {
+    SU_ERROR("Invalid tuner decimation %d\n", tu->rq_decimation);
+    return SU_FALSE;
+  }
+
+  /* Decimating tuners read their input into a buffer of their own */
+  if (tu->rq_decimation > 1 && tu->buffer == NULL)
+    if ((tu->buffer = malloc(
+        SU_BLOCK_STREAM_BUFFER_SIZE * sizeof (SUCOMPLEX))) == NULL)
+      return SU_FALSE;
+
+  /* Overlap-save cannot decimate: switch modes around the change */
+  if (tu->rq_decimation > 1) {
+    if (!su_iir_filt_set_fir_mode(&tu->bpf, SU_FIR_FILT_MODE_DIRECT))
+      return SU_FALSE;
+
+    if (!su_iir_filt_set_decimation(&tu->bpf, tu->rq_decimation))
+      return SU_FALSE;
+  } else {
+    if (!su_iir_filt_set_decimation(&tu->bpf, 1))
+      return SU_FALSE;
+
+    if (!su_iir_filt_set_fir_mode(&tu->bpf, SU_FIR_FILT_MODE_AUTO))
+      return SU_FALSE;
+  }
+
+  tu->decimation = tu->rq_decimation;
+
+  return SU_TRUE;
 }
 
 void
 su_tuner_destroy(su_tuner_t *tu)
 {
   su_iir_filt_finalize(&tu->bpf);
+
+  if (tu->buffer != NULL)
+    free(tu->buffer);
+
   free(tu);
 }
 
@@ -123,15 +186,17 @@ su_tuner_new(SUFLOAT fc, SUFLOAT bw, SUFLOAT if_off, SUSCOUNT size)
   if ((new = calloc(1, sizeof (su_tuner_t))) == NULL)
     goto fail;
 
-  new->rq_fc     = fc;
-  new->rq_bw     = bw;
-  new->rq_if_off = if_off;
-  new->rq_h_size = size;
+  new->rq_fc         = fc;
+  new->rq_bw         = bw;
+  new->rq_if_off     = if_off;
+  new->rq_h_size     = size;
+  new->rq_decimation = 1;
+  new->decimation    = 1;
 
   if (!su_tuner_update_filter(new))
     goto fail;
 
-  su_ncqo_init(&new->lo, new->rq_if_off - new->rq_fc);
+  su_mixer_init(&new->lo, new->rq_if_off - new->rq_fc);
 
   return new;
 
@@ -142,7 +207,6 @@ fail:
   return NULL;
 }
 
-/* Tuner constructor */
 SUPRIVATE SUBOOL
 su_block_tuner_ctor(struct sigutils_block *block, void **private, va_list ap)
 {
@@ -152,7 +216,6 @@ su_block_tuner_ctor(struct sigutils_block *block, void **private, va_list ap)
   SUFLOAT bw;
   SUFLOAT if_off;
   unsigned int size;
-  unsigned int d;
 
   fc     = va_arg(ap, double);
   bw     = va_arg(ap, double);
@@ -189,6 +252,16 @@ su_block_tuner_ctor(struct sigutils_block *block, void **private, va_list ap)
       "size",
       &tu->rq_h_size);
 
+  /*
+   * Output rate is input rate / decimation. It may be changed at any
+   * time, and takes effect on the next read.
+   */
+  ok = ok && su_block_set_property_ref(
+      block,
+      SU_PROPERTY_TYPE_INTEGER,
+      "decimation",
+      &tu->rq_decimation);
+
   ok = ok && su_block_set_property_ref(
       block,
       SU_PROPERTY_TYPE_FLOAT,
@@ -228,25 +301,39 @@ su_block_tuner_acquire(
   su_tuner_t *tu;
   SUSDIFF size;
   SUSDIFF got;
-  int i = 0;
+  SUSDIFF produced = 0;
 
   SUCOMPLEX *start;
+  SUCOMPLEX *buf;
 
   tu  = (su_tuner_t *) priv;
 
+  if (tu->rq_decimation != tu->decimation)
+    if (!su_tuner_update_decimation(tu)) {
+      SU_ERROR("Failed to set tuner decimation\n");
+      return -1;
+    }
+
   size = su_stream_get_contiguous(out, &start, out->size);
 
+  /*
+   * When decimating, input is read into a separate buffer, never more
+   * than what fits in the output once decimated. Otherwise, we process
+   * in place.
+   */
+  if (tu->decimation > 1) {
+    size = size * tu->decimation - (tu->decimation - 1);
+    if (size > SU_BLOCK_STREAM_BUFFER_SIZE)
+      size = SU_BLOCK_STREAM_BUFFER_SIZE;
+    buf  = tu->buffer;
+  } else {
+    buf  = start;
+  }
+
   do {
-    if ((got = su_block_port_read(in, start, size)) > 0) {
-      /* Got data, process in place */
-      for (i = 0; i < got; ++i)
-        start[i] = su_tuner_feed(tu, start[i]);
-
-      /* Increment position */
-      if (su_stream_advance_contiguous(out, got) != got) {
-        SU_ERROR("Unexpected size after su_stream_advance_contiguous\n");
-        return -1;
-      }
+    if ((got = su_block_port_read(in, buf, size)) > 0) {
+      /* Got data */
+      produced = su_tuner_feed_bulk(tu, buf, got, start);
     } else if (got == SU_BLOCK_PORT_READ_ERROR_PORT_DESYNC) {
       SU_WARNING("Tuner slow, samples lost\n");
       if (!su_block_port_resync(in)) {
@@ -257,9 +344,21 @@ su_block_tuner_acquire(
       SU_ERROR("su_block_port_read: error %d\n", got);
       return -1;
     }
-  } while (got == SU_BLOCK_PORT_READ_ERROR_PORT_DESYNC);
 
-  return got;
+    /* Returning 0 means end of stream: wait for a whole output sample */
+  } while (got == SU_BLOCK_PORT_READ_ERROR_PORT_DESYNC
+      || (got > 0 && produced == 0));
+
+  if (got <= 0)
+    return got;
+
+  /* Increment position */
+  if (su_stream_advance_contiguous(out, produced) != produced) {
+    SU_ERROR("Unexpected size after su_stream_advance_contiguous\n");
+    return -1;
+  }
+
+  return produced;
 }
 
 struct sigutils_block_class su_block_class_TUNER = {
@@ -270,4 +369,3 @@ struct sigutils_block_class su_block_class_TUNER = {
     su_block_tuner_dtor,    /* destructor */
     su_block_tuner_acquire  /* acquire */
 };
-
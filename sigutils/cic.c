@@ -0,0 +1,196 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#define SU_LOG_DOMAIN "cic"
+
+#include <string.h>
+#include <math.h>
+
+#include "log.h"
+#include "taps.h"
+#include "cic.h"
+
+/* Fractional bits left by a CIC of this size */
+SUINLINE int
+su_cic_filt_get_frac_bits(unsigned int decimation, unsigned int stages)
+{
+  /* Integrators grow N log2(R) bits above the input */
+  return 62 - (int) ceil(stages * log2(decimation)) - SU_CIC_HEADROOM_BITS;
+}
+
+unsigned int
+su_cic_filt_get_max_stages(unsigned int decimation)
+{
+  unsigned int stages = SU_CIC_MAX_STAGES;
+
+  if (decimation == 0)
+    return 0;
+
+  while (stages > 0
+      && su_cic_filt_get_frac_bits(decimation, stages) < SU_CIC_MIN_FRAC_BITS)
+    --stages;
+
+  return stages;
+}
+
+SUBOOL
+su_cic_filt_init(
+    su_cic_filt_t *filt,
+    unsigned int decimation,
+    unsigned int stages)
+{
+  int frac;
+
+  SU_TRYCATCH(decimation > 0, return SU_FALSE);
+  SU_TRYCATCH(stages > 0 && stages <= SU_CIC_MAX_STAGES, return SU_FALSE);
+
+  memset(filt, 0, sizeof(su_cic_filt_t));
+
+  frac = su_cic_filt_get_frac_bits(decimation, stages);
+
+  if (frac < SU_CIC_MIN_FRAC_BITS) {
+    SU_ERROR(
+        "CIC of %d stages cannot decimate by %d\n",
+        stages,
+        decimation);
+    return SU_FALSE;
+  }
+
+  filt->decimation = decimation;
+  filt->stages     = stages;
+  filt->scale      = ldexp(1, frac);
+  filt->gain       = 1. / (ldexp(1, frac) * pow(decimation, stages));
+
+  return SU_TRUE;
+}
+
+SUSCOUNT
+su_cic_filt_feed_bulk(
+    su_cic_filt_t *filt,
+    const SUCOMPLEX *x,
+    SUSCOUNT len,
+    SUCOMPLEX *y)
+{
+  unsigned int stages = filt->stages;
+  uint64_t v[2];
+  uint64_t t;
+  SUSCOUNT i;
+  SUSCOUNT n = 0;
+  unsigned int c, s;
+
+  for (i = 0; i < len; ++i) {
+    v[0] = (uint64_t) (int64_t) (SU_C_REAL(x[i]) * filt->scale);
+    v[1] = (uint64_t) (int64_t) (SU_C_IMAG(x[i]) * filt->scale);
+
+    for (c = 0; c < 2; ++c)
+      for (s = 0; s < stages; ++s)
+        v[c] = filt->integ[c][s] += v[c];
+
+    if (++filt->ptr < filt->decimation)
+      continue;
+
+    filt->ptr = 0;
+
+    for (c = 0; c < 2; ++c)
+      for (s = 0; s < stages; ++s) {
+        t = v[c];
+        v[c] -= filt->comb[c][s];
+        filt->comb[c][s] = t;
+      }
+
+    /* n <= i: in place filtering is safe */
+    y[n++] =
+        filt->gain * (SUFLOAT) (int64_t) v[0]
+        + I * filt->gain * (SUFLOAT) (int64_t) v[1];
+  }
+
+  return n;
+}
+
+SUFLOAT
+su_cic_filt_get_response(const su_cic_filt_t *filt, SUFLOAT f)
+{
+  SUFLOAT num, den;
+
+  if (f == 0)
+    return 1;
+
+  num = SU_SIN(.5 * PI * f);
+  den = filt->decimation * SU_SIN(.5 * PI * f / filt->decimation);
+
+  return SU_POW(SU_ABS(num / den), filt->stages);
+}
+
+void
+su_cic_filt_reset(su_cic_filt_t *filt)
+{
+  memset(filt->integ, 0, sizeof(filt->integ));
+  memset(filt->comb, 0, sizeof(filt->comb));
+
+  filt->ptr = 0;
+}
+
+void
+su_cic_filt_finalize(su_cic_filt_t *filt)
+{
+  memset(filt, 0, sizeof(su_cic_filt_t));
+
+  filt->decimation = 1;
+  filt->scale      = 1;
+  filt->gain       = 1;
+}
+
+void
+su_cic_comp_init(
+    SUFLOAT *h,
+    SUSCOUNT size,
+    const su_cic_filt_t *cic,
+    SUFLOAT fc)
+{
+  SUFLOAT center = .5 * (size - 1);
+  SUFLOAT a, f;
+  SUFLOAT sum = 0;
+  unsigned int i, k;
+
+  for (i = 0; i < size; ++i)
+    h[i] = 0;
+
+  /* Zero-phase frequency samples at f = 2k / size */
+  for (k = 0; 2 * k < size; ++k) {
+    f = 2. * k / size;
+    if (f > fc)
+      break;
+
+    a = 1. / su_cic_filt_get_response(cic, f);
+    if (k > 0)
+      a *= 2;
+
+    for (i = 0; i < size; ++i)
+      h[i] += a * SU_COS(PI * f * (i - center));
+  }
+
+  su_taps_apply_hamming(h, size);
+
+  for (i = 0; i < size; ++i)
+    sum += h[i];
+
+  for (i = 0; i < size; ++i)
+    h[i] /= sum;
+}
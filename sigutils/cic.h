@@ -0,0 +1,117 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#ifndef _SIGUTILS_CIC_H
+#define _SIGUTILS_CIC_H
+
+#include <stdint.h>
+
+#include "types.h"
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic push
+#    pragma clang diagnostic ignored "-Wreturn-type-c-linkage"
+#  endif // __clang__
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Cascaded integrator-comb decimator: N integrators at the input rate, a
+ * decimation by R and N combs at the output rate. Equivalent to N
+ * cascaded boxcar filters of length R, without a single multiplication.
+ *
+ * Samples are converted to fixed point, and integrators are allowed to
+ * wrap around: in modular arithmetic, combs cancel the overflow exactly
+ * as long as the output fits in 64 bits. Fractional bits are chosen so
+ * that inputs up to 2^SU_CIC_HEADROOM_BITS never overflow.
+ *
+ * Magnitude response (f relative to the output Nyquist frequency) is
+ *
+ *   |H(f)| = |sin(PI f / 2) / (R sin(PI f / (2 R)))|^N
+ *
+ * which droops in the passband: see su_cic_comp_init for a compensation
+ * filter.
+ */
+#define SU_CIC_DEFAULT_STAGES 4
+#define SU_CIC_MAX_STAGES     6
+#define SU_CIC_HEADROOM_BITS  4
+#define SU_CIC_MIN_FRAC_BITS  12
+
+struct sigutils_cic_filt {
+  unsigned int decimation; /* R */
+  unsigned int stages;     /* N */
+  unsigned int ptr;        /* Samples since last output */
+
+  uint64_t integ[2][SU_CIC_MAX_STAGES]; /* Real and imaginary integrators */
+  uint64_t comb[2][SU_CIC_MAX_STAGES];  /* Previous comb inputs */
+
+  SUFLOAT scale;           /* Float to fixed point */
+  SUFLOAT gain;            /* Fixed point to float, and 1 / R^N */
+};
+
+typedef struct sigutils_cic_filt su_cic_filt_t;
+
+#define su_cic_filt_INITIALIZER {1, 0, 0, {{0}}, {{0}}, 1, 1}
+
+SUBOOL su_cic_filt_init(
+    su_cic_filt_t *filt,
+    unsigned int decimation,
+    unsigned int stages);
+
+/*
+ * Largest number of stages (up to SU_CIC_MAX_STAGES) a CIC decimating by
+ * R can have without overflowing, 0 if not even one fits.
+ */
+unsigned int su_cic_filt_get_max_stages(unsigned int decimation);
+
+/* Push len samples, write outputs to y. Returns the number of outputs */
+SUSCOUNT su_cic_filt_feed_bulk(
+    su_cic_filt_t *filt,
+    const SUCOMPLEX *x,
+    SUSCOUNT len,
+    SUCOMPLEX *y);
+
+/* Normalized magnitude response */
+SUFLOAT su_cic_filt_get_response(const su_cic_filt_t *filt, SUFLOAT f);
+
+void su_cic_filt_reset(su_cic_filt_t *filt);
+
+void su_cic_filt_finalize(su_cic_filt_t *filt);
+
+/*
+ * Compensation filter (odd size, at the CIC output rate) whose response
+ * is the inverse of the CIC droop up to fc, and zero above it. Designed
+ * by frequency sampling and Hamming windowed. Unity DC gain.
+ */
+void su_cic_comp_init(
+    SUFLOAT *h,
+    SUSCOUNT size,
+    const su_cic_filt_t *cic,
+    SUFLOAT fc);
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic pop
+#  endif // __clang__
+}
+#endif /* __cplusplus */
+
+#endif /* _SIGUTILS_CIC_H */
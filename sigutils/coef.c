@@ -41,6 +41,7 @@
 #include <string.h>
 #include <math.h>
 #include "iir.h"
+#include "coef.h"
 
 /**********************************************************************
   binomial_mult - multiplies a series of binomials together and returns
@@ -629,3 +630,174 @@ su_sf_bwbs(int n, SUFLOAT f1f, SUFLOAT f2f)
 
   return 1.0 / sfr;
 }
+
+/**********************************************************************
+  sos_bw* - second order section (biquad cascade) form of the Butterworth
+  filters above. Analog prototype poles are prewarped, moved to the z
+  plane with the bilinear transform and grouped in conjugate pairs. Each
+  pair is matched with its zeros (at z = -1 for the lowpass, at z = 1 and
+  z = -1 for the bandpass) and normalized to unity gain at DC (lowpass)
+  or at the center frequency (bandpass).
+
+*/
+
+/* Analog prototype pole k of n, on the unit circle */
+SUPRIVATE SUCOMPLEX
+su_sos_bw_pole(int n, int k)
+{
+  SUFLOAT parg = M_PI * (SUFLOAT) (2 * k + 1) / (SUFLOAT) (2 * n);
+
+  return -SU_SIN(parg) + I * SU_COS(parg);
+}
+
+SUPRIVATE SUCOMPLEX
+su_sos_bilinear(SUCOMPLEX s)
+{
+  return (1 + s) / (1 - s);
+}
+
+/*
+ * Fill a section from its poles (either a conjugate pair or two real
+ * poles, z2 = 0 for first order sections) and numerator b[0..2].
+ */
+SUPRIVATE void
+su_sos_set_section(
+    SUFLOAT *sos,
+    const SUFLOAT *b,
+    SUCOMPLEX z1,
+    SUCOMPLEX z2,
+    SUCOMPLEX zref)
+{
+  SUCOMPLEX zi = 1 / zref;
+  SUCOMPLEX num, den;
+  SUFLOAT a1, a2, g;
+
+  a1 = -SU_C_REAL(z1 + z2);
+  a2 = SU_C_REAL(z1 * z2);
+
+  num = b[0] + (b[1] + b[2] * zi) * zi;
+  den = 1 + (a1 + a2 * zi) * zi;
+
+  g = SU_C_ABS(den) / SU_C_ABS(num);
+
+  sos[0] = g * b[0];
+  sos[1] = g * b[1];
+  sos[2] = g * b[2];
+  sos[3] = a1;
+  sos[4] = a2;
+}
+
+unsigned int
+su_sos_bwlp_sections(int n)
+{
+  return (n + 1) / 2;
+}
+
+unsigned int
+su_sos_bwbp_sections(int n)
+{
+  return n;
+}
+
+SUFLOAT *
+su_sos_bwlp(int n, SUFLOAT fcf)
+{
+  static const SUFLOAT b2[] = {1, 2, 1};
+  static const SUFLOAT b1[] = {1, 1, 0};
+  SUFLOAT *sos = NULL;
+  SUFLOAT wc;
+  SUCOMPLEX z;
+  int k;
+
+  if (n < 1)
+    return NULL;
+
+  if ((sos = malloc(
+      su_sos_bwlp_sections(n) * SU_SOS_COEF_COUNT * sizeof(SUFLOAT))) == NULL)
+    return NULL;
+
+  wc = SU_TAN(M_PI * fcf / 2.0);
+
+  for (k = 0; k < n / 2; ++k) {
+    z = su_sos_bilinear(wc * su_sos_bw_pole(n, k));
+    su_sos_set_section(
+        sos + k * SU_SOS_COEF_COUNT,
+        b2,
+        z,
+        SU_C_CONJ(z),
+        1);
+  }
+
+  /* Odd order: real pole left */
+  if (n & 1)
+    su_sos_set_section(
+        sos + k * SU_SOS_COEF_COUNT,
+        b1,
+        su_sos_bilinear(-wc),
+        0,
+        1);
+
+  return sos;
+}
+
+SUFLOAT *
+su_sos_bwbp(int n, SUFLOAT f1f, SUFLOAT f2f)
+{
+  static const SUFLOAT b[] = {1, 0, -1};
+  SUFLOAT *sos = NULL;
+  SUFLOAT w1, w2, w0sq, bw;
+  SUCOMPLEX p, d, s, zref;
+  int k, j = 0;
+
+  if (n < 1)
+    return NULL;
+
+  if ((sos = malloc(
+      su_sos_bwbp_sections(n) * SU_SOS_COEF_COUNT * sizeof(SUFLOAT))) == NULL)
+    return NULL;
+
+  w1   = SU_TAN(M_PI * f1f / 2.0);
+  w2   = SU_TAN(M_PI * f2f / 2.0);
+  w0sq = w1 * w2;
+  bw   = w2 - w1;
+  zref = SU_C_EXP(2 * I * SU_ATAN(SU_SQRT(w0sq)));
+
+  /*
+   * Lowpass to bandpass: every prototype pole p becomes the two roots of
+   * s^2 - p bw s + w0^2. Poles in the upper half plane give a section
+   * per root, completed with its conjugate.
+   */
+  for (k = 0; k < n / 2; ++k) {
+    p = su_sos_bw_pole(n, k);
+    d = SU_C_SQRT(p * p * bw * bw - 4 * w0sq);
+
+    s = su_sos_bilinear(.5 * (p * bw + d));
+    su_sos_set_section(
+        sos + j++ * SU_SOS_COEF_COUNT,
+        b,
+        s,
+        SU_C_CONJ(s),
+        zref);
+
+    s = su_sos_bilinear(.5 * (p * bw - d));
+    su_sos_set_section(
+        sos + j++ * SU_SOS_COEF_COUNT,
+        b,
+        s,
+        SU_C_CONJ(s),
+        zref);
+  }
+
+  /* Odd order: the real prototype pole gives a pair on its own */
+  if (n & 1) {
+    d = SU_C_SQRT((SUCOMPLEX) (bw * bw - 4 * w0sq));
+    su_sos_set_section(
+        sos + j * SU_SOS_COEF_COUNT,
+        b,
+        su_sos_bilinear(.5 * (-bw + d)),
+        su_sos_bilinear(.5 * (-bw - d)),
+        zref);
+  }
+
+  return sos;
+}
@@ -38,4 +38,18 @@ SUFLOAT su_sf_bwhp(int n, SUFLOAT fcf);
 SUFLOAT su_sf_bwbp(int n, SUFLOAT f1f, SUFLOAT f2f);
 SUFLOAT su_sf_bwbs(int n, SUFLOAT f1f, SUFLOAT f2f);
 
+/*
+ * Second order sections. Every section takes SU_SOS_COEF_COUNT
+ * coefficients (b0, b1, b2, a1, a2), a0 being 1. Poles are paired with
+ * zeros section by section, and every section has unity gain in the
+ * passband.
+ */
+#define SU_SOS_COEF_COUNT 5
+
+unsigned int su_sos_bwlp_sections(int n);
+unsigned int su_sos_bwbp_sections(int n);
+
+SUFLOAT *su_sos_bwlp(int n, SUFLOAT fcf);
+SUFLOAT *su_sos_bwbp(int n, SUFLOAT f1f, SUFLOAT f2f);
+
 #endif /* _SIGUTILS_COEF_H */
@@ -24,6 +24,7 @@
 
 #include "sampling.h"
 #include "taps.h"
+#include "simd.h"
 #include "assert.h"
 
 SUBOOL
@@ -43,67 +44,115 @@ su_peak_detector_init(su_peak_detector_t *pd, unsigned int size, SUFLOAT thres)
   pd->p = 0;
   pd->count = 0;
   pd->accum = 0.0;
+  pd->accum2 = 0.0;
+  pd->center = 0.0;
   pd->inv_size = 1. / size;
 
   return SU_TRUE;
 }
 
-int
-su_peak_detector_feed(su_peak_detector_t *pd, SUFLOAT x)
+/* Move the center to the current mean, recompute sums from scratch */
+SUPRIVATE void
+su_peak_detector_recenter(su_peak_detector_t *pd)
 {
-  SUFLOAT mean;
-  SUFLOAT variance = .0;
   SUFLOAT d;
-  SUFLOAT x2;
-  SUFLOAT threshold;
   unsigned int i;
+
+  pd->center += pd->inv_size * pd->accum;
+  pd->accum = 0;
+  pd->accum2 = 0;
+
+  for (i = 0; i < pd->size; ++i) {
+    d = pd->history[i] - pd->center;
+    pd->accum += d;
+    pd->accum2 += d * d;
+  }
+}
+
+SUINLINE int
+__su_peak_detector_feed(su_peak_detector_t *pd, SUFLOAT x)
+{
+  SUFLOAT mean;
+  SUFLOAT variance;
+  SUFLOAT d, prev;
+  SUFLOAT x2;
   int peak = 0;
 
   /* There are essentially two work regimes here:
    *
    * 1. Filling up the history buffer. We can't tell whether the passed
    *    sample is a peak or not, so we return 0.
-   * 2. Overwriting the history buffer. We update the mean to calculate the
-   *    STD, compare it against the incoming sample and return
+   * 2. Overwriting the history buffer. We use the running mean and
+   *    variance, compare them against the incoming sample and return
    *    0, 1 or -1 accordingly.
    */
 
   if (pd->count < pd->size) {
     /* Populate */
+    if (pd->count == 0)
+      pd->center = x;
+
     pd->history[pd->count++] = x;
-  } else {
-    mean = pd->inv_size * pd->accum;
 
-    /* Compute variance */
-    for (i = 0; i < pd->size; ++i) {
-      d = pd->history[i] - mean;
-      variance += d * d;
-    }
+    d = x - pd->center;
+    pd->accum += d;
+    pd->accum2 += d * d;
 
-    variance *= pd->inv_size;
+    if (pd->count == pd->size)
+      su_peak_detector_recenter(pd);
+  } else {
+    /* Shifted mean, and variance around it */
+    mean = pd->inv_size * pd->accum;
+    variance = pd->inv_size * pd->accum2 - mean * mean;
+    if (variance < 0)
+      variance = 0;
 
-    x2 = x - mean;
+    x2 = x - pd->center - mean;
     x2 *= x2;
-    threshold = pd->thr2 * variance;
-
-    if (x2 > threshold) {
-      peak = x > mean ? 1 : -1;
-    }
 
+    if (x2 > pd->thr2 * variance)
+      peak = x > pd->center + mean ? 1 : -1;
 
-    /* Remove last sample from accumulator */
-    pd->accum -= pd->history[pd->p];
+    /* Replace oldest sample */
+    prev = pd->history[pd->p] - pd->center;
+    d = x - pd->center;
+    pd->accum += d - prev;
+    pd->accum2 += d * d - prev * prev;
     pd->history[pd->p++] = x;
 
-    if (pd->p == pd->size)
+    if (pd->p == pd->size) {
       pd->p = 0; /* Rollover */
+      su_peak_detector_recenter(pd);
+    }
   }
 
-  pd->accum += x;
-
   return peak;
 }
 
+int
+su_peak_detector_feed(su_peak_detector_t *pd, SUFLOAT x)
+{
+  return __su_peak_detector_feed(pd, x);
+}
+
+SUSCOUNT
+su_peak_detector_feed_bulk(
+    su_peak_detector_t *pd,
+    const SUFLOAT *x,
+    SUSCOUNT len,
+    SUSCOUNT *peaks,
+    SUSCOUNT max)
+{
+  SUSCOUNT i;
+  SUSCOUNT n = 0;
+
+  for (i = 0; i < len && n < max; ++i)
+    if (__su_peak_detector_feed(pd, x[i]) > 0)
+      peaks[n++] = i;
+
+  return n;
+}
+
 void
 su_peak_detector_finalize(su_peak_detector_t *pd)
 {
@@ -136,11 +185,11 @@ su_peak_detector_finalize(su_peak_detector_t *pd)
  *    1. Same damping factor.
  *    2. Tune to the center frequency of the selected channel
  *    3. Set mode to SU_CHANNEL_DETECTOR_MODE_ORDER ESTIMATION
- * 2. Feed it with samples (this will compute a power).
- * 3. Apply peak detector in the channel frequency range after some runs.
- * 4. At least two peaks should appear. If a third peak appears in the
- *    center frequency, order has been found. Otherwise, estimator should
- *    be reset and start again.
+ * 2. Feed it with samples. Every window is raised to the powers 2, 4 ...
+ *    max_order, and the nonlinear diff is computed along them.
+ * 3. The smallest power whose spectrum shows a tone is the constellation
+ *    order. The baudrate is estimated from the nonlinear diff, as in
+ *    cyclostationary analysis.
  */
 
 struct sigutils_channel *
@@ -162,34 +211,308 @@ su_channel_destroy(struct sigutils_channel *channel)
   free(channel);
 }
 
+/************************** Channel pool and index ***************************/
+SUPRIVATE struct sigutils_channel *
+su_channel_detector_alloc_channel(su_channel_detector_t *detector)
+{
+  struct sigutils_channel *slab = NULL;
+  struct sigutils_channel **tmp;
+  struct sigutils_channel *chan;
+  unsigned int i;
+
+  if (detector->chan_free_count == 0) {
+    SU_TRYCATCH(
+        slab = calloc(
+            SU_CHANNEL_DETECTOR_POOL_SLAB,
+            sizeof(struct sigutils_channel)),
+        goto fail);
+
+    /* The free stack must be able to hold every channel in the pool */
+    SU_TRYCATCH(
+        tmp = realloc(
+            detector->chan_free,
+            (detector->chan_slab_count + 1)
+            * SU_CHANNEL_DETECTOR_POOL_SLAB
+            * sizeof(struct sigutils_channel *)),
+        goto fail);
+    detector->chan_free = tmp;
+
+    SU_TRYCATCH(
+        PTR_LIST_APPEND_CHECK(detector->chan_slab, slab) != -1,
+        goto fail);
+
+    for (i = 0; i < SU_CHANNEL_DETECTOR_POOL_SLAB; ++i)
+      detector->chan_free[i] = slab + SU_CHANNEL_DETECTOR_POOL_SLAB - i - 1;
+
+    detector->chan_free_count = SU_CHANNEL_DETECTOR_POOL_SLAB;
+  }
+
+  chan = detector->chan_free[--detector->chan_free_count];
+  memset(chan, 0, sizeof(struct sigutils_channel));
+
+  return chan;
+
+fail:
+  if (slab != NULL)
+    free(slab);
+
+  return NULL;
+}
+
+SUINLINE void
+su_channel_detector_free_channel(
+    su_channel_detector_t *detector,
+    struct sigutils_channel *chan)
+{
+  detector->chan_free[detector->chan_free_count++] = chan;
+}
+
 SUPRIVATE void
 su_channel_detector_channel_list_clear(su_channel_detector_t *detector)
 {
-  struct sigutils_channel *chan;
   unsigned int i;
 
-  FOR_EACH_PTR(chan, i, detector->channel)
-    su_channel_destroy(chan);
+  for (i = 0; i < detector->channel_count; ++i)
+    su_channel_detector_free_channel(detector, detector->channel_list[i]);
+
+  detector->channel_count      = 0;
+  detector->channel_max_halfbw = 0;
+}
+
+/* First channel whose center frequency is not below fc */
+SUINLINE unsigned int
+su_channel_detector_lower_bound(
+    const su_channel_detector_t *detector,
+    SUFLOAT fc)
+{
+  unsigned int lo = 0;
+  unsigned int hi = detector->channel_count;
+  unsigned int mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (detector->channel_list[mid]->fc < fc)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/*
+ * Only channels whose center lies within channel_max_halfbw of fc may
+ * contain it. Returns the index of the closest one, -1 if none.
+ */
+SUPRIVATE int
+su_channel_detector_lookup_index(
+    const su_channel_detector_t *detector,
+    SUFLOAT fc,
+    SUBOOL valid)
+{
+  const struct sigutils_channel *chan;
+  SUFLOAT halfbw = detector->channel_max_halfbw;
+  SUFLOAT dist, best_dist = INFINITY;
+  unsigned int i;
+  int best = -1;
+
+  for (i = su_channel_detector_lower_bound(detector, fc - halfbw);
+       i < detector->channel_count;
+       ++i) {
+    chan = detector->channel_list[i];
+    if (chan->fc > fc + halfbw)
+      break;
 
-  if (detector->channel_list != NULL)
-    free(detector->channel_list);
+    if (valid && !SU_CHANNEL_IS_VALID(chan))
+      continue;
+
+    dist = SU_ABS(fc - chan->fc);
+    if (dist <= chan->bw * .5 && dist < best_dist) {
+      best_dist = dist;
+      best = i;
+    }
+  }
+
+  return best;
+}
+
+/* Moves a channel whose center frequency changed back to its place */
+SUPRIVATE void
+su_channel_detector_channel_resort(
+    su_channel_detector_t *detector,
+    unsigned int i)
+{
+  struct sigutils_channel **list = detector->channel_list;
+  struct sigutils_channel *chan = list[i];
+
+  while (i > 0 && list[i - 1]->fc > chan->fc) {
+    list[i] = list[i - 1];
+    --i;
+  }
+
+  while (i + 1 < detector->channel_count && list[i + 1]->fc < chan->fc) {
+    list[i] = list[i + 1];
+    ++i;
+  }
+
+  list[i] = chan;
+
+  if (chan->bw * .5 > detector->channel_max_halfbw)
+    detector->channel_max_halfbw = chan->bw * .5;
+}
+
+SUPRIVATE SUBOOL
+su_channel_detector_channel_insert(
+    su_channel_detector_t *detector,
+    struct sigutils_channel *chan)
+{
+  struct sigutils_channel **tmp;
+  unsigned int alloc;
+  unsigned int i;
+
+  if (detector->channel_count == detector->channel_alloc) {
+    alloc = detector->channel_alloc == 0 ? 16 : 2 * detector->channel_alloc;
+
+    SU_TRYCATCH(
+        tmp = realloc(
+            detector->channel_list,
+            alloc * sizeof(struct sigutils_channel *)),
+        return SU_FALSE);
+
+    detector->channel_list  = tmp;
+    detector->channel_alloc = alloc;
+  }
+
+  i = su_channel_detector_lower_bound(detector, chan->fc);
 
-  detector->channel_count = 0;
-  detector->channel_list  = NULL;
+  memmove(
+      detector->channel_list + i + 1,
+      detector->channel_list + i,
+      (detector->channel_count - i) * sizeof(struct sigutils_channel *));
+
+  detector->channel_list[i] = chan;
+  ++detector->channel_count;
+
+  if (chan->bw * .5 > detector->channel_max_halfbw)
+    detector->channel_max_halfbw = chan->bw * .5;
+
+  return SU_TRUE;
 }
 
+/* Ages every channel and drops the expired ones in a single pass */
 SUPRIVATE void
 su_channel_detector_channel_collect(su_channel_detector_t *detector)
 {
+  struct sigutils_channel *chan;
+  unsigned int i, n = 0;
+
+  detector->channel_max_halfbw = 0;
+
+  for (i = 0; i < detector->channel_count; ++i) {
+    chan = detector->channel_list[i];
+
+    if (chan->age++ > 2 * chan->present) {
+      su_channel_detector_free_channel(detector, chan);
+    } else {
+      detector->channel_list[n++] = chan;
+      if (chan->bw * .5 > detector->channel_max_halfbw)
+        detector->channel_max_halfbw = chan->bw * .5;
+    }
+  }
+
+  detector->channel_count = n;
+}
+
+SUPRIVATE SUBOOL
+su_channel_snapshot_copy(
+    su_channel_snapshot_t *dest,
+    const su_channel_snapshot_t *src)
+{
+  struct sigutils_channel *tmp;
+
+  if (src->channel_count > dest->channel_alloc) {
+    SU_TRYCATCH(
+        tmp = realloc(
+            dest->channel_list,
+            src->channel_count * sizeof(struct sigutils_channel)),
+        return SU_FALSE);
+
+    dest->channel_list  = tmp;
+    dest->channel_alloc = src->channel_count;
+  }
+
+  if (src->channel_count > 0)
+    memcpy(
+        dest->channel_list,
+        src->channel_list,
+        src->channel_count * sizeof(struct sigutils_channel));
+
+  dest->channel_count = src->channel_count;
+  dest->generation    = src->generation;
+
+  return SU_TRUE;
+}
+
+/* Makes the current channel list visible to su_channel_detector_get_snapshot */
+SUPRIVATE SUBOOL
+su_channel_detector_publish(su_channel_detector_t *detector)
+{
+  su_channel_snapshot_t *snap = &detector->snapshot;
+  struct sigutils_channel *tmp;
+  SUBOOL ok = SU_FALSE;
   unsigned int i;
 
+  pthread_mutex_lock(&detector->snapshot_mutex);
+
+  if (detector->channel_count > snap->channel_alloc) {
+    SU_TRYCATCH(
+        tmp = realloc(
+            snap->channel_list,
+            detector->channel_alloc * sizeof(struct sigutils_channel)),
+        goto done);
+
+    snap->channel_list  = tmp;
+    snap->channel_alloc = detector->channel_alloc;
+  }
+
   for (i = 0; i < detector->channel_count; ++i)
-    if (detector->channel_list[i] != NULL)
-      if (detector->channel_list[i]->age++
-          > 2 * detector->channel_list[i]->present) {
-        su_channel_destroy(detector->channel_list[i]);
-        detector->channel_list[i] = NULL;
-      }
+    snap->channel_list[i] = *detector->channel_list[i];
+
+  snap->channel_count = detector->channel_count;
+  ++snap->generation;
+
+  ok = SU_TRUE;
+
+done:
+  pthread_mutex_unlock(&detector->snapshot_mutex);
+
+  return ok;
+}
+
+SUBOOL
+su_channel_detector_get_snapshot(
+    su_channel_detector_t *detector,
+    su_channel_snapshot_t *snap)
+{
+  SUBOOL ok = SU_TRUE;
+
+  pthread_mutex_lock(&detector->snapshot_mutex);
+
+  if (snap->generation != detector->snapshot.generation)
+    ok = su_channel_snapshot_copy(snap, &detector->snapshot);
+
+  pthread_mutex_unlock(&detector->snapshot_mutex);
+
+  return ok;
+}
+
+void
+su_channel_snapshot_finalize(su_channel_snapshot_t *snap)
+{
+  if (snap->channel_list != NULL)
+    free(snap->channel_list);
+
+  memset(snap, 0, sizeof(su_channel_snapshot_t));
 }
 
 struct sigutils_channel *
@@ -197,15 +520,9 @@ su_channel_detector_lookup_channel(
     const su_channel_detector_t *detector,
     SUFLOAT fc)
 {
-  struct sigutils_channel *chan;
-  unsigned int i;
-
-  FOR_EACH_PTR(chan, i, detector->channel)
-    if (fc >= chan->fc - chan->bw * .5 &&
-        fc <= chan->fc + chan->bw * .5)
-      return chan;
+  int i = su_channel_detector_lookup_index(detector, fc, SU_FALSE);
 
-  return NULL;
+  return i == -1 ? NULL : detector->channel_list[i];
 }
 
 struct sigutils_channel *
@@ -213,16 +530,9 @@ su_channel_detector_lookup_valid_channel(
     const su_channel_detector_t *detector,
     SUFLOAT fc)
 {
-  struct sigutils_channel *chan;
-  unsigned int i;
-
-  FOR_EACH_PTR(chan, i, detector->channel)
-    if (SU_CHANNEL_IS_VALID(chan))
-      if (fc >= chan->fc - chan->bw * .5 &&
-          fc <= chan->fc + chan->bw * .5)
-        return chan;
+  int i = su_channel_detector_lookup_index(detector, fc, SU_TRUE);
 
-  return NULL;
+  return i == -1 ? NULL : detector->channel_list[i];
 }
 
 SUPRIVATE SUBOOL
@@ -232,21 +542,25 @@ su_channel_detector_assert_channel(
 {
   struct sigutils_channel *chan = NULL;
   SUFLOAT k = .5;
+  int i;
 
-  if ((chan = su_channel_detector_lookup_channel(detector, new->fc)) == NULL) {
-    if ((chan = calloc(1, sizeof (struct sigutils_channel))) == NULL)
-      return SU_FALSE;
+  if ((i = su_channel_detector_lookup_index(detector, new->fc, SU_FALSE))
+      == -1) {
+    SU_TRYCATCH(
+        chan = su_channel_detector_alloc_channel(detector),
+        return SU_FALSE);
 
     chan->bw      = new->bw;
     chan->fc      = new->fc;
     chan->f_lo    = new->f_lo;
     chan->f_hi    = new->f_hi;
 
-    if (PTR_LIST_APPEND_CHECK(detector->channel, chan) == -1) {
-      su_channel_destroy(chan);
+    if (!su_channel_detector_channel_insert(detector, chan)) {
+      su_channel_detector_free_channel(detector, chan);
       return SU_FALSE;
     }
   } else {
+    chan = detector->channel_list[i];
     chan->present++;
     if (chan->age > 20)
       k /=  (chan->age - 20);
@@ -256,6 +570,8 @@ su_channel_detector_assert_channel(
     chan->f_lo += 1. / (chan->age + 1) * (new->f_lo - chan->f_lo);
     chan->f_hi += 1. / (chan->age + 1) * (new->f_hi - chan->f_hi);
     chan->fc   += 1. / (chan->age + 1) * (new->fc   - chan->fc);
+
+    su_channel_detector_channel_resort(detector, i);
   }
 
   /* Signal levels are instantaneous values. Cannot average */
@@ -269,15 +585,49 @@ su_channel_detector_assert_channel(
 void
 su_channel_detector_destroy(su_channel_detector_t *detector)
 {
+  unsigned int i;
+
+  su_channel_detector_detach_specttuner(detector);
+
   if (detector->fft_plan != NULL)
-    SU_FFTW(_destroy_plan)(detector->fft_plan);
+    su_fft_plan_release(detector->fft_plan);
 
   if (detector->fft_plan_rev != NULL)
-    SU_FFTW(_destroy_plan)(detector->fft_plan_rev);
+    su_fft_plan_release(detector->fft_plan_rev);
+
+  if (detector->batch_plan != NULL)
+    su_fft_plan_release(detector->batch_plan);
+
+  if (detector->order_plan != NULL)
+    su_fft_plan_release(detector->order_plan);
+
+  if (detector->order_in != NULL)
+    SU_FFTW(_free)(detector->order_in);
+
+  if (detector->order_out != NULL)
+    SU_FFTW(_free)(detector->order_out);
+
+  if (detector->batch_in != NULL)
+    SU_FFTW(_free)(detector->batch_in);
+
+  if (detector->batch_out != NULL)
+    SU_FFTW(_free)(detector->batch_out);
+
+  if (detector->window_fft != NULL)
+    SU_FFTW(_free)(detector->window_fft);
 
   if (detector->window != NULL)
     SU_FFTW(_free)(detector->window);
 
+  if (detector->window_real != NULL)
+    SU_FFTW(_free)(detector->window_real);
+
+  if (detector->history != NULL)
+    free(detector->history);
+
+  if (detector->history_real != NULL)
+    free(detector->history_real);
+
   if (detector->window_func != NULL)
     SU_FFTW(_free)(detector->window_func);
 
@@ -296,7 +646,22 @@ su_channel_detector_destroy(su_channel_detector_t *detector)
   if (detector->spmin != NULL)
     free(detector->spmin);
 
-  su_channel_detector_channel_list_clear(detector);
+  if (detector->channel_list != NULL)
+    free(detector->channel_list);
+
+  for (i = 0; i < detector->chan_slab_count; ++i)
+    free(detector->chan_slab_list[i]);
+
+  if (detector->chan_slab_list != NULL)
+    free(detector->chan_slab_list);
+
+  if (detector->chan_free != NULL)
+    free(detector->chan_free);
+
+  if (detector->snapshot_init)
+    pthread_mutex_destroy(&detector->snapshot_mutex);
+
+  su_channel_snapshot_finalize(&detector->snapshot);
 
   su_softtuner_finalize(&detector->tuner);
 
@@ -305,6 +670,9 @@ su_channel_detector_destroy(su_channel_detector_t *detector)
 
   su_peak_detector_finalize(&detector->pd);
 
+  if (detector->pd_db != NULL)
+    free(detector->pd_db);
+
   free(detector);
 }
 
@@ -318,6 +686,42 @@ su_channel_detector_get_channel_list(
   *channel_count = detector->channel_count;
 }
 
+SUINLINE SUSCOUNT
+su_channel_detector_params_get_hop(
+    const struct sigutils_channel_detector_params *params)
+{
+  return params->hop == 0 ? params->window_size : params->hop;
+}
+
+/* Powers of the signal used by ORDER_ESTIMATION: 2, 4 ... 2^orders */
+SUINLINE unsigned int
+su_channel_detector_params_get_orders(
+    const struct sigutils_channel_detector_params *params)
+{
+  unsigned int orders = 0;
+
+  if (params->mode != SU_CHANNEL_DETECTOR_MODE_ORDER_ESTIMATION)
+    return 0;
+
+  while ((2u << orders) <= params->max_order)
+    ++orders;
+
+  return orders;
+}
+
+/* The spectra of a tuner can only feed the power spectrum modes */
+SUINLINE SUBOOL
+su_channel_detector_params_can_share(
+    const struct sigutils_channel_detector_params *params,
+    const su_specttuner_t *st)
+{
+  return (params->mode == SU_CHANNEL_DETECTOR_MODE_SPECTRUM
+      || params->mode == SU_CHANNEL_DETECTOR_MODE_DISCOVERY)
+      && !params->tune
+      && params->window_size == st->params.window_size
+      && params->real == st->params.real;
+}
+
 SUBOOL
 su_channel_detector_set_params(
     su_channel_detector_t *detector,
@@ -341,6 +745,26 @@ su_channel_detector_set_params(
   if (params->window != detector->params.window)
     return SU_FALSE;
 
+  /* Same goes for batch buffers and real input */
+  if (params->batch != detector->params.batch)
+    return SU_FALSE;
+
+  if (params->real != detector->params.real)
+    return SU_FALSE;
+
+  /* Overlap is decided at allocation time too */
+  if (su_channel_detector_params_get_hop(params) != detector->hop)
+    return SU_FALSE;
+
+  if (params->real
+      && params->mode != SU_CHANNEL_DETECTOR_MODE_SPECTRUM
+      && params->mode != SU_CHANNEL_DETECTOR_MODE_DISCOVERY)
+    return SU_FALSE;
+
+  /* Order estimation rows are allocated for a given max_order */
+  if (su_channel_detector_params_get_orders(params) != detector->orders)
+    return SU_FALSE;
+
   /* Changing the detector bandwidth implies recreating the antialias filter */
   if (params->bw != detector->params.bw)
     return SU_FALSE;
@@ -352,6 +776,10 @@ su_channel_detector_set_params(
   if (params->bw > 0.0 && params->samp_rate != detector->params.samp_rate)
     return SU_FALSE;
 
+  if (detector->st != NULL
+      && !su_channel_detector_params_can_share(params, detector->st))
+    return SU_FALSE;
+
   /* It's okay to change the parameters now */
   detector->params = *params;
 
@@ -362,9 +790,64 @@ su_channel_detector_set_params(
   return SU_TRUE;
 }
 
+/*
+ * Cosine terms of the window function, as in su_taps_apply_*:
+ * w[n] = a0 - a1 cos(2 pi n / N) + a2 cos(4 pi n / N) - ...
+ */
+SUPRIVATE void
+su_channel_detector_init_window_kernel(su_channel_detector_t *detector)
+{
+  SUFLOAT a[SU_CHANNEL_DETECTOR_WINDOW_TERMS] = {1};
+  unsigned int terms = 1;
+  unsigned int m;
+
+  switch (detector->params.window) {
+    case SU_CHANNEL_DETECTOR_WINDOW_HAMMING:
+      a[0] = SU_HAMMING_ALPHA;
+      a[1] = SU_MAMMING_BETA;
+      terms = 2;
+      break;
+
+    case SU_CHANNEL_DETECTOR_WINDOW_HANN:
+      a[0] = SU_HANN_ALPHA;
+      a[1] = SU_HANN_BETA;
+      terms = 2;
+      break;
+
+    case SU_CHANNEL_DETECTOR_WINDOW_FLAT_TOP:
+      /* Last term matches su_taps_apply_flat_top */
+      a[0] = SU_FLAT_TOP_A0;
+      a[1] = SU_FLAT_TOP_A1;
+      a[2] = SU_FLAT_TOP_A2;
+      a[3] = SU_FLAT_TOP_A3;
+      a[4] = SU_FLAT_TOP_A1;
+      terms = 5;
+      break;
+
+    case SU_CHANNEL_DETECTOR_WINDOW_BLACKMANN_HARRIS:
+      a[0] = SU_BLACKMANN_HARRIS_A0;
+      a[1] = SU_BLACKMANN_HARRIS_A1;
+      a[2] = SU_BLACKMANN_HARRIS_A2;
+      a[3] = SU_BLACKMANN_HARRIS_A3;
+      terms = 4;
+      break;
+
+    default:
+      break;
+  }
+
+  /* a cos(2 pi m n / N) = a / 2 (e^(2 pi i m n / N) + e^(-2 pi i m n / N)) */
+  detector->win_kernel[0] = a[0];
+  for (m = 1; m < terms; ++m)
+    detector->win_kernel[m] = (m & 1 ? -.5 : .5) * a[m];
+
+  detector->win_terms = terms;
+}
+
 SUINLINE SUBOOL
 su_channel_detector_init_window_func(su_channel_detector_t *detector)
 {
+  SUFLOAT energy = 0;
   unsigned int i;
 
   for (i = 0; i < detector->params.window_size; ++i)
@@ -408,7 +891,103 @@ su_channel_detector_init_window_func(su_channel_detector_t *detector)
       return SU_FALSE;
   }
 
-  return SU_TRUE;
+  /* PSD of white noise must not depend on the window function */
+  for (i = 0; i < detector->params.window_size; ++i)
+    energy += SU_C_REAL(
+        detector->window_func[i] * SU_C_CONJ(detector->window_func[i]));
+
+  detector->psd_norm = 1. / energy;
+
+  su_channel_detector_init_window_kernel(detector);
+
+  return SU_TRUE;
+}
+
+/*
+ * Rows of the batched FFT of the order estimation mode, and the peak
+ * detector of the baudrate estimation.
+ */
+SUPRIVATE SUBOOL
+su_channel_detector_init_order(su_channel_detector_t *detector)
+{
+  unsigned int rows = detector->orders + 1;
+  SUSCOUNT size = rows * detector->params.window_size;
+
+  SU_TRYCATCH(
+      detector->order_in = SU_FFTW(_malloc)(size * sizeof(SU_FFTW(_complex))),
+      return SU_FALSE);
+
+  SU_TRYCATCH(
+      detector->order_out = SU_FFTW(_malloc)(size * sizeof(SU_FFTW(_complex))),
+      return SU_FALSE);
+
+  memset(detector->order_in, 0, size * sizeof(SU_FFTW(_complex)));
+
+  SU_TRYCATCH(
+      detector->order_plan = su_fft_plan_acquire_many(
+          detector->params.window_size,
+          rows,
+          FFTW_FORWARD,
+          detector->order_in,
+          detector->order_out),
+      return SU_FALSE);
+
+  SU_TRYCATCH(
+      su_peak_detector_init(
+          &detector->pd,
+          detector->params.pd_size,
+          detector->params.pd_thres),
+      return SU_FALSE);
+
+  SU_TRYCATCH(
+      detector->pd_db = malloc(
+          detector->params.window_size / 2 * sizeof(SUFLOAT)),
+      return SU_FALSE);
+
+  return SU_TRUE;
+}
+
+SUPRIVATE SUBOOL
+su_channel_detector_init_batch(su_channel_detector_t *detector)
+{
+  SUSCOUNT window_size = detector->params.window_size;
+  SUSCOUNT length = detector->params.batch * window_size;
+
+  if ((detector->batch_in
+      = SU_FFTW(_malloc)(length * sizeof(SU_FFTW(_complex)))) == NULL) {
+    SU_ERROR("cannot allocate memory for batch input\n");
+    return SU_FALSE;
+  }
+
+  if ((detector->batch_out
+      = SU_FFTW(_malloc)(length * sizeof(SU_FFTW(_complex)))) == NULL) {
+    SU_ERROR("cannot allocate memory for batch output\n");
+    return SU_FALSE;
+  }
+
+  if ((detector->window_fft
+      = SU_FFTW(_malloc)(window_size * sizeof(SU_FFTW(_complex)))) == NULL) {
+    SU_ERROR("cannot allocate memory for window function FFT\n");
+    return SU_FALSE;
+  }
+
+  if ((detector->batch_plan = su_fft_plan_acquire_many(
+      window_size,
+      detector->params.batch,
+      FFTW_FORWARD,
+      detector->batch_in,
+      detector->batch_out)) == NULL) {
+    SU_ERROR("failed to create batch FFT plan\n");
+    return SU_FALSE;
+  }
+
+  /* Windows are transformed before removing the DC. See feed_batch */
+  su_fft_plan_execute(
+      detector->fft_plan,
+      detector->window_func,
+      detector->window_fft);
+
+  return SU_TRUE;
 }
 
 su_channel_detector_t *
@@ -428,14 +1007,72 @@ su_channel_detector_new(const struct sigutils_channel_detector_params *params)
 
   new->params = *params;
 
-  if ((new->window
-      = SU_FFTW(_malloc)(
-          params->window_size * sizeof(SU_FFTW(_complex)))) == NULL) {
-    SU_ERROR("cannot allocate memory for window\n");
+  SU_TRYCATCH(pthread_mutex_init(&new->snapshot_mutex, NULL) == 0, goto fail);
+  new->snapshot_init = SU_TRUE;
+
+  new->hop = su_channel_detector_params_get_hop(params);
+  new->to_frame = params->window_size;
+  new->orders = su_channel_detector_params_get_orders(params);
+
+  if (params->mode == SU_CHANNEL_DETECTOR_MODE_ORDER_ESTIMATION
+      && new->orders == 0) {
+    SU_ERROR("order estimation requires max_order >= 2\n");
     goto fail;
   }
 
-  memset(new->window, 0, params->window_size * sizeof(SU_FFTW(_complex)));
+  if (new->hop > params->window_size) {
+    SU_ERROR("hop cannot exceed the window size\n");
+    goto fail;
+  }
+
+  if (new->hop < params->window_size) {
+    if (params->mode != SU_CHANNEL_DETECTOR_MODE_SPECTRUM
+        && params->mode != SU_CHANNEL_DETECTOR_MODE_DISCOVERY) {
+      SU_ERROR("overlapped windows not supported in this mode\n");
+      goto fail;
+    }
+
+    if (params->real) {
+      SU_TRYCATCH(
+          new->history_real = calloc(params->window_size, sizeof(SUFLOAT)),
+          goto fail);
+    } else {
+      SU_TRYCATCH(
+          new->history = calloc(params->window_size, sizeof(SUCOMPLEX)),
+          goto fail);
+    }
+  }
+
+  if (params->real) {
+    /* Real input is only supported by the PSD-based modes */
+    if (params->mode != SU_CHANNEL_DETECTOR_MODE_SPECTRUM
+        && params->mode != SU_CHANNEL_DETECTOR_MODE_DISCOVERY) {
+      SU_ERROR("real input not supported in this mode\n");
+      goto fail;
+    }
+
+    if (params->tune) {
+      SU_ERROR("real input cannot be tuned\n");
+      goto fail;
+    }
+
+    if ((new->window_real
+        = SU_FFTW(_malloc)(params->window_size * sizeof(SUFLOAT))) == NULL) {
+      SU_ERROR("cannot allocate memory for window\n");
+      goto fail;
+    }
+
+    memset(new->window_real, 0, params->window_size * sizeof(SUFLOAT));
+  } else {
+    if ((new->window
+        = SU_FFTW(_malloc)(
+            params->window_size * sizeof(SU_FFTW(_complex)))) == NULL) {
+      SU_ERROR("cannot allocate memory for window\n");
+      goto fail;
+    }
+
+    memset(new->window, 0, params->window_size * sizeof(SU_FFTW(_complex)));
+  }
 
   if ((new->window_func
       = SU_FFTW(_malloc)(
@@ -457,21 +1094,29 @@ su_channel_detector_new(const struct sigutils_channel_detector_params *params)
 
   /*
    * Generic result allocation: the same buffer is used differently depending
-   * on the detector mode
+   * on the detector mode. Order estimation keeps one spectrum per row.
    */
-  if ((new->_r_alloc
-      = calloc(params->window_size, sizeof(SUFLOAT))) == NULL) {
+  if ((new->_r_alloc = calloc(
+      (new->orders + 1) * params->window_size,
+      sizeof(SUFLOAT))) == NULL) {
     SU_ERROR("cannot allocate memory for averaged FFT\n");
     goto fail;
   }
 
-  /* Direct FFT plan */
-  if ((new->fft_plan = SU_FFTW(_plan_dft_1d)(
-      params->window_size,
-      new->window,
-      new->fft,
-      FFTW_FORWARD,
-      FFTW_ESTIMATE)) == NULL) {
+  /* Direct FFT plan. Real input only needs the half spectrum */
+  if (params->real)
+    new->fft_plan = su_fft_plan_acquire_r2c(
+        params->window_size,
+        new->window_real,
+        new->fft);
+  else
+    new->fft_plan = su_fft_plan_acquire(
+        params->window_size,
+        FFTW_FORWARD,
+        new->window,
+        new->fft);
+
+  if (new->fft_plan == NULL) {
     SU_ERROR("failed to create FFT plan\n");
     goto fail;
   }
@@ -479,7 +1124,10 @@ su_channel_detector_new(const struct sigutils_channel_detector_params *params)
   /* Mode-specific allocations */
   switch (params->mode) {
     case SU_CHANNEL_DETECTOR_MODE_SPECTRUM:
+      break;
+
     case SU_CHANNEL_DETECTOR_MODE_ORDER_ESTIMATION:
+      SU_TRYCATCH(su_channel_detector_init_order(new), goto fail);
       break;
 
     case SU_CHANNEL_DETECTOR_MODE_DISCOVERY:
@@ -508,12 +1156,11 @@ su_channel_detector_new(const struct sigutils_channel_detector_params *params)
 
       memset(new->ifft, 0, params->window_size * sizeof(SU_FFTW(_complex)));
 
-      if ((new->fft_plan_rev = SU_FFTW(_plan_dft_1d)(
+      if ((new->fft_plan_rev = su_fft_plan_acquire(
           params->window_size,
-          new->fft,
-          new->ifft,
           FFTW_BACKWARD,
-          FFTW_ESTIMATE)) == NULL) {
+          new->fft,
+          new->ifft)) == NULL) {
         SU_ERROR("failed to create FFT plan\n");
         goto fail;
       }
@@ -526,9 +1173,20 @@ su_channel_detector_new(const struct sigutils_channel_detector_params *params)
         goto fail;
       }
 
+      SU_TRYCATCH(
+          new->pd_db = malloc(params->window_size / 2 * sizeof(SUFLOAT)),
+          goto fail);
       break;
   }
 
+  /* Batch buffers, for modes that only need the power spectrum */
+  if (params->batch > 1
+      && !params->real
+      && new->hop == params->window_size
+      && (params->mode == SU_CHANNEL_DETECTOR_MODE_SPECTRUM
+        || params->mode == SU_CHANNEL_DETECTOR_MODE_DISCOVERY))
+    SU_TRYCATCH(su_channel_detector_init_batch(new), goto fail);
+
   /* Initialize tuner (if enabled) */
   if (params->tune) {
     SU_TRYCATCH(
@@ -572,6 +1230,7 @@ su_channel_detector_find_channels(
     su_channel_detector_t *detector) {
   unsigned int i;
   unsigned int N;
+  unsigned int bins;
   unsigned int fs;
   SUCOMPLEX acc; /* Accumulator for the autocorrelation technique */
   SUFLOAT psd;   /* Power spectral density in this FFT bin */
@@ -588,7 +1247,10 @@ su_channel_detector_find_channels(
   N = detector->params.window_size;
   fs = detector->params.samp_rate;
 
-  for (i = 0; i < N; ++i) {
+  /* Real input: the upper half is a mirror, it would yield image channels */
+  bins = detector->params.real ? N / 2 + 1 : N;
+
+  for (i = 0; i < bins; ++i) {
     psd = detector->spect[i];
     nfreq = 2 * i / (SUFLOAT) N;
 
@@ -706,88 +1368,95 @@ su_channel_params_adjust_to_channel(
   su_channel_params_adjust(params);
 }
 
+/* Real input: the PSD is even, fill the negative frequencies */
+SUINLINE void
+su_channel_detector_mirror_spectrum(su_channel_detector_t *detector)
+{
+  unsigned int i;
+
+  for (i = detector->params.window_size / 2 + 1;
+       i < detector->params.window_size;
+       ++i)
+    detector->spect[i] = detector->spect[detector->params.window_size - i];
+}
+
+/*
+ * Smooth the last FFT into spect, track its extremes and gather noise
+ * statistics, all in a single pass. Real input only has window_size / 2 + 1
+ * meaningful bins: the rest are mirrored and tracked separately.
+ */
+SUPRIVATE void
+su_channel_detector_track_spectrum(
+    su_channel_detector_t *detector,
+    su_simd_psd_stats_t *stats)
+{
+  su_simd_psd_stats_t upper;
+  unsigned int N = detector->params.window_size;
+  unsigned int bins = detector->params.real ? N / 2 + 1 : N;
+
+  su_simd_psd_track(
+      detector->spect,
+      detector->spmin,
+      detector->spmax,
+      detector->fft,
+      detector->psd_norm,
+      detector->params.alpha,
+      detector->params.beta,
+      detector->N0,
+      bins,
+      stats);
+
+  if (bins < N) {
+    su_channel_detector_mirror_spectrum(detector);
+
+    su_simd_psd_track(
+        detector->spect + bins,
+        detector->spmin + bins,
+        detector->spmax + bins,
+        NULL,
+        0,
+        0,
+        detector->params.beta,
+        detector->N0,
+        N - bins,
+        &upper);
+
+    stats->sum   += upper.sum;
+    stats->valid += upper.valid;
+
+    if (upper.min < stats->min) {
+      stats->min     = upper.min;
+      stats->min_bin = bins + upper.min_bin;
+    }
+  }
+}
+
 SUPRIVATE SUBOOL
 su_channel_perform_discovery(su_channel_detector_t *detector)
 {
-  unsigned int i;
   unsigned int N; /* FFT size */
-  unsigned int valid; /* valid FFT bins */
-  unsigned int min_pwr_bin; /* bin of the stpectrogram where the min power is */
-  SUFLOAT alpha;
-  SUFLOAT beta;
-  SUFLOAT gamma;
-  SUFLOAT min_pwr; /* minimum power density */
-  SUFLOAT psd; /* current power density */
-  SUFLOAT N0; /* Noise level */
-
-  SUBOOL  detector_enabled; /* whether we can detect channels */
+  su_simd_psd_stats_t stats;
 
   N = detector->params.window_size;
 
+  su_channel_detector_track_spectrum(detector, &stats);
+
   if (detector->iters++ == 0) {
     /* First run */
     memcpy(detector->spmax, detector->spect, N * sizeof(SUFLOAT));
     memcpy(detector->spmin, detector->spect, N * sizeof(SUFLOAT));
 
     /* First estimation of the noise floor */
-    if (detector->N0 == 0) {
-      N0 = INFINITY;
-      for (i = 0; i < N; ++i)
-        if (detector->spect[i] < N0)
-          N0 = detector->spect[i];
-
-      detector->N0 = N0;
-    }
+    if (detector->N0 == 0)
+      detector->N0 = stats.min;
   } else {
-    /* Next runs */
-
-    alpha = detector->params.alpha;
-    beta  = detector->params.beta;
-    gamma = detector->params.gamma;
-
-    detector_enabled = detector->req_samples == 0;
-    N0 = 0;
-    valid = 0;
-    min_pwr = INFINITY;
-    min_pwr_bin = -1;
-
-    for (i = 0; i < N; ++i) {
-      psd = detector->spect[i];
-
-      /* Update minimum */
-      if (psd < detector->spmin[i])
-        detector->spmin[i] = psd;
-      else
-        detector->spmin[i] += beta * (psd - detector->spmin[i]);
-
-      /* Update maximum */
-      if (psd > detector->spmax[i])
-        detector->spmax[i] = psd;
-      else
-        detector->spmax[i] += beta * (psd - detector->spmax[i]);
-
-      if (detector_enabled) {
-        /* Use previous N0 estimation to detect outliers */
-        if (detector->spmin[i] < detector->N0
-            && detector->N0 < detector->spmax[i]) {
-          N0 += psd;
-          ++valid;
-        }
-
-        /* Update minimum power */
-        if (psd < min_pwr) {
-          min_pwr_bin = i;
-          min_pwr = psd;
-        }
-      }
-    }
-
-    if (detector_enabled) {
-      if (valid != 0)
-        detector->N0 = N0 / valid;
-      else if (min_pwr_bin != -1)
+    /* Next runs: previous N0 estimation was used to detect outliers */
+    if (detector->req_samples == 0) {
+      if (stats.valid != 0)
+        detector->N0 = stats.sum / stats.valid;
+      else if (stats.min_bin != (SUSCOUNT) -1)
         detector->N0 = .5
-          * (detector->spmin[min_pwr_bin] + detector->spmax[min_pwr_bin]);
+          * (detector->spmin[stats.min_bin] + detector->spmax[stats.min_bin]);
     }
 
     /* Check whether max age has been reached and clear channel list */
@@ -801,6 +1470,8 @@ su_channel_perform_discovery(su_channel_detector_t *detector)
       return SU_FALSE;
 
     su_channel_detector_channel_collect(detector);
+
+    SU_TRYCATCH(su_channel_detector_publish(detector), return SU_FALSE);
   }
 
   return SU_TRUE;
@@ -910,7 +1581,8 @@ su_channel_detect_baudrate_from_nonlinear_diff(su_channel_detector_t *detector)
   int i, N;
   int max_idx;
 
-  SUSCOUNT startbin;
+  SUSDIFF startbin;
+  SUSCOUNT len, p, peak;
   SUFLOAT dbaud;
   SUFLOAT max;
   SUFLOAT equiv_fs;
@@ -975,37 +1647,232 @@ su_channel_detect_baudrate_from_nonlinear_diff(su_channel_detector_t *detector)
     i = 1;
   }
 
-  while (i < N / 2) {
-    if (su_peak_detector_feed(&detector->pd, SU_DB(detector->spect[i])) > 0)
-      if (su_channel_detector_guess_baudrate(
-          detector,
-          equiv_fs,
-          i,
-          detector->params.pd_signif))
-        break;
-    ++i;
+  if (i >= N / 2)
+    return SU_TRUE;
+
+  len = N / 2 - i;
+  for (p = 0; p < len; ++p)
+    detector->pd_db[p] = SU_DB(detector->spect[i + p]);
+
+  /* Peaks, one at a time: the detector stops right after each one */
+  for (p = 0; p < len; ++p) {
+    if (su_peak_detector_feed_bulk(
+        &detector->pd,
+        detector->pd_db + p,
+        len - p,
+        &peak,
+        1) == 0)
+      break;
+
+    p += peak;
+
+    if (su_channel_detector_guess_baudrate(
+        detector,
+        equiv_fs,
+        i + p,
+        detector->params.pd_signif))
+      break;
   }
 
   return SU_TRUE;
 }
 
+/*
+ * Expand the window into the rows of the order estimation FFT, in a single
+ * pass. Row 0 is the nonlinear diff of the signal (as in NONLINEAR_DIFF
+ * mode). Row k is its phase raised to 2^k: amplitude is dropped so that
+ * high powers stay in range and only the constellation phases matter.
+ * The window function is shared by every row.
+ */
+SUPRIVATE void
+su_channel_detector_order_expand(su_channel_detector_t *detector)
+{
+  unsigned int N = detector->params.window_size;
+  unsigned int orders = detector->orders;
+  unsigned int i, k;
+  const SUCOMPLEX *x = detector->window;
+  SU_FFTW(_complex) *row = detector->order_in;
+  SUCOMPLEX prev = detector->prev;
+  SUCOMPLEX diff, u;
+  SUFLOAT gain = detector->params.samp_rate;
+  SUFLOAT mag, w;
+
+  for (i = 0; i < N; ++i) {
+    w = SU_C_REAL(detector->window_func[i]);
+
+    diff = gain * (x[i] - prev);
+    prev = x[i];
+    row[i] = w * SU_C_REAL(diff * SU_C_CONJ(diff));
+
+    mag = SU_C_ABS(x[i]);
+    u = mag > 0 ? x[i] / mag : 0;
+
+    for (k = 1; k <= orders; ++k) {
+      u *= u;
+      row[k * N + i] = w * u;
+    }
+  }
+
+  detector->prev = prev;
+}
+
+/*
+ * An M-PSK signal raised to M collapses into a tone at M times its
+ * carrier offset. The order is the smallest power whose averaged
+ * spectrum has a peak pd_signif dB above the pd_size bins at each side
+ * of it (past the main lobe of the window). Comparing against the
+ * surroundings instead of the whole spectrum tells tones apart from the
+ * low-pass lobes of lower order constellations. The offset is ambiguous
+ * beyond +/- fs / (2 M).
+ */
+SUPRIVATE void
+su_channel_detector_estimate_order(su_channel_detector_t *detector)
+{
+  unsigned int N = detector->params.window_size;
+  unsigned int i, k;
+  unsigned int max_idx;
+  unsigned int d, count;
+  const SUFLOAT *spect;
+  SUFLOAT max, side;
+  SUFLOAT equiv_fs;
+  int bin;
+
+  equiv_fs =
+      (SUFLOAT) detector->params.samp_rate
+      / (SUFLOAT) detector->params.decimation;
+
+  detector->order = 0;
+  detector->order_offset = 0;
+
+  for (k = 1; k <= detector->orders; ++k) {
+    spect = detector->spect + k * N;
+    max = 0;
+    max_idx = 0;
+
+    for (i = 0; i < N; ++i)
+      if (spect[i] > max) {
+        max = spect[i];
+        max_idx = i;
+      }
+
+    side = 0;
+    count = 0;
+    for (d = SU_CHANNEL_DETECTOR_ORDER_GUARD + 1;
+         d <= SU_CHANNEL_DETECTOR_ORDER_GUARD + detector->params.pd_size
+         && 2 * d < N;
+         ++d) {
+      side += spect[(max_idx + d) % N] + spect[(max_idx + N - d) % N];
+      count += 2;
+    }
+
+    if (count == 0 || max == 0)
+      continue;
+
+    side /= count;
+
+    if (SU_POWER_DB(max) - SU_POWER_DB(side) > detector->params.pd_signif) {
+      bin = max_idx < N / 2 ? (int) max_idx : (int) max_idx - (int) N;
+      detector->order = 1u << k;
+      detector->order_offset = bin * equiv_fs / (N * detector->order);
+      break;
+    }
+  }
+}
+
 SUINLINE void
 su_channel_detector_apply_window(su_channel_detector_t *detector)
 {
   unsigned int i;
 
-  for (i = detector->next_to_window; i < detector->ptr; ++i)
-    detector->window[i] *= detector->window_func[i];
+  if (detector->params.real)
+    for (i = detector->next_to_window; i < detector->ptr; ++i)
+      detector->window_real[i] *= SU_C_REAL(detector->window_func[i]);
+  else
+    for (i = detector->next_to_window; i < detector->ptr; ++i)
+      detector->window[i] *= detector->window_func[i];
 
   detector->next_to_window = detector->ptr;
 }
 
+/*
+ * Overlapped windows: the oldest sample is at ptr. The DC is removed and
+ * the window function applied on the way to the FFT input.
+ */
+SUINLINE void
+su_channel_detector_window_history(su_channel_detector_t *detector)
+{
+  const SU_FFTW(_complex) *w = detector->window_func;
+  SUSCOUNT size = detector->params.window_size;
+  SUSCOUNT tail = size - detector->ptr;
+  SUCOMPLEX dc = detector->dc;
+  SUFLOAT dc_real = SU_C_REAL(dc);
+  const SUCOMPLEX *old = detector->history;
+  const SUFLOAT *old_real = detector->history_real;
+  unsigned int i;
+
+  if (detector->params.real) {
+    for (i = 0; i < tail; ++i)
+      detector->window_real[i] =
+          (old_real[detector->ptr + i] - dc_real) * SU_C_REAL(w[i]);
+
+    for (i = tail; i < size; ++i)
+      detector->window_real[i] =
+          (old_real[i - tail] - dc_real) * SU_C_REAL(w[i]);
+  } else {
+    for (i = 0; i < tail; ++i)
+      detector->window[i] = (old[detector->ptr + i] - dc) * w[i];
+
+    for (i = tail; i < size; ++i)
+      detector->window[i] = (old[i - tail] - dc) * w[i];
+  }
+}
+
+/*
+ * Power spectrum stage of the SPECTRUM and DISCOVERY modes. Works on the
+ * contents of detector->fft. For real input, only the first
+ * window_size / 2 + 1 bins are valid.
+ */
+SUINLINE SUBOOL
+su_channel_detector_update_spectrum(su_channel_detector_t *detector)
+{
+  unsigned int i;
+  unsigned int bins = detector->params.window_size;
+  SUFLOAT norm = detector->psd_norm;
+
+  if (detector->params.real)
+    bins = detector->params.window_size / 2 + 1;
+
+  if (detector->params.mode == SU_CHANNEL_DETECTOR_MODE_SPECTRUM) {
+    /* Spectrum mode only */
+    ++detector->iters;
+
+    for (i = 0; i < bins; ++i)
+      detector->spect[i] =
+          norm * SU_C_REAL(detector->fft[i] * SU_C_CONJ(detector->fft[i]));
+
+    if (detector->params.real)
+      su_channel_detector_mirror_spectrum(detector);
+
+    return SU_TRUE;
+  }
+
+  /*
+   * Channel detection is based on the analysis of the power spectrum
+   */
+  detector->dc +=
+    SU_CHANNEL_DETECTOR_DC_ALPHA *
+    (detector->fft[0] / detector->params.window_size - detector->dc);
+
+  /* PSD smoothing happens during discovery, in the same pass */
+  return su_channel_perform_discovery(detector);
+}
+
 SUBOOL
 su_channel_detector_exec_fft(su_channel_detector_t *detector)
 {
   unsigned int i;
+  unsigned int size;
   SUFLOAT psd;
-  SUFLOAT wsizeinv = 1. / detector->params.window_size;
   SUFLOAT ac;
 
   if (detector->fft_issued)
@@ -1015,35 +1882,24 @@ su_channel_detector_exec_fft(su_channel_detector_t *detector)
 
   switch (detector->params.mode) {
     case SU_CHANNEL_DETECTOR_MODE_SPECTRUM:
-      /* Spectrum mode only */
-      ++detector->iters;
-      su_channel_detector_apply_window(detector);
-      SU_FFTW(_execute(detector->fft_plan));
-
-      for (i = 0; i < detector->params.window_size; ++i)
-        detector->spect[i] = wsizeinv * SU_C_REAL(detector->fft[i] * SU_C_CONJ(detector->fft[i]));
-
-      return SU_TRUE;
-
     case SU_CHANNEL_DETECTOR_MODE_DISCOVERY:
-      /*
-       * Channel detection is based on the analysis of the power spectrum
-       */
-      su_channel_detector_apply_window(detector);
-
-      SU_FFTW(_execute(detector->fft_plan));
-
-      detector->dc +=
-        SU_CHANNEL_DETECTOR_DC_ALPHA *
-        (detector->fft[0] / detector->params.window_size - detector->dc);
+      if (detector->hop < detector->params.window_size)
+        su_channel_detector_window_history(detector);
+      else
+        su_channel_detector_apply_window(detector);
 
-      /* Update DC component */
-      for (i = 0; i < detector->params.window_size; ++i) {
-        psd = wsizeinv * SU_C_REAL(detector->fft[i] * SU_C_CONJ(detector->fft[i]));
-        detector->spect[i] += detector->params.alpha * (psd - detector->spect[i]);
-      }
+      if (detector->params.real)
+        su_fft_plan_execute_r2c(
+            detector->fft_plan,
+            detector->window_real,
+            detector->fft);
+      else
+        su_fft_plan_execute(
+            detector->fft_plan,
+            detector->window,
+            detector->fft);
 
-      return su_channel_perform_discovery(detector);
+      return su_channel_detector_update_spectrum(detector);
 
     case SU_CHANNEL_DETECTOR_MODE_AUTOCORRELATION:
       /*
@@ -1053,10 +1909,10 @@ su_channel_detector_exec_fft(su_channel_detector_t *detector)
        */
 
       /* Don't apply *any* window function */
-      SU_FFTW(_execute(detector->fft_plan));
+      su_fft_plan_execute(detector->fft_plan, detector->window, detector->fft);
       for (i = 0; i < detector->params.window_size; ++i)
         detector->fft[i] *= SU_C_CONJ(detector->fft[i]);
-      SU_FFTW(_execute(detector->fft_plan_rev));
+      su_fft_plan_execute(detector->fft_plan_rev, detector->fft, detector->ifft);
 
       /* Average result */
       for (i = 0; i < detector->params.window_size; ++i) {
@@ -1078,7 +1934,7 @@ su_channel_detector_exec_fft(su_channel_detector_t *detector)
           detector->window,
           detector->params.window_size);
 
-      SU_FFTW(_execute(detector->fft_plan));
+      su_fft_plan_execute(detector->fft_plan, detector->window, detector->fft);
 
       for (i = 0; i < detector->params.window_size; ++i) {
         psd = SU_C_REAL(detector->fft[i] * SU_C_CONJ(detector->fft[i]));
@@ -1091,6 +1947,32 @@ su_channel_detector_exec_fft(su_channel_detector_t *detector)
 
       break;
 
+    case SU_CHANNEL_DETECTOR_MODE_ORDER_ESTIMATION:
+      /*
+       * Nonlinear diff and powers of the signal, all from the same pass
+       * over the window and transformed by a single batched FFT.
+       */
+      su_channel_detector_order_expand(detector);
+
+      su_fft_plan_execute(
+          detector->order_plan,
+          detector->order_in,
+          detector->order_out);
+
+      size = (detector->orders + 1) * detector->params.window_size;
+      for (i = 0; i < size; ++i) {
+        psd = SU_C_REAL(
+            detector->order_out[i] * SU_C_CONJ(detector->order_out[i]));
+        psd /= detector->params.window_size;
+        detector->spect[i] +=
+            detector->params.alpha * (psd - detector->spect[i]);
+      }
+
+      su_channel_detector_estimate_order(detector);
+
+      /* Row 0 is the nonlinear diff spectrum */
+      return su_channel_detect_baudrate_from_nonlinear_diff(detector);
+
     default:
       SU_WARNING("Mode not implemented\n");
       return SU_FALSE;
@@ -1099,32 +1981,219 @@ su_channel_detector_exec_fft(su_channel_detector_t *detector)
   return SU_TRUE;
 }
 
+/* Performs the FFT if the window is full */
 SUINLINE SUBOOL
-su_channel_detector_feed_internal(su_channel_detector_t *detector, SUCOMPLEX x)
+su_channel_detector_end_window(su_channel_detector_t *detector)
 {
-  SUCOMPLEX diff;
-
-  /* In nonlinear diff mode, we store something else in the window */
-  if (detector->params.mode == SU_CHANNEL_DETECTOR_MODE_NONLINEAR_DIFF) {
-     diff = (x - detector->prev) * detector->params.samp_rate;
-     detector->prev = x;
-     x = diff * SU_C_CONJ(diff);
-  }
+  SUBOOL ok = SU_TRUE;
 
-  detector->window[detector->ptr++] = x - detector->dc;
   detector->fft_issued = SU_FALSE;
 
   if (detector->ptr == detector->params.window_size) {
-    /* Window is full, perform FFT */
-    SU_TRYCATCH(
-        su_channel_detector_exec_fft(detector),
-        return SU_FALSE);
+    ok = su_channel_detector_exec_fft(detector);
 
     detector->ptr = 0;
     detector->next_to_window = 0;
   }
 
-  return SU_TRUE;
+  return ok;
+}
+
+/*
+ * Copies samples up to the end of the current window straight into
+ * detector->window, removing the DC and applying the mode-specific
+ * transform on the way, and runs the FFT stage if the window is complete.
+ * Returns the number of samples consumed, -1 if the FFT stage failed.
+ */
+SUPRIVATE SUSDIFF
+su_channel_detector_feed_span(
+    su_channel_detector_t *detector,
+    const SUCOMPLEX *signal,
+    SUSCOUNT size)
+{
+  SUSCOUNT chunk = detector->params.window_size - detector->ptr;
+  SU_FFTW(_complex) *dest = detector->window + detector->ptr;
+  SUSCOUNT i;
+
+  if (chunk > size)
+    chunk = size;
+
+  switch (detector->params.mode) {
+    case SU_CHANNEL_DETECTOR_MODE_SPECTRUM:
+    case SU_CHANNEL_DETECTOR_MODE_DISCOVERY:
+      /* Windowed right away: nothing left for exec_fft */
+      su_simd_window(
+          dest,
+          signal,
+          detector->dc,
+          detector->window_func + detector->ptr,
+          chunk);
+      detector->next_to_window = detector->ptr + chunk;
+      break;
+
+    case SU_CHANNEL_DETECTOR_MODE_NONLINEAR_DIFF:
+      /* In nonlinear diff mode, we store something else in the window */
+      detector->prev = su_simd_nonlinear_diff(
+          dest,
+          signal,
+          detector->prev,
+          detector->params.samp_rate,
+          detector->dc,
+          chunk);
+      break;
+
+    default:
+      for (i = 0; i < chunk; ++i)
+        dest[i] = signal[i] - detector->dc;
+  }
+
+  detector->ptr += chunk;
+
+  if (!su_channel_detector_end_window(detector))
+    return -1;
+
+  return chunk;
+}
+
+SUPRIVATE SUSDIFF
+su_channel_detector_feed_span_real(
+    su_channel_detector_t *detector,
+    const SUFLOAT *signal,
+    SUSCOUNT size)
+{
+  SUSCOUNT chunk = detector->params.window_size - detector->ptr;
+  SUFLOAT *dest = detector->window_real + detector->ptr;
+  const SU_FFTW(_complex) *w = detector->window_func + detector->ptr;
+  SUFLOAT dc = SU_C_REAL(detector->dc);
+  SUSCOUNT i;
+
+  if (chunk > size)
+    chunk = size;
+
+  for (i = 0; i < chunk; ++i)
+    dest[i] = (signal[i] - dc) * SU_C_REAL(w[i]);
+
+  detector->ptr += chunk;
+  detector->next_to_window = detector->ptr;
+
+  if (!su_channel_detector_end_window(detector))
+    return -1;
+
+  return chunk;
+}
+
+/*
+ * Overlapped windows: samples go to the circular buffer, and a window is
+ * transformed every hop samples. Exactly one of signal and signal_real
+ * is used. Returns the number of samples consumed.
+ */
+SUPRIVATE SUSCOUNT
+su_channel_detector_feed_history(
+    su_channel_detector_t *detector,
+    const SUCOMPLEX *signal,
+    const SUFLOAT *signal_real,
+    SUSCOUNT size)
+{
+  SUSCOUNT window_size = detector->params.window_size;
+  SUSCOUNT chunk;
+  SUSCOUNT i = 0;
+
+  while (i < size) {
+    chunk = SU_MIN(size - i, detector->to_frame);
+    chunk = SU_MIN(chunk, window_size - detector->ptr);
+
+    if (signal_real != NULL)
+      memcpy(
+          detector->history_real + detector->ptr,
+          signal_real + i,
+          chunk * sizeof(SUFLOAT));
+    else
+      memcpy(
+          detector->history + detector->ptr,
+          signal + i,
+          chunk * sizeof(SUCOMPLEX));
+
+    detector->ptr += chunk;
+    if (detector->ptr == window_size)
+      detector->ptr = 0;
+
+    detector->to_frame -= chunk;
+    detector->fft_issued = SU_FALSE;
+    i += chunk;
+
+    if (detector->to_frame == 0) {
+      detector->to_frame = detector->hop;
+      SU_TRYCATCH(su_channel_detector_exec_fft(detector), return i - 1);
+    }
+  }
+
+  return i;
+}
+
+/*
+ * Batches can only be processed at window boundaries, and only if there
+ * are enough samples to fill all windows in the batch.
+ */
+SUINLINE SUBOOL
+su_channel_detector_can_batch(
+    const su_channel_detector_t *detector,
+    SUSCOUNT size)
+{
+  return detector->batch_plan != NULL
+      && detector->ptr == 0
+      && (detector->params.mode == SU_CHANNEL_DETECTOR_MODE_SPECTRUM
+        || detector->params.mode == SU_CHANNEL_DETECTOR_MODE_DISCOVERY)
+      && size >= detector->params.batch * detector->params.window_size;
+}
+
+/*
+ * Transforms params.batch consecutive windows with a single plan execution,
+ * and then runs the spectrum stage on each of them. Since the DC estimate
+ * is updated after every window, the DC is removed in the frequency
+ * domain: FFT(w (x - dc)) = FFT(w x) - dc FFT(w).
+ *
+ * Returns the number of samples consumed. Less than a full batch means
+ * that processing of a window failed.
+ */
+SUPRIVATE SUSCOUNT
+su_channel_detector_feed_batch(
+    su_channel_detector_t *detector,
+    const SUCOMPLEX *signal)
+{
+  SUSCOUNT window_size = detector->params.window_size;
+  unsigned int batch = detector->params.batch;
+  const SU_FFTW(_complex) *spectrum;
+  SU_FFTW(_complex) *dest;
+  unsigned int i, j;
+
+  for (i = 0; i < batch; ++i) {
+    dest = detector->batch_in + i * window_size;
+    for (j = 0; j < window_size; ++j)
+      dest[j] = signal[j] * detector->window_func[j];
+    signal += window_size;
+  }
+
+  su_fft_plan_execute(
+      detector->batch_plan,
+      detector->batch_in,
+      detector->batch_out);
+
+  for (i = 0; i < batch; ++i) {
+    spectrum = detector->batch_out + i * window_size;
+
+    if (detector->dc != 0)
+      for (j = 0; j < window_size; ++j)
+        detector->fft[j] = spectrum[j] - detector->dc * detector->window_fft[j];
+    else
+      memcpy(detector->fft, spectrum, window_size * sizeof(SUCOMPLEX));
+
+    detector->fft_issued = SU_TRUE;
+
+    if (!su_channel_detector_update_spectrum(detector))
+      return (i + 1) * window_size - 1;
+  }
+
+  return batch * window_size;
 }
 
 SUSCOUNT
@@ -1136,8 +2205,13 @@ su_channel_detector_feed_bulk(
   unsigned int i;
   const SUCOMPLEX *tuned_signal;
   SUSCOUNT tuned_size;
+  SUSCOUNT got;
+  SUSDIFF spanned;
   SUSDIFF result;
 
+  SU_TRYCATCH(!detector->params.real, return 0);
+  SU_TRYCATCH(detector->st == NULL, return 0);
+
   if (detector->params.tune) {
     su_softtuner_feed(&detector->tuner, signal, size);
 
@@ -1153,13 +2227,257 @@ su_channel_detector_feed_bulk(
     tuned_size   = size;
   }
 
-  for (i = 0; i < tuned_size; ++i)
-    if (!su_channel_detector_feed_internal(detector, tuned_signal[i]))
+  if (detector->hop < detector->params.window_size)
+    return su_channel_detector_feed_history(
+        detector,
+        tuned_signal,
+        NULL,
+        tuned_size);
+
+  i = 0;
+
+  while (i < tuned_size) {
+    if (su_channel_detector_can_batch(detector, tuned_size - i)) {
+      got = su_channel_detector_feed_batch(detector, tuned_signal + i);
+      i += got;
+
+      if (got < detector->params.batch * detector->params.window_size)
+        break;
+    } else {
+      if ((spanned = su_channel_detector_feed_span(
+          detector,
+          tuned_signal + i,
+          tuned_size - i)) < 0)
+        break;
+      i += spanned;
+    }
+  }
+
+  return i;
+}
+
+SUSCOUNT
+su_channel_detector_feed_bulk_real(
+    su_channel_detector_t *detector,
+    const SUFLOAT *signal,
+    SUSCOUNT size)
+{
+  SUSCOUNT i = 0;
+  SUSDIFF got;
+
+  SU_TRYCATCH(detector->params.real, return 0);
+  SU_TRYCATCH(detector->st == NULL, return 0);
+
+  if (detector->hop < detector->params.window_size)
+    return su_channel_detector_feed_history(detector, NULL, signal, size);
+
+  while (i < size) {
+    if ((got = su_channel_detector_feed_span_real(
+        detector,
+        signal + i,
+        size - i)) < 0)
       break;
+    i += got;
+  }
 
   return i;
 }
 
+/*
+ * Bin k of a spectrum, for k up to win_terms bins out of range. Real input
+ * only has bins 0 to window_size / 2: the rest are the conjugates of their
+ * Hermitian mirror.
+ */
+SUINLINE SUCOMPLEX
+su_channel_detector_get_bin(
+    const su_channel_detector_t *detector,
+    const SUCOMPLEX *fft,
+    SUSDIFF k)
+{
+  SUSDIFF N = detector->params.window_size;
+
+  if (k < 0)
+    k += N;
+  else if (k >= N)
+    k -= N;
+
+  if (detector->params.real && k > N / 2)
+    return SU_C_CONJ(fft[N - k]);
+
+  return fft[k];
+}
+
+/*
+ * FFT(w (x - dc)) from FFT(x), into detector->fft. Only the bins near the
+ * edges of the spectrum need to wrap around. The DC leaves its mark on the
+ * nonzero bins of the spectrum of the window only.
+ */
+SUPRIVATE void
+su_channel_detector_window_spectrum(
+    su_channel_detector_t *detector,
+    const SUCOMPLEX *fft)
+{
+  const SUFLOAT *c = detector->win_kernel;
+  SUSDIFF terms = detector->win_terms;
+  SUSDIFF N = detector->params.window_size;
+  SUSDIFF bins = detector->params.real ? N / 2 + 1 : N;
+  SUCOMPLEX dc = detector->dc;
+  SUCOMPLEX acc;
+  SUSDIFF k, m;
+
+  if (detector->params.real)
+    dc = SU_C_REAL(dc);
+
+  for (k = 0; k < bins; ++k) {
+    acc = c[0] * fft[k];
+
+    if (k >= terms - 1 && k + terms - 1 < bins)
+      for (m = 1; m < terms; ++m)
+        acc += c[m] * (fft[k - m] + fft[k + m]);
+    else
+      for (m = 1; m < terms; ++m)
+        acc += c[m] * (
+            su_channel_detector_get_bin(detector, fft, k - m)
+            + su_channel_detector_get_bin(detector, fft, k + m));
+
+    detector->fft[k] = acc;
+  }
+
+  if (dc != 0) {
+    detector->fft[0] -= N * c[0] * dc;
+
+    for (m = 1; m < terms; ++m) {
+      detector->fft[m] -= N * c[m] * dc;
+      if (!detector->params.real)
+        detector->fft[N - m] -= N * c[m] * dc;
+    }
+  }
+}
+
+SUBOOL
+su_channel_detector_feed_spectrum(
+    su_channel_detector_t *detector,
+    const SUCOMPLEX *fft)
+{
+  SU_TRYCATCH(
+      detector->params.mode == SU_CHANNEL_DETECTOR_MODE_SPECTRUM
+      || detector->params.mode == SU_CHANNEL_DETECTOR_MODE_DISCOVERY,
+      return SU_FALSE);
+
+  su_channel_detector_window_spectrum(detector, fft);
+
+  detector->fft_issued = SU_TRUE;
+
+  return su_channel_detector_update_spectrum(detector);
+}
+
+/* Whether some open tuner channel contains f0 (angular frequency) */
+SUPRIVATE SUBOOL
+su_channel_detector_is_tuned(
+    const su_channel_detector_t *detector,
+    SUFLOAT f0)
+{
+  const su_specttuner_t *st = detector->st;
+  const su_specttuner_channel_t *channel;
+  SUFLOAT delta;
+  unsigned int i;
+
+  for (i = 0; i < st->channel_count; ++i) {
+    if ((channel = st->channel_list[i]) == NULL)
+      continue;
+
+    delta = SU_ABS(f0 - channel->params.f0);
+    if (delta > PI)
+      delta = 2 * PI - delta;
+
+    if (delta < .5 * channel->params.bw)
+      return SU_TRUE;
+  }
+
+  return SU_FALSE;
+}
+
+SUPRIVATE SUBOOL
+su_channel_detector_open_channels(su_channel_detector_t *detector)
+{
+  struct sigutils_specttuner_channel_params params = detector->auto_params;
+  const struct sigutils_channel *chan;
+  SUFLOAT fs = detector->params.samp_rate;
+  unsigned int i;
+
+  for (i = 0; i < detector->channel_count; ++i) {
+    chan = detector->channel_list[i];
+
+    if (!SU_CHANNEL_IS_VALID(chan))
+      continue;
+
+    params.f0 = SU_NORM2ANG_FREQ(SU_ABS2NORM_FREQ(fs, chan->fc));
+    if (params.f0 < 0)
+      params.f0 += 2 * PI;
+
+    if (su_channel_detector_is_tuned(detector, params.f0))
+      continue;
+
+    params.bw = SU_NORM2ANG_FREQ(SU_ABS2NORM_FREQ(fs, chan->bw));
+
+    SU_TRYCATCH(
+        su_specttuner_open_channel(detector->st, &params) != NULL,
+        return SU_FALSE);
+  }
+
+  return SU_TRUE;
+}
+
+SUPRIVATE SUBOOL
+su_channel_detector_on_spectrum(
+    su_specttuner_t *st,
+    void *privdata,
+    const SUCOMPLEX *fft)
+{
+  su_channel_detector_t *detector = (su_channel_detector_t *) privdata;
+
+  SU_TRYCATCH(
+      su_channel_detector_feed_spectrum(detector, fft),
+      return SU_FALSE);
+
+  if (detector->auto_open)
+    SU_TRYCATCH(su_channel_detector_open_channels(detector), return SU_FALSE);
+
+  return SU_TRUE;
+}
+
+SUBOOL
+su_channel_detector_attach_specttuner(
+    su_channel_detector_t *detector,
+    su_specttuner_t *st,
+    const struct sigutils_specttuner_channel_params *auto_params)
+{
+  SU_TRYCATCH(detector->st == NULL, return SU_FALSE);
+  SU_TRYCATCH(st->on_spectrum == NULL, return SU_FALSE);
+  SU_TRYCATCH(
+      su_channel_detector_params_can_share(&detector->params, st),
+      return SU_FALSE);
+
+  detector->st = st;
+  detector->auto_open = auto_params != NULL;
+  if (auto_params != NULL)
+    detector->auto_params = *auto_params;
+
+  su_specttuner_set_spectrum_cb(st, su_channel_detector_on_spectrum, detector);
+
+  return SU_TRUE;
+}
+
+void
+su_channel_detector_detach_specttuner(su_channel_detector_t *detector)
+{
+  if (detector->st != NULL) {
+    su_specttuner_set_spectrum_cb(detector->st, NULL, NULL);
+    detector->st = NULL;
+    detector->auto_open = SU_FALSE;
+  }
+}
+
 SUBOOL
 su_channel_detector_feed(su_channel_detector_t *detector, SUCOMPLEX x)
 {
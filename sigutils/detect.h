@@ -21,10 +21,14 @@
 #ifndef _SIGUTILS_DETECT_H
 #define _SIGUTILS_DETECT_H
 
+#include <pthread.h>
+
 #include "sigutils.h"
 #include "ncqo.h"
 #include "iir.h"
 #include "softtune.h"
+#include "fftplan.h"
+#include "specttuner.h"
 
 #ifdef __cplusplus
 #  ifdef __clang__
@@ -45,6 +49,8 @@ extern "C" {
 #define SU_CHANNEL_DETECTOR_PEAK_PSD_ALPHA   SU_ADDSFX(.25)
 #define SU_CHANNEL_DETECTOR_DC_ALPHA         SU_ADDSFX(.1)
 #define SU_CHANNEL_DETECTOR_AVG_TIME_WINDOW  SU_ADDSFX(10.) /* In seconds */
+#define SU_CHANNEL_DETECTOR_ORDER_GUARD      4 /* Main lobe of tones, in bins */
+#define SU_CHANNEL_DETECTOR_WINDOW_TERMS     5 /* Max cosine terms of windows */
 
 #define SU_CHANNEL_IS_VALID(cp)                               \
         ((cp)->age > SU_CHANNEL_DETECTOR_MIN_MAJORITY_AGE     \
@@ -56,6 +62,13 @@ extern "C" {
               (detector)->params.samp_rate * (detector)->params.decimation, \
               2 * (SUFLOAT) (i) / (SUFLOAT) (detector)->params.window_size)
 
+/*
+ * Running mean and variance of the last `size` samples are kept as sums
+ * of the samples shifted by `center`, updated in O(1) per sample. The
+ * center is moved to the current mean every `size` samples, and the sums
+ * are recomputed from the history, so that rounding errors never build
+ * up and the shifted sums stay small.
+ */
 struct sigutils_peak_detector {
   unsigned int size;
   SUFLOAT thr2; /* In sigmas */
@@ -64,8 +77,10 @@ struct sigutils_peak_detector {
   SUFLOAT *history;
   unsigned int p;
   unsigned int count;
-  SUFLOAT accum; /* Scaled mean */
+  SUFLOAT accum; /* Sum of (x - center) */
   SUFLOAT inv_size; /* 1. / size */
+  SUFLOAT accum2; /* Sum of (x - center)^2 */
+  SUFLOAT center;
 };
 
 typedef struct sigutils_peak_detector su_peak_detector_t;
@@ -79,6 +94,8 @@ typedef struct sigutils_peak_detector su_peak_detector_t;
   0, /* count */                        \
   0, /* accum */                        \
   0, /* inv_size */                     \
+  0, /* accum2 */                       \
+  0, /* center */                       \
 }
 
 enum sigutils_channel_detector_mode {
@@ -119,8 +136,27 @@ struct sigutils_channel_detector_params {
   SUSCOUNT pd_size;   /* PD samples */
   SUFLOAT  pd_thres;  /* PD threshold, in sigmas */
   SUFLOAT  pd_signif; /* Minimum significance, in dB */
+
+  /* Windows per FFT in feed_bulk (0 or 1: no batch) */
+  unsigned int batch;
+
+  /* Real input, use feed_bulk_real (SPECTRUM and DISCOVERY, no tune) */
+  SUBOOL real;
+
+  /*
+   * Samples between consecutive windows (0: window_size). Values below
+   * window_size overlap windows (SPECTRUM and DISCOVERY only)
+   */
+  SUSCOUNT hop;
 };
 
+/*
+ * Batching delays results by batch windows, so it is off by default.
+ * Offline or bulk consumers may use SU_CHANNEL_DETECTOR_THROUGHPUT_BATCH.
+ */
+#define SU_CHANNEL_DETECTOR_DEFAULT_BATCH    1
+#define SU_CHANNEL_DETECTOR_THROUGHPUT_BATCH 4
+
 #define sigutils_channel_detector_params_INITIALIZER            \
 {                                                               \
   SU_CHANNEL_DETECTOR_MODE_SPECTRUM, /* Mode */                 \
@@ -139,7 +175,10 @@ struct sigutils_channel_detector_params {
   SU_CHANNEL_MAX_AGE,        /* max_age */                      \
   10,       /* pd_samples */                                    \
   SU_ADDSFX(2.),       /* pd_thres */                           \
-  SU_ADDSFX(10.)       /* pd_signif */                          \
+  SU_ADDSFX(10.),      /* pd_signif */                          \
+  SU_CHANNEL_DETECTOR_DEFAULT_BATCH, /* batch */                \
+  SU_FALSE, /* real */                                          \
+  0,        /* hop */                                           \
 }
 
 #define sigutils_channel_INITIALIZER    \
@@ -156,6 +195,24 @@ struct sigutils_channel_detector_params {
   0,    /* present */                   \
 }
 
+/*
+ * Copy of the channel list, sorted by center frequency. Readers on other
+ * threads keep their own snapshot and refresh it with
+ * su_channel_detector_get_snapshot.
+ */
+struct sigutils_channel_snapshot {
+  struct sigutils_channel *channel_list;
+  unsigned int channel_count;
+  unsigned int channel_alloc;
+  unsigned int generation; /* Discovery run the channels belong to */
+};
+
+typedef struct sigutils_channel_snapshot su_channel_snapshot_t;
+
+#define su_channel_snapshot_INITIALIZER {NULL, 0, 0, 0}
+
+#define SU_CHANNEL_DETECTOR_POOL_SLAB 64 /* Channels per pool allocation */
+
 struct sigutils_channel_detector {
   /* Common members */
   struct sigutils_channel_detector_params params;
@@ -168,10 +225,44 @@ struct sigutils_channel_detector {
   unsigned int chan_age;
   SU_FFTW(_complex) *window_func;
   SU_FFTW(_complex) *window;
-  SU_FFTW(_plan) fft_plan;
+  SUFLOAT *window_real; /* Used instead of window if params.real */
+  su_fft_plan_t *fft_plan;
   SU_FFTW(_complex) *fft;
   SUSCOUNT req_samples; /* Number of required samples for detection */
-
+  SUFLOAT psd_norm; /* 1 / window energy */
+
+  /*
+   * Spectra computed elsewhere (su_channel_detector_feed_spectrum) are not
+   * windowed. Window functions are sums of cosines, and are applied as a
+   * convolution with the 2 * win_terms - 1 bins of the spectrum of their
+   * periodic version: win_kernel[m] is the weight of bins k - m and k + m.
+   */
+  SUFLOAT win_kernel[SU_CHANNEL_DETECTOR_WINDOW_TERMS];
+  unsigned int win_terms;
+
+  /* Spectral tuner the FFT is taken from, if attached */
+  su_specttuner_t *st;
+  SUBOOL auto_open; /* Open tuner channels for discovered carriers */
+  struct sigutils_specttuner_channel_params auto_params;
+
+  /*
+   * Overlapped windows (hop < window_size). Raw samples are kept in a
+   * circular buffer of window_size samples (ptr being the write position)
+   * and the window function is applied while copying them to the FFT
+   * input. No other copies are made.
+   */
+  SUSCOUNT hop;
+  SUSCOUNT to_frame; /* Samples until the next window */
+  SUCOMPLEX *history;
+  SUFLOAT *history_real;
+
+  /* Batch mode (SPECTRUM and DISCOVERY only) */
+  SU_FFTW(_complex) *batch_in;
+  SU_FFTW(_complex) *batch_out;
+  su_fft_plan_t *batch_plan;
+  SU_FFTW(_complex) *window_fft; /* FFT of window_func, for DC removal */
+
+  /* ORDER_ESTIMATION keeps orders + 1 rows of window_size bins in spect */
   union {
     SUFLOAT *spect; /* Used only if mode == DISCOVERY, NONLINEAR_DIFF */
     SUFLOAT *acorr; /* Used only if mode == AUTOCORRELATION */
@@ -179,18 +270,48 @@ struct sigutils_channel_detector {
   };
 
   /* Channel detector members */
-  SU_FFTW(_plan) fft_plan_rev;
+  su_fft_plan_t *fft_plan_rev;
   SU_FFTW(_complex) *ifft;
   SUFLOAT *spmax;
   SUFLOAT *spmin;
   SUFLOAT N0; /* Detected noise floor */
   SUCOMPLEX dc; /* Detected DC component */
-  PTR_LIST(struct sigutils_channel, channel);
+
+  /*
+   * Channel store. channel_list is sorted by center frequency and has no
+   * holes, so that lookups are binary searches. Channels are taken from
+   * a pool of slabs and recycled.
+   */
+  struct sigutils_channel **channel_list;
+  unsigned int channel_count;
+  unsigned int channel_alloc;
+  SUFLOAT channel_max_halfbw; /* Upper bound of bw / 2 of every channel */
+  PTR_LIST(struct sigutils_channel, chan_slab);
+  struct sigutils_channel **chan_free; /* Recycled channels */
+  unsigned int chan_free_count;
+
+  /* Channel list as of the last discovery run */
+  pthread_mutex_t snapshot_mutex;
+  SUBOOL snapshot_init;
+  su_channel_snapshot_t snapshot;
 
   /* Baudrate estimator members */
   SUFLOAT baud; /* Detected baudrate */
   SUCOMPLEX prev; /* Used by nonlinear diff */
   su_peak_detector_t pd; /* Peak detector used by nonlinear diff */
+  SUFLOAT *pd_db; /* Half spectrum in dB, as fed to the peak detector */
+
+  /*
+   * Order estimator members. Every window is expanded into orders + 1
+   * rows that go through a single batched FFT: the nonlinear diff (for
+   * the baudrate) and the phase of the signal raised to 2, 4 ... 2^orders
+   */
+  unsigned int orders;
+  SU_FFTW(_complex) *order_in;
+  SU_FFTW(_complex) *order_out;
+  su_fft_plan_t *order_plan;
+  unsigned int order;   /* Detected constellation order (0: unknown) */
+  SUFLOAT order_offset; /* Carrier offset, from the power of the order */
 };
 
 typedef struct sigutils_channel_detector su_channel_detector_t;
@@ -200,6 +321,7 @@ su_channel_detector_rewind(su_channel_detector_t *cd)
 {
   cd->ptr = 0;
   cd->iters = 0;
+  cd->to_frame = cd->params.window_size;
 }
 
 SUINLINE unsigned int
@@ -232,6 +354,19 @@ su_channel_detector_get_baud(const su_channel_detector_t *cd)
   return cd->baud;
 }
 
+/* Only in ORDER_ESTIMATION mode. 0 if no order has been found yet */
+SUINLINE unsigned int
+su_channel_detector_get_order(const su_channel_detector_t *cd)
+{
+  return cd->order;
+}
+
+SUINLINE SUFLOAT
+su_channel_detector_get_order_offset(const su_channel_detector_t *cd)
+{
+  return cd->order_offset;
+}
+
 SUINLINE SUFLOAT
 su_channel_detector_get_window_size(const su_channel_detector_t *cd)
 {
@@ -246,6 +381,18 @@ SUBOOL su_peak_detector_init(
 
 int su_peak_detector_feed(su_peak_detector_t *pd, SUFLOAT x);
 
+/*
+ * Feed up to len samples, stopping right after the max-th sample above
+ * the threshold (i.e. for which su_peak_detector_feed would return 1).
+ * Their indices are written to peaks, and their number is returned.
+ */
+SUSCOUNT su_peak_detector_feed_bulk(
+    su_peak_detector_t *pd,
+    const SUFLOAT *x,
+    SUSCOUNT len,
+    SUSCOUNT *peaks,
+    SUSCOUNT max);
+
 void su_peak_detector_finalize(su_peak_detector_t *pd);
 
 /************************** Channel detector API ****************************/
@@ -272,11 +419,57 @@ SUSCOUNT su_channel_detector_feed_bulk(
     const SUCOMPLEX *signal,
     SUSCOUNT size);
 
+SUSCOUNT su_channel_detector_feed_bulk_real(
+    su_channel_detector_t *detector,
+    const SUFLOAT *signal,
+    SUSCOUNT size);
+
+/*
+ * Run the spectrum stage on the unwindowed FFT of the last window_size
+ * samples (only bins 0 to window_size / 2 for real input), instead of
+ * transforming samples fed to the detector. DC removal and the window
+ * function are applied in the frequency domain. SPECTRUM and DISCOVERY
+ * modes only.
+ */
+SUBOOL su_channel_detector_feed_spectrum(
+    su_channel_detector_t *detector,
+    const SUCOMPLEX *fft);
+
+/*
+ * Shared FFT: the detector consumes every spectrum computed by the tuner,
+ * i.e. windows of window_size samples overlapped by half, and must not be
+ * fed samples of its own. Window size and sample type of both must match.
+ *
+ * If auto_params is not NULL, a tuner channel is opened (with
+ * su_specttuner_open_channel, from the feeding thread) for every valid
+ * channel whose center frequency is not covered by any open channel yet.
+ * f0 and bw are taken from the discovered channel, the rest from
+ * auto_params. Opened channels belong to the tuner, and the detector never
+ * closes them. The detector must be detached before destroying the tuner.
+ */
+SUBOOL su_channel_detector_attach_specttuner(
+    su_channel_detector_t *detector,
+    su_specttuner_t *st,
+    const struct sigutils_specttuner_channel_params *auto_params);
+
+void su_channel_detector_detach_specttuner(su_channel_detector_t *detector);
+
+/* Live channel list, sorted by frequency. Detector thread only */
 void su_channel_detector_get_channel_list(
     const su_channel_detector_t *detector,
     struct sigutils_channel ***channel_list,
     unsigned int *channel_count);
 
+/*
+ * Copies the channel list published by the last discovery run into snap,
+ * unless snap is already up to date. Safe to call from any thread.
+ */
+SUBOOL su_channel_detector_get_snapshot(
+    su_channel_detector_t *detector,
+    su_channel_snapshot_t *snap);
+
+void su_channel_snapshot_finalize(su_channel_snapshot_t *snap);
+
 void su_channel_params_adjust(struct sigutils_channel_detector_params *params);
 
 void su_channel_params_adjust_to_channel(
@@ -287,6 +480,7 @@ struct sigutils_channel *su_channel_dup(const struct sigutils_channel *channel);
 
 void su_channel_destroy(struct sigutils_channel *channel);
 
+/* Channel containing fc whose center is closest to it, NULL if none */
 struct sigutils_channel *su_channel_detector_lookup_channel(
     const su_channel_detector_t *detector,
     SUFLOAT fc);
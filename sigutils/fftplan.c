@@ -0,0 +1,339 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#define SU_LOG_DOMAIN "fftplan"
+
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "log.h"
+#include "fftplan.h"
+
+/*
+ * Plans are never destroyed once created: a released plan remains in the
+ * registry with refcnt == 0, so reopening channels of the same size (e.g.
+ * during frequency hopping) never hits the planner again.
+ */
+PTR_LIST(SUPRIVATE su_fft_plan_t, fft_plan);
+
+SUPRIVATE pthread_mutex_t g_fft_plan_mutex = PTHREAD_MUTEX_INITIALIZER;
+SUPRIVATE enum sigutils_fft_plan_mode g_fft_plan_mode =
+    SU_FFT_PLAN_MODE_ESTIMATE;
+SUPRIVATE char *g_fft_plan_wisdom_file = NULL;
+
+SUPRIVATE unsigned int
+su_fft_plan_mode_to_flags(enum sigutils_fft_plan_mode mode)
+{
+  switch (mode) {
+    case SU_FFT_PLAN_MODE_MEASURE:
+      return FFTW_MEASURE;
+
+    case SU_FFT_PLAN_MODE_PATIENT:
+      return FFTW_PATIENT;
+
+    default:
+      return FFTW_ESTIMATE;
+  }
+}
+
+SUPRIVATE SUBOOL
+su_fft_plan_key_equals(
+    const struct sigutils_fft_plan_key *a,
+    const struct sigutils_fft_plan_key *b)
+{
+  return a->size == b->size
+      && a->howmany == b->howmany
+      && a->sign == b->sign
+      && a->real == b->real
+      && a->inplace == b->inplace
+      && a->unaligned == b->unaligned;
+}
+
+/* Must be called with the registry mutex held */
+SUPRIVATE SUBOOL
+su_fft_plan_save_wisdom_unsafe(void)
+{
+  if (g_fft_plan_wisdom_file == NULL)
+    return SU_TRUE;
+
+  if (!SU_FFTW(_export_wisdom_to_filename)(g_fft_plan_wisdom_file)) {
+    SU_WARNING("Failed to save FFTW wisdom to %s\n", g_fft_plan_wisdom_file);
+    return SU_FALSE;
+  }
+
+  return SU_TRUE;
+}
+
+SUPRIVATE void
+su_fft_plan_destroy(su_fft_plan_t *plan)
+{
+  if (plan->plan != NULL)
+    SU_FFTW(_destroy_plan) (plan->plan);
+
+  free(plan);
+}
+
+/* Must be called with the registry mutex held */
+SUPRIVATE su_fft_plan_t *
+su_fft_plan_new_unsafe(const struct sigutils_fft_plan_key *key)
+{
+  su_fft_plan_t *new = NULL;
+  SU_FFTW(_complex) *in = NULL;
+  SU_FFTW(_complex) *out = NULL;
+  unsigned int flags = su_fft_plan_mode_to_flags(g_fft_plan_mode);
+  unsigned int length = key->size * key->howmany;
+  int n = key->size;
+
+  if (key->unaligned)
+    flags |= FFTW_UNALIGNED;
+
+  SU_TRYCATCH(new = calloc(1, sizeof(su_fft_plan_t)), goto fail);
+
+  new->key = *key;
+
+  /*
+   * Measuring planners overwrite their buffers. Plan on scratch
+   * memory so callers never lose data.
+   */
+  SU_TRYCATCH(
+      in = SU_FFTW(_malloc)(length * sizeof(SU_FFTW(_complex))),
+      goto fail);
+
+  if (key->inplace)
+    out = in;
+  else
+    SU_TRYCATCH(
+        out = SU_FFTW(_malloc)(length * sizeof(SU_FFTW(_complex))),
+        goto fail);
+
+  if (key->real) {
+    SU_TRYCATCH(
+        new->plan = SU_FFTW(_plan_dft_r2c_1d)(n, (SUFLOAT *) in, out, flags),
+        goto fail);
+  } else if (key->howmany == 1) {
+    SU_TRYCATCH(
+        new->plan = SU_FFTW(_plan_dft_1d)(n, in, out, key->sign, flags),
+        goto fail);
+  } else {
+    SU_TRYCATCH(
+        new->plan = SU_FFTW(_plan_many_dft)(
+            1,
+            &n,
+            key->howmany,
+            in,
+            NULL,
+            1,
+            n,
+            out,
+            NULL,
+            1,
+            n,
+            key->sign,
+            flags),
+        goto fail);
+  }
+
+  if (g_fft_plan_mode != SU_FFT_PLAN_MODE_ESTIMATE)
+    (void) su_fft_plan_save_wisdom_unsafe();
+
+  SU_FFTW(_free) (in);
+  if (out != in)
+    SU_FFTW(_free) (out);
+
+  return new;
+
+fail:
+  if (out != NULL && out != in)
+    SU_FFTW(_free) (out);
+
+  if (in != NULL)
+    SU_FFTW(_free) (in);
+
+  if (new != NULL)
+    su_fft_plan_destroy(new);
+
+  return NULL;
+}
+
+SUPRIVATE su_fft_plan_t *
+su_fft_plan_acquire_by_key(const struct sigutils_fft_plan_key *key)
+{
+  su_fft_plan_t *this = NULL;
+  su_fft_plan_t *new = NULL;
+  unsigned int i;
+
+  pthread_mutex_lock(&g_fft_plan_mutex);
+
+  FOR_EACH_PTR(this, i, fft_plan)
+    if (su_fft_plan_key_equals(&this->key, key)) {
+      ++this->refcnt;
+      pthread_mutex_unlock(&g_fft_plan_mutex);
+      return this;
+    }
+
+  SU_TRYCATCH(new = su_fft_plan_new_unsafe(key), goto fail);
+  SU_TRYCATCH(PTR_LIST_APPEND_CHECK(fft_plan, new) != -1, goto fail);
+
+  new->refcnt = 1;
+
+  pthread_mutex_unlock(&g_fft_plan_mutex);
+
+  return new;
+
+fail:
+  if (new != NULL)
+    su_fft_plan_destroy(new);
+
+  pthread_mutex_unlock(&g_fft_plan_mutex);
+
+  return NULL;
+}
+
+su_fft_plan_t *
+su_fft_plan_acquire_many(
+    unsigned int size,
+    unsigned int howmany,
+    int sign,
+    const SU_FFTW(_complex) *in,
+    const SU_FFTW(_complex) *out)
+{
+  struct sigutils_fft_plan_key key;
+
+  SU_TRYCATCH(howmany > 0, return NULL);
+
+  key.size      = size;
+  key.howmany   = howmany;
+  key.sign      = sign;
+  key.real      = SU_FALSE;
+  key.inplace   = in == out;
+  key.unaligned =
+         SU_FFTW(_alignment_of)((float *) in) != 0
+      || SU_FFTW(_alignment_of)((float *) out) != 0;
+
+  return su_fft_plan_acquire_by_key(&key);
+}
+
+su_fft_plan_t *
+su_fft_plan_acquire(
+    unsigned int size,
+    int sign,
+    const SU_FFTW(_complex) *in,
+    const SU_FFTW(_complex) *out)
+{
+  return su_fft_plan_acquire_many(size, 1, sign, in, out);
+}
+
+su_fft_plan_t *
+su_fft_plan_acquire_r2c(
+    unsigned int size,
+    const SUFLOAT *in,
+    const SU_FFTW(_complex) *out)
+{
+  struct sigutils_fft_plan_key key;
+
+  SU_TRYCATCH((const void *) in != (const void *) out, return NULL);
+
+  key.size      = size;
+  key.howmany   = 1;
+  key.sign      = FFTW_FORWARD;
+  key.real      = SU_TRUE;
+  key.inplace   = SU_FALSE;
+  key.unaligned =
+         SU_FFTW(_alignment_of)((float *) in) != 0
+      || SU_FFTW(_alignment_of)((float *) out) != 0;
+
+  return su_fft_plan_acquire_by_key(&key);
+}
+
+void
+su_fft_plan_release(su_fft_plan_t *plan)
+{
+  pthread_mutex_lock(&g_fft_plan_mutex);
+
+  if (plan->refcnt > 0)
+    --plan->refcnt;
+  else
+    SU_WARNING("Releasing an unreferenced FFT plan\n");
+
+  pthread_mutex_unlock(&g_fft_plan_mutex);
+}
+
+SUBOOL
+su_fft_plan_set_config(const struct sigutils_fft_plan_config *config)
+{
+  char *wisdom_file = NULL;
+
+  if (config->wisdom_file != NULL)
+    SU_TRYCATCH(wisdom_file = strdup(config->wisdom_file), return SU_FALSE);
+
+  pthread_mutex_lock(&g_fft_plan_mutex);
+
+  if (g_fft_plan_wisdom_file != NULL)
+    free(g_fft_plan_wisdom_file);
+
+  g_fft_plan_wisdom_file = wisdom_file;
+  g_fft_plan_mode = config->mode;
+
+  pthread_mutex_unlock(&g_fft_plan_mutex);
+
+  return SU_TRUE;
+}
+
+void
+su_fft_plan_get_config(struct sigutils_fft_plan_config *config)
+{
+  pthread_mutex_lock(&g_fft_plan_mutex);
+
+  config->mode = g_fft_plan_mode;
+  config->wisdom_file = g_fft_plan_wisdom_file;
+
+  pthread_mutex_unlock(&g_fft_plan_mutex);
+}
+
+SUBOOL
+su_fft_plan_save_wisdom(void)
+{
+  SUBOOL ok;
+
+  pthread_mutex_lock(&g_fft_plan_mutex);
+  ok = su_fft_plan_save_wisdom_unsafe();
+  pthread_mutex_unlock(&g_fft_plan_mutex);
+
+  return ok;
+}
+
+SUBOOL
+su_fft_plan_init(void)
+{
+  pthread_mutex_lock(&g_fft_plan_mutex);
+
+  /* A missing wisdom file is not an error: it will be created later */
+  if (g_fft_plan_mode != SU_FFT_PLAN_MODE_ESTIMATE
+      && g_fft_plan_wisdom_file != NULL)
+    if (!SU_FFTW(_import_wisdom_from_filename)(g_fft_plan_wisdom_file))
+      SU_INFO(
+          "No FFTW wisdom loaded from %s, plans will be measured\n",
+          g_fft_plan_wisdom_file);
+
+  pthread_mutex_unlock(&g_fft_plan_mutex);
+
+  return SU_TRUE;
+}
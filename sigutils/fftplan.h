@@ -0,0 +1,139 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#ifndef _SIGUTILS_FFTPLAN_H
+#define _SIGUTILS_FFTPLAN_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Process-wide FFTW plan registry. Plans are created once per
+ * (size, batch count, direction, placement, alignment) and shared by
+ * every object that needs them, using the new-array execute interface.
+ * Since FFTW planners are not thread safe, all planning and plan
+ * destruction is serialized by the registry.
+ */
+
+enum sigutils_fft_plan_mode {
+  SU_FFT_PLAN_MODE_ESTIMATE, /* Fast planning, suboptimal plans (default) */
+  SU_FFT_PLAN_MODE_MEASURE,  /* Measure plans, reuse wisdom */
+  SU_FFT_PLAN_MODE_PATIENT,  /* Measure harder, reuse wisdom */
+};
+
+struct sigutils_fft_plan_config {
+  enum sigutils_fft_plan_mode mode;
+  const char *wisdom_file; /* May be NULL */
+};
+
+#define sigutils_fft_plan_config_INITIALIZER    \
+{                                               \
+  SU_FFT_PLAN_MODE_ESTIMATE, /* mode */         \
+  NULL,                      /* wisdom_file */  \
+}
+
+struct sigutils_fft_plan_key {
+  unsigned int size;
+  unsigned int howmany; /* Contiguous transforms per execution */
+  int sign;         /* FFTW_FORWARD or FFTW_BACKWARD */
+  SUBOOL real;      /* Real input (r2c, forward only) */
+  SUBOOL inplace;
+  SUBOOL unaligned; /* Buffers not SIMD-aligned */
+};
+
+struct sigutils_fft_plan {
+  struct sigutils_fft_plan_key key;
+  SU_FFTW(_plan) plan;
+  unsigned int refcnt;
+};
+
+typedef struct sigutils_fft_plan su_fft_plan_t;
+
+SUINLINE void
+su_fft_plan_execute(
+    const su_fft_plan_t *plan,
+    SU_FFTW(_complex) *in,
+    SU_FFTW(_complex) *out)
+{
+  SU_FFTW(_execute_dft) (plan->plan, in, out);
+}
+
+/* Only for plans returned by su_fft_plan_acquire_r2c */
+SUINLINE void
+su_fft_plan_execute_r2c(
+    const su_fft_plan_t *plan,
+    SUFLOAT *in,
+    SU_FFTW(_complex) *out)
+{
+  SU_FFTW(_execute_dft_r2c) (plan->plan, in, out);
+}
+
+/* Called by su_lib_init_ex. Loads wisdom if a wisdom file was configured */
+SUBOOL su_fft_plan_init(void);
+
+/* Must be set before su_lib_init_ex for wisdom to be loaded */
+SUBOOL su_fft_plan_set_config(const struct sigutils_fft_plan_config *config);
+
+void su_fft_plan_get_config(struct sigutils_fft_plan_config *config);
+
+SUBOOL su_fft_plan_save_wisdom(void);
+
+/*
+ * Buffers passed to acquire are only inspected for placement and
+ * alignment. They are never written. Executions must use buffers with
+ * the same placement and alignment.
+ */
+su_fft_plan_t *su_fft_plan_acquire(
+    unsigned int size,
+    int sign,
+    const SU_FFTW(_complex) *in,
+    const SU_FFTW(_complex) *out);
+
+/*
+ * Same as above, but each execution transforms howmany consecutive
+ * arrays of size elements (i.e. in[j * size + k], j < howmany).
+ */
+su_fft_plan_t *su_fft_plan_acquire_many(
+    unsigned int size,
+    unsigned int howmany,
+    int sign,
+    const SU_FFTW(_complex) *in,
+    const SU_FFTW(_complex) *out);
+
+/*
+ * Forward transform of size real samples. Only the non-negative half of
+ * the spectrum (size / 2 + 1 bins) is written, the rest being its
+ * Hermitian mirror. Always out of place.
+ */
+su_fft_plan_t *su_fft_plan_acquire_r2c(
+    unsigned int size,
+    const SUFLOAT *in,
+    const SU_FFTW(_complex) *out);
+
+void su_fft_plan_release(su_fft_plan_t *plan);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _SIGUTILS_FFTPLAN_H */
@@ -0,0 +1,509 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#define SU_LOG_DOMAIN "fir"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "log.h"
+#include "fir.h"
+#include "simd.h"
+
+SUPRIVATE SUSCOUNT g_fir_filt_fft_threshold = SU_FIR_FILT_DEFAULT_THRESHOLD;
+
+SUSCOUNT
+su_fir_filt_get_fft_threshold(void)
+{
+  return g_fir_filt_fft_threshold;
+}
+
+void
+su_fir_filt_set_fft_threshold(SUSCOUNT threshold)
+{
+  g_fir_filt_fft_threshold = threshold;
+}
+
+/******************************** Direct form *********************************/
+/* Make room for at least one more sample */
+SUINLINE void
+__su_fir_filt_rewind(su_fir_filt_t *filt)
+{
+  if (filt->x_ptr == filt->x_alloc) {
+    memmove(
+        filt->x,
+        filt->x + filt->x_alloc - (filt->size - 1),
+        (filt->size - 1) * sizeof(SUCOMPLEX));
+    filt->x_ptr = filt->size - 1;
+  }
+}
+
+/* Output for the sample at ptr - 1 */
+SUINLINE SUCOMPLEX
+__su_fir_filt_eval(const su_fir_filt_t *filt, unsigned int ptr)
+{
+  const SUCOMPLEX *x = filt->x + ptr - filt->size;
+  SUCOMPLEX y;
+
+  if (filt->symmetry == SU_FIR_FILT_SYMMETRY_NONE)
+    return su_simd_dot_real(x, filt->h, filt->size);
+
+  /* Both ends of the window walk towards the center */
+  y = su_simd_dot_real_fold(
+      x + filt->fold_first,
+      x + filt->size - 1 - filt->fold_first,
+      filt->hf,
+      filt->fold_size,
+      filt->symmetry == SU_FIR_FILT_SYMMETRY_EVEN ? 1 : -1,
+      filt->fold_stride);
+
+  if (filt->center != 0)
+    y += filt->center * x[filt->size / 2];
+
+  return y;
+}
+
+/* Look for symmetries in the (time-reversed) taps */
+SUPRIVATE SUBOOL
+su_fir_filt_init_fold(su_fir_filt_t *filt)
+{
+  const SUFLOAT *h = filt->h;
+  unsigned int size = filt->size;
+  unsigned int half = size / 2;
+  SUBOOL even = SU_TRUE;
+  SUBOOL odd = SU_TRUE;
+  SUBOOL zero[2] = {SU_TRUE, SU_TRUE};
+  SUFLOAT max = 0;
+  SUFLOAT tol;
+  unsigned int i;
+
+  if (size < SU_FIR_FILT_FOLD_MIN_SIZE)
+    return SU_TRUE;
+
+  for (i = 0; i < size; ++i)
+    if (SU_ABS(h[i]) > max)
+      max = SU_ABS(h[i]);
+
+  tol = SU_FIR_FILT_FOLD_TOL * max;
+
+  for (i = 0; i < half; ++i) {
+    if (SU_ABS(h[i] - h[size - 1 - i]) > tol)
+      even = SU_FALSE;
+
+    if (SU_ABS(h[i] + h[size - 1 - i]) > tol)
+      odd = SU_FALSE;
+
+    if (SU_ABS(h[i]) > tol)
+      zero[i & 1] = SU_FALSE;
+  }
+
+  if ((size & 1) && SU_ABS(h[half]) > tol)
+    odd = SU_FALSE;
+
+  if (max == 0 || (!even && !odd))
+    return SU_TRUE;
+
+  filt->symmetry    = even
+      ? SU_FIR_FILT_SYMMETRY_EVEN
+      : SU_FIR_FILT_SYMMETRY_ODD;
+  filt->fold_first  = 0;
+  filt->fold_stride = 1;
+
+  if (zero[0] != zero[1]) {
+    filt->fold_first  = zero[0] ? 1 : 0;
+    filt->fold_stride = 2;
+  }
+
+  /* Only the central tap is left */
+  if (zero[0] && zero[1])
+    filt->fold_size = 0;
+  else
+    filt->fold_size =
+        (half - filt->fold_first + filt->fold_stride - 1) / filt->fold_stride;
+
+  if ((size & 1) && even)
+    filt->center = h[half];
+
+  SU_TRYCATCH(
+      filt->hf = SU_FFTW(_malloc)(
+          2 * (filt->fold_size + 1) * sizeof(SUFLOAT)),
+      return SU_FALSE);
+
+  /* Duplicated: one for the real part, one for the imaginary part */
+  for (i = 0; i < filt->fold_size; ++i)
+    filt->hf[2 * i] = filt->hf[2 * i + 1] =
+        h[filt->fold_first + i * filt->fold_stride];
+
+  return SU_TRUE;
+}
+
+SUPRIVATE void
+su_fir_filt_feed_bulk_direct(
+    su_fir_filt_t *filt,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT len)
+{
+  SUSCOUNT chunk;
+  SUSCOUNT i;
+
+  while (len > 0) {
+    __su_fir_filt_rewind(filt);
+
+    chunk = filt->x_alloc - filt->x_ptr;
+    if (chunk > len)
+      chunk = len;
+
+    /* Whole chunk goes in first: this allows in-place filtering */
+    memcpy(filt->x + filt->x_ptr, x, chunk * sizeof(SUCOMPLEX));
+
+    for (i = 0; i < chunk; ++i) {
+      filt->curr_y = __su_fir_filt_eval(filt, filt->x_ptr + i + 1);
+      y[i] = filt->gain * filt->curr_y;
+    }
+
+    filt->x_ptr += chunk;
+
+    x   += chunk;
+    y   += chunk;
+    len -= chunk;
+  }
+}
+
+SUPRIVATE SUSCOUNT
+su_fir_filt_feed_bulk_decim_direct(
+    su_fir_filt_t *filt,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT len)
+{
+  unsigned int decim = filt->decimation;
+  SUSCOUNT chunk;
+  SUSCOUNT i;
+  SUSCOUNT n = 0;
+
+  while (len > 0) {
+    __su_fir_filt_rewind(filt);
+
+    chunk = filt->x_alloc - filt->x_ptr;
+    if (chunk > len)
+      chunk = len;
+
+    /* Outputs never overtake inputs: in-place filtering is safe */
+    memcpy(filt->x + filt->x_ptr, x, chunk * sizeof(SUCOMPLEX));
+
+    /* Evaluate only at the instants that are kept */
+    for (i = decim - 1 - filt->decim_ptr; i < chunk; i += decim) {
+      filt->curr_y = __su_fir_filt_eval(filt, filt->x_ptr + i + 1);
+      y[n++] = filt->gain * filt->curr_y;
+    }
+
+    filt->decim_ptr = (filt->decim_ptr + chunk) % decim;
+    filt->x_ptr += chunk;
+
+    x   += chunk;
+    len -= chunk;
+  }
+
+  return n;
+}
+
+/******************************** Overlap-save ********************************/
+/*
+ * x holds the last size - 1 samples of the previous block followed by the
+ * p samples of the current one. Once L samples have been collected, the
+ * last L points of the circular convolution are the filter output.
+ */
+SUPRIVATE void
+__su_fir_filt_run_block(su_fir_filt_t *filt)
+{
+  su_fft_plan_execute(filt->fwd, filt->x, filt->X);
+  su_simd_cmul(filt->X, filt->H, filt->fft_size);
+  su_fft_plan_execute(filt->bwd, filt->X, filt->y);
+
+  memmove(
+      filt->x,
+      filt->x + filt->block,
+      (filt->size - 1) * sizeof(SUCOMPLEX));
+
+  filt->p = 0;
+}
+
+SUPRIVATE void
+su_fir_filt_feed_bulk_fft(
+    su_fir_filt_t *filt,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT len)
+{
+  const SUCOMPLEX *prev;
+  SUSCOUNT chunk;
+  SUSCOUNT i;
+
+  while (len > 0) {
+    chunk = filt->block - filt->p;
+    if (chunk > len)
+      chunk = len;
+
+    /* Input goes in first: this allows in-place filtering */
+    memcpy(
+        filt->x + filt->size - 1 + filt->p,
+        x,
+        chunk * sizeof(SUCOMPLEX));
+
+    prev = filt->y + filt->size - 1 + filt->p;
+    for (i = 0; i < chunk; ++i)
+      y[i] = filt->gain * prev[i];
+
+    filt->curr_y = prev[chunk - 1];
+    filt->p += chunk;
+
+    if (filt->p == filt->block)
+      __su_fir_filt_run_block(filt);
+
+    x   += chunk;
+    y   += chunk;
+    len -= chunk;
+  }
+}
+
+SUPRIVATE SUBOOL
+su_fir_filt_init_fft(su_fir_filt_t *filt, const SUFLOAT *b)
+{
+  unsigned int size = filt->x_alloc;
+  unsigned int i;
+
+  filt->fft_size = size;
+  filt->block    = size - filt->size + 1;
+
+  SU_TRYCATCH(
+      filt->H = SU_FFTW(_malloc)(size * sizeof(SU_FFTW(_complex))),
+      return SU_FALSE);
+
+  SU_TRYCATCH(
+      filt->X = SU_FFTW(_malloc)(size * sizeof(SU_FFTW(_complex))),
+      return SU_FALSE);
+
+  SU_TRYCATCH(
+      filt->y = SU_FFTW(_malloc)(size * sizeof(SU_FFTW(_complex))),
+      return SU_FALSE);
+
+  SU_TRYCATCH(
+      filt->fwd = su_fft_plan_acquire(size, FFTW_FORWARD, filt->x, filt->X),
+      return SU_FALSE);
+
+  SU_TRYCATCH(
+      filt->bwd = su_fft_plan_acquire(size, FFTW_BACKWARD, filt->X, filt->y),
+      return SU_FALSE);
+
+  /* Taps spectrum. The 1 / F normalization of the IFFT goes here */
+  memset(filt->X, 0, size * sizeof(SU_FFTW(_complex)));
+  for (i = 0; i < filt->size; ++i)
+    filt->X[i] = b[i] / (SUFLOAT) size;
+
+  su_fft_plan_execute(filt->fwd, filt->X, filt->H);
+
+  memset(filt->y, 0, size * sizeof(SU_FFTW(_complex)));
+
+  return SU_TRUE;
+}
+
+/*********************************** API **************************************/
+void
+su_fir_filt_finalize(su_fir_filt_t *filt)
+{
+  if (filt->fwd != NULL)
+    su_fft_plan_release(filt->fwd);
+
+  if (filt->bwd != NULL)
+    su_fft_plan_release(filt->bwd);
+
+  if (filt->H != NULL)
+    SU_FFTW(_free) (filt->H);
+
+  if (filt->X != NULL)
+    SU_FFTW(_free) (filt->X);
+
+  if (filt->y != NULL)
+    SU_FFTW(_free) (filt->y);
+
+  if (filt->h != NULL)
+    SU_FFTW(_free) (filt->h);
+
+  if (filt->hf != NULL)
+    SU_FFTW(_free) (filt->hf);
+
+  if (filt->x != NULL)
+    SU_FFTW(_free) (filt->x);
+
+  memset(filt, 0, sizeof(su_fir_filt_t));
+
+  filt->gain        = 1;
+  filt->decimation  = 1;
+  filt->fold_stride = 1;
+}
+
+void
+su_fir_filt_reset(su_fir_filt_t *filt)
+{
+  memset(filt->x, 0, (filt->size - 1) * sizeof(SUCOMPLEX));
+
+  if (filt->y != NULL)
+    memset(filt->y, 0, filt->fft_size * sizeof(SU_FFTW(_complex)));
+
+  filt->x_ptr     = filt->size - 1;
+  filt->p         = 0;
+  filt->decim_ptr = 0;
+  filt->curr_y    = 0;
+}
+
+SUBOOL
+su_fir_filt_init_ex(
+    su_fir_filt_t *filt,
+    const SUFLOAT *b,
+    SUSCOUNT size,
+    enum sigutils_fir_filt_mode mode)
+{
+  unsigned int i;
+
+  SU_TRYCATCH(size > 0, return SU_FALSE);
+
+  memset(filt, 0, sizeof(su_fir_filt_t));
+
+  if (mode == SU_FIR_FILT_MODE_AUTO)
+    mode = size > g_fir_filt_fft_threshold
+        ? SU_FIR_FILT_MODE_FFT
+        : SU_FIR_FILT_MODE_DIRECT;
+
+  filt->size        = size;
+  filt->x_alloc     = size - 1 + SU_FIR_FILT_HEADROOM;
+  filt->gain        = 1;
+  filt->decimation  = 1;
+  filt->fold_stride = 1;
+
+  /* In overlap-save, the delay line is the FFT input */
+  if (mode == SU_FIR_FILT_MODE_FFT) {
+    filt->x_alloc = 1;
+    while (filt->x_alloc < SU_FIR_FILT_FFT_RATIO * size)
+      filt->x_alloc <<= 1;
+  }
+
+  SU_TRYCATCH(
+      filt->h = SU_FFTW(_malloc)(size * sizeof(SUFLOAT)),
+      goto fail);
+
+  SU_TRYCATCH(
+      filt->x = SU_FFTW(_malloc)(filt->x_alloc * sizeof(SUCOMPLEX)),
+      goto fail);
+
+  for (i = 0; i < size; ++i)
+    filt->h[i] = b[size - i - 1];
+
+  if (mode == SU_FIR_FILT_MODE_FFT) {
+    SU_TRYCATCH(su_fir_filt_init_fft(filt, b), goto fail);
+  } else {
+    SU_TRYCATCH(su_fir_filt_init_fold(filt), goto fail);
+  }
+
+  su_fir_filt_reset(filt);
+
+  return SU_TRUE;
+
+fail:
+  su_fir_filt_finalize(filt);
+
+  return SU_FALSE;
+}
+
+SUBOOL
+su_fir_filt_init(su_fir_filt_t *filt, const SUFLOAT *b, SUSCOUNT size)
+{
+  return su_fir_filt_init_ex(filt, b, size, SU_FIR_FILT_MODE_DIRECT);
+}
+
+SUCOMPLEX
+su_fir_filt_feed(su_fir_filt_t *filt, SUCOMPLEX x)
+{
+  SUCOMPLEX y;
+
+  if (su_fir_filt_is_fft(filt)) {
+    su_fir_filt_feed_bulk_fft(filt, &x, &y, 1);
+    return y;
+  }
+
+  __su_fir_filt_rewind(filt);
+
+  filt->x[filt->x_ptr++] = x;
+  filt->curr_y = __su_fir_filt_eval(filt, filt->x_ptr);
+
+  return filt->gain * filt->curr_y;
+}
+
+void
+su_fir_filt_feed_bulk(
+    su_fir_filt_t *filt,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT len)
+{
+  if (su_fir_filt_is_fft(filt))
+    su_fir_filt_feed_bulk_fft(filt, x, y, len);
+  else
+    su_fir_filt_feed_bulk_direct(filt, x, y, len);
+}
+
+SUBOOL
+su_fir_filt_set_decimation(su_fir_filt_t *filt, unsigned int decimation)
+{
+  SU_TRYCATCH(decimation > 0, return SU_FALSE);
+  SU_TRYCATCH(decimation == 1 || !su_fir_filt_is_fft(filt), return SU_FALSE);
+
+  filt->decimation = decimation;
+  filt->decim_ptr  = 0;
+
+  return SU_TRUE;
+}
+
+SUSCOUNT
+su_fir_filt_feed_bulk_decim(
+    su_fir_filt_t *filt,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT len)
+{
+  if (filt->decimation == 1) {
+    su_fir_filt_feed_bulk(filt, x, y, len);
+    return len;
+  }
+
+  return su_fir_filt_feed_bulk_decim_direct(filt, x, y, len);
+}
+
+SUCOMPLEX
+su_fir_filt_get(const su_fir_filt_t *filt)
+{
+  return filt->gain * filt->curr_y;
+}
+
+void
+su_fir_filt_set_gain(su_fir_filt_t *filt, SUFLOAT gain)
+{
+  filt->gain = gain;
+}
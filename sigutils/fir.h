@@ -0,0 +1,223 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#ifndef _SIGUTILS_FIR_H
+#define _SIGUTILS_FIR_H
+
+#include "types.h"
+#include "fftplan.h"
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic push
+#    pragma clang diagnostic ignored "-Wreturn-type-c-linkage"
+#  endif // __clang__
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * FIR filter. Two implementations are available:
+ *
+ * - Direct form: the delay line is a linear buffer in which samples are
+ *   appended in order, so the last N samples are always contiguous and
+ *   every output is a plain dot product against the (time-reversed) taps.
+ *   When the buffer is exhausted, the last N - 1 samples are moved back to
+ *   its beginning. With the default headroom, this happens once every
+ *   SU_FIR_FILT_HEADROOM samples. No latency, O(N) per sample.
+ *
+ * - Overlap-save: samples are accumulated in blocks of L and filtered in
+ *   the frequency domain with an FFT of size F (power of two, at least
+ *   SU_FIR_FILT_FFT_RATIO times N), with L = F - N + 1. Output is delayed
+ *   by L samples, O(log N) per sample.
+ *
+ * Filters that can tolerate the latency (i.e. not inside a feedback loop)
+ * may be initialized with SU_FIR_FILT_MODE_AUTO, which switches to
+ * overlap-save above su_fir_filt_get_fft_threshold() taps. The default
+ * threshold comes from su_test_fir_benchmark (FFTW 3.3, x86-64 with AVX2,
+ * release build): overlap-save was ahead at every size, but by less than
+ * 2x up to 8 taps, which does not pay for a whole block of latency. From
+ * 16 taps on it was 4x faster, and 30x at 2048. The crossover depends on
+ * the FFT backend and the machine, so the threshold can be set at build
+ * time (CMake variable SIGUTILS_FIR_FFT_THRESHOLD) or at run time.
+ *
+ * In direct form, linear phase filters are detected at init time. If the
+ * taps are symmetric (or antisymmetric), samples sharing a tap are added
+ * (or subtracted) before the product, halving the multiplications. If, on
+ * top of that, every other tap is zero (half-band filters, Hilbert
+ * transformers), these are skipped too. Taps are compared with a tolerance
+ * of SU_FIR_FILT_FOLD_TOL relative to the largest tap. Below
+ * SU_FIR_FILT_FOLD_MIN_SIZE taps, the plain dot product is just as fast.
+ */
+#define SU_FIR_FILT_HEADROOM          1024
+#define SU_FIR_FILT_FFT_RATIO         4
+#ifndef SU_FIR_FILT_DEFAULT_THRESHOLD
+#  define SU_FIR_FILT_DEFAULT_THRESHOLD 8
+#endif /* SU_FIR_FILT_DEFAULT_THRESHOLD */
+#define SU_FIR_FILT_FOLD_MIN_SIZE     64
+#define SU_FIR_FILT_FOLD_TOL          1e-6
+
+enum sigutils_fir_filt_mode {
+  SU_FIR_FILT_MODE_DIRECT,
+  SU_FIR_FILT_MODE_FFT,
+  SU_FIR_FILT_MODE_AUTO,
+};
+
+enum sigutils_fir_filt_symmetry {
+  SU_FIR_FILT_SYMMETRY_NONE,
+  SU_FIR_FILT_SYMMETRY_EVEN, /* h[k] = h[N - 1 - k] */
+  SU_FIR_FILT_SYMMETRY_ODD,  /* h[k] = -h[N - 1 - k] */
+};
+
+struct sigutils_fir_filt {
+  unsigned int size;    /* Number of taps */
+  SUFLOAT *h;           /* Time-reversed taps, aligned */
+
+  SUCOMPLEX *x;         /* Delay line (FFT mode: F samples), aligned */
+  unsigned int x_alloc; /* Direct form: size - 1 + SU_FIR_FILT_HEADROOM */
+  unsigned int x_ptr;   /* Next write position */
+
+  SUCOMPLEX curr_y;     /* Last output, before gain */
+  SUFLOAT gain;
+
+  /* Overlap-save state */
+  unsigned int fft_size; /* F. 0 in direct form */
+  unsigned int block;    /* L, also the latency */
+  unsigned int p;        /* Samples in the current block */
+  SU_FFTW(_complex) *H;  /* Taps spectrum, scaled by 1 / F */
+  SU_FFTW(_complex) *X;  /* Block spectrum */
+  SU_FFTW(_complex) *y;  /* Previous block output */
+  su_fft_plan_t *fwd;
+  su_fft_plan_t *bwd;
+
+  /* Decimation (direct form only) */
+  unsigned int decimation;
+  unsigned int decim_ptr; /* Samples since last kept output */
+
+  /* Linear phase folding (direct form only) */
+  enum sigutils_fir_filt_symmetry symmetry;
+  unsigned int fold_size;   /* Folded products, central tap excluded */
+  unsigned int fold_first;  /* First non-zero tap */
+  unsigned int fold_stride; /* 2 if every other tap is zero */
+  SUFLOAT *hf;              /* Non-zero taps of the first half, twice */
+  SUFLOAT center;           /* Central tap (odd sizes) */
+};
+
+typedef struct sigutils_fir_filt su_fir_filt_t;
+
+#define su_fir_filt_INITIALIZER                                  \
+  {                                                              \
+    0, NULL, NULL, 0, 0, 0, 1, 0, 0, 0, NULL, NULL, NULL, NULL,  \
+    NULL, 1, 0, SU_FIR_FILT_SYMMETRY_NONE, 0, 0, 1, NULL, 0      \
+  }
+
+/* Tap count above which SU_FIR_FILT_MODE_AUTO uses overlap-save */
+SUSCOUNT su_fir_filt_get_fft_threshold(void);
+void su_fir_filt_set_fft_threshold(SUSCOUNT threshold);
+
+/* Initialize filter with taps b[0..size - 1] */
+SUBOOL su_fir_filt_init_ex(
+    su_fir_filt_t *filt,
+    const SUFLOAT *b,
+    SUSCOUNT size,
+    enum sigutils_fir_filt_mode mode);
+
+/* Same as above, direct form */
+SUBOOL su_fir_filt_init(su_fir_filt_t *filt, const SUFLOAT *b, SUSCOUNT size);
+
+/* Delay (in samples) introduced by the implementation, on top of the taps */
+SUINLINE SUSCOUNT
+su_fir_filt_get_latency(const su_fir_filt_t *filt)
+{
+  return filt->block;
+}
+
+SUINLINE SUBOOL
+su_fir_filt_is_fft(const su_fir_filt_t *filt)
+{
+  return filt->fft_size > 0;
+}
+
+/* Symmetry found at init time. Always NONE in overlap-save */
+SUINLINE enum sigutils_fir_filt_symmetry
+su_fir_filt_get_symmetry(const su_fir_filt_t *filt)
+{
+  return filt->symmetry;
+}
+
+/* Multiplications per output */
+SUINLINE SUSCOUNT
+su_fir_filt_get_products(const su_fir_filt_t *filt)
+{
+  if (filt->symmetry == SU_FIR_FILT_SYMMETRY_NONE)
+    return filt->size;
+
+  return filt->fold_size + (filt->center != 0);
+}
+
+/* Push sample to filter */
+SUCOMPLEX su_fir_filt_feed(su_fir_filt_t *filt, SUCOMPLEX x);
+
+/* Push a bunch of samples to filter. x and y may be the same buffer */
+void su_fir_filt_feed_bulk(
+    su_fir_filt_t *filt,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT len);
+
+/*
+ * Keep only one output out of every `decimation`. Only supported in
+ * direct form, where outputs that are dropped are never computed: each
+ * kept output only costs size / decimation operations per input sample,
+ * just like a polyphase decimator.
+ */
+SUBOOL su_fir_filt_set_decimation(
+    su_fir_filt_t *filt,
+    unsigned int decimation);
+
+/*
+ * Push len samples, write the kept outputs to y. Returns the number of
+ * outputs. x and y may be the same buffer.
+ */
+SUSCOUNT su_fir_filt_feed_bulk_decim(
+    su_fir_filt_t *filt,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT len);
+
+/* Get last output */
+SUCOMPLEX su_fir_filt_get(const su_fir_filt_t *filt);
+
+/* Set output gain */
+void su_fir_filt_set_gain(su_fir_filt_t *filt, SUFLOAT gain);
+
+/* Clear delay line */
+void su_fir_filt_reset(su_fir_filt_t *filt);
+
+/* Destroy filter */
+void su_fir_filt_finalize(su_fir_filt_t *filt);
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic pop
+#  endif // __clang__
+}
+#endif /* __cplusplus */
+
+#endif /* _SIGUTILS_FIR_H */
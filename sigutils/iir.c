@@ -134,6 +134,26 @@ su_iir_filt_finalize(su_iir_filt_t *filt)
 
   if (filt->y != NULL)
     free(filt->y);
+
+  if (filt->fir != NULL) {
+    su_fir_filt_finalize(filt->fir);
+    free(filt->fir);
+  }
+}
+
+/*
+ * The gain of FIR-backed filters lives here only (it may be changed through
+ * a property reference at any time): the FIR engine always runs at unity
+ * gain, and curr_y never includes it.
+ */
+SUINLINE void
+__su_iir_filt_apply_gain(const su_iir_filt_t *filt, SUCOMPLEX *y, SUSCOUNT len)
+{
+  SUSCOUNT i;
+
+  if (filt->gain != 1)
+    for (i = 0; i < len; ++i)
+      y[i] *= filt->gain;
 }
 
 SUCOMPLEX
@@ -141,6 +161,12 @@ su_iir_filt_feed(su_iir_filt_t *filt, SUCOMPLEX x)
 {
   SUCOMPLEX y;
 
+  if (filt->fir != NULL) {
+    (void) su_fir_filt_feed(filt->fir, x);
+    filt->curr_y = filt->fir->curr_y;
+    return filt->gain * filt->curr_y;
+  }
+
   __su_iir_filt_push_x(filt, x);
   y = __su_iir_filt_eval(filt);
   __su_iir_filt_push_y(filt, y);
@@ -159,6 +185,13 @@ su_iir_filt_feed_bulk(
 {
   SUCOMPLEX tmp_y;
 
+  if (filt->fir != NULL) {
+    su_fir_filt_feed_bulk(filt->fir, x, y, len);
+    __su_iir_filt_apply_gain(filt, y, len);
+    filt->curr_y = filt->fir->curr_y;
+    return;
+  }
+
   while (len-- != 0) {
     __su_iir_filt_push_x(filt, *x++);
     tmp_y = __su_iir_filt_eval(filt);
@@ -181,6 +214,76 @@ su_iir_filt_set_gain(su_iir_filt_t *filt, SUFLOAT gain)
   filt->gain = gain;
 }
 
+SUBOOL
+su_iir_filt_set_fir_mode(
+    su_iir_filt_t *filt,
+    enum sigutils_fir_filt_mode mode)
+{
+  su_fir_filt_t *fir = NULL;
+
+  /* Output feedback rules out anything but the direct form */
+  if (filt->fir == NULL)
+    return mode != SU_FIR_FILT_MODE_FFT;
+
+  if ((fir = malloc(sizeof (su_fir_filt_t))) == NULL)
+    return SU_FALSE;
+
+  if (!su_fir_filt_init_ex(fir, filt->b, filt->x_size, mode)) {
+    free(fir);
+    return SU_FALSE;
+  }
+
+  if (!su_fir_filt_set_decimation(fir, filt->fir->decimation)) {
+    su_fir_filt_finalize(fir);
+    free(fir);
+    return SU_FALSE;
+  }
+
+  su_fir_filt_finalize(filt->fir);
+  free(filt->fir);
+
+  filt->fir = fir;
+  filt->curr_y = 0;
+
+  return SU_TRUE;
+}
+
+SUSCOUNT
+su_iir_filt_get_latency(const su_iir_filt_t *filt)
+{
+  return filt->fir != NULL ? su_fir_filt_get_latency(filt->fir) : 0;
+}
+
+SUBOOL
+su_iir_filt_set_decimation(su_iir_filt_t *filt, unsigned int decimation)
+{
+  if (filt->fir == NULL)
+    return decimation == 1;
+
+  return su_fir_filt_set_decimation(filt->fir, decimation);
+}
+
+SUSCOUNT
+su_iir_filt_feed_bulk_decim(
+    su_iir_filt_t *filt,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT len)
+{
+  SUSCOUNT n;
+
+  if (filt->fir == NULL) {
+    su_iir_filt_feed_bulk(filt, x, y, len);
+    return len;
+  }
+
+  n = su_fir_filt_feed_bulk_decim(filt->fir, x, y, len);
+  __su_iir_filt_apply_gain(filt, y, n);
+  filt->curr_y = filt->fir->curr_y;
+
+  return n;
+}
+
 SUBOOL
 __su_iir_filt_init(
     su_iir_filt_t *filt,
@@ -192,6 +295,7 @@ __su_iir_filt_init(
 {
   SUCOMPLEX *x = NULL;
   SUCOMPLEX *y = NULL;
+  su_fir_filt_t *fir = NULL;
   SUFLOAT *a_copy = NULL;
   SUFLOAT *b_copy = NULL;
   unsigned int x_alloc = x_size;
@@ -214,8 +318,18 @@ __su_iir_filt_init(
     y_alloc = 2 * y_alloc - 1;
 #endif /* SU_USE_VOLK */
 
-  if ((x = calloc(x_alloc, sizeof (SUCOMPLEX))) == NULL)
+  if (y_size == 0) {
+    if ((fir = malloc(sizeof (su_fir_filt_t))) == NULL)
+      goto fail;
+
+    if (!su_fir_filt_init(fir, b, x_size)) {
+      free(fir);
+      fir = NULL;
+      goto fail;
+    }
+  } else if ((x = calloc(x_alloc, sizeof (SUCOMPLEX))) == NULL) {
     goto fail;
+  }
 
   if (y_size > 0)
     if ((y = calloc(y_alloc, sizeof (SUCOMPLEX))) == NULL)
@@ -240,6 +354,7 @@ __su_iir_filt_init(
 
   filt->x = x;
   filt->y = y;
+  filt->fir = fir;
 
   filt->a = a_copy;
   filt->b = b_copy;
@@ -256,6 +371,11 @@ __su_iir_filt_init(
   return SU_TRUE;
 
 fail:
+  if (fir != NULL) {
+    su_fir_filt_finalize(fir);
+    free(fir);
+  }
+
   if (x != NULL)
     free(x);
 
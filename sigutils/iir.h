@@ -23,6 +23,7 @@
 
 #include <stdlib.h>
 #include "types.h"
+#include "fir.h"
 
 #define SU_FLOAT_GUARD INFINITY
 
@@ -54,11 +55,18 @@ struct sigutils_iir_filt {
   SUFLOAT *b;
 
   SUFLOAT gain;
+
+  /*
+   * Filters without output feedback (y_size == 0) are run by a dedicated
+   * FIR engine. In that case, x and y are not allocated.
+   */
+  su_fir_filt_t *fir;
 };
 
 typedef struct sigutils_iir_filt su_iir_filt_t;
 
-#define su_iir_filt_INITIALIZER {0, 0, 0, 0, 0, 0, 0, NULL, NULL, NULL, NULL, 1}
+#define su_iir_filt_INITIALIZER \
+  {0, 0, 0, 0, 0, 0, 0, NULL, NULL, NULL, NULL, 1, NULL}
 
 /* Push sample to filter */
 SUCOMPLEX su_iir_filt_feed(su_iir_filt_t *filt, SUCOMPLEX x);
@@ -93,6 +101,30 @@ SUBOOL __su_iir_filt_init(
 /* Set output gain */
 void su_iir_filt_set_gain(su_iir_filt_t *filt, SUFLOAT gain);
 
+/*
+ * Change the implementation of a filter without output feedback. Filter
+ * state is lost. SU_FIR_FILT_MODE_AUTO may introduce latency: only for
+ * filters outside feedback loops.
+ */
+SUBOOL su_iir_filt_set_fir_mode(
+    su_iir_filt_t *filt,
+    enum sigutils_fir_filt_mode mode);
+
+/* Delay (in samples) introduced by the implementation, on top of the taps */
+SUSCOUNT su_iir_filt_get_latency(const su_iir_filt_t *filt);
+
+/* Keep one output out of every `decimation` (direct form FIR only) */
+SUBOOL su_iir_filt_set_decimation(
+    su_iir_filt_t *filt,
+    unsigned int decimation);
+
+/* Push a bunch of samples, returns the number of outputs written to y */
+SUSCOUNT su_iir_filt_feed_bulk_decim(
+    su_iir_filt_t *filt,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT len);
+
 /* Initialize Butterworth low-pass filter of order N */
 SUBOOL su_iir_bwlpf_init(su_iir_filt_t *filt, SUSCOUNT n, SUFLOAT fc);
 
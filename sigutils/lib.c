@@ -23,6 +23,7 @@
 #define SU_LOG_LEVEL "lib"
 
 #include "sigutils.h"
+#include "fftplan.h"
 
 /* Block classes */
 extern struct sigutils_block_class su_block_class_AGC;
@@ -32,6 +33,7 @@ extern struct sigutils_block_class su_block_class_COSTAS;
 extern struct sigutils_block_class su_block_class_RRC;
 extern struct sigutils_block_class su_block_class_CDR;
 extern struct sigutils_block_class su_block_class_SIGGEN;
+extern struct sigutils_block_class su_block_class_RESAMPLER;
 
 /* Modem classes */
 extern struct sigutils_modem_class su_modem_class_QPSK;
@@ -95,6 +97,7 @@ su_lib_init_ex(const struct sigutils_log_config *logconfig)
           &su_block_class_RRC,
           &su_block_class_CDR,
           &su_block_class_SIGGEN,
+          &su_block_class_RESAMPLER,
       };
 
   struct sigutils_modem_class *modems[] =
@@ -112,6 +115,11 @@ su_lib_init_ex(const struct sigutils_log_config *logconfig)
 
   su_log_init(logconfig);
 
+  if (!su_fft_plan_init()) {
+    SU_ERROR("Failed to initialize FFT plan registry\n");
+    return SU_FALSE;
+  }
+
   for (i = 0; i < sizeof (blocks) / sizeof (blocks[0]); ++i)
     if (!su_block_class_register(blocks[i])) {
       if (blocks[i]->name != NULL)
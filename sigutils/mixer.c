@@ -0,0 +1,105 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#define SU_LOG_DOMAIN "mixer"
+
+#include <string.h>
+#include <math.h>
+
+#include "log.h"
+#include "simd.h"
+#include "mixer.h"
+
+SUINLINE double
+su_mixer_wrap(double phi)
+{
+  phi = fmod(phi, 2 * M_PI);
+
+  return phi < 0 ? phi + 2 * M_PI : phi;
+}
+
+void
+su_mixer_init(su_mixer_t *mixer, SUFLOAT fnor)
+{
+  memset(mixer, 0, sizeof(su_mixer_t));
+
+  mixer->step = 1;
+
+  su_mixer_set_freq(mixer, fnor);
+}
+
+void
+su_mixer_set_freq(su_mixer_t *mixer, SUFLOAT fnor)
+{
+  mixer->fnor = fnor;
+}
+
+void
+su_mixer_inc_phase(su_mixer_t *mixer, SUFLOAT delta)
+{
+  mixer->phi_inc += delta;
+}
+
+SUFLOAT
+su_mixer_get_freq(const su_mixer_t *mixer)
+{
+  return mixer->fnor;
+}
+
+SUFLOAT
+su_mixer_get_phase(const su_mixer_t *mixer)
+{
+  return su_mixer_wrap(mixer->phi + mixer->phi_inc);
+}
+
+void
+su_mixer_mix(
+    su_mixer_t *mixer,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT size)
+{
+  SUCOMPLEX phasor;
+  SUSCOUNT chunk;
+  SUSCOUNT i;
+
+  /* Block boundary: apply pending changes */
+  if (mixer->omega != SU_NORM2ANG_FREQ(mixer->fnor)) {
+    mixer->omega = SU_NORM2ANG_FREQ(mixer->fnor);
+    mixer->step  = SU_C_EXP(I * mixer->omega);
+  }
+
+  if (mixer->phi_inc != 0) {
+    mixer->phi     = su_mixer_wrap(mixer->phi + mixer->phi_inc);
+    mixer->phi_inc = 0;
+  }
+
+  if (x != y)
+    memcpy(y, x, size * sizeof(SUCOMPLEX));
+
+  for (i = 0; i < size; i += chunk) {
+    chunk = SU_MIN(size - i, SU_MIXER_RENORM_PERIOD);
+
+    phasor = cos(mixer->phi) + I * sin(mixer->phi);
+    su_simd_rotate(y + i, chunk, &phasor, mixer->step);
+
+    mixer->phi = su_mixer_wrap(mixer->phi + chunk * (double) mixer->omega);
+  }
+}
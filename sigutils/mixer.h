@@ -0,0 +1,89 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#ifndef _SIGUTILS_MIXER_H
+#define _SIGUTILS_MIXER_H
+
+#include "types.h"
+#include "sampling.h"
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic push
+#    pragma clang diagnostic ignored "-Wreturn-type-c-linkage"
+#  endif // __clang__
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Bulk complex mixer: rotates whole buffers by a constant frequency,
+ *
+ *   y[i] = x[i] * exp(j (phi + i * omega))
+ *
+ * with a recursive phasor (a single complex multiplication per sample,
+ * see su_simd_rotate). Rounding errors make a recursive phasor drift in
+ * both magnitude and phase, so every SU_MIXER_RENORM_PERIOD samples it is
+ * recomputed from the exact phase, which is kept in double precision.
+ *
+ * Frequency and phase changes are deferred to the next call to
+ * su_mixer_mix: a block is always mixed with a single frequency.
+ */
+#define SU_MIXER_RENORM_PERIOD 256
+
+struct sigutils_mixer {
+  SUFLOAT   fnor;    /* Normalized frequency, as requested */
+  SUFLOAT   omega;   /* Angular frequency of the current block */
+  SUCOMPLEX step;    /* exp(j omega) */
+  double    phi;     /* Exact phase of the next sample */
+  double    phi_inc; /* Pending phase increment */
+};
+
+typedef struct sigutils_mixer su_mixer_t;
+
+#define su_mixer_INITIALIZER {0, 0, 1, 0, 0}
+
+void su_mixer_init(su_mixer_t *mixer, SUFLOAT fnor);
+
+/* Applied on the next block */
+void su_mixer_set_freq(su_mixer_t *mixer, SUFLOAT fnor);
+
+/* Applied on the next block */
+void su_mixer_inc_phase(su_mixer_t *mixer, SUFLOAT delta);
+
+SUFLOAT su_mixer_get_freq(const su_mixer_t *mixer);
+
+/* Phase of the next sample, in [0, 2 PI) */
+SUFLOAT su_mixer_get_phase(const su_mixer_t *mixer);
+
+/* y[i] = x[i] * lo[i]. x and y may be the same buffer */
+void su_mixer_mix(
+    su_mixer_t *mixer,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT size);
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic pop
+#  endif // __clang__
+}
+#endif /* __cplusplus */
+
+#endif /* _SIGUTILS_MIXER_H */
@@ -20,12 +20,39 @@
 
 #define _GNU_SOURCE
 #include <math.h>
+#include <pthread.h>
 
 #define SU_LOG_DOMAIN "ncqo"
 
 #include "log.h"
 #include "ncqo.h"
 #include "sampling.h"
+#include "simd.h"
+
+/*
+ * Quarter-wave table, shared by all integer oscillators. Two extra
+ * entries let the interpolation read past the end of the quarter. It is
+ * built exactly once, no matter how many threads create oscillators.
+ */
+SUPRIVATE SUFLOAT g_ncqo_lut[SU_NCQO_LUT_SIZE + 2];
+SUPRIVATE pthread_once_t g_ncqo_lut_once = PTHREAD_ONCE_INIT;
+
+SUPRIVATE void
+su_ncqo_lut_init(void)
+{
+  unsigned int i;
+
+  for (i = 0; i < SU_NCQO_LUT_SIZE + 2; ++i)
+    g_ncqo_lut[i] = sin(.5 * M_PI * i / SU_NCQO_LUT_SIZE);
+}
+
+const SUFLOAT *
+su_ncqo_get_lut(void)
+{
+  (void) pthread_once(&g_ncqo_lut_once, su_ncqo_lut_init);
+
+  return g_ncqo_lut;
+}
 
 /* Expects: relative frequency */
 void
@@ -37,21 +64,35 @@ su_ncqo_init(su_ncqo_t *ncqo, SUFLOAT fnor)
   ncqo->sin   = 0;
   ncqo->cos   = 1;
 
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  ncqo->p     = 0;
-  ncqo->pre_c = SU_FALSE;
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
+  ncqo->integer = SU_FALSE;
+  ncqo->fixed   = SU_FALSE;
+  ncqo->acc     = 0;
+  ncqo->inc     = su_ncqo_angle_to_acc(ncqo->omega);
 }
 
 void
-su_ncqo_init_fixed(su_ncqo_t *ncqo, SUFLOAT fnor)
+su_ncqo_init_integer(su_ncqo_t *ncqo, SUFLOAT fnor)
 {
   su_ncqo_init(ncqo, fnor);
 
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  ncqo->pre_c = SU_TRUE;
-  __su_ncqo_populate_precalc_buffer(ncqo);
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
+  (void) su_ncqo_get_lut();
+
+  ncqo->integer = SU_TRUE;
+}
+
+void
+su_ncqo_init_fixed(su_ncqo_t *ncqo, SUFLOAT fnor)
+{
+  su_ncqo_init_integer(ncqo, fnor);
+
+  ncqo->fixed = SU_TRUE;
+}
+
+SUINLINE SUCOMPLEX
+su_ncqo_lookup(uint32_t acc)
+{
+  return su_ncqo_lut_sin(g_ncqo_lut, acc + SU_NCQO_QUARTER)
+      + I * su_ncqo_lut_sin(g_ncqo_lut, acc);
 }
 
 SUINLINE void
@@ -75,12 +116,15 @@ __su_ncqo_assert_sin(su_ncqo_t *ncqo)
 void
 su_ncqo_set_phase(su_ncqo_t *ncqo, SUFLOAT phi)
 {
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c) {
+  if (ncqo->fixed) {
     SU_ERROR("Cannot set phase on a fixed NCQO\n");
     return;
   }
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
+
+  if (ncqo->integer) {
+    ncqo->acc = su_ncqo_angle_to_acc(phi);
+    return;
+  }
 
   ncqo->phi = phi - 2 * PI * SU_FLOOR(phi / (2 * PI));
 }
@@ -88,48 +132,33 @@ su_ncqo_set_phase(su_ncqo_t *ncqo, SUFLOAT phi)
 SUFLOAT
 su_ncqo_get_i(su_ncqo_t *ncqo)
 {
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c) {
-    return ncqo->cos_buffer[ncqo->p];
-  } else {
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
-    __su_ncqo_assert_cos(ncqo);
-    return ncqo->cos;
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  }
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
+  if (ncqo->integer)
+    return su_ncqo_lut_sin(g_ncqo_lut, ncqo->acc + SU_NCQO_QUARTER);
+
+  __su_ncqo_assert_cos(ncqo);
+  return ncqo->cos;
 }
 
 SUFLOAT
 su_ncqo_get_q(su_ncqo_t *ncqo)
 {
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c) {
-    return ncqo->sin_buffer[ncqo->p];
-  } else {
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
-    __su_ncqo_assert_sin(ncqo);
-    return ncqo->sin;
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  }
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
+  if (ncqo->integer)
+    return su_ncqo_lut_sin(g_ncqo_lut, ncqo->acc);
+
+  __su_ncqo_assert_sin(ncqo);
+  return ncqo->sin;
 }
 
 SUCOMPLEX
 su_ncqo_get(su_ncqo_t *ncqo)
 {
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c) {
-    return ncqo->cos_buffer[ncqo->p] + I * ncqo->sin_buffer[ncqo->p];
-  } else {
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
+  if (ncqo->integer)
+    return su_ncqo_lookup(ncqo->acc);
+
   __su_ncqo_assert_cos(ncqo);
   __su_ncqo_assert_sin(ncqo);
 
   return ncqo->cos + ncqo->sin * I;
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  }
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
 }
 
 SUFLOAT
@@ -137,12 +166,10 @@ su_ncqo_read_i(su_ncqo_t *ncqo)
 {
   SUFLOAT old;
 
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c) {
-    old = ncqo->cos_buffer[ncqo->p];
-    __su_ncqo_step_precalc(ncqo);
+  if (ncqo->integer) {
+    old = su_ncqo_lut_sin(g_ncqo_lut, ncqo->acc + SU_NCQO_QUARTER);
+    ncqo->acc += ncqo->inc;
   } else {
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
     old = ncqo->cos;
 
     __su_ncqo_step(ncqo);
@@ -150,9 +177,7 @@ su_ncqo_read_i(su_ncqo_t *ncqo)
     ncqo->cos_updated = SU_TRUE;
     ncqo->sin_updated = SU_FALSE;
     ncqo->cos = SU_COS(ncqo->phi);
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
   }
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
 
   return old;
 }
@@ -162,12 +187,10 @@ su_ncqo_read_q(su_ncqo_t *ncqo)
 {
   SUFLOAT old;
 
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c) {
-    old = ncqo->sin_buffer[ncqo->p];
-    __su_ncqo_step_precalc(ncqo);
+  if (ncqo->integer) {
+    old = su_ncqo_lut_sin(g_ncqo_lut, ncqo->acc);
+    ncqo->acc += ncqo->inc;
   } else {
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
     old = ncqo->sin;
 
     __su_ncqo_step(ncqo);
@@ -175,9 +198,7 @@ su_ncqo_read_q(su_ncqo_t *ncqo)
     ncqo->cos_updated = SU_FALSE;
     ncqo->sin_updated = SU_TRUE;
     ncqo->sin = SU_SIN(ncqo->phi);
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
   }
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
 
   return old;
 }
@@ -187,12 +208,10 @@ su_ncqo_read(su_ncqo_t *ncqo)
 {
   SUCOMPLEX old;
 
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c) {
-    old = ncqo->cos_buffer[ncqo->p] + I * ncqo->sin_buffer[ncqo->p];
-    __su_ncqo_step_precalc(ncqo);
+  if (ncqo->integer) {
+    old = su_ncqo_lookup(ncqo->acc);
+    ncqo->acc += ncqo->inc;
   } else {
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
     old = ncqo->cos + I * ncqo->sin;
 
     __su_ncqo_step(ncqo);
@@ -202,39 +221,67 @@ su_ncqo_read(su_ncqo_t *ncqo)
 
     ncqo->cos = SU_COS(ncqo->phi);
     ncqo->sin = SU_SIN(ncqo->phi);
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
   }
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
 
   return old;
 }
 
+void
+su_ncqo_read_bulk(su_ncqo_t *ncqo, SUCOMPLEX *out, SUSCOUNT n)
+{
+  SUSCOUNT i;
+
+  if (ncqo->integer) {
+    ncqo->acc = su_simd_ncqo(out, NULL, n, ncqo->acc, ncqo->inc, g_ncqo_lut);
+    return;
+  }
+
+  for (i = 0; i < n; ++i)
+    out[i] = su_ncqo_read(ncqo);
+}
+
+void
+su_ncqo_mix_bulk(
+    su_ncqo_t *ncqo,
+    const SUCOMPLEX *in,
+    SUCOMPLEX *out,
+    SUSCOUNT n)
+{
+  SUSCOUNT i;
+
+  if (ncqo->integer) {
+    ncqo->acc = su_simd_ncqo(out, in, n, ncqo->acc, ncqo->inc, g_ncqo_lut);
+    return;
+  }
+
+  for (i = 0; i < n; ++i)
+    out[i] = in[i] * su_ncqo_read(ncqo);
+}
+
 void
 su_ncqo_set_angfreq(su_ncqo_t *ncqo, SUFLOAT omrel)
 {
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c) {
+  if (ncqo->fixed) {
     SU_ERROR("Cannot change frequency on a fixed NCQO\n");
     return;
   }
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
 
   ncqo->omega = omrel;
   ncqo->fnor  = SU_ANG2NORM_FREQ(omrel);
+  ncqo->inc   = su_ncqo_angle_to_acc(ncqo->omega);
 }
 
 void
 su_ncqo_inc_angfreq(su_ncqo_t *ncqo, SUFLOAT delta)
 {
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c) {
+  if (ncqo->fixed) {
     SU_ERROR("Cannot increase frequency on a fixed NCQO\n");
     return;
   }
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
 
   ncqo->omega += delta;
   ncqo->fnor   = SU_ANG2NORM_FREQ(ncqo->omega);
+  ncqo->inc    = su_ncqo_angle_to_acc(ncqo->omega);
 }
 
 SUFLOAT
@@ -246,29 +293,27 @@ su_ncqo_get_angfreq(const su_ncqo_t *ncqo)
 void
 su_ncqo_set_freq(su_ncqo_t *ncqo, SUFLOAT fnor)
 {
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c) {
+  if (ncqo->fixed) {
     SU_ERROR("Cannot change frequency on a fixed NCQO\n");
     return;
   }
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
 
   ncqo->fnor  = fnor;
   ncqo->omega = SU_NORM2ANG_FREQ(fnor);
+  ncqo->inc   = su_ncqo_angle_to_acc(ncqo->omega);
 }
 
 void
 su_ncqo_inc_freq(su_ncqo_t *ncqo, SUFLOAT delta)
 {
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c) {
+  if (ncqo->fixed) {
     SU_ERROR("Cannot increase frequency on a fixed NCQO\n");
     return;
   }
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
 
   ncqo->fnor  += delta;
   ncqo->omega  = SU_NORM2ANG_FREQ(ncqo->fnor);
+  ncqo->inc    = su_ncqo_angle_to_acc(ncqo->omega);
 }
 
 SUFLOAT
@@ -276,4 +321,3 @@ su_ncqo_get_freq(const su_ncqo_t *ncqo)
 {
   return ncqo->fnor;
 }
-
@@ -21,6 +21,8 @@
 #ifndef _SIGUTILS_NCQO_H
 #define _SIGUTILS_NCQO_H
 
+#include <stdint.h>
+
 #include "types.h"
 #include "sampling.h"
 
@@ -33,21 +35,30 @@ extern "C" {
 #endif /* __cplusplus */
 
 
-#define SU_NCQO_USE_PRECALC_BUFFER
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-#  define SU_NCQO_PRECALC_BUFFER_LEN 1024
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
+/*
+ * Two kinds of oscillators are available:
+ *
+ * - Floating point: the phase is a float in [0, 2 PI), and sin / cos are
+ *   computed on demand. Rounding errors accumulate in the phase.
+ *
+ * - Integer: the phase is a 32-bit accumulator in which 2^32 is a full
+ *   turn. Wraparound is exact and the phase never drifts (the frequency
+ *   resolution is 2^-32 cycles per sample). sin / cos are interpolated
+ *   from a quarter-wave table shared by every oscillator, which makes
+ *   them cheap enough to mix whole buffers at once (see
+ *   su_ncqo_mix_bulk). Maximum error is about 3e-7.
+ *
+ * Fixed oscillators are integer oscillators whose phase and frequency
+ * cannot be changed after init.
+ */
+#define SU_NCQO_LUT_BITS      10
+#define SU_NCQO_LUT_SIZE      (1 << SU_NCQO_LUT_BITS) /* Per quarter turn */
+#define SU_NCQO_QUARTER       0x40000000u
+#define SU_NCQO_LUT_FRAC_BITS (30 - SU_NCQO_LUT_BITS)
+#define SU_NCQO_LUT_FRAC_MASK ((1u << SU_NCQO_LUT_FRAC_BITS) - 1)
 
 /* The numerically-controlled quadruature oscillator definition */
 struct sigutils_ncqo {
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  SUFLOAT phi_buffer[SU_NCQO_PRECALC_BUFFER_LEN];
-  SUFLOAT sin_buffer[SU_NCQO_PRECALC_BUFFER_LEN];
-  SUFLOAT cos_buffer[SU_NCQO_PRECALC_BUFFER_LEN];
-  SUBOOL  pre_c;
-  unsigned int p; /* Pointer in precalc buffer */
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
-
   SUFLOAT phi;
   SUFLOAT omega; /* Normalized angular frequency */
   SUFLOAT fnor;  /* Normalized frequency in hcps */
@@ -57,11 +68,17 @@ struct sigutils_ncqo {
 
   SUBOOL  cos_updated;
   SUFLOAT cos;
+
+  /* Integer oscillators */
+  SUBOOL   integer;
+  SUBOOL   fixed; /* Phase and frequency cannot change */
+  uint32_t acc;   /* Phase, in 2^-32 turns */
+  uint32_t inc;   /* Phase increment per sample */
 };
 
 typedef struct sigutils_ncqo su_ncqo_t;
 
-#define su_ncqo_INITIALIZER {0, 0, 0, 0, 0}
+#define su_ncqo_INITIALIZER {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
 
 /* Methods */
 SUINLINE SUFLOAT
@@ -82,105 +99,86 @@ su_phase_adjust_one_cycle(SUFLOAT phi)
   return phi;
 }
 
-SUINLINE void
-__su_ncqo_step(su_ncqo_t *ncqo)
+/* Angle (in radians, any sign) to accumulator units, modulo 2^32 */
+SUINLINE uint32_t
+su_ncqo_angle_to_acc(SUFLOAT phi)
 {
-  ncqo->phi += ncqo->omega;
+  double turns = phi / (2 * M_PI);
 
-  if (ncqo->phi >= 2 * PI)
-    ncqo->phi -= 2 * PI;
-  else if (ncqo->phi < 0)
-    ncqo->phi += 2 * PI;
+  turns -= floor(turns);
+
+  /* turns * 2^32 may round up to 2^32: truncate in 64 bits */
+  return (uint32_t) (uint64_t) (turns * 4294967296.);
 }
 
-/* vvvvvvvvvvvvvvvvvvvvvvvvvvv VOLK HACKS BELOW vvvvvvvvvvvvvvvvvvvvvvvvvvvvvv*/
-#if defined(_SU_SINGLE_PRECISION) && HAVE_VOLK
-#  define SU_USE_VOLK
-#  define SU_VOLK_CALL_STRIDE_BITS 5
-#  define SU_VOLK_CALL_STRIDE      (1 << SU_VOLK_CALL_STRIDE_BITS)
-#  define SU_VOLK_CALL_STRIDE_MASK (SU_VOLK_CALL_STRIDE - 1)
-#  ifdef __cplusplus
+SUINLINE SUFLOAT
+su_ncqo_acc_to_angle(uint32_t acc)
+{
+  return acc * (2 * M_PI / 4294967296.);
 }
-#  endif /* __cplusplus */
-#  include <volk/volk.h>
-#  ifdef __cplusplus
-extern "C" {
-#  endif /* __cplusplus */
-#endif
 
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-SUINLINE void
-__su_ncqo_populate_precalc_buffer(su_ncqo_t *ncqo)
+/*
+ * sin(2 PI phase / 2^32). The 2 MSBs of the phase select the quadrant, the
+ * next SU_NCQO_LUT_BITS the table entry, and the rest the fraction
+ * between entries.
+ */
+SUINLINE SUFLOAT
+su_ncqo_lut_sin(const SUFLOAT *lut, uint32_t phase)
 {
-  unsigned int i;
-#ifdef SU_USE_VOLK
-  unsigned int p;
-#endif /* SU_USE_VOLK */
-  /* Precalculate phase buffer */
-  for (i = 0; i < SU_NCQO_PRECALC_BUFFER_LEN; ++i) {
-    ncqo->phi_buffer[i] = ncqo->phi;
-#  ifndef SU_USE_VOLK
-#    ifdef HAVE_SINCOS
-    SU_SINCOS(ncqo->phi, ncqo->sin_buffer + i, ncqo->cos_buffer + i);
-#    else /* HAVE_SINCOS */
-    ncqo->sin_buffer[i] = SU_SIN(ncqo->phi);
-    ncqo->cos_buffer[i] = SU_COS(ncqo->phi);
-#    endif /* HAVE_SINCOS */
-#  else
-    if ((i & SU_VOLK_CALL_STRIDE_MASK) == SU_VOLK_CALL_STRIDE_MASK) {
-      p = i & ~SU_VOLK_CALL_STRIDE_MASK;
-      volk_32f_sin_32f(
-          ncqo->sin_buffer + p,
-          ncqo->phi_buffer + p,
-          SU_VOLK_CALL_STRIDE);
-      volk_32f_cos_32f(
-          ncqo->cos_buffer + p,
-          ncqo->phi_buffer + p,
-          SU_VOLK_CALL_STRIDE);
-    }
-#  endif /* SU_USE_VOLK */
-    __su_ncqo_step(ncqo);
-  }
+  uint32_t p = phase & (SU_NCQO_QUARTER - 1);
+  uint32_t i;
+  SUFLOAT frac, v;
+
+  /* Odd quadrants run the table backwards */
+  if (phase & SU_NCQO_QUARTER)
+    p = SU_NCQO_QUARTER - p;
+
+  i    = p >> SU_NCQO_LUT_FRAC_BITS;
+  frac = (p & SU_NCQO_LUT_FRAC_MASK) * (1.f / (1 << SU_NCQO_LUT_FRAC_BITS));
+  v    = lut[i] + frac * (lut[i + 1] - lut[i]);
+
+  /* Second half of the turn is negative */
+  return (phase & (SU_NCQO_QUARTER << 1)) ? -v : v;
 }
 
 SUINLINE void
-__su_ncqo_step_precalc(su_ncqo_t *ncqo)
+__su_ncqo_step(su_ncqo_t *ncqo)
 {
-  if (++ncqo->p == SU_NCQO_PRECALC_BUFFER_LEN) {
-    ncqo->p = 0;
-    __su_ncqo_populate_precalc_buffer(ncqo);
-  }
-}
+  ncqo->phi += ncqo->omega;
 
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
-/* ^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^ VOLK HACKS ABOVE ^^^^^^^^^^^^^^^^^^^^^^^^^^^*/
+  if (ncqo->phi >= 2 * PI)
+    ncqo->phi -= 2 * PI;
+  else if (ncqo->phi < 0)
+    ncqo->phi += 2 * PI;
+}
 
 /* NCQO constructor */
 void su_ncqo_init(su_ncqo_t *ncqo, SUFLOAT frel);
 
-/* NCQO constructor for fixed frequency */
+/* NCQO constructor, integer phase accumulator */
+void su_ncqo_init_integer(su_ncqo_t *ncqo, SUFLOAT fnor);
+
+/* NCQO constructor for fixed frequency (integer phase accumulator) */
 void su_ncqo_init_fixed(su_ncqo_t *ncqo, SUFLOAT fnor);
 
+/* Quarter-wave sine table: sin(PI / 2 * i / SU_NCQO_LUT_SIZE) */
+const SUFLOAT *su_ncqo_get_lut(void);
+
 /* Compute next step */
 SUINLINE void
 su_ncqo_step(su_ncqo_t *ncqo)
 {
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c) {
-    __su_ncqo_step_precalc(ncqo);
+  if (ncqo->integer) {
+    ncqo->acc += ncqo->inc;
   } else {
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
     __su_ncqo_step(ncqo);
 
     /* Sine & cosine values are now outdated */
     ncqo->cos_updated = SU_FALSE;
     ncqo->sin_updated = SU_FALSE;
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
   }
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
 }
 
-
 /* Force phase */
 void su_ncqo_set_phase(su_ncqo_t *ncqo, SUFLOAT phi);
 
@@ -188,10 +186,8 @@ void su_ncqo_set_phase(su_ncqo_t *ncqo, SUFLOAT phi);
 SUINLINE SUFLOAT
 su_ncqo_get_phase(su_ncqo_t *ncqo)
 {
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c)
-    return ncqo->phi_buffer[ncqo->p];
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
+  if (ncqo->integer)
+    return su_ncqo_acc_to_angle(ncqo->acc);
 
   return ncqo->phi;
 }
@@ -200,14 +196,17 @@ su_ncqo_get_phase(su_ncqo_t *ncqo)
 SUINLINE void
 su_ncqo_inc_phase(su_ncqo_t *ncqo, SUFLOAT delta)
 {
-#ifdef SU_NCQO_USE_PRECALC_BUFFER
-  if (ncqo->pre_c) {
-#  ifdef SU_LOG_DOMAIN
+  if (ncqo->fixed) {
+#ifdef SU_LOG_DOMAIN
     SU_ERROR("Cannot increase phase on a fixed NCQO\n");
-#  endif /* SU_LOG_DOMAIN */
+#endif /* SU_LOG_DOMAIN */
+    return;
+  }
+
+  if (ncqo->integer) {
+    ncqo->acc += su_ncqo_angle_to_acc(delta);
     return;
   }
-#endif /* SU_NCQO_USE_PRECALC_BUFFER */
 
   ncqo->phi += delta;
 
@@ -233,6 +232,16 @@ SUFLOAT su_ncqo_read_q(su_ncqo_t *ncqo);
 /* Read (compute next + get) both components as complex */
 SUCOMPLEX su_ncqo_read(su_ncqo_t *ncqo);
 
+/* Read the next n samples of the oscillator */
+void su_ncqo_read_bulk(su_ncqo_t *ncqo, SUCOMPLEX *out, SUSCOUNT n);
+
+/* out[i] = in[i] * su_ncqo_read(ncqo). in and out may be the same buffer */
+void su_ncqo_mix_bulk(
+    su_ncqo_t *ncqo,
+    const SUCOMPLEX *in,
+    SUCOMPLEX *out,
+    SUSCOUNT n);
+
 /* Set oscillator frequency (normalized angular freq) */
 void su_ncqo_set_angfreq(su_ncqo_t *ncqo, SUFLOAT omrel);
 
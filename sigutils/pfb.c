@@ -0,0 +1,336 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#define SU_LOG_DOMAIN "pfb"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "log.h"
+#include "taps.h"
+#include "pfb.h"
+
+/******************************** Channel API *********************************/
+SUPRIVATE void
+su_pfb_channel_destroy(su_pfb_channel_t *channel)
+{
+  if (channel->buffer != NULL)
+    free(channel->buffer);
+
+  free(channel);
+}
+
+SUPRIVATE su_pfb_channel_t *
+su_pfb_channel_new(
+    const su_pfb_channelizer_t *owner,
+    const struct sigutils_pfb_channel_params *params)
+{
+  su_pfb_channel_t *new = NULL;
+
+  SU_TRYCATCH(params->index < owner->params.channels, goto fail);
+  SU_TRYCATCH(params->on_data != NULL, goto fail);
+
+  SU_TRYCATCH(new = calloc(1, sizeof(su_pfb_channel_t)), goto fail);
+
+  new->params = *params;
+  new->slot = -1;
+
+  SU_TRYCATCH(
+      new->buffer = malloc(owner->params.buffer_size * sizeof(SUCOMPLEX)),
+      goto fail);
+
+  return new;
+
+fail:
+  if (new != NULL)
+    su_pfb_channel_destroy(new);
+
+  return NULL;
+}
+
+SUINLINE SUBOOL
+su_pfb_channel_flush(su_pfb_channel_t *channel)
+{
+  SUBOOL ok = SU_TRUE;
+
+  if (channel->p > 0 && !channel->closing) {
+    ok = (channel->params.on_data) (
+        channel,
+        channel->params.privdata,
+        channel->buffer,
+        channel->p);
+    channel->p = 0;
+  }
+
+  return ok;
+}
+
+/****************************** Channelizer API *******************************/
+void
+su_pfb_channelizer_destroy(su_pfb_channelizer_t *pfb)
+{
+  unsigned int i;
+
+  for (i = 0; i < pfb->channel_count; ++i)
+    if (pfb->channel_list[i] != NULL)
+      su_pfb_channel_destroy(pfb->channel_list[i]);
+
+  if (pfb->channel_list != NULL)
+    free(pfb->channel_list);
+
+  if (pfb->plan != NULL)
+    su_fft_plan_release(pfb->plan);
+
+  if (pfb->y != NULL)
+    SU_FFTW(_free) (pfb->y);
+
+  if (pfb->u != NULL)
+    SU_FFTW(_free) (pfb->u);
+
+  if (pfb->history != NULL)
+    free(pfb->history);
+
+  if (pfb->h != NULL)
+    free(pfb->h);
+
+  free(pfb);
+}
+
+su_pfb_channelizer_t *
+su_pfb_channelizer_new(const struct sigutils_pfb_channelizer_params *params)
+{
+  su_pfb_channelizer_t *new = NULL;
+  unsigned int channels = params->channels;
+  SUFLOAT sum = 0;
+  unsigned int i;
+
+  SU_TRYCATCH(channels > 1, goto fail);
+  SU_TRYCATCH(params->taps_per_branch > 0, goto fail);
+  SU_TRYCATCH(params->bw > 0, goto fail);
+  SU_TRYCATCH(params->buffer_size > 0, goto fail);
+  SU_TRYCATCH(!params->oversample || (channels & 1) == 0, goto fail);
+
+  SU_TRYCATCH(new = calloc(1, sizeof(su_pfb_channelizer_t)), goto fail);
+
+  new->params = *params;
+  new->decimation = params->oversample ? channels / 2 : channels;
+  new->length = channels * params->taps_per_branch;
+
+  /*
+   * Prototype: low pass filter whose cutoff is half the channel spacing
+   * (times the relative bandwidth). Normalized for unity DC gain.
+   */
+  SU_TRYCATCH(new->h = malloc(new->length * sizeof(SUFLOAT)), goto fail);
+
+  su_taps_brickwall_lp_init(new->h, params->bw / channels, new->length);
+
+  for (i = 0; i < new->length; ++i)
+    sum += new->h[i];
+
+  for (i = 0; i < new->length; ++i)
+    new->h[i] /= sum;
+
+  SU_TRYCATCH(
+      new->history = calloc(2 * new->length, sizeof(SUCOMPLEX)),
+      goto fail);
+
+  SU_TRYCATCH(
+      new->u = SU_FFTW(_malloc)(channels * sizeof(SU_FFTW(_complex))),
+      goto fail);
+
+  SU_TRYCATCH(
+      new->y = SU_FFTW(_malloc)(channels * sizeof(SU_FFTW(_complex))),
+      goto fail);
+
+  SU_TRYCATCH(
+      new->plan = su_fft_plan_acquire(channels, FFTW_BACKWARD, new->u, new->y),
+      goto fail);
+
+  return new;
+
+fail:
+  if (new != NULL)
+    su_pfb_channelizer_destroy(new);
+
+  return NULL;
+}
+
+su_pfb_channel_t *
+su_pfb_channelizer_open_channel(
+    su_pfb_channelizer_t *pfb,
+    const struct sigutils_pfb_channel_params *params)
+{
+  su_pfb_channel_t *new = NULL;
+  int slot;
+
+  SU_TRYCATCH(new = su_pfb_channel_new(pfb, params), goto fail);
+
+  SU_TRYCATCH(
+      (slot = PTR_LIST_APPEND_CHECK(pfb->channel, new)) != -1,
+      goto fail);
+
+  new->slot = slot;
+
+  ++pfb->open;
+
+  return new;
+
+fail:
+  if (new != NULL)
+    su_pfb_channel_destroy(new);
+
+  return NULL;
+}
+
+SUBOOL
+su_pfb_channelizer_close_channel(
+    su_pfb_channelizer_t *pfb,
+    su_pfb_channel_t *channel)
+{
+  SU_TRYCATCH(channel->slot >= 0, return SU_FALSE);
+  SU_TRYCATCH(
+      (unsigned int) channel->slot < pfb->channel_count,
+      return SU_FALSE);
+  SU_TRYCATCH(pfb->channel_list[channel->slot] == channel, return SU_FALSE);
+  SU_TRYCATCH(!channel->closing, return SU_FALSE);
+
+  --pfb->open;
+
+  /* Called from on_data: the delivery loop may still reference it */
+  if (pfb->delivering) {
+    channel->closing = SU_TRUE;
+    ++pfb->closing;
+    return SU_TRUE;
+  }
+
+  pfb->channel_list[channel->slot] = NULL;
+
+  su_pfb_channel_destroy(channel);
+
+  return SU_TRUE;
+}
+
+/* Release the channels closed during the last delivery */
+SUPRIVATE void
+su_pfb_channelizer_collect(su_pfb_channelizer_t *pfb)
+{
+  su_pfb_channel_t *channel;
+  unsigned int i;
+
+  FOR_EACH_PTR(channel, i, pfb->channel)
+    if (channel->closing) {
+      pfb->channel_list[i] = NULL;
+      su_pfb_channel_destroy(channel);
+    }
+
+  pfb->closing = 0;
+}
+
+/* Computes one output sample for all M channels */
+SUINLINE void
+__su_pfb_channelizer_run(su_pfb_channelizer_t *pfb)
+{
+  unsigned int channels = pfb->params.channels;
+  unsigned int taps = pfb->params.taps_per_branch;
+  const SUCOMPLEX *x = pfb->history + pfb->pos;
+  const SUFLOAT *h;
+  SUCOMPLEX *u = pfb->u;
+  unsigned int p, r;
+
+  /* Polyphase partial sums. Inner loop is contiguous in h and x */
+  memset(u, 0, channels * sizeof(SUCOMPLEX));
+
+  for (p = 0; p < taps; ++p) {
+    h = pfb->h + p * channels;
+    for (r = 0; r < channels; ++r)
+      u[r] += h[r] * x[r];
+    x += channels;
+  }
+
+  su_fft_plan_execute(pfb->plan, pfb->u, pfb->y);
+}
+
+SUINLINE SUBOOL
+__su_pfb_channelizer_deliver(su_pfb_channelizer_t *pfb)
+{
+  su_pfb_channel_t *channel;
+  SUCOMPLEX y;
+  SUBOOL ok = SU_TRUE;
+  SUBOOL odd = pfb->params.oversample && (pfb->m & 1);
+  unsigned int i;
+
+  FOR_EACH_PTR(channel, i, pfb->channel) {
+    if (channel->closing)
+      continue;
+
+    y = pfb->y[channel->params.index];
+
+    /* 2x oversampling: (-1)^(k m) */
+    if (odd && (channel->params.index & 1))
+      y = -y;
+
+    channel->buffer[channel->p++] = y;
+
+    if (channel->p == pfb->params.buffer_size)
+      ok = su_pfb_channel_flush(channel) && ok;
+  }
+
+  ++pfb->m;
+
+  return ok;
+}
+
+SUBOOL
+su_pfb_channelizer_feed_bulk(
+    su_pfb_channelizer_t *pfb,
+    const SUCOMPLEX *buf,
+    SUSCOUNT size)
+{
+  su_pfb_channel_t *channel;
+  unsigned int length = pfb->length;
+  SUBOOL ok = SU_TRUE;
+  SUSCOUNT i;
+  unsigned int j;
+
+  pfb->delivering = SU_TRUE;
+
+  for (i = 0; i < size; ++i) {
+    /* Push sample, newest first */
+    pfb->pos = pfb->pos == 0 ? length - 1 : pfb->pos - 1;
+    pfb->history[pfb->pos] = pfb->history[pfb->pos + length] = buf[i];
+
+    if (++pfb->count == pfb->decimation) {
+      pfb->count = 0;
+      __su_pfb_channelizer_run(pfb);
+      ok = __su_pfb_channelizer_deliver(pfb) && ok;
+    }
+  }
+
+  /* Don't keep samples waiting across calls */
+  FOR_EACH_PTR(channel, j, pfb->channel)
+    ok = su_pfb_channel_flush(channel) && ok;
+
+  pfb->delivering = SU_FALSE;
+
+  if (pfb->closing > 0)
+    su_pfb_channelizer_collect(pfb);
+
+  return ok;
+}
@@ -0,0 +1,184 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#ifndef _SIGUTILS_PFB_H
+#define _SIGUTILS_PFB_H
+
+#include "types.h"
+#include "fftplan.h"
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic push
+#    pragma clang diagnostic ignored "-Wreturn-type-c-linkage"
+#  endif // __clang__
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Polyphase filter bank channelizer. Splits the input band into M
+ * uniformly spaced channels, channel k being centered at 2 * PI * k / M
+ * (channels above M / 2 are negative frequencies). All channels are
+ * computed at once with a single M-point FFT per output sample:
+ *
+ *   u_r[m] = sum_p h[p * M + r] * x[m * D - p * M - r]
+ *   y_k[m] = e^(-j 2 PI k m D / M) * IDFT_M{u_r[m]}[k]
+ *
+ * Where h is a low-pass prototype of M * taps_per_branch coefficients and
+ * D is the decimation: M for a critically sampled bank (outputs at fs / M)
+ * or M / 2 for a 2x oversampled bank (outputs at 2 fs / M). In the latter,
+ * the correction term reduces to (-1)^(k m).
+ *
+ * Compared to su_specttuner, this only pays off when channels sit on a
+ * uniform raster, but then every channel comes at the cost of one FFT.
+ */
+
+#define SU_PFB_CHANNELIZER_DEFAULT_TAPS_PER_BRANCH 8
+#define SU_PFB_CHANNELIZER_DEFAULT_BUFFER_SIZE     512
+
+struct sigutils_pfb_channelizer_params {
+  unsigned int channels;        /* M */
+  unsigned int taps_per_branch; /* Prototype length is M * taps_per_branch */
+  SUBOOL oversample;            /* Output at 2 fs / M instead of fs / M */
+  SUFLOAT bw;                   /* Prototype bandwidth, relative to spacing */
+  SUSCOUNT buffer_size;         /* Max samples per channel callback */
+};
+
+#define sigutils_pfb_channelizer_params_INITIALIZER                    \
+{                                                                      \
+  64,       /* channels */                                             \
+  SU_PFB_CHANNELIZER_DEFAULT_TAPS_PER_BRANCH, /* taps_per_branch */    \
+  SU_FALSE, /* oversample */                                           \
+  1,        /* bw */                                                   \
+  SU_PFB_CHANNELIZER_DEFAULT_BUFFER_SIZE, /* buffer_size */            \
+}
+
+struct sigutils_pfb_channel;
+
+/*
+ * on_data may close any channel, including its own. Channels closed
+ * from a callback stop receiving data immediately, but their memory is
+ * released when su_pfb_channelizer_feed_bulk returns.
+ */
+struct sigutils_pfb_channel_params {
+  unsigned int index; /* Channel index, 0 to M - 1 */
+  void *privdata;     /* Private data */
+  SUBOOL (*on_data) (
+      const struct sigutils_pfb_channel *channel,
+      void *privdata,
+      const SUCOMPLEX *data, /* Valid only during the callback */
+      SUSCOUNT size);
+};
+
+#define sigutils_pfb_channel_params_INITIALIZER \
+{                                               \
+  0,    /* index */                             \
+  NULL, /* privdata */                          \
+  NULL, /* on_data */                           \
+}
+
+struct sigutils_pfb_channel {
+  struct sigutils_pfb_channel_params params;
+  int slot;           /* Back reference */
+
+  SUCOMPLEX *buffer;  /* Pending output */
+  SUSCOUNT p;         /* Samples in buffer */
+
+  SUBOOL closing;     /* Closed during delivery, release pending */
+};
+
+typedef struct sigutils_pfb_channel su_pfb_channel_t;
+
+struct sigutils_pfb_channelizer {
+  struct sigutils_pfb_channelizer_params params;
+
+  unsigned int decimation; /* D */
+  unsigned int length;     /* Prototype length (L = M * taps_per_branch) */
+  SUFLOAT *h;              /* Prototype filter, L coefficients */
+
+  /*
+   * Delay line, in reverse order: x[n - j] == history[pos + j]. Every
+   * sample is written twice (at pos and pos + L) so that the last L
+   * samples are always contiguous.
+   */
+  SUCOMPLEX *history;
+  unsigned int pos;
+  unsigned int count;      /* Samples since last output */
+  SUSCOUNT m;              /* Output sample index */
+
+  SU_FFTW(_complex) *u;    /* Polyphase partial sums */
+  SU_FFTW(_complex) *y;    /* Channel outputs */
+  su_fft_plan_t *plan;
+
+  unsigned int open;       /* Open channels */
+  unsigned int closing;    /* Channels closed during delivery */
+  SUBOOL delivering;       /* Inside feed_bulk: closes are deferred */
+  PTR_LIST(su_pfb_channel_t, channel);
+};
+
+typedef struct sigutils_pfb_channelizer su_pfb_channelizer_t;
+
+SUINLINE unsigned int
+su_pfb_channelizer_get_channel_count(const su_pfb_channelizer_t *pfb)
+{
+  return pfb->open;
+}
+
+SUINLINE unsigned int
+su_pfb_channelizer_get_decimation(const su_pfb_channelizer_t *pfb)
+{
+  return pfb->decimation;
+}
+
+/* Center frequency of channel index, as angular frequency */
+SUINLINE SUFLOAT
+su_pfb_channelizer_get_channel_freq(
+    const su_pfb_channelizer_t *pfb,
+    unsigned int index)
+{
+  return 2 * PI * (SUFLOAT) index / (SUFLOAT) pfb->params.channels;
+}
+
+su_pfb_channelizer_t *su_pfb_channelizer_new(
+    const struct sigutils_pfb_channelizer_params *params);
+
+void su_pfb_channelizer_destroy(su_pfb_channelizer_t *pfb);
+
+su_pfb_channel_t *su_pfb_channelizer_open_channel(
+    su_pfb_channelizer_t *pfb,
+    const struct sigutils_pfb_channel_params *params);
+
+SUBOOL su_pfb_channelizer_close_channel(
+    su_pfb_channelizer_t *pfb,
+    su_pfb_channel_t *channel);
+
+SUBOOL su_pfb_channelizer_feed_bulk(
+    su_pfb_channelizer_t *pfb,
+    const SUCOMPLEX *buf,
+    SUSCOUNT size);
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic pop
+#  endif // __clang__
+}
+#endif /* __cplusplus */
+
+#endif /* _SIGUTILS_PFB_H */
@@ -129,7 +129,7 @@ su_costas_init(
   costas->kind = kind;
   costas->gain = 1;
 
-  su_ncqo_init(&costas->ncqo, fhint);
+  su_ncqo_init_integer(&costas->ncqo, fhint);
 
   /* Initialize arm filters */
   if (arm_order == 0)
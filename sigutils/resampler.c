@@ -0,0 +1,377 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#define SU_LOG_DOMAIN "resampler"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "log.h"
+#include "taps.h"
+#include "simd.h"
+#include "resampler.h"
+
+SUPRIVATE unsigned int
+su_resampler_gcd(unsigned int a, unsigned int b)
+{
+  unsigned int t;
+
+  while (b != 0) {
+    t = a % b;
+    a = b;
+    b = t;
+  }
+
+  return a;
+}
+
+/* Make room for at least one more sample */
+SUINLINE void
+__su_resampler_rewind(su_resampler_t *resampler)
+{
+  if (resampler->x_ptr == resampler->x_alloc) {
+    memmove(
+        resampler->x,
+        resampler->x + resampler->x_alloc - (resampler->x_size - 1),
+        (resampler->x_size - 1) * sizeof(SUCOMPLEX));
+    resampler->x_ptr = resampler->x_size - 1;
+  }
+}
+
+/*
+ * Cubic Lagrange interpolation between x[1] and x[2], in Farrow form:
+ * the polynomial coefficients depend only on the samples, so changing
+ * mu (or the ratio) costs nothing.
+ */
+SUINLINE SUCOMPLEX
+__su_resampler_farrow(const SUCOMPLEX *x, SUFLOAT mu)
+{
+  SUCOMPLEX c1, c2, c3;
+
+  c1 = -x[0] / 3 - x[1] / 2 + x[2] - x[3] / 6;
+  c2 = (x[0] + x[2]) / 2 - x[1];
+  c3 = (x[3] - x[0]) / 6 + (x[1] - x[2]) / 2;
+
+  return ((c3 * mu + c2) * mu + c1) * mu + x[1];
+}
+
+/* Outputs for samples up to ptr - 1, rational mode */
+SUINLINE SUSCOUNT
+__su_resampler_run_rational(
+    su_resampler_t *resampler,
+    unsigned int ptr,
+    SUCOMPLEX *y)
+{
+  const SUCOMPLEX *x = resampler->x + ptr - resampler->taps;
+  SUSCOUNT n = 0;
+
+  while (resampler->phase < resampler->interp) {
+    y[n++] = su_simd_dot_real(
+        x,
+        resampler->h + resampler->phase * resampler->taps,
+        resampler->taps);
+    resampler->phase += resampler->decim;
+  }
+
+  resampler->phase -= resampler->interp;
+
+  return n;
+}
+
+/* Outputs for samples up to ptr - 1, arbitrary mode */
+SUINLINE SUSCOUNT
+__su_resampler_run_arbitrary(
+    su_resampler_t *resampler,
+    unsigned int ptr,
+    SUCOMPLEX *y)
+{
+  const SUCOMPLEX *x = resampler->x + ptr - SU_RESAMPLER_FARROW_TAPS;
+  SUSCOUNT n = 0;
+
+  while (resampler->mu < 1) {
+    y[n++] = __su_resampler_farrow(x, resampler->mu);
+    resampler->mu += resampler->step;
+  }
+
+  resampler->mu -= 1;
+
+  return n;
+}
+
+SUPRIVATE SUBOOL
+su_resampler_alloc_delay_line(su_resampler_t *resampler, unsigned int size)
+{
+  resampler->x_size  = size;
+  resampler->x_alloc = size - 1 + SU_RESAMPLER_HEADROOM;
+
+  SU_TRYCATCH(
+      resampler->x = SU_FFTW(_malloc)(resampler->x_alloc * sizeof(SUCOMPLEX)),
+      return SU_FALSE);
+
+  return SU_TRUE;
+}
+
+/*********************************** API **************************************/
+void
+su_resampler_finalize(su_resampler_t *resampler)
+{
+  if (resampler->h != NULL)
+    SU_FFTW(_free) (resampler->h);
+
+  if (resampler->x != NULL)
+    SU_FFTW(_free) (resampler->x);
+
+  su_fir_filt_finalize(&resampler->aa);
+
+  memset(resampler, 0, sizeof(su_resampler_t));
+
+  resampler->interp = 1;
+  resampler->decim  = 1;
+  resampler->step   = 1;
+}
+
+void
+su_resampler_reset(su_resampler_t *resampler)
+{
+  memset(resampler->x, 0, (resampler->x_size - 1) * sizeof(SUCOMPLEX));
+
+  if (resampler->have_aa)
+    su_fir_filt_reset(&resampler->aa);
+
+  resampler->x_ptr = resampler->x_size - 1;
+  resampler->phase = 0;
+  resampler->mu    = 0;
+}
+
+SUBOOL
+su_resampler_init_rational(
+    su_resampler_t *resampler,
+    unsigned int interp,
+    unsigned int decim,
+    unsigned int taps)
+{
+  SUFLOAT *proto = NULL;
+  SUFLOAT sum = 0;
+  unsigned int gcd;
+  unsigned int length;
+  unsigned int p, k;
+
+  SU_TRYCATCH(interp > 0, return SU_FALSE);
+  SU_TRYCATCH(decim > 0, return SU_FALSE);
+  SU_TRYCATCH(taps > 0, return SU_FALSE);
+
+  memset(resampler, 0, sizeof(su_resampler_t));
+
+  gcd = su_resampler_gcd(interp, decim);
+
+  resampler->mode   = SU_RESAMPLER_MODE_RATIONAL;
+  resampler->interp = interp / gcd;
+  resampler->decim  = decim / gcd;
+  resampler->step   = 1;
+
+  /*
+   * Transition band is relative to the narrowest of both bands: when
+   * decimating, the prototype grows with M.
+   */
+  resampler->taps =
+      (taps * SU_MAX(resampler->interp, resampler->decim)
+      + resampler->interp - 1) / resampler->interp;
+
+  length = resampler->interp * resampler->taps;
+
+  SU_TRYCATCH(
+      resampler->h = SU_FFTW(_malloc)(length * sizeof(SUFLOAT)),
+      goto fail);
+
+  SU_TRYCATCH(proto = malloc(length * sizeof(SUFLOAT)), goto fail);
+
+  SU_TRYCATCH(
+      su_resampler_alloc_delay_line(resampler, resampler->taps),
+      goto fail);
+
+  /*
+   * Prototype runs at L times the input rate. Its cutoff is the lowest of
+   * both Nyquist frequencies, and its gain L makes up for the zeros.
+   */
+  su_taps_brickwall_lp_init(
+      proto,
+      1. / SU_MAX(resampler->interp, resampler->decim),
+      length);
+
+  for (p = 0; p < length; ++p)
+    sum += proto[p];
+
+  for (p = 0; p < resampler->interp; ++p)
+    for (k = 0; k < resampler->taps; ++k)
+      resampler->h[p * resampler->taps + resampler->taps - k - 1] =
+          resampler->interp * proto[p + k * resampler->interp] / sum;
+
+  free(proto);
+
+  su_resampler_reset(resampler);
+
+  return SU_TRUE;
+
+fail:
+  if (proto != NULL)
+    free(proto);
+
+  su_resampler_finalize(resampler);
+
+  return SU_FALSE;
+}
+
+SUBOOL
+su_resampler_init_arbitrary(
+    su_resampler_t *resampler,
+    SUFLOAT ratio,
+    unsigned int aa_taps)
+{
+  SUFLOAT *b = NULL;
+
+  SU_TRYCATCH(ratio > 0, return SU_FALSE);
+
+  memset(resampler, 0, sizeof(su_resampler_t));
+
+  resampler->mode   = SU_RESAMPLER_MODE_ARBITRARY;
+  resampler->interp = 1;
+  resampler->decim  = 1;
+  resampler->step   = 1. / ratio;
+
+  SU_TRYCATCH(
+      su_resampler_alloc_delay_line(resampler, SU_RESAMPLER_FARROW_TAPS),
+      goto fail);
+
+  /* Interpolation does not need a prefilter */
+  if (aa_taps > 0 && ratio < 1) {
+    SU_TRYCATCH(b = malloc(aa_taps * sizeof(SUFLOAT)), goto fail);
+    su_taps_brickwall_lp_init(b, ratio, aa_taps);
+    SU_TRYCATCH(su_fir_filt_init(&resampler->aa, b, aa_taps), goto fail);
+    resampler->have_aa = SU_TRUE;
+    free(b);
+    b = NULL;
+  }
+
+  su_resampler_reset(resampler);
+
+  return SU_TRUE;
+
+fail:
+  if (b != NULL)
+    free(b);
+
+  su_resampler_finalize(resampler);
+
+  return SU_FALSE;
+}
+
+SUFLOAT
+su_resampler_get_ratio(const su_resampler_t *resampler)
+{
+  if (resampler->mode == SU_RESAMPLER_MODE_RATIONAL)
+    return (SUFLOAT) resampler->interp / (SUFLOAT) resampler->decim;
+
+  return 1. / resampler->step;
+}
+
+SUBOOL
+su_resampler_set_ratio(su_resampler_t *resampler, SUFLOAT ratio)
+{
+  SU_TRYCATCH(
+      resampler->mode == SU_RESAMPLER_MODE_ARBITRARY,
+      return SU_FALSE);
+  SU_TRYCATCH(ratio > 0, return SU_FALSE);
+
+  resampler->step = 1. / ratio;
+
+  return SU_TRUE;
+}
+
+SUSCOUNT
+su_resampler_get_max_output(const su_resampler_t *resampler, SUSCOUNT len)
+{
+  if (resampler->mode == SU_RESAMPLER_MODE_RATIONAL)
+    return len * resampler->interp / resampler->decim + 1;
+
+  /* One extra output to absorb rounding errors in mu */
+  return (SUSCOUNT) SU_FLOOR(len / resampler->step) + 2;
+}
+
+SUSCOUNT
+su_resampler_get_max_input(const su_resampler_t *resampler, SUSCOUNT room)
+{
+  if (resampler->mode == SU_RESAMPLER_MODE_RATIONAL) {
+    if (room < 1)
+      return 0;
+
+    return (room - 1) * resampler->decim / resampler->interp;
+  }
+
+  if (room < 2)
+    return 0;
+
+  return (SUSCOUNT) SU_FLOOR((room - 2) * resampler->step);
+}
+
+SUSCOUNT
+su_resampler_feed_bulk(
+    su_resampler_t *resampler,
+    const SUCOMPLEX *x,
+    SUSCOUNT len,
+    SUCOMPLEX *y)
+{
+  SUSCOUNT chunk;
+  SUSCOUNT i;
+  SUSCOUNT n = 0;
+  unsigned int ptr;
+
+  while (len > 0) {
+    __su_resampler_rewind(resampler);
+
+    chunk = resampler->x_alloc - resampler->x_ptr;
+    if (chunk > len)
+      chunk = len;
+
+    if (resampler->have_aa)
+      su_fir_filt_feed_bulk(
+          &resampler->aa,
+          x,
+          resampler->x + resampler->x_ptr,
+          chunk);
+    else
+      memcpy(resampler->x + resampler->x_ptr, x, chunk * sizeof(SUCOMPLEX));
+
+    ptr = resampler->x_ptr + 1;
+
+    if (resampler->mode == SU_RESAMPLER_MODE_RATIONAL)
+      for (i = 0; i < chunk; ++i)
+        n += __su_resampler_run_rational(resampler, ptr++, y + n);
+    else
+      for (i = 0; i < chunk; ++i)
+        n += __su_resampler_run_arbitrary(resampler, ptr++, y + n);
+
+    resampler->x_ptr += chunk;
+
+    x   += chunk;
+    len -= chunk;
+  }
+
+  return n;
+}
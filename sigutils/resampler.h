@@ -0,0 +1,151 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#ifndef _SIGUTILS_RESAMPLER_H
+#define _SIGUTILS_RESAMPLER_H
+
+#include "types.h"
+#include "fir.h"
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic push
+#    pragma clang diagnostic ignored "-Wreturn-type-c-linkage"
+#  endif // __clang__
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Sample rate converter. Two modes are available:
+ *
+ * - Rational: output rate is L / M times the input rate. A low-pass
+ *   prototype of K * max(L, M) taps is split into L phases, and each
+ *   output is a single dot product against the delay line:
+ *
+ *     y[n] = sum_k h[p + k * L] * x[i - k],  with n * M = i * L + p
+ *
+ *   Zeros introduced by the interpolation are never multiplied, nor are
+ *   outputs dropped by the decimation ever computed.
+ *
+ * - Arbitrary: output rate is `ratio` times the input rate, and the ratio
+ *   may change at any time (e.g. to track a clock). Outputs are computed
+ *   with a cubic Lagrange interpolator in Farrow form. There is no
+ *   implicit anti-aliasing: when reducing the sample rate, a prefilter of
+ *   `aa_taps` taps can be requested at init time, designed for the
+ *   initial ratio.
+ *
+ * In both cases, input is kept in a linear buffer (see fir.h) so that the
+ * last samples are always contiguous.
+ */
+#define SU_RESAMPLER_HEADROOM               1024
+#define SU_RESAMPLER_DEFAULT_TAPS           16
+#define SU_RESAMPLER_FARROW_TAPS            4
+
+enum sigutils_resampler_mode {
+  SU_RESAMPLER_MODE_RATIONAL,
+  SU_RESAMPLER_MODE_ARBITRARY,
+};
+
+struct sigutils_resampler {
+  enum sigutils_resampler_mode mode;
+
+  /* Rational */
+  unsigned int interp;  /* L, after reduction */
+  unsigned int decim;   /* M, after reduction */
+  unsigned int taps;    /* Taps per phase */
+  SUFLOAT *h;           /* L phases of time-reversed taps, aligned */
+  unsigned int phase;   /* Phase of the next output, n * M - i * L */
+
+  /* Arbitrary */
+  SUFLOAT step;         /* Input samples per output (1 / ratio) */
+  SUFLOAT mu;           /* Fractional position of the next output */
+  su_fir_filt_t aa;     /* Anti-aliasing prefilter */
+  SUBOOL have_aa;
+
+  /* Delay line */
+  SUCOMPLEX *x;
+  unsigned int x_size;  /* Samples needed by every output */
+  unsigned int x_alloc; /* x_size - 1 + SU_RESAMPLER_HEADROOM */
+  unsigned int x_ptr;   /* Next write position */
+};
+
+typedef struct sigutils_resampler su_resampler_t;
+
+#define su_resampler_INITIALIZER                   \
+  {                                                \
+    SU_RESAMPLER_MODE_RATIONAL,                    \
+    1, 1, 0, NULL, 0,                              \
+    1, 0, su_fir_filt_INITIALIZER, SU_FALSE,       \
+    NULL, 0, 0, 0                                  \
+  }
+
+/* L / M resampler, with K = taps */
+SUBOOL su_resampler_init_rational(
+    su_resampler_t *resampler,
+    unsigned int interp,
+    unsigned int decim,
+    unsigned int taps);
+
+/* Arbitrary ratio resampler. aa_taps = 0 disables the prefilter */
+SUBOOL su_resampler_init_arbitrary(
+    su_resampler_t *resampler,
+    SUFLOAT ratio,
+    unsigned int aa_taps);
+
+/* Output rate divided by input rate */
+SUFLOAT su_resampler_get_ratio(const su_resampler_t *resampler);
+
+/* Only in arbitrary mode. Prefilter is not redesigned */
+SUBOOL su_resampler_set_ratio(su_resampler_t *resampler, SUFLOAT ratio);
+
+/* Upper bound of the outputs produced by the next len samples */
+SUSCOUNT su_resampler_get_max_output(
+    const su_resampler_t *resampler,
+    SUSCOUNT len);
+
+/* Largest input whose output is guaranteed to fit in room samples */
+SUSCOUNT su_resampler_get_max_input(
+    const su_resampler_t *resampler,
+    SUSCOUNT room);
+
+/*
+ * Push len samples, write outputs to y. Returns the number of outputs,
+ * never above su_resampler_get_max_output(). x and y must not overlap.
+ */
+SUSCOUNT su_resampler_feed_bulk(
+    su_resampler_t *resampler,
+    const SUCOMPLEX *x,
+    SUSCOUNT len,
+    SUCOMPLEX *y);
+
+/* Clear delay line */
+void su_resampler_reset(su_resampler_t *resampler);
+
+/* Destroy resampler */
+void su_resampler_finalize(su_resampler_t *resampler);
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic pop
+#  endif // __clang__
+}
+#endif /* __cplusplus */
+
+#endif /* _SIGUTILS_RESAMPLER_H */
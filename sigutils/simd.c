@@ -0,0 +1,1575 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#define SU_LOG_DOMAIN "simd"
+
+#include "log.h"
+#include "simd.h"
+#include "ncqo.h"
+
+#ifdef SU_SIMD_X86
+#  include <immintrin.h>
+#  define SU_SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif /* SU_SIMD_X86 */
+
+/*
+ * Levels are detected once. Races on first use are harmless since every
+ * thread computes the same value.
+ */
+SUPRIVATE int g_simd_max_level = -1;
+SUPRIVATE int g_simd_level = -1;
+
+enum sigutils_simd_level
+su_simd_get_max_level(void)
+{
+  if (g_simd_max_level == -1) {
+    g_simd_max_level = SU_SIMD_LEVEL_SCALAR;
+#ifdef SU_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      g_simd_max_level = SU_SIMD_LEVEL_AVX2;
+    else if (__builtin_cpu_supports("sse3"))
+      g_simd_max_level = SU_SIMD_LEVEL_SSE3;
+#endif /* SU_SIMD_X86 */
+  }
+
+  return g_simd_max_level;
+}
+
+enum sigutils_simd_level
+su_simd_get_level(void)
+{
+  if (g_simd_level == -1)
+    g_simd_level = su_simd_get_max_level();
+
+  return g_simd_level;
+}
+
+enum sigutils_simd_level
+su_simd_set_level(enum sigutils_simd_level level)
+{
+  if (level > su_simd_get_max_level())
+    level = su_simd_get_max_level();
+
+  g_simd_level = level;
+
+  return level;
+}
+
+const char *
+su_simd_level_to_string(enum sigutils_simd_level level)
+{
+  switch (level) {
+    case SU_SIMD_LEVEL_SCALAR:
+      return "scalar";
+
+    case SU_SIMD_LEVEL_SSE3:
+      return "SSE3";
+
+    case SU_SIMD_LEVEL_AVX2:
+      return "AVX2";
+  }
+
+  return "unknown";
+}
+
+/******************************* Scalar kernels *******************************/
+SUPRIVATE void
+su_simd_cmul_scalar(SUCOMPLEX *x, const SUCOMPLEX *h, SUSCOUNT size)
+{
+  SUSCOUNT i;
+
+  for (i = 0; i < size; ++i)
+    x[i] *= h[i];
+}
+
+SUPRIVATE void
+su_simd_glue_scalar(
+    SUCOMPLEX *curr,
+    const SUCOMPLEX *prev,
+    const SUFLOAT *alpha,
+    const SUFLOAT *beta,
+    SUFLOAT gain,
+    SUSCOUNT size)
+{
+  SUSCOUNT i;
+
+  for (i = 0; i < size; ++i)
+    curr[i] = gain * (alpha[i] * curr[i] + beta[i] * prev[i]);
+}
+
+SUPRIVATE SUCOMPLEX
+su_simd_rotate_scalar(
+    SUCOMPLEX *x,
+    SUSCOUNT size,
+    SUCOMPLEX phase,
+    SUCOMPLEX step)
+{
+  SUSCOUNT i;
+
+  for (i = 0; i < size; ++i) {
+    x[i] *= phase;
+    phase *= step;
+  }
+
+  return phase;
+}
+
+SUPRIVATE SUCOMPLEX
+su_simd_dot_real_scalar(const SUCOMPLEX *x, const SUFLOAT *h, SUSCOUNT size)
+{
+  SUSCOUNT i;
+  SUCOMPLEX y = 0;
+
+  for (i = 0; i < size; ++i)
+    y += h[i] * x[i];
+
+  return y;
+}
+
+/* Constant sign and stride let the compiler specialize (and vectorize) */
+SUINLINE SUCOMPLEX
+__su_simd_dot_real_fold_scalar(
+    const SUCOMPLEX *x,
+    const SUCOMPLEX *xr,
+    const SUFLOAT *h2,
+    SUSCOUNT size,
+    SUFLOAT sign,
+    unsigned int stride)
+{
+  SUSCOUNT i;
+  SUCOMPLEX y = 0;
+
+  for (i = 0; i < size; ++i)
+    y += h2[2 * i] * (x[i * stride] + sign * *(xr - i * stride));
+
+  return y;
+}
+
+SUPRIVATE SUCOMPLEX
+su_simd_dot_real_fold_scalar(
+    const SUCOMPLEX *x,
+    const SUCOMPLEX *xr,
+    const SUFLOAT *h2,
+    SUSCOUNT size,
+    SUFLOAT sign,
+    unsigned int stride)
+{
+  if (stride == 1)
+    return sign > 0
+        ? __su_simd_dot_real_fold_scalar(x, xr, h2, size, 1, 1)
+        : __su_simd_dot_real_fold_scalar(x, xr, h2, size, -1, 1);
+
+  return sign > 0
+      ? __su_simd_dot_real_fold_scalar(x, xr, h2, size, 1, stride)
+      : __su_simd_dot_real_fold_scalar(x, xr, h2, size, -1, stride);
+}
+
+SUPRIVATE void
+su_simd_window_scalar(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUCOMPLEX dc,
+    const SUCOMPLEX *w,
+    SUSCOUNT size)
+{
+  SUSCOUNT i;
+
+  for (i = 0; i < size; ++i)
+    y[i] = (x[i] - dc) * SU_C_REAL(w[i]);
+}
+
+SUPRIVATE SUCOMPLEX
+su_simd_nonlinear_diff_scalar(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUCOMPLEX prev,
+    SUFLOAT gain,
+    SUCOMPLEX dc,
+    SUSCOUNT size)
+{
+  SUCOMPLEX diff;
+  SUSCOUNT i;
+
+  for (i = 0; i < size; ++i) {
+    diff = gain * (x[i] - prev);
+    prev = x[i];
+    y[i] = SU_C_REAL(diff * SU_C_CONJ(diff)) - dc;
+  }
+
+  return prev;
+}
+
+/* Channels [0, count) of the interleaved frames */
+SUPRIVATE void
+su_simd_biquad_scalar(
+    SUCOMPLEX *x,
+    SUCOMPLEX *s1,
+    SUCOMPLEX *s2,
+    const SUFLOAT *coef,
+    SUSCOUNT lanes,
+    SUSCOUNT count,
+    SUSCOUNT len)
+{
+  SUSCOUNT c, t;
+  SUCOMPLEX in, y, z1, z2;
+
+  for (c = 0; c < count; ++c) {
+    z1 = s1[c];
+    z2 = s2[c];
+
+    for (t = 0; t < len; ++t) {
+      in = x[t * lanes + c];
+      y  = coef[0] * in + z1;
+      z1 = coef[1] * in - coef[3] * y + z2;
+      z2 = coef[2] * in - coef[4] * y;
+      x[t * lanes + c] = y;
+    }
+
+    s1[c] = z1;
+    s2[c] = z2;
+  }
+}
+
+/* Bins [first, size), accumulated into stats */
+SUINLINE void
+__su_simd_psd_track_scalar(
+    SUFLOAT *spect,
+    SUFLOAT *spmin,
+    SUFLOAT *spmax,
+    const SUCOMPLEX *fft,
+    SUFLOAT norm,
+    SUFLOAT alpha,
+    SUFLOAT beta,
+    SUFLOAT N0,
+    SUSCOUNT first,
+    SUSCOUNT size,
+    su_simd_psd_stats_t *stats)
+{
+  SUSCOUNT i;
+  SUFLOAT psd;
+
+  for (i = first; i < size; ++i) {
+    psd = spect[i];
+
+    if (fft != NULL) {
+      psd += alpha * (norm * SU_C_REAL(fft[i] * SU_C_CONJ(fft[i])) - psd);
+      spect[i] = psd;
+    }
+
+    if (psd < spmin[i])
+      spmin[i] = psd;
+    else
+      spmin[i] += beta * (psd - spmin[i]);
+
+    if (psd > spmax[i])
+      spmax[i] = psd;
+    else
+      spmax[i] += beta * (psd - spmax[i]);
+
+    if (spmin[i] < N0 && N0 < spmax[i]) {
+      stats->sum += psd;
+      ++stats->valid;
+    }
+
+    if (psd < stats->min) {
+      stats->min = psd;
+      stats->min_bin = i;
+    }
+  }
+}
+
+SUINLINE void
+su_simd_psd_stats_init(su_simd_psd_stats_t *stats)
+{
+  stats->sum     = 0;
+  stats->valid   = 0;
+  stats->min     = INFINITY;
+  stats->min_bin = -1;
+}
+
+SUPRIVATE void
+su_simd_psd_track_scalar(
+    SUFLOAT *spect,
+    SUFLOAT *spmin,
+    SUFLOAT *spmax,
+    const SUCOMPLEX *fft,
+    SUFLOAT norm,
+    SUFLOAT alpha,
+    SUFLOAT beta,
+    SUFLOAT N0,
+    SUSCOUNT size,
+    su_simd_psd_stats_t *stats)
+{
+  su_simd_psd_stats_init(stats);
+
+  __su_simd_psd_track_scalar(
+      spect, spmin, spmax, fft,
+      norm, alpha, beta, N0,
+      0, size,
+      stats);
+}
+
+SUPRIVATE uint32_t
+su_simd_ncqo_scalar(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUSCOUNT size,
+    uint32_t phase,
+    uint32_t inc,
+    const SUFLOAT *lut)
+{
+  SUSCOUNT i;
+  SUCOMPLEX lo;
+
+  for (i = 0; i < size; ++i) {
+    lo = su_ncqo_lut_sin(lut, phase + SU_NCQO_QUARTER)
+        + I * su_ncqo_lut_sin(lut, phase);
+    y[i] = x != NULL ? x[i] * lo : lo;
+    phase += inc;
+  }
+
+  return phase;
+}
+
+#ifdef SU_SIMD_X86
+/******************************** SSE3 kernels ********************************/
+/*
+ * Fold per-lane partial results of a vector pass into stats. Lanes keep
+ * the first occurrence of their minimum: ties go to the lowest index.
+ */
+SUINLINE void
+su_simd_psd_stats_reduce(
+    su_simd_psd_stats_t *stats,
+    const float *sum,
+    const uint32_t *valid,
+    const float *min,
+    const uint32_t *min_bin,
+    unsigned int lanes)
+{
+  unsigned int j;
+
+  for (j = 0; j < lanes; ++j) {
+    stats->sum   += sum[j];
+    stats->valid += valid[j];
+
+    if (min[j] < stats->min
+        || (min[j] == stats->min
+            && stats->min_bin != (SUSCOUNT) -1
+            && min_bin[j] < stats->min_bin)) {
+      stats->min = min[j];
+      stats->min_bin = min_bin[j];
+    }
+  }
+}
+
+SUPRIVATE SU_SIMD_TARGET("sse3") __m128
+su_simd_cmul_ps_sse3(__m128 a, __m128 b)
+{
+  __m128 br = _mm_moveldup_ps(b);
+  __m128 bi = _mm_movehdup_ps(b);
+  __m128 sw = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+
+  return _mm_addsub_ps(_mm_mul_ps(a, br), _mm_mul_ps(sw, bi));
+}
+
+SUPRIVATE SU_SIMD_TARGET("sse3") void
+su_simd_cmul_sse3(SUCOMPLEX *x, const SUCOMPLEX *h, SUSCOUNT size)
+{
+  SUSCOUNT i;
+  float *fx = (float *) x;
+  const float *fh = (const float *) h;
+
+  for (i = 0; i + 2 <= size; i += 2)
+    _mm_storeu_ps(
+        fx + 2 * i,
+        su_simd_cmul_ps_sse3(
+            _mm_loadu_ps(fx + 2 * i),
+            _mm_loadu_ps(fh + 2 * i)));
+
+  su_simd_cmul_scalar(x + i, h + i, size - i);
+}
+
+SUPRIVATE SU_SIMD_TARGET("sse3") void
+su_simd_glue_sse3(
+    SUCOMPLEX *curr,
+    const SUCOMPLEX *prev,
+    const SUFLOAT *alpha,
+    const SUFLOAT *beta,
+    SUFLOAT gain,
+    SUSCOUNT size)
+{
+  SUSCOUNT i;
+  float *fc = (float *) curr;
+  const float *fp = (const float *) prev;
+  __m128 g = _mm_set1_ps(gain);
+  __m128 a, b;
+
+  for (i = 0; i + 2 <= size; i += 2) {
+    /* Duplicate real coefficients: [a0 a0 a1 a1] */
+    a = _mm_castpd_ps(_mm_load_sd((const double *) (alpha + i)));
+    b = _mm_castpd_ps(_mm_load_sd((const double *) (beta + i)));
+    a = _mm_unpacklo_ps(a, a);
+    b = _mm_unpacklo_ps(b, b);
+
+    _mm_storeu_ps(
+        fc + 2 * i,
+        _mm_mul_ps(
+            g,
+            _mm_add_ps(
+                _mm_mul_ps(a, _mm_loadu_ps(fc + 2 * i)),
+                _mm_mul_ps(b, _mm_loadu_ps(fp + 2 * i)))));
+  }
+
+  su_simd_glue_scalar(
+      curr + i,
+      prev + i,
+      alpha + i,
+      beta + i,
+      gain,
+      size - i);
+}
+
+SUPRIVATE SU_SIMD_TARGET("sse3") SUCOMPLEX
+su_simd_rotate_sse3(
+    SUCOMPLEX *x,
+    SUSCOUNT size,
+    SUCOMPLEX phase,
+    SUCOMPLEX step)
+{
+  SUSCOUNT i;
+  float *fx = (float *) x;
+  SUCOMPLEX lanes[2];
+  SUCOMPLEX step2[2];
+  __m128 p, s;
+
+  lanes[0] = phase;
+  lanes[1] = phase * step;
+  step2[0] = step2[1] = step * step;
+
+  p = _mm_loadu_ps((const float *) lanes);
+  s = _mm_loadu_ps((const float *) step2);
+
+  for (i = 0; i + 2 <= size; i += 2) {
+    _mm_storeu_ps(
+        fx + 2 * i,
+        su_simd_cmul_ps_sse3(_mm_loadu_ps(fx + 2 * i), p));
+    p = su_simd_cmul_ps_sse3(p, s);
+  }
+
+  _mm_storeu_ps((float *) lanes, p);
+
+  return su_simd_rotate_scalar(x + i, size - i, lanes[0], step);
+}
+
+SUPRIVATE SU_SIMD_TARGET("sse3") SUCOMPLEX
+su_simd_dot_real_sse3(const SUCOMPLEX *x, const SUFLOAT *h, SUSCOUNT size)
+{
+  SUSCOUNT i;
+  const float *fx = (const float *) x;
+  SUCOMPLEX lanes[2];
+  __m128 acc = _mm_setzero_ps();
+  __m128 t;
+
+  for (i = 0; i + 2 <= size; i += 2) {
+    t = _mm_castpd_ps(_mm_load_sd((const double *) (h + i)));
+    acc = _mm_add_ps(
+        acc,
+        _mm_mul_ps(_mm_unpacklo_ps(t, t), _mm_loadu_ps(fx + 2 * i)));
+  }
+
+  _mm_storeu_ps((float *) lanes, acc);
+
+  return lanes[0] + lanes[1]
+      + su_simd_dot_real_scalar(x + i, h + i, size - i);
+}
+
+/* Reversed pairs: (xr[0], xr[-1]), or (xr[0], xr[-2]) if stride is 2 */
+SUPRIVATE SU_SIMD_TARGET("sse3") SUCOMPLEX
+su_simd_dot_real_fold_sse3(
+    const SUCOMPLEX *x,
+    const SUCOMPLEX *xr,
+    const SUFLOAT *h2,
+    SUSCOUNT size,
+    SUFLOAT sign,
+    unsigned int stride)
+{
+  SUSCOUNT i = 0;
+  SUCOMPLEX y;
+  SUCOMPLEX lanes[2];
+  __m128 mask = _mm_set1_ps(sign < 0 ? -0.f : 0.f);
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  __m128 a, b;
+
+  if (stride == 1) {
+    for (i = 0; i + 4 <= size; i += 4) {
+      a = _mm_loadu_ps((const float *) (x + i));
+      b = _mm_loadu_ps((const float *) (xr - i - 1));
+      b = _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2));
+      acc0 = _mm_add_ps(
+          acc0,
+          _mm_mul_ps(
+              _mm_loadu_ps(h2 + 2 * i),
+              _mm_add_ps(a, _mm_xor_ps(b, mask))));
+
+      a = _mm_loadu_ps((const float *) (x + i + 2));
+      b = _mm_loadu_ps((const float *) (xr - i - 3));
+      b = _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2));
+      acc1 = _mm_add_ps(
+          acc1,
+          _mm_mul_ps(
+              _mm_loadu_ps(h2 + 2 * i + 4),
+              _mm_add_ps(a, _mm_xor_ps(b, mask))));
+    }
+
+    if (i + 2 <= size) {
+      a = _mm_loadu_ps((const float *) (x + i));
+      b = _mm_loadu_ps((const float *) (xr - i - 1));
+      b = _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2));
+      acc0 = _mm_add_ps(
+          acc0,
+          _mm_mul_ps(
+              _mm_loadu_ps(h2 + 2 * i),
+              _mm_add_ps(a, _mm_xor_ps(b, mask))));
+      i += 2;
+    }
+  } else if (stride == 2) {
+    /* Gathers read one sample past term i + 1: keep them inside */
+    for (i = 0; i + 2 < size; i += 2) {
+      a = _mm_shuffle_ps(
+          _mm_loadu_ps((const float *) (x + 2 * i)),
+          _mm_loadu_ps((const float *) (x + 2 * i + 2)),
+          _MM_SHUFFLE(1, 0, 1, 0));
+      b = _mm_shuffle_ps(
+          _mm_loadu_ps((const float *) (xr - 2 * i - 1)),
+          _mm_loadu_ps((const float *) (xr - 2 * i - 3)),
+          _MM_SHUFFLE(3, 2, 3, 2));
+      acc0 = _mm_add_ps(
+          acc0,
+          _mm_mul_ps(
+              _mm_loadu_ps(h2 + 2 * i),
+              _mm_add_ps(a, _mm_xor_ps(b, mask))));
+    }
+  }
+
+  _mm_storeu_ps((float *) lanes, _mm_add_ps(acc0, acc1));
+
+  y = lanes[0] + lanes[1];
+
+  /* Short tail: a call to the scalar kernel would cost more */
+  for (; i < size; ++i)
+    y += h2[2 * i] * (x[i * stride] + sign * *(xr - i * stride));
+
+  return y;
+}
+
+SUPRIVATE SU_SIMD_TARGET("sse3") void
+su_simd_window_sse3(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUCOMPLEX dc,
+    const SUCOMPLEX *w,
+    SUSCOUNT size)
+{
+  SUSCOUNT i;
+  float *fy = (float *) y;
+  const float *fx = (const float *) x;
+  const float *fw = (const float *) w;
+  __m128 d = _mm_setr_ps(
+      SU_C_REAL(dc), SU_C_IMAG(dc), SU_C_REAL(dc), SU_C_IMAG(dc));
+
+  for (i = 0; i + 2 <= size; i += 2)
+    _mm_storeu_ps(
+        fy + 2 * i,
+        _mm_mul_ps(
+            _mm_sub_ps(_mm_loadu_ps(fx + 2 * i), d),
+            _mm_moveldup_ps(_mm_loadu_ps(fw + 2 * i))));
+
+  su_simd_window_scalar(y + i, x + i, dc, w + i, size - i);
+}
+
+SUPRIVATE SU_SIMD_TARGET("sse3") SUCOMPLEX
+su_simd_nonlinear_diff_sse3(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUCOMPLEX prev,
+    SUFLOAT gain,
+    SUCOMPLEX dc,
+    SUSCOUNT size)
+{
+  SUSCOUNT i;
+  float *fy = (float *) y;
+  const float *fx = (const float *) x;
+  __m128 g = _mm_set1_ps(gain);
+  __m128 d = _mm_setr_ps(
+      SU_C_REAL(dc), SU_C_IMAG(dc), SU_C_REAL(dc), SU_C_IMAG(dc));
+  __m128 zero = _mm_setzero_ps();
+  __m128 diff, mag;
+
+  if (size == 0)
+    return prev;
+
+  /* First sample depends on prev */
+  prev = su_simd_nonlinear_diff_scalar(y, x, prev, gain, dc, 1);
+
+  for (i = 1; i + 2 <= size; i += 2) {
+    diff = _mm_mul_ps(
+        g,
+        _mm_sub_ps(_mm_loadu_ps(fx + 2 * i), _mm_loadu_ps(fx + 2 * i - 2)));
+    diff = _mm_mul_ps(diff, diff);
+
+    /* [|d0|^2 |d1|^2 |d0|^2 |d1|^2] -> [|d0|^2 0 |d1|^2 0] */
+    mag = _mm_unpacklo_ps(_mm_hadd_ps(diff, diff), zero);
+
+    _mm_storeu_ps(fy + 2 * i, _mm_sub_ps(mag, d));
+  }
+
+  return su_simd_nonlinear_diff_scalar(
+      y + i,
+      x + i,
+      x[i - 1],
+      gain,
+      dc,
+      size - i);
+}
+
+SUPRIVATE SU_SIMD_TARGET("sse3") SUSCOUNT
+su_simd_biquad_sse3(
+    SUCOMPLEX *x,
+    SUCOMPLEX *s1,
+    SUCOMPLEX *s2,
+    const SUFLOAT *coef,
+    SUSCOUNT lanes,
+    SUSCOUNT len)
+{
+  SUSCOUNT c, t;
+  float *fx;
+  __m128 b0 = _mm_set1_ps(coef[0]);
+  __m128 b1 = _mm_set1_ps(coef[1]);
+  __m128 b2 = _mm_set1_ps(coef[2]);
+  __m128 a1 = _mm_set1_ps(coef[3]);
+  __m128 a2 = _mm_set1_ps(coef[4]);
+  __m128 in, y, z1, z2;
+
+  for (c = 0; c + 2 <= lanes; c += 2) {
+    z1 = _mm_loadu_ps((const float *) (s1 + c));
+    z2 = _mm_loadu_ps((const float *) (s2 + c));
+
+    for (t = 0; t < len; ++t) {
+      fx = (float *) (x + t * lanes + c);
+      in = _mm_loadu_ps(fx);
+      y  = _mm_add_ps(_mm_mul_ps(b0, in), z1);
+      z1 = _mm_add_ps(
+          _mm_sub_ps(_mm_mul_ps(b1, in), _mm_mul_ps(a1, y)),
+          z2);
+      z2 = _mm_sub_ps(_mm_mul_ps(b2, in), _mm_mul_ps(a2, y));
+      _mm_storeu_ps(fx, y);
+    }
+
+    _mm_storeu_ps((float *) (s1 + c), z1);
+    _mm_storeu_ps((float *) (s2 + c), z2);
+  }
+
+  return c;
+}
+
+SUPRIVATE SU_SIMD_TARGET("sse3") void
+su_simd_psd_track_sse3(
+    SUFLOAT *spect,
+    SUFLOAT *spmin,
+    SUFLOAT *spmax,
+    const SUCOMPLEX *fft,
+    SUFLOAT norm,
+    SUFLOAT alpha,
+    SUFLOAT beta,
+    SUFLOAT N0,
+    SUSCOUNT size,
+    su_simd_psd_stats_t *stats)
+{
+  SUSCOUNT i;
+  const float *ff = (const float *) fft;
+  __m128 vnorm  = _mm_set1_ps(norm);
+  __m128 valpha = _mm_set1_ps(alpha);
+  __m128 vbeta  = _mm_set1_ps(beta);
+  __m128 vN0    = _mm_set1_ps(N0);
+  __m128 sum    = _mm_setzero_ps();
+  __m128 min    = _mm_set1_ps(INFINITY);
+  __m128i valid = _mm_setzero_si128();
+  __m128i bin   = _mm_setr_epi32(0, 1, 2, 3);
+  __m128i minb  = _mm_set1_epi32(-1);
+  __m128 psd, a, b, mn, mx, lt, gt, in;
+  float lane_sum[4], lane_min[4];
+  uint32_t lane_valid[4], lane_bin[4];
+
+  su_simd_psd_stats_init(stats);
+
+  for (i = 0; i + 4 <= size; i += 4) {
+    psd = _mm_loadu_ps(spect + i);
+
+    if (fft != NULL) {
+      a = _mm_loadu_ps(ff + 2 * i);
+      b = _mm_loadu_ps(ff + 2 * i + 4);
+      a = _mm_mul_ps(vnorm, _mm_hadd_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)));
+      psd = _mm_add_ps(psd, _mm_mul_ps(valpha, _mm_sub_ps(a, psd)));
+      _mm_storeu_ps(spect + i, psd);
+    }
+
+    /* No blendv in SSE3: select with masks */
+    mn = _mm_loadu_ps(spmin + i);
+    lt = _mm_cmplt_ps(psd, mn);
+    mn = _mm_add_ps(mn, _mm_mul_ps(vbeta, _mm_sub_ps(psd, mn)));
+    mn = _mm_or_ps(_mm_and_ps(lt, psd), _mm_andnot_ps(lt, mn));
+    _mm_storeu_ps(spmin + i, mn);
+
+    mx = _mm_loadu_ps(spmax + i);
+    gt = _mm_cmpgt_ps(psd, mx);
+    mx = _mm_add_ps(mx, _mm_mul_ps(vbeta, _mm_sub_ps(psd, mx)));
+    mx = _mm_or_ps(_mm_and_ps(gt, psd), _mm_andnot_ps(gt, mx));
+    _mm_storeu_ps(spmax + i, mx);
+
+    /* Masks are -1 when true */
+    in = _mm_and_ps(_mm_cmplt_ps(mn, vN0), _mm_cmplt_ps(vN0, mx));
+    sum = _mm_add_ps(sum, _mm_and_ps(in, psd));
+    valid = _mm_sub_epi32(valid, _mm_castps_si128(in));
+
+    lt = _mm_cmplt_ps(psd, min);
+    min = _mm_or_ps(_mm_and_ps(lt, psd), _mm_andnot_ps(lt, min));
+    minb = _mm_or_si128(
+        _mm_and_si128(_mm_castps_si128(lt), bin),
+        _mm_andnot_si128(_mm_castps_si128(lt), minb));
+
+    bin = _mm_add_epi32(bin, _mm_set1_epi32(4));
+  }
+
+  _mm_storeu_ps(lane_sum, sum);
+  _mm_storeu_ps(lane_min, min);
+  _mm_storeu_si128((__m128i *) lane_valid, valid);
+  _mm_storeu_si128((__m128i *) lane_bin, minb);
+
+  su_simd_psd_stats_reduce(stats, lane_sum, lane_valid, lane_min, lane_bin, 4);
+
+  __su_simd_psd_track_scalar(
+      spect, spmin, spmax, fft,
+      norm, alpha, beta, N0,
+      i, size,
+      stats);
+}
+
+/******************************** AVX2 kernels ********************************/
+SUPRIVATE SU_SIMD_TARGET("avx2") __m256
+su_simd_cmul_ps_avx2(__m256 a, __m256 b)
+{
+  __m256 br = _mm256_moveldup_ps(b);
+  __m256 bi = _mm256_movehdup_ps(b);
+  __m256 sw = _mm256_permute_ps(a, _MM_SHUFFLE(2, 3, 0, 1));
+
+  return _mm256_addsub_ps(_mm256_mul_ps(a, br), _mm256_mul_ps(sw, bi));
+}
+
+/* [r0 r1 r2 r3] -> [r0 r0 r1 r1 r2 r2 r3 r3] */
+SUPRIVATE SU_SIMD_TARGET("avx2") __m256
+su_simd_dup_ps_avx2(const float *r)
+{
+  __m128 v = _mm_loadu_ps(r);
+
+  return _mm256_insertf128_ps(
+      _mm256_castps128_ps256(_mm_unpacklo_ps(v, v)),
+      _mm_unpackhi_ps(v, v),
+      1);
+}
+
+SUPRIVATE SU_SIMD_TARGET("avx2") void
+su_simd_cmul_avx2(SUCOMPLEX *x, const SUCOMPLEX *h, SUSCOUNT size)
+{
+  SUSCOUNT i;
+  float *fx = (float *) x;
+  const float *fh = (const float *) h;
+
+  for (i = 0; i + 4 <= size; i += 4)
+    _mm256_storeu_ps(
+        fx + 2 * i,
+        su_simd_cmul_ps_avx2(
+            _mm256_loadu_ps(fx + 2 * i),
+            _mm256_loadu_ps(fh + 2 * i)));
+
+  su_simd_cmul_scalar(x + i, h + i, size - i);
+}
+
+SUPRIVATE SU_SIMD_TARGET("avx2") void
+su_simd_glue_avx2(
+    SUCOMPLEX *curr,
+    const SUCOMPLEX *prev,
+    const SUFLOAT *alpha,
+    const SUFLOAT *beta,
+    SUFLOAT gain,
+    SUSCOUNT size)
+{
+  SUSCOUNT i;
+  float *fc = (float *) curr;
+  const float *fp = (const float *) prev;
+  __m256 g = _mm256_set1_ps(gain);
+
+  for (i = 0; i + 4 <= size; i += 4)
+    _mm256_storeu_ps(
+        fc + 2 * i,
+        _mm256_mul_ps(
+            g,
+            _mm256_add_ps(
+                _mm256_mul_ps(
+                    su_simd_dup_ps_avx2(alpha + i),
+                    _mm256_loadu_ps(fc + 2 * i)),
+                _mm256_mul_ps(
+                    su_simd_dup_ps_avx2(beta + i),
+                    _mm256_loadu_ps(fp + 2 * i)))));
+
+  su_simd_glue_scalar(
+      curr + i,
+      prev + i,
+      alpha + i,
+      beta + i,
+      gain,
+      size - i);
+}
+
+SUPRIVATE SU_SIMD_TARGET("avx2") SUCOMPLEX
+su_simd_rotate_avx2(
+    SUCOMPLEX *x,
+    SUSCOUNT size,
+    SUCOMPLEX phase,
+    SUCOMPLEX step)
+{
+  SUSCOUNT i;
+  float *fx = (float *) x;
+  SUCOMPLEX lanes[4];
+  SUCOMPLEX step4[4];
+  SUCOMPLEX step2 = step * step;
+  __m256 p, s;
+
+  lanes[0] = phase;
+  for (i = 1; i < 4; ++i)
+    lanes[i] = lanes[i - 1] * step;
+
+  step4[0] = step4[1] = step4[2] = step4[3] = step2 * step2;
+
+  p = _mm256_loadu_ps((const float *) lanes);
+  s = _mm256_loadu_ps((const float *) step4);
+
+  for (i = 0; i + 4 <= size; i += 4) {
+    _mm256_storeu_ps(
+        fx + 2 * i,
+        su_simd_cmul_ps_avx2(_mm256_loadu_ps(fx + 2 * i), p));
+    p = su_simd_cmul_ps_avx2(p, s);
+  }
+
+  _mm256_storeu_ps((float *) lanes, p);
+
+  /* The tail runs legacy SSE code: avoid AVX-SSE transition penalties */
+  _mm256_zeroupper();
+
+  return su_simd_rotate_scalar(x + i, size - i, lanes[0], step);
+}
+
+SUPRIVATE SU_SIMD_TARGET("avx2") SUCOMPLEX
+su_simd_dot_real_avx2(const SUCOMPLEX *x, const SUFLOAT *h, SUSCOUNT size)
+{
+  SUSCOUNT i;
+  const float *fx = (const float *) x;
+  SUCOMPLEX lanes[4];
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+
+  /* Two accumulators hide the latency of the adds */
+  for (i = 0; i + 8 <= size; i += 8) {
+    acc0 = _mm256_add_ps(
+        acc0,
+        _mm256_mul_ps(
+            su_simd_dup_ps_avx2(h + i),
+            _mm256_loadu_ps(fx + 2 * i)));
+    acc1 = _mm256_add_ps(
+        acc1,
+        _mm256_mul_ps(
+            su_simd_dup_ps_avx2(h + i + 4),
+            _mm256_loadu_ps(fx + 2 * i + 8)));
+  }
+
+  if (i + 4 <= size) {
+    acc0 = _mm256_add_ps(
+        acc0,
+        _mm256_mul_ps(
+            su_simd_dup_ps_avx2(h + i),
+            _mm256_loadu_ps(fx + 2 * i)));
+    i += 4;
+  }
+
+  _mm256_storeu_ps((float *) lanes, _mm256_add_ps(acc0, acc1));
+
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3]
+      + su_simd_dot_real_scalar(x + i, h + i, size - i);
+}
+
+SUPRIVATE SU_SIMD_TARGET("avx2") SUCOMPLEX
+su_simd_dot_real_fold_avx2(
+    const SUCOMPLEX *x,
+    const SUCOMPLEX *xr,
+    const SUFLOAT *h2,
+    SUSCOUNT size,
+    SUFLOAT sign,
+    unsigned int stride)
+{
+  SUSCOUNT i = 0;
+  SUCOMPLEX y;
+  SUCOMPLEX lanes[4];
+  __m256 mask = _mm256_set1_ps(sign < 0 ? -0.f : 0.f);
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  __m256d a, b;
+
+  /* Complex samples are moved around as doubles */
+  if (stride == 1) {
+    for (i = 0; i + 8 <= size; i += 8) {
+      a = _mm256_loadu_pd((const double *) (x + i));
+      b = _mm256_permute4x64_pd(
+          _mm256_loadu_pd((const double *) (xr - i - 3)),
+          _MM_SHUFFLE(0, 1, 2, 3));
+      acc0 = _mm256_add_ps(
+          acc0,
+          _mm256_mul_ps(
+              _mm256_loadu_ps(h2 + 2 * i),
+              _mm256_add_ps(
+                  _mm256_castpd_ps(a),
+                  _mm256_xor_ps(_mm256_castpd_ps(b), mask))));
+
+      a = _mm256_loadu_pd((const double *) (x + i + 4));
+      b = _mm256_permute4x64_pd(
+          _mm256_loadu_pd((const double *) (xr - i - 7)),
+          _MM_SHUFFLE(0, 1, 2, 3));
+      acc1 = _mm256_add_ps(
+          acc1,
+          _mm256_mul_ps(
+              _mm256_loadu_ps(h2 + 2 * i + 8),
+              _mm256_add_ps(
+                  _mm256_castpd_ps(a),
+                  _mm256_xor_ps(_mm256_castpd_ps(b), mask))));
+    }
+
+    if (i + 4 <= size) {
+      a = _mm256_loadu_pd((const double *) (x + i));
+      b = _mm256_permute4x64_pd(
+          _mm256_loadu_pd((const double *) (xr - i - 3)),
+          _MM_SHUFFLE(0, 1, 2, 3));
+      acc0 = _mm256_add_ps(
+          acc0,
+          _mm256_mul_ps(
+              _mm256_loadu_ps(h2 + 2 * i),
+              _mm256_add_ps(
+                  _mm256_castpd_ps(a),
+                  _mm256_xor_ps(_mm256_castpd_ps(b), mask))));
+      i += 4;
+    }
+  } else if (stride == 2) {
+    /* Gathers read one sample past term i + 3: keep them inside */
+    for (i = 0; i + 4 < size; i += 4) {
+      a = _mm256_permute4x64_pd(
+          _mm256_unpacklo_pd(
+              _mm256_loadu_pd((const double *) (x + 2 * i)),
+              _mm256_loadu_pd((const double *) (x + 2 * i + 4))),
+          _MM_SHUFFLE(3, 1, 2, 0));
+      b = _mm256_permute4x64_pd(
+          _mm256_unpackhi_pd(
+              _mm256_loadu_pd((const double *) (xr - 2 * i - 3)),
+              _mm256_loadu_pd((const double *) (xr - 2 * i - 7))),
+          _MM_SHUFFLE(1, 3, 0, 2));
+      acc0 = _mm256_add_ps(
+          acc0,
+          _mm256_mul_ps(
+              _mm256_loadu_ps(h2 + 2 * i),
+              _mm256_add_ps(
+                  _mm256_castpd_ps(a),
+                  _mm256_xor_ps(_mm256_castpd_ps(b), mask))));
+    }
+  }
+
+  _mm256_storeu_ps((float *) lanes, _mm256_add_ps(acc0, acc1));
+
+  y = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+  /* Short tail: a call to the scalar kernel would cost more */
+  for (; i < size; ++i)
+    y += h2[2 * i] * (x[i * stride] + sign * *(xr - i * stride));
+
+  return y;
+}
+
+SUPRIVATE SU_SIMD_TARGET("avx2") void
+su_simd_window_avx2(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUCOMPLEX dc,
+    const SUCOMPLEX *w,
+    SUSCOUNT size)
+{
+  SUSCOUNT i;
+  float *fy = (float *) y;
+  const float *fx = (const float *) x;
+  const float *fw = (const float *) w;
+  __m256 d = _mm256_setr_ps(
+      SU_C_REAL(dc), SU_C_IMAG(dc), SU_C_REAL(dc), SU_C_IMAG(dc),
+      SU_C_REAL(dc), SU_C_IMAG(dc), SU_C_REAL(dc), SU_C_IMAG(dc));
+
+  for (i = 0; i + 4 <= size; i += 4)
+    _mm256_storeu_ps(
+        fy + 2 * i,
+        _mm256_mul_ps(
+            _mm256_sub_ps(_mm256_loadu_ps(fx + 2 * i), d),
+            _mm256_moveldup_ps(_mm256_loadu_ps(fw + 2 * i))));
+
+  /* The tail runs legacy SSE code: avoid AVX-SSE transition penalties */
+  _mm256_zeroupper();
+
+  su_simd_window_scalar(y + i, x + i, dc, w + i, size - i);
+}
+
+SUPRIVATE SU_SIMD_TARGET("avx2") SUCOMPLEX
+su_simd_nonlinear_diff_avx2(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUCOMPLEX prev,
+    SUFLOAT gain,
+    SUCOMPLEX dc,
+    SUSCOUNT size)
+{
+  SUSCOUNT i;
+  float *fy = (float *) y;
+  const float *fx = (const float *) x;
+  __m256 g = _mm256_set1_ps(gain);
+  __m256 d = _mm256_setr_ps(
+      SU_C_REAL(dc), SU_C_IMAG(dc), SU_C_REAL(dc), SU_C_IMAG(dc),
+      SU_C_REAL(dc), SU_C_IMAG(dc), SU_C_REAL(dc), SU_C_IMAG(dc));
+  __m256 zero = _mm256_setzero_ps();
+  __m256 diff, mag;
+
+  if (size == 0)
+    return prev;
+
+  /* First sample depends on prev */
+  prev = su_simd_nonlinear_diff_scalar(y, x, prev, gain, dc, 1);
+
+  for (i = 1; i + 4 <= size; i += 4) {
+    diff = _mm256_mul_ps(
+        g,
+        _mm256_sub_ps(
+            _mm256_loadu_ps(fx + 2 * i),
+            _mm256_loadu_ps(fx + 2 * i - 2)));
+    diff = _mm256_mul_ps(diff, diff);
+
+    /* re^2 + im^2 in the real parts, zero in the imaginary parts */
+    mag = _mm256_add_ps(
+        diff,
+        _mm256_permute_ps(diff, _MM_SHUFFLE(2, 3, 0, 1)));
+    mag = _mm256_blend_ps(mag, zero, 0xaa);
+
+    _mm256_storeu_ps(fy + 2 * i, _mm256_sub_ps(mag, d));
+  }
+
+  /* The tail runs legacy SSE code: avoid AVX-SSE transition penalties */
+  _mm256_zeroupper();
+
+  return su_simd_nonlinear_diff_scalar(
+      y + i,
+      x + i,
+      x[i - 1],
+      gain,
+      dc,
+      size - i);
+}
+
+SUPRIVATE SU_SIMD_TARGET("avx2") SUSCOUNT
+su_simd_biquad_avx2(
+    SUCOMPLEX *x,
+    SUCOMPLEX *s1,
+    SUCOMPLEX *s2,
+    const SUFLOAT *coef,
+    SUSCOUNT lanes,
+    SUSCOUNT len)
+{
+  SUSCOUNT c, t;
+  float *fx;
+  __m256 b0 = _mm256_set1_ps(coef[0]);
+  __m256 b1 = _mm256_set1_ps(coef[1]);
+  __m256 b2 = _mm256_set1_ps(coef[2]);
+  __m256 a1 = _mm256_set1_ps(coef[3]);
+  __m256 a2 = _mm256_set1_ps(coef[4]);
+  __m256 in, y, z1, z2;
+
+  for (c = 0; c + 4 <= lanes; c += 4) {
+    z1 = _mm256_loadu_ps((const float *) (s1 + c));
+    z2 = _mm256_loadu_ps((const float *) (s2 + c));
+
+    for (t = 0; t < len; ++t) {
+      fx = (float *) (x + t * lanes + c);
+      in = _mm256_loadu_ps(fx);
+      y  = _mm256_add_ps(_mm256_mul_ps(b0, in), z1);
+      z1 = _mm256_add_ps(
+          _mm256_sub_ps(_mm256_mul_ps(b1, in), _mm256_mul_ps(a1, y)),
+          z2);
+      z2 = _mm256_sub_ps(_mm256_mul_ps(b2, in), _mm256_mul_ps(a2, y));
+      _mm256_storeu_ps(fx, y);
+    }
+
+    _mm256_storeu_ps((float *) (s1 + c), z1);
+    _mm256_storeu_ps((float *) (s2 + c), z2);
+  }
+
+  return c;
+}
+
+SUPRIVATE SU_SIMD_TARGET("avx2") __m256
+su_simd_lut_sin_avx2(const SUFLOAT *lut, __m256i phase)
+{
+  __m256i quarter = _mm256_set1_epi32(SU_NCQO_QUARTER);
+  __m256i p = _mm256_and_si256(
+      phase,
+      _mm256_set1_epi32(SU_NCQO_QUARTER - 1));
+  __m256i odd = _mm256_cmpeq_epi32(_mm256_and_si256(phase, quarter), quarter);
+  __m256i idx;
+  __m256 frac, a, b;
+
+  p    = _mm256_blendv_epi8(p, _mm256_sub_epi32(quarter, p), odd);
+  idx  = _mm256_srli_epi32(p, SU_NCQO_LUT_FRAC_BITS);
+  frac = _mm256_mul_ps(
+      _mm256_cvtepi32_ps(
+          _mm256_and_si256(p, _mm256_set1_epi32(SU_NCQO_LUT_FRAC_MASK))),
+      _mm256_set1_ps(1.f / (1 << SU_NCQO_LUT_FRAC_BITS)));
+
+  a = _mm256_i32gather_ps(lut, idx, 4);
+  b = _mm256_i32gather_ps(lut + 1, idx, 4);
+  a = _mm256_add_ps(a, _mm256_mul_ps(frac, _mm256_sub_ps(b, a)));
+
+  /* The MSB of the phase is the sign of the sine */
+  return _mm256_xor_ps(
+      a,
+      _mm256_castsi256_ps(
+          _mm256_and_si256(phase, _mm256_set1_epi32(0x80000000u))));
+}
+
+SUPRIVATE SU_SIMD_TARGET("avx2") uint32_t
+su_simd_ncqo_avx2(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUSCOUNT size,
+    uint32_t phase,
+    uint32_t inc,
+    const SUFLOAT *lut)
+{
+  SUSCOUNT i;
+  float *fy = (float *) y;
+  const float *fx = (const float *) x;
+  __m256i quarter = _mm256_set1_epi32(SU_NCQO_QUARTER);
+  __m256i step = _mm256_set1_epi32(8 * inc);
+  __m256i ph;
+  __m256 s, c, lo, hi;
+
+  ph = _mm256_add_epi32(
+      _mm256_set1_epi32(phase),
+      _mm256_mullo_epi32(
+          _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+          _mm256_set1_epi32(inc)));
+
+  for (i = 0; i + 8 <= size; i += 8) {
+    s = su_simd_lut_sin_avx2(lut, ph);
+    c = su_simd_lut_sin_avx2(lut, _mm256_add_epi32(ph, quarter));
+
+    /* Interleave as (cos, sin) pairs, in order */
+    lo = _mm256_unpacklo_ps(c, s);
+    hi = _mm256_unpackhi_ps(c, s);
+    c  = _mm256_permute2f128_ps(lo, hi, 0x20);
+    s  = _mm256_permute2f128_ps(lo, hi, 0x31);
+
+    if (fx != NULL) {
+      c = su_simd_cmul_ps_avx2(_mm256_loadu_ps(fx + 2 * i), c);
+      s = su_simd_cmul_ps_avx2(_mm256_loadu_ps(fx + 2 * i + 8), s);
+    }
+
+    _mm256_storeu_ps(fy + 2 * i, c);
+    _mm256_storeu_ps(fy + 2 * i + 8, s);
+
+    ph = _mm256_add_epi32(ph, step);
+  }
+
+  /* The tail runs legacy SSE code: avoid AVX-SSE transition penalties */
+  _mm256_zeroupper();
+
+  return su_simd_ncqo_scalar(
+      y + i,
+      x != NULL ? x + i : NULL,
+      size - i,
+      phase + (uint32_t) i * inc,
+      inc,
+      lut);
+}
+
+SUPRIVATE SU_SIMD_TARGET("avx2") void
+su_simd_psd_track_avx2(
+    SUFLOAT *spect,
+    SUFLOAT *spmin,
+    SUFLOAT *spmax,
+    const SUCOMPLEX *fft,
+    SUFLOAT norm,
+    SUFLOAT alpha,
+    SUFLOAT beta,
+    SUFLOAT N0,
+    SUSCOUNT size,
+    su_simd_psd_stats_t *stats)
+{
+  SUSCOUNT i;
+  const float *ff = (const float *) fft;
+  __m256 vnorm  = _mm256_set1_ps(norm);
+  __m256 valpha = _mm256_set1_ps(alpha);
+  __m256 vbeta  = _mm256_set1_ps(beta);
+  __m256 vN0    = _mm256_set1_ps(N0);
+  __m256 sum    = _mm256_setzero_ps();
+  __m256 min    = _mm256_set1_ps(INFINITY);
+  __m256i valid = _mm256_setzero_si256();
+  __m256i bin   = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i minb  = _mm256_set1_epi32(-1);
+  __m256 psd, a, b, mn, mx, lt, in;
+  float lane_sum[8], lane_min[8];
+  uint32_t lane_valid[8], lane_bin[8];
+
+  su_simd_psd_stats_init(stats);
+
+  for (i = 0; i + 8 <= size; i += 8) {
+    psd = _mm256_loadu_ps(spect + i);
+
+    if (fft != NULL) {
+      a = _mm256_loadu_ps(ff + 2 * i);
+      b = _mm256_loadu_ps(ff + 2 * i + 8);
+
+      /* hadd works per 128-bit lane: bins come out as 0 1 4 5 2 3 6 7 */
+      a = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+      a = _mm256_castpd_ps(
+          _mm256_permute4x64_pd(
+              _mm256_castps_pd(a),
+              _MM_SHUFFLE(3, 1, 2, 0)));
+      a = _mm256_mul_ps(vnorm, a);
+      psd = _mm256_add_ps(psd, _mm256_mul_ps(valpha, _mm256_sub_ps(a, psd)));
+      _mm256_storeu_ps(spect + i, psd);
+    }
+
+    mn = _mm256_loadu_ps(spmin + i);
+    mn = _mm256_blendv_ps(
+        _mm256_add_ps(mn, _mm256_mul_ps(vbeta, _mm256_sub_ps(psd, mn))),
+        psd,
+        _mm256_cmp_ps(psd, mn, _CMP_LT_OQ));
+    _mm256_storeu_ps(spmin + i, mn);
+
+    mx = _mm256_loadu_ps(spmax + i);
+    mx = _mm256_blendv_ps(
+        _mm256_add_ps(mx, _mm256_mul_ps(vbeta, _mm256_sub_ps(psd, mx))),
+        psd,
+        _mm256_cmp_ps(psd, mx, _CMP_GT_OQ));
+    _mm256_storeu_ps(spmax + i, mx);
+
+    /* Masks are -1 when true */
+    in = _mm256_and_ps(
+        _mm256_cmp_ps(mn, vN0, _CMP_LT_OQ),
+        _mm256_cmp_ps(vN0, mx, _CMP_LT_OQ));
+    sum = _mm256_add_ps(sum, _mm256_and_ps(in, psd));
+    valid = _mm256_sub_epi32(valid, _mm256_castps_si256(in));
+
+    lt = _mm256_cmp_ps(psd, min, _CMP_LT_OQ);
+    min = _mm256_blendv_ps(min, psd, lt);
+    minb = _mm256_castps_si256(
+        _mm256_blendv_ps(
+            _mm256_castsi256_ps(minb),
+            _mm256_castsi256_ps(bin),
+            lt));
+
+    bin = _mm256_add_epi32(bin, _mm256_set1_epi32(8));
+  }
+
+  _mm256_storeu_ps(lane_sum, sum);
+  _mm256_storeu_ps(lane_min, min);
+  _mm256_storeu_si256((__m256i *) lane_valid, valid);
+  _mm256_storeu_si256((__m256i *) lane_bin, minb);
+
+  /* The tail runs legacy SSE code: avoid AVX-SSE transition penalties */
+  _mm256_zeroupper();
+
+  su_simd_psd_stats_reduce(stats, lane_sum, lane_valid, lane_min, lane_bin, 8);
+
+  __su_simd_psd_track_scalar(
+      spect, spmin, spmax, fft,
+      norm, alpha, beta, N0,
+      i, size,
+      stats);
+}
+#endif /* SU_SIMD_X86 */
+
+/********************************* Dispatchers ********************************/
+void
+su_simd_cmul(SUCOMPLEX *x, const SUCOMPLEX *h, SUSCOUNT size)
+{
+  switch (su_simd_get_level()) {
+#ifdef SU_SIMD_X86
+    case SU_SIMD_LEVEL_AVX2:
+      su_simd_cmul_avx2(x, h, size);
+      break;
+
+    case SU_SIMD_LEVEL_SSE3:
+      su_simd_cmul_sse3(x, h, size);
+      break;
+#endif /* SU_SIMD_X86 */
+
+    default:
+      su_simd_cmul_scalar(x, h, size);
+  }
+}
+
+void
+su_simd_glue(
+    SUCOMPLEX *curr,
+    const SUCOMPLEX *prev,
+    const SUFLOAT *alpha,
+    const SUFLOAT *beta,
+    SUFLOAT gain,
+    SUSCOUNT size)
+{
+  switch (su_simd_get_level()) {
+#ifdef SU_SIMD_X86
+    case SU_SIMD_LEVEL_AVX2:
+      su_simd_glue_avx2(curr, prev, alpha, beta, gain, size);
+      break;
+
+    case SU_SIMD_LEVEL_SSE3:
+      su_simd_glue_sse3(curr, prev, alpha, beta, gain, size);
+      break;
+#endif /* SU_SIMD_X86 */
+
+    default:
+      su_simd_glue_scalar(curr, prev, alpha, beta, gain, size);
+  }
+}
+
+void
+su_simd_rotate(
+    SUCOMPLEX *x,
+    SUSCOUNT size,
+    SUCOMPLEX *phase,
+    SUCOMPLEX step)
+{
+  SUCOMPLEX p;
+
+  switch (su_simd_get_level()) {
+#ifdef SU_SIMD_X86
+    case SU_SIMD_LEVEL_AVX2:
+      p = su_simd_rotate_avx2(x, size, *phase, step);
+      break;
+
+    case SU_SIMD_LEVEL_SSE3:
+      p = su_simd_rotate_sse3(x, size, *phase, step);
+      break;
+#endif /* SU_SIMD_X86 */
+
+    default:
+      p = su_simd_rotate_scalar(x, size, *phase, step);
+  }
+
+  /* Keep the recursive phasor from drifting away from the unit circle */
+  *phase = p / SU_C_ABS(p);
+}
+
+SUCOMPLEX
+su_simd_dot_real(const SUCOMPLEX *x, const SUFLOAT *h, SUSCOUNT size)
+{
+  switch (su_simd_get_level()) {
+#ifdef SU_SIMD_X86
+    case SU_SIMD_LEVEL_AVX2:
+      return su_simd_dot_real_avx2(x, h, size);
+
+    case SU_SIMD_LEVEL_SSE3:
+      return su_simd_dot_real_sse3(x, h, size);
+#endif /* SU_SIMD_X86 */
+
+    default:
+      return su_simd_dot_real_scalar(x, h, size);
+  }
+}
+
+SUCOMPLEX
+su_simd_dot_real_fold(
+    const SUCOMPLEX *x,
+    const SUCOMPLEX *xr,
+    const SUFLOAT *h2,
+    SUSCOUNT size,
+    SUFLOAT sign,
+    unsigned int stride)
+{
+  switch (su_simd_get_level()) {
+#ifdef SU_SIMD_X86
+    case SU_SIMD_LEVEL_AVX2:
+      return su_simd_dot_real_fold_avx2(x, xr, h2, size, sign, stride);
+
+    case SU_SIMD_LEVEL_SSE3:
+      return su_simd_dot_real_fold_sse3(x, xr, h2, size, sign, stride);
+#endif /* SU_SIMD_X86 */
+
+    default:
+      return su_simd_dot_real_fold_scalar(x, xr, h2, size, sign, stride);
+  }
+}
+
+void
+su_simd_window(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUCOMPLEX dc,
+    const SUCOMPLEX *w,
+    SUSCOUNT size)
+{
+  switch (su_simd_get_level()) {
+#ifdef SU_SIMD_X86
+    case SU_SIMD_LEVEL_AVX2:
+      su_simd_window_avx2(y, x, dc, w, size);
+      break;
+
+    case SU_SIMD_LEVEL_SSE3:
+      su_simd_window_sse3(y, x, dc, w, size);
+      break;
+#endif /* SU_SIMD_X86 */
+
+    default:
+      su_simd_window_scalar(y, x, dc, w, size);
+  }
+}
+
+SUCOMPLEX
+su_simd_nonlinear_diff(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUCOMPLEX prev,
+    SUFLOAT gain,
+    SUCOMPLEX dc,
+    SUSCOUNT size)
+{
+  switch (su_simd_get_level()) {
+#ifdef SU_SIMD_X86
+    case SU_SIMD_LEVEL_AVX2:
+      return su_simd_nonlinear_diff_avx2(y, x, prev, gain, dc, size);
+
+    case SU_SIMD_LEVEL_SSE3:
+      return su_simd_nonlinear_diff_sse3(y, x, prev, gain, dc, size);
+#endif /* SU_SIMD_X86 */
+
+    default:
+      return su_simd_nonlinear_diff_scalar(y, x, prev, gain, dc, size);
+  }
+}
+
+void
+su_simd_biquad(
+    SUCOMPLEX *x,
+    SUCOMPLEX *s1,
+    SUCOMPLEX *s2,
+    const SUFLOAT *coef,
+    SUSCOUNT lanes,
+    SUSCOUNT len)
+{
+  SUSCOUNT done = 0;
+
+  switch (su_simd_get_level()) {
+#ifdef SU_SIMD_X86
+    case SU_SIMD_LEVEL_AVX2:
+      done = su_simd_biquad_avx2(x, s1, s2, coef, lanes, len);
+      break;
+
+    case SU_SIMD_LEVEL_SSE3:
+      done = su_simd_biquad_sse3(x, s1, s2, coef, lanes, len);
+      break;
+#endif /* SU_SIMD_X86 */
+
+    default:
+      break;
+  }
+
+  /* Channels left out of the vector lanes */
+  su_simd_biquad_scalar(
+      x + done,
+      s1 + done,
+      s2 + done,
+      coef,
+      lanes,
+      lanes - done,
+      len);
+}
+
+uint32_t
+su_simd_ncqo(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUSCOUNT size,
+    uint32_t phase,
+    uint32_t inc,
+    const SUFLOAT *lut)
+{
+  switch (su_simd_get_level()) {
+#ifdef SU_SIMD_X86
+    case SU_SIMD_LEVEL_AVX2:
+      return su_simd_ncqo_avx2(y, x, size, phase, inc, lut);
+#endif /* SU_SIMD_X86 */
+
+    /* SSE3 has no gathers */
+    default:
+      return su_simd_ncqo_scalar(y, x, size, phase, inc, lut);
+  }
+}
+
+void
+su_simd_psd_track(
+    SUFLOAT *spect,
+    SUFLOAT *spmin,
+    SUFLOAT *spmax,
+    const SUCOMPLEX *fft,
+    SUFLOAT norm,
+    SUFLOAT alpha,
+    SUFLOAT beta,
+    SUFLOAT N0,
+    SUSCOUNT size,
+    su_simd_psd_stats_t *stats)
+{
+  switch (su_simd_get_level()) {
+#ifdef SU_SIMD_X86
+    case SU_SIMD_LEVEL_AVX2:
+      su_simd_psd_track_avx2(
+          spect, spmin, spmax, fft, norm, alpha, beta, N0, size, stats);
+      break;
+
+    case SU_SIMD_LEVEL_SSE3:
+      su_simd_psd_track_sse3(
+          spect, spmin, spmax, fft, norm, alpha, beta, N0, size, stats);
+      break;
+#endif /* SU_SIMD_X86 */
+
+    default:
+      su_simd_psd_track_scalar(
+          spect, spmin, spmax, fft, norm, alpha, beta, N0, size, stats);
+  }
+}
@@ -0,0 +1,210 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#ifndef _SIGUTILS_SIMD_H
+#define _SIGUTILS_SIMD_H
+
+#include <stdint.h>
+
+#include "types.h"
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic push
+#    pragma clang diagnostic ignored "-Wreturn-type-c-linkage"
+#  endif // __clang__
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Vector kernels for the hot loops of the library. The implementation is
+ * selected at runtime according to the CPU features. Vector paths are
+ * only available for single precision builds on x86 compilers supporting
+ * per-function target attributes. Otherwise, scalar code is used.
+ */
+#if defined(_SU_SINGLE_PRECISION)                   \
+    && (defined(__x86_64__) || defined(__i386__))   \
+    && defined(__GNUC__)
+#  define SU_SIMD_X86
+#endif
+
+enum sigutils_simd_level {
+  SU_SIMD_LEVEL_SCALAR,
+  SU_SIMD_LEVEL_SSE3,
+  SU_SIMD_LEVEL_AVX2,
+};
+
+#define SU_SIMD_LEVEL_COUNT (SU_SIMD_LEVEL_AVX2 + 1)
+
+/* Best level supported by this CPU */
+enum sigutils_simd_level su_simd_get_max_level(void);
+
+/* Level currently in use */
+enum sigutils_simd_level su_simd_get_level(void);
+
+/* Force a level (clamped to the maximum). Mostly useful for benchmarks */
+enum sigutils_simd_level su_simd_set_level(enum sigutils_simd_level level);
+
+const char *su_simd_level_to_string(enum sigutils_simd_level level);
+
+/* x[i] *= h[i] */
+void su_simd_cmul(SUCOMPLEX *x, const SUCOMPLEX *h, SUSCOUNT size);
+
+/* curr[i] = gain * (alpha[i] * curr[i] + beta[i] * prev[i]) */
+void su_simd_glue(
+    SUCOMPLEX *curr,
+    const SUCOMPLEX *prev,
+    const SUFLOAT *alpha,
+    const SUFLOAT *beta,
+    SUFLOAT gain,
+    SUSCOUNT size);
+
+/*
+ * x[i] *= phase * step^i. On return, phase is advanced by size steps and
+ * renormalized to unit magnitude.
+ */
+void su_simd_rotate(
+    SUCOMPLEX *x,
+    SUSCOUNT size,
+    SUCOMPLEX *phase,
+    SUCOMPLEX step);
+
+/*
+ * y[i] = (x[i] - dc) * Re(w[i]). Window functions are stored as complex
+ * numbers, only their real parts are used. x and y must not overlap.
+ */
+void su_simd_window(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUCOMPLEX dc,
+    const SUCOMPLEX *w,
+    SUSCOUNT size);
+
+/*
+ * Squared magnitude of the scaled derivative, minus a DC component:
+ *
+ *   y[i] = |gain * (x[i] - x[i - 1])|^2 - dc,  with x[-1] = prev
+ *
+ * Returns x[size - 1] (prev if size is 0). x and y must not overlap.
+ */
+SUCOMPLEX su_simd_nonlinear_diff(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUCOMPLEX prev,
+    SUFLOAT gain,
+    SUCOMPLEX dc,
+    SUSCOUNT size);
+
+/*
+ * Biquad (b0, b1, b2, a1, a2) in transposed direct form II, run in place
+ * over len frames of `lanes` interleaved, independent channels. s1 and s2
+ * hold the state of every channel.
+ */
+void su_simd_biquad(
+    SUCOMPLEX *x,
+    SUCOMPLEX *s1,
+    SUCOMPLEX *s2,
+    const SUFLOAT *coef,
+    SUSCOUNT lanes,
+    SUSCOUNT len);
+
+/* sum(x[i] * h[i]), h being real */
+SUCOMPLEX su_simd_dot_real(
+    const SUCOMPLEX *x,
+    const SUFLOAT *h,
+    SUSCOUNT size);
+
+/*
+ * Folded dot product, for linear phase filters:
+ *
+ *   sum(h[i] * (x[i * stride] + sign * xr[-i * stride]))
+ *
+ * with sign = 1 (symmetric taps) or -1 (antisymmetric taps). stride is
+ * either 1, or 2 for filters in which every other tap is zero. Taps are
+ * passed duplicated, i.e. h2[2 * i] = h2[2 * i + 1] = h[i], so that they
+ * line up with the real and imaginary parts of the samples.
+ */
+SUCOMPLEX su_simd_dot_real_fold(
+    const SUCOMPLEX *x,
+    const SUCOMPLEX *xr,
+    const SUFLOAT *h2,
+    SUSCOUNT size,
+    SUFLOAT sign,
+    unsigned int stride);
+
+/* Summary of a spectrum, as gathered by su_simd_psd_track */
+struct sigutils_simd_psd_stats {
+  SUFLOAT  sum;     /* Sum of the bins whose [min, max] range contains N0 */
+  SUSCOUNT valid;   /* Number of such bins */
+  SUFLOAT  min;     /* Smallest bin */
+  SUSCOUNT min_bin; /* Index of its first occurrence, -1 if none */
+};
+
+typedef struct sigutils_simd_psd_stats su_simd_psd_stats_t;
+
+/*
+ * Discovery pass over a power spectrum. If fft is not NULL, the spectrum
+ * is smoothed first:
+ *
+ *   spect[i] += alpha * (norm * |fft[i]|^2 - spect[i])
+ *
+ * Then, spmin[i] and spmax[i] follow spect[i] (immediately when crossed,
+ * with a time constant beta otherwise), and bins whose updated range
+ * contains N0 are added to stats->sum. Arithmetic matches the scalar
+ * version exactly, except for the order in which stats->sum is added.
+ */
+void su_simd_psd_track(
+    SUFLOAT *spect,
+    SUFLOAT *spmin,
+    SUFLOAT *spmax,
+    const SUCOMPLEX *fft,
+    SUFLOAT norm,
+    SUFLOAT alpha,
+    SUFLOAT beta,
+    SUFLOAT N0,
+    SUSCOUNT size,
+    su_simd_psd_stats_t *stats);
+
+/*
+ * Integer phase oscillator. Phases are 32-bit fractions of a turn, and
+ * sines are interpolated from lut, a quarter-wave table of
+ * SU_NCQO_LUT_SIZE + 2 entries (see ncqo.h). Writes
+ *
+ *   y[i] = x[i] * exp(j 2 PI (phase + i * inc) / 2^32)
+ *
+ * or just the oscillator if x is NULL. x and y may be the same buffer.
+ * Returns the phase after size samples.
+ */
+uint32_t su_simd_ncqo(
+    SUCOMPLEX *y,
+    const SUCOMPLEX *x,
+    SUSCOUNT size,
+    uint32_t phase,
+    uint32_t inc,
+    const SUFLOAT *lut);
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic pop
+#  endif // __clang__
+}
+#endif /* __cplusplus */
+
+#endif /* _SIGUTILS_SIMD_H */
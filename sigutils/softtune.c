@@ -19,11 +19,13 @@
 */
 
 #include <assert.h>
+#include <limits.h>
 #include <string.h>
 
 #define SU_LOG_DOMAIN "softtuner"
 
 #include "sampling.h"
+#include "taps.h"
 #include "softtune.h"
 
 void
@@ -42,11 +44,107 @@ su_softtuner_params_adjust_to_channel(
   params->fc = channel->fc - channel->ft;
 }
 
+SUPRIVATE SUBOOL
+su_softtuner_init_fir(su_fir_filt_t *fir, SUFLOAT *h, SUSCOUNT size)
+{
+  SUFLOAT sum = 0;
+  unsigned int i;
+
+  for (i = 0; i < size; ++i)
+    sum += h[i];
+
+  for (i = 0; i < size; ++i)
+    h[i] /= sum;
+
+  return su_fir_filt_init(fir, h, size);
+}
+
+/* One half-band per factor 2, the CIC takes the rest */
+SUPRIVATE SUSCOUNT
+su_softtuner_split_decimation(SUSCOUNT decimation, unsigned int *halfbands)
+{
+  *halfbands = 0;
+
+  while (*halfbands < SU_SOFTTUNER_HALFBAND_STAGES && (decimation & 1) == 0) {
+    decimation >>= 1;
+    ++*halfbands;
+  }
+
+  return decimation;
+}
+
+/*
+ * CIC stages for the CIC share of the decimation: the default, or fewer
+ * if the integrators would overflow. 0 if no CIC can do it.
+ */
+SUPRIVATE unsigned int
+su_softtuner_get_cic_stages(SUSCOUNT decimation)
+{
+  unsigned int halfbands;
+
+  decimation = su_softtuner_split_decimation(decimation, &halfbands);
+
+  if (decimation > UINT_MAX)
+    return 0;
+
+  return MIN(
+      SU_CIC_DEFAULT_STAGES,
+      su_cic_filt_get_max_stages((unsigned int) decimation));
+}
+
+SUPRIVATE SUBOOL
+su_softtuner_init_cic(su_softtuner_t *tuner, unsigned int stages)
+{
+  SUFLOAT h[SU_MAX(SU_SOFTTUNER_CIC_COMP_TAPS, SU_SOFTTUNER_HALFBAND_TAPS)];
+  SUSCOUNT decimation;
+  SUFLOAT fc;
+  unsigned int i;
+
+  decimation = su_softtuner_split_decimation(
+      tuner->params.decimation,
+      &tuner->halfbands);
+
+  SU_TRYCATCH(
+      su_cic_filt_init(&tuner->cic, decimation, stages),
+      return SU_FALSE);
+
+  /* Compensation cutoff, at the CIC output rate: never above the output */
+  fc = 1. / (1 << tuner->halfbands);
+  if (tuner->params.bw > 0.0)
+    fc = MIN(
+        fc,
+        .5 * SU_ABS2NORM_FREQ(tuner->params.samp_rate, tuner->params.bw)
+           * SU_SOFTTUNER_ANTIALIAS_EXTRA_BW
+           * decimation);
+
+  su_cic_comp_init(h, SU_SOFTTUNER_CIC_COMP_TAPS, &tuner->cic, fc);
+  SU_TRYCATCH(
+      su_softtuner_init_fir(&tuner->comp, h, SU_SOFTTUNER_CIC_COMP_TAPS),
+      return SU_FALSE);
+
+  for (i = 0; i < tuner->halfbands; ++i) {
+    su_taps_brickwall_lp_init(h, .5, SU_SOFTTUNER_HALFBAND_TAPS);
+    SU_TRYCATCH(
+        su_softtuner_init_fir(
+            tuner->halfband + i,
+            h,
+            SU_SOFTTUNER_HALFBAND_TAPS),
+        return SU_FALSE);
+    SU_TRYCATCH(
+        su_fir_filt_set_decimation(tuner->halfband + i, 2),
+        return SU_FALSE);
+  }
+
+  return SU_TRUE;
+}
+
 SUBOOL
 su_softtuner_init(
     su_softtuner_t *tuner,
     const struct sigutils_softtuner_params *params)
 {
+  unsigned int stages = 0;
+
   assert(params->samp_rate > 0);
   assert(params->decimation > 0);
 
@@ -59,17 +157,29 @@ su_softtuner_init(
       su_stream_init(&tuner->output, SU_BLOCK_STREAM_BUFFER_SIZE),
       goto fail);
 
-  su_ncqo_init_fixed(
+  /* Carrier centering multiplies by the conjugate of the carrier */
+  su_mixer_init(
       &tuner->lo,
-      SU_ABS2NORM_FREQ(params->samp_rate, params->fc));
+      -SU_ABS2NORM_FREQ(params->samp_rate, params->fc));
+
+  if (params->mode == SU_SOFTTUNER_MODE_CIC
+      && (stages = su_softtuner_get_cic_stages(params->decimation)) == 0) {
+    SU_WARNING(
+        "Decimation %lu too large for a CIC, falling back to SOS\n",
+        (unsigned long) params->decimation);
+    tuner->params.mode = SU_SOFTTUNER_MODE_SOS;
+  }
 
-  if (params->bw > 0.0) {
+  if (tuner->params.mode == SU_SOFTTUNER_MODE_CIC) {
+    SU_TRYCATCH(su_softtuner_init_cic(tuner, stages), goto fail);
+  } else if (params->bw > 0.0) {
     SU_TRYCATCH(
-        su_iir_bwlpf_init(
+        su_sos_bwlpf_init(
             &tuner->antialias,
             SU_SOFTTUNER_ANTIALIAS_ORDER,
             .5 * SU_ABS2NORM_FREQ(params->samp_rate, params->bw)
-               * SU_SOFTTUNER_ANTIALIAS_EXTRA_BW),
+               * SU_SOFTTUNER_ANTIALIAS_EXTRA_BW,
+            1),
          goto fail);
     tuner->filtered = SU_TRUE;
   }
@@ -82,6 +192,36 @@ fail:
   return SU_FALSE;
 }
 
+/* Input samples that can be consumed before the output buffer is full */
+SUINLINE SUSCOUNT
+su_softtuner_get_max_input(const su_softtuner_t *tuner, SUSCOUNT room)
+{
+  /* Worst case: an output is just about to come out */
+  if (tuner->params.mode == SU_SOFTTUNER_MODE_CIC)
+    return room * tuner->params.decimation - (tuner->params.decimation - 1);
+
+  if (tuner->params.decimation > 1)
+    return room * tuner->params.decimation - tuner->decim_ptr;
+
+  return room;
+}
+
+/* Runs the CIC chain in place. Returns the number of outputs */
+SUINLINE SUSCOUNT
+su_softtuner_decimate(su_softtuner_t *tuner, SUCOMPLEX *x, SUSCOUNT len)
+{
+  unsigned int i;
+
+  len = su_cic_filt_feed_bulk(&tuner->cic, x, len, x);
+
+  su_fir_filt_feed_bulk(&tuner->comp, x, x, len);
+
+  for (i = 0; i < tuner->halfbands; ++i)
+    len = su_fir_filt_feed_bulk_decim(tuner->halfband + i, x, x, len);
+
+  return len;
+}
+
 SUSCOUNT
 su_softtuner_feed(
     su_softtuner_t *tuner,
@@ -89,7 +229,9 @@ su_softtuner_feed(
     SUSCOUNT size)
 {
   SUSCOUNT  i = 0;
-  SUCOMPLEX x;
+  SUSCOUNT  j;
+  SUCOMPLEX x[SU_SOFTTUNER_FEED_CHUNK];
+  SUSCOUNT chunk;
   SUSCOUNT avail;
   SUCOMPLEX *buf;
   SUSCOUNT n = 0;
@@ -103,24 +245,39 @@ su_softtuner_feed(
 
   buf[0] = 0;
 
-  for (i = 0; i < size && n < avail; ++i) {
+  while (i < size && n < avail) {
+    chunk = MIN(size - i, SU_SOFTTUNER_FEED_CHUNK);
+    chunk = MIN(chunk, su_softtuner_get_max_input(tuner, avail - n));
+
     /* Carrier centering. Must happen *before* decimation */
-    x = input[i] * SU_C_CONJ(su_ncqo_read(&tuner->lo));
+    su_mixer_mix(&tuner->lo, input + i, x, chunk);
+
+    if (tuner->params.mode == SU_SOFTTUNER_MODE_CIC) {
+      j = su_softtuner_decimate(tuner, x, chunk);
+      memcpy(buf + n, x, j * sizeof (SUCOMPLEX));
+      n += j;
+      i += chunk;
+      continue;
+    }
 
     if (tuner->filtered)
-      x = su_iir_filt_feed(&tuner->antialias, x);
-
-    if (tuner->params.decimation > 1) {
-      if (++tuner->decim_ptr < tuner->params.decimation) {
-        buf[n] += tuner->avginv * x;
+      su_sos_filt_feed_bulk(&tuner->antialias, x, x, chunk);
+
+    for (j = 0; j < chunk; ++j) {
+      if (tuner->params.decimation > 1) {
+        if (++tuner->decim_ptr < tuner->params.decimation) {
+          buf[n] += tuner->avginv * x[j];
+        } else {
+          if (++n < avail)
+            buf[n] = 0;
+          tuner->decim_ptr = 0; /* Reset decimation pointer */
+        }
       } else {
-        if (++n < avail)
-          buf[n] = 0;
-        tuner->decim_ptr = 0; /* Reset decimation pointer */
+        buf[n++] = x[j];
       }
-    } else {
-      buf[n++] = x;
     }
+
+    i += chunk;
   }
 
   su_stream_advance_contiguous(&tuner->output, n);
@@ -149,8 +306,16 @@ su_softtuner_read(su_softtuner_t *tuner, SUCOMPLEX *out, SUSCOUNT size)
 void
 su_softtuner_finalize(su_softtuner_t *tuner)
 {
+  unsigned int i;
+
   if (tuner->filtered)
-    su_iir_filt_finalize(&tuner->antialias);
+    su_sos_filt_finalize(&tuner->antialias);
+
+  su_cic_filt_finalize(&tuner->cic);
+  su_fir_filt_finalize(&tuner->comp);
+
+  for (i = 0; i < SU_SOFTTUNER_HALFBAND_STAGES; ++i)
+    su_fir_filt_finalize(tuner->halfband + i);
 
   su_stream_finalize(&tuner->output);
 
@@ -23,14 +23,41 @@
 
 #include "block.h"
 #include "sigutils.h"
-#include "ncqo.h"
+#include "mixer.h"
 #include "sampling.h"
-#include "iir.h"
+#include "sos.h"
+#include "fir.h"
+#include "cic.h"
 
 /* Extra bandwidth given to antialias filter */
 #define SU_SOFTTUNER_ANTIALIAS_EXTRA_BW 2
 #define SU_SOFTTUNER_ANTIALIAS_ORDER    4
 
+/* Samples mixed and filtered at once */
+#define SU_SOFTTUNER_FEED_CHUNK 256
+
+/* Decimation chain */
+#define SU_SOFTTUNER_HALFBAND_STAGES 2
+#define SU_SOFTTUNER_HALFBAND_TAPS   31
+#define SU_SOFTTUNER_CIC_COMP_TAPS   31
+
+/*
+ * Decimation modes:
+ *
+ * - SOS: Butterworth antialias filter at the input rate, followed by
+ *   decimation by averaging.
+ * - CIC: multiplierless CIC decimator, followed by a CIC compensation
+ *   FIR and up to SU_SOFTTUNER_HALFBAND_STAGES half-band decimators (one
+ *   per factor 2 of the decimation). Only the CIC runs at the input rate.
+ *   The CIC has SU_CIC_DEFAULT_STAGES stages, or fewer if its share of
+ *   the decimation is too large for its accumulators (roughly above 2896).
+ *   Decimations no CIC can handle fall back to SOS.
+ */
+enum sigutils_softtuner_mode {
+  SU_SOFTTUNER_MODE_SOS,
+  SU_SOFTTUNER_MODE_CIC,
+};
+
 struct sigutils_channel {
   SUFLOAT fc;    /* Channel central frequency */
   SUFLOAT f_lo;  /* Lower frequency belonging to the channel */
@@ -49,6 +76,7 @@ struct sigutils_softtuner_params {
   SUSCOUNT decimation;
   SUFLOAT  fc;
   SUFLOAT  bw;
+  enum sigutils_softtuner_mode mode;
 };
 
 #define sigutils_softtuner_params_INITIALIZER   \
@@ -57,17 +85,24 @@ struct sigutils_softtuner_params {
   0, /* decimation */                           \
   0, /* fc */                                   \
   0, /* bw */                                   \
+  SU_SOFTTUNER_MODE_CIC, /* mode */             \
 }
 
 struct sigutils_softtuner {
   struct sigutils_softtuner_params params;
-  su_ncqo_t lo; /* Local oscillator */
-  su_iir_filt_t antialias; /* Antialiasing filter */
+  su_mixer_t lo; /* Local oscillator */
+  su_sos_filt_t antialias; /* Antialiasing filter */
   su_stream_t output; /* Output stream */
   su_off_t read_ptr;
   SUSCOUNT decim_ptr;
   SUBOOL filtered;
   SUFLOAT avginv;
+
+  /* CIC mode */
+  su_cic_filt_t cic;
+  su_fir_filt_t comp; /* CIC compensation */
+  su_fir_filt_t halfband[SU_SOFTTUNER_HALFBAND_STAGES];
+  unsigned int halfbands;
 };
 
 typedef struct sigutils_softtuner su_softtuner_t;
@@ -77,9 +112,9 @@ su_channel_detector_set_fc(su_softtuner_t *cd, SUFLOAT fc)
 {
   cd->params.fc = fc;
 
-  su_ncqo_init(
+  su_mixer_init(
       &cd->lo,
-      SU_ABS2NORM_FREQ(cd->params.samp_rate, cd->params.fc));
+      -SU_ABS2NORM_FREQ(cd->params.samp_rate, cd->params.fc));
 }
 
 void su_softtuner_params_adjust_to_channel(
@@ -0,0 +1,202 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#define SU_LOG_DOMAIN "sos"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "log.h"
+#include "sos.h"
+#include "simd.h"
+
+void
+su_sos_filt_finalize(su_sos_filt_t *filt)
+{
+  if (filt->coef != NULL)
+    free(filt->coef);
+
+  if (filt->state != NULL)
+    free(filt->state);
+
+  memset(filt, 0, sizeof(su_sos_filt_t));
+
+  filt->gain = 1;
+}
+
+void
+su_sos_filt_reset(su_sos_filt_t *filt)
+{
+  memset(
+      filt->state,
+      0,
+      2 * filt->sections * filt->channels * sizeof(SUCOMPLEX));
+
+  filt->curr_y = 0;
+}
+
+SUBOOL
+su_sos_filt_init(
+    su_sos_filt_t *filt,
+    const SUFLOAT *coef,
+    unsigned int sections,
+    unsigned int channels)
+{
+  SU_TRYCATCH(sections > 0, return SU_FALSE);
+  SU_TRYCATCH(channels > 0, return SU_FALSE);
+
+  memset(filt, 0, sizeof(su_sos_filt_t));
+
+  filt->sections = sections;
+  filt->channels = channels;
+  filt->gain     = 1;
+
+  SU_TRYCATCH(
+      filt->coef = malloc(sections * SU_SOS_COEF_COUNT * sizeof(SUFLOAT)),
+      goto fail);
+
+  SU_TRYCATCH(
+      filt->state = calloc(2 * sections * channels, sizeof(SUCOMPLEX)),
+      goto fail);
+
+  memcpy(filt->coef, coef, sections * SU_SOS_COEF_COUNT * sizeof(SUFLOAT));
+
+  return SU_TRUE;
+
+fail:
+  su_sos_filt_finalize(filt);
+
+  return SU_FALSE;
+}
+
+SUBOOL
+su_sos_bwlpf_init(
+    su_sos_filt_t *filt,
+    SUSCOUNT n,
+    SUFLOAT fc,
+    unsigned int channels)
+{
+  SUFLOAT *coef = NULL;
+  SUBOOL ok = SU_FALSE;
+
+  SU_TRYCATCH(coef = su_sos_bwlp(n, fc), goto done);
+
+  ok = su_sos_filt_init(filt, coef, su_sos_bwlp_sections(n), channels);
+
+done:
+  if (coef != NULL)
+    free(coef);
+
+  return ok;
+}
+
+SUBOOL
+su_sos_bwbpf_init(
+    su_sos_filt_t *filt,
+    SUSCOUNT n,
+    SUFLOAT f1,
+    SUFLOAT f2,
+    unsigned int channels)
+{
+  SUFLOAT *coef = NULL;
+  SUBOOL ok = SU_FALSE;
+
+  SU_TRYCATCH(coef = su_sos_bwbp(n, f1, f2), goto done);
+
+  ok = su_sos_filt_init(filt, coef, su_sos_bwbp_sections(n), channels);
+
+done:
+  if (coef != NULL)
+    free(coef);
+
+  return ok;
+}
+
+SUCOMPLEX
+su_sos_filt_feed(su_sos_filt_t *filt, SUCOMPLEX x)
+{
+  const SUFLOAT *coef = filt->coef;
+  SUCOMPLEX *s = filt->state;
+  SUCOMPLEX y = x;
+  unsigned int i;
+
+  for (i = 0; i < filt->sections; ++i) {
+    x    = y;
+    y    = coef[0] * x + s[0];
+    s[0] = coef[1] * x - coef[3] * y + s[1];
+    s[1] = coef[2] * x - coef[4] * y;
+
+    coef += SU_SOS_COEF_COUNT;
+    s    += 2;
+  }
+
+  filt->curr_y = y;
+
+  return filt->gain * y;
+}
+
+void
+su_sos_filt_feed_bulk(
+    su_sos_filt_t *filt,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT len)
+{
+  unsigned int channels = filt->channels;
+  SUCOMPLEX *s = filt->state;
+  SUSCOUNT i;
+  unsigned int j;
+
+  if (len == 0)
+    return;
+
+  if (x != y)
+    memcpy(y, x, len * channels * sizeof(SUCOMPLEX));
+
+  /* Whole block through one section, then the next */
+  for (j = 0; j < filt->sections; ++j) {
+    su_simd_biquad(
+        y,
+        s,
+        s + channels,
+        filt->coef + j * SU_SOS_COEF_COUNT,
+        channels,
+        len);
+    s += 2 * channels;
+  }
+
+  filt->curr_y = y[(len - 1) * channels];
+
+  if (filt->gain != 1)
+    for (i = 0; i < len * channels; ++i)
+      y[i] *= filt->gain;
+}
+
+SUCOMPLEX
+su_sos_filt_get(const su_sos_filt_t *filt)
+{
+  return filt->gain * filt->curr_y;
+}
+
+void
+su_sos_filt_set_gain(su_sos_filt_t *filt, SUFLOAT gain)
+{
+  filt->gain = gain;
+}
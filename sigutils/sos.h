@@ -0,0 +1,110 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#ifndef _SIGUTILS_SOS_H
+#define _SIGUTILS_SOS_H
+
+#include "types.h"
+#include "coef.h"
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic push
+#    pragma clang diagnostic ignored "-Wreturn-type-c-linkage"
+#  endif // __clang__
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Cascade of second order sections, each one in transposed direct form
+ * II. Unlike a single high order polynomial, low order sections remain
+ * stable in single precision even for very narrow filters.
+ *
+ * The same filter may run on several channels at once: samples are then
+ * passed in frames of `channels` interleaved samples (x[t * channels + c])
+ * and channels are processed in parallel, in SIMD lanes.
+ */
+struct sigutils_sos_filt {
+  unsigned int sections;
+  unsigned int channels;
+
+  SUFLOAT *coef;     /* SU_SOS_COEF_COUNT per section */
+  SUCOMPLEX *state;  /* 2 * channels per section */
+
+  SUCOMPLEX curr_y;  /* Last output of channel 0, before gain */
+  SUFLOAT gain;
+};
+
+typedef struct sigutils_sos_filt su_sos_filt_t;
+
+#define su_sos_filt_INITIALIZER {0, 0, NULL, NULL, 0, 1}
+
+/* Initialize filter from sections coefficients */
+SUBOOL su_sos_filt_init(
+    su_sos_filt_t *filt,
+    const SUFLOAT *coef,
+    unsigned int sections,
+    unsigned int channels);
+
+/* Initialize Butterworth low-pass filter of order N */
+SUBOOL su_sos_bwlpf_init(
+    su_sos_filt_t *filt,
+    SUSCOUNT n,
+    SUFLOAT fc,
+    unsigned int channels);
+
+/* Initialize Butterworth band-pass filter of order N */
+SUBOOL su_sos_bwbpf_init(
+    su_sos_filt_t *filt,
+    SUSCOUNT n,
+    SUFLOAT f1,
+    SUFLOAT f2,
+    unsigned int channels);
+
+/* Push sample to a single channel filter */
+SUCOMPLEX su_sos_filt_feed(su_sos_filt_t *filt, SUCOMPLEX x);
+
+/* Push len frames to filter. x and y may be the same buffer */
+void su_sos_filt_feed_bulk(
+    su_sos_filt_t *filt,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT len);
+
+/* Get last output (channel 0) */
+SUCOMPLEX su_sos_filt_get(const su_sos_filt_t *filt);
+
+/* Set output gain */
+void su_sos_filt_set_gain(su_sos_filt_t *filt, SUFLOAT gain);
+
+/* Clear filter state */
+void su_sos_filt_reset(su_sos_filt_t *filt);
+
+/* Destroy filter */
+void su_sos_filt_finalize(su_sos_filt_t *filt);
+
+#ifdef __cplusplus
+#  ifdef __clang__
+#    pragma clang diagnostic pop
+#  endif // __clang__
+}
+#endif /* __cplusplus */
+
+#endif /* _SIGUTILS_SOS_H */
@@ -18,125 +18,451 @@
 
 */
 
+#define _GNU_SOURCE
 #define SU_LOG_DOMAIN "specttuner"
 
 #include "log.h"
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "sampling.h"
 #include "taps.h"
 #include "specttuner.h"
+#include "simd.h"
+
+/*
+ * Filter responses only depend on the window size and the channel width.
+ * Since it is common to have lots of channels sharing a few bandwidths,
+ * responses are computed once and shared by all channels using them.
+ */
+PTR_LIST(SUPRIVATE struct sigutils_specttuner_filter, specttuner_filter);
+SUPRIVATE pthread_mutex_t g_specttuner_filter_mutex =
+    PTHREAD_MUTEX_INITIALIZER;
 
 SUPRIVATE void
-su_specttuner_channel_destroy(su_specttuner_channel_t *channel)
+su_specttuner_filter_destroy(struct sigutils_specttuner_filter *filter)
 {
-  if (channel->plan[SU_SPECTTUNER_STATE_EVEN] != NULL)
-    SU_FFTW(_destroy_plan) (channel->plan[SU_SPECTTUNER_STATE_EVEN]);
-
-  if (channel->plan[SU_SPECTTUNER_STATE_ODD] != NULL)
-    SU_FFTW(_destroy_plan) (channel->plan[SU_SPECTTUNER_STATE_ODD]);
+  if (filter->resp != NULL)
+    SU_FFTW(_free) (filter->resp);
 
-  if (channel->ifft[SU_SPECTTUNER_STATE_EVEN] != NULL)
-    SU_FFTW(_free) (channel->ifft[SU_SPECTTUNER_STATE_EVEN]);
-
-  if (channel->ifft[SU_SPECTTUNER_STATE_ODD] != NULL)
-    SU_FFTW(_free) (channel->ifft[SU_SPECTTUNER_STATE_ODD]);
+  free(filter);
+}
 
-  if (channel->fft != NULL)
-    SU_FFTW(_free) (channel->fft);
+SUPRIVATE struct sigutils_specttuner_filter *
+su_specttuner_filter_new(
+    unsigned int window_size,
+    unsigned int halfw,
+    SUFLOAT k)
+{
+  struct sigutils_specttuner_filter *new = NULL;
+  SU_FFTW(_complex) *h = NULL;
+  su_fft_plan_t *forward = NULL;
+  su_fft_plan_t *backward = NULL;
+  SUCOMPLEX tmp;
+  unsigned int window_half = window_size / 2;
+  unsigned int i;
 
-  if (channel->window != NULL)
-    SU_FFTW(_free) (channel->window);
+  SU_TRYCATCH(
+      new = calloc(1, sizeof(struct sigutils_specttuner_filter)),
+      goto fail);
 
-  if (channel->forward != NULL)
-    SU_FFTW(_destroy_plan) (channel->forward);
+  new->window_size = window_size;
+  new->halfw = halfw;
+  new->k = k;
 
-  if (channel->backward != NULL)
-    SU_FFTW(_destroy_plan) (channel->backward);
+  SU_TRYCATCH(
+      new->resp = SU_FFTW(_malloc)(2 * halfw * sizeof(SU_FFTW(_complex))),
+      goto fail);
 
-  if (channel->h != NULL)
-    SU_FFTW(_free) (channel->h);
+  /* Full-size response is only needed while computing the filter */
+  SU_TRYCATCH(
+      h = SU_FFTW(_malloc)(window_size * sizeof(SU_FFTW(_complex))),
+      goto fail);
 
-  free(channel);
-}
+  SU_TRYCATCH(
+      forward = su_fft_plan_acquire(window_size, FFTW_FORWARD, h, h),
+      goto fail);
 
-SUPRIVATE void
-su_specttuner_update_channel_filter(
-    const su_specttuner_t *owner,
-    su_specttuner_channel_t *channel)
-{
-  SUCOMPLEX tmp;
-  unsigned int window_size = owner->params.window_size;
-  unsigned int window_half = window_size / 2;
-  unsigned int i;
+  SU_TRYCATCH(
+      backward = su_fft_plan_acquire(window_size, FFTW_BACKWARD, h, h),
+      goto fail);
 
   /* First step: Setup ideal filter response */
-  memset(channel->h, 0, sizeof(SUCOMPLEX) * window_size);
+  memset(h, 0, sizeof(SUCOMPLEX) * window_size);
 
-  for (i = 0; i < channel->halfw; ++i) {
-    channel->h[i] = 1;
-    channel->h[window_size - i - 1] = 1;
+  for (i = 0; i < halfw; ++i) {
+    h[i] = 1;
+    h[window_size - i - 1] = 1;
   }
 
   /* Second step: switch to time domain */
-  SU_FFTW(_execute) (channel->backward);
+  su_fft_plan_execute(backward, h, h);
 
   /* Third step: recenter coefficients to apply window function */
   for (i = 0; i < window_half; ++i) {
-    tmp = channel->h[i];
-    channel->h[i] = channel->k * channel->h[window_half + i];
-    channel->h[window_half + i] = channel->k * tmp;
+    tmp = h[i];
+    h[i] = k * h[window_half + i];
+    h[window_half + i] = k * tmp;
   }
 
   /* Fourth step: apply Window function */
-  su_taps_apply_blackmann_harris_complex(channel->h, window_size);
+  su_taps_apply_blackmann_harris_complex(h, window_size);
 
   /* Fifth step: recenter back */
   for (i = 0; i < window_half; ++i) {
-    tmp = channel->h[i];
-    channel->h[i] = channel->h[window_half + i];
-    channel->h[window_half + i] = tmp;
+    tmp = h[i];
+    h[i] = h[window_half + i];
+    h[window_half + i] = tmp;
   }
 
   /* Sixth step: move back to frequency domain */
-  SU_FFTW(_execute) (channel->forward);
+  su_fft_plan_execute(forward, h, h);
+
+  /*
+   * Seventh step: keep only the bins the channel actually copies. The
+   * remaining ones always multiply zeroes. Channel scaling is applied
+   * here too.
+   */
+  for (i = 0; i < halfw; ++i) {
+    new->resp[i] = k * h[i];
+    new->resp[halfw + i] = k * h[window_size - halfw + i];
+  }
+
+  su_fft_plan_release(backward);
+  su_fft_plan_release(forward);
+  SU_FFTW(_free) (h);
+
+  return new;
+
+fail:
+  if (backward != NULL)
+    su_fft_plan_release(backward);
+
+  if (forward != NULL)
+    su_fft_plan_release(forward);
+
+  if (h != NULL)
+    SU_FFTW(_free) (h);
+
+  if (new != NULL)
+    su_specttuner_filter_destroy(new);
+
+  return NULL;
+}
+
+SUPRIVATE struct sigutils_specttuner_filter *
+su_specttuner_filter_acquire(
+    unsigned int window_size,
+    unsigned int halfw,
+    SUFLOAT k)
+{
+  struct sigutils_specttuner_filter *this = NULL;
+  struct sigutils_specttuner_filter *new = NULL;
+  unsigned int i;
+
+  pthread_mutex_lock(&g_specttuner_filter_mutex);
+
+  FOR_EACH_PTR(this, i, specttuner_filter)
+    if (this->window_size == window_size
+        && this->halfw == halfw
+        && this->k == k) {
+      ++this->refcnt;
+      pthread_mutex_unlock(&g_specttuner_filter_mutex);
+      return this;
+    }
+
+  SU_TRYCATCH(
+      new = su_specttuner_filter_new(window_size, halfw, k),
+      goto fail);
+  SU_TRYCATCH(PTR_LIST_APPEND_CHECK(specttuner_filter, new) != -1, goto fail);
+
+  new->refcnt = 1;
+
+  pthread_mutex_unlock(&g_specttuner_filter_mutex);
+
+  return new;
+
+fail:
+  if (new != NULL)
+    su_specttuner_filter_destroy(new);
+
+  pthread_mutex_unlock(&g_specttuner_filter_mutex);
+
+  return NULL;
+}
+
+SUPRIVATE void
+su_specttuner_filter_release(struct sigutils_specttuner_filter *filter)
+{
+  unsigned int i;
+
+  pthread_mutex_lock(&g_specttuner_filter_mutex);
+
+  if (--filter->refcnt == 0) {
+    for (i = 0; i < specttuner_filter_count; ++i)
+      if (specttuner_filter_list[i] == filter) {
+        specttuner_filter_list[i] = NULL;
+        break;
+      }
+
+    su_specttuner_filter_destroy(filter);
+  }
+
+  pthread_mutex_unlock(&g_specttuner_filter_mutex);
+}
+
+unsigned int
+su_specttuner_get_filter_count(void)
+{
+  unsigned int count = 0;
+  unsigned int i;
+
+  pthread_mutex_lock(&g_specttuner_filter_mutex);
+
+  for (i = 0; i < specttuner_filter_count; ++i)
+    if (specttuner_filter_list[i] != NULL)
+      ++count;
+
+  pthread_mutex_unlock(&g_specttuner_filter_mutex);
+
+  return count;
+}
+
+/*************************** Pull-mode output ring ***************************/
+SUPRIVATE void
+su_specttuner_ring_destroy(struct sigutils_specttuner_ring *ring)
+{
+  if (ring->buffer != NULL) {
+    if (ring->mirrored)
+      munmap(ring->buffer, 2 * ring->size * sizeof(SUCOMPLEX));
+    else
+      free(ring->buffer);
+  }
+
+  free(ring);
 }
 
+#ifdef MFD_CLOEXEC
 SUPRIVATE SUBOOL
-su_specttuner_init_filter_response(
-    const su_specttuner_t *owner,
-    su_specttuner_channel_t *channel)
+su_specttuner_ring_map_mirrored(struct sigutils_specttuner_ring *ring)
 {
+  size_t bytes = ring->size * sizeof(SUCOMPLEX);
+  int fd = -1;
+  uint8_t *addr = MAP_FAILED;
   SUBOOL ok = SU_FALSE;
-  unsigned int window_size = owner->params.window_size;
 
-  /* Backward plan */
   SU_TRYCATCH(
-      channel->forward = SU_FFTW(_plan_dft_1d)(
-          window_size,
-          channel->h,
-          channel->h,
-          FFTW_FORWARD,
-          FFTW_ESTIMATE),
+      (fd = memfd_create("su_specttuner_ring", MFD_CLOEXEC)) != -1,
       goto done);
+  SU_TRYCATCH(ftruncate(fd, bytes) != -1, goto done);
 
-  /* Forward plan */
+  /* Reserve twice the space, then map the same pages on both halves */
   SU_TRYCATCH(
-      channel->backward = SU_FFTW(_plan_dft_1d)(
-          window_size,
-          channel->h,
-          channel->h,
-          FFTW_BACKWARD,
-          FFTW_ESTIMATE),
+      (addr = mmap(
+          NULL,
+          2 * bytes,
+          PROT_NONE,
+          MAP_PRIVATE | MAP_ANONYMOUS,
+          -1,
+          0)) != MAP_FAILED,
       goto done);
 
-  su_specttuner_update_channel_filter(owner, channel);
+  SU_TRYCATCH(
+      mmap(
+          addr,
+          bytes,
+          PROT_READ | PROT_WRITE,
+          MAP_SHARED | MAP_FIXED,
+          fd,
+          0) != MAP_FAILED,
+      goto done);
+
+  SU_TRYCATCH(
+      mmap(
+          addr + bytes,
+          bytes,
+          PROT_READ | PROT_WRITE,
+          MAP_SHARED | MAP_FIXED,
+          fd,
+          0) != MAP_FAILED,
+      goto done);
+
+  ring->buffer = (SUCOMPLEX *) addr;
+  ring->mirrored = SU_TRUE;
+  addr = MAP_FAILED;
 
   ok = SU_TRUE;
+
 done:
+  if (addr != MAP_FAILED)
+    munmap(addr, 2 * bytes);
+
+  if (fd != -1)
+    close(fd);
 
   return ok;
 }
+#endif /* MFD_CLOEXEC */
+
+SUPRIVATE struct sigutils_specttuner_ring *
+su_specttuner_ring_new(SUSCOUNT size, SUBOOL mirrored)
+{
+  struct sigutils_specttuner_ring *new = NULL;
+  SUSCOUNT n = 1;
+  SUSCOUNT min_size = size;
+
+  SU_TRYCATCH(
+      new = calloc(1, sizeof(struct sigutils_specttuner_ring)),
+      goto fail);
+
+  /* Mirrored rings must span whole pages */
+  if (mirrored && min_size * sizeof(SUCOMPLEX) < (SUSCOUNT) getpagesize())
+    min_size = getpagesize() / sizeof(SUCOMPLEX);
+
+  while (n < min_size)
+    n <<= 1;
+
+  new->size = n;
+
+#ifdef MFD_CLOEXEC
+  if (mirrored && !su_specttuner_ring_map_mirrored(new))
+    SU_WARNING("Cannot map mirrored ring, falling back to plain memory\n");
+#else
+  if (mirrored)
+    SU_WARNING("Mirrored rings not supported, falling back to plain memory\n");
+#endif /* MFD_CLOEXEC */
+
+  if (!new->mirrored)
+    SU_TRYCATCH(new->buffer = malloc(n * sizeof(SUCOMPLEX)), goto fail);
+
+  return new;
+
+fail:
+  if (new != NULL)
+    su_specttuner_ring_destroy(new);
+
+  return NULL;
+}
+
+/* Producer side. Called from the thread processing the channel */
+SUPRIVATE void
+su_specttuner_ring_write(
+    struct sigutils_specttuner_ring *ring,
+    const SUCOMPLEX *data,
+    SUSCOUNT size)
+{
+  SUSCOUNT head = ring->head;
+  SUSCOUNT tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  SUSCOUNT avail = ring->size - (head - tail);
+  SUSCOUNT p = head & (ring->size - 1);
+  SUSCOUNT chunk;
+
+  if (size > avail) {
+    __atomic_add_fetch(&ring->overruns, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&ring->dropped, size - avail, __ATOMIC_RELAXED);
+    size = avail;
+  }
+
+  if (ring->mirrored) {
+    memcpy(ring->buffer + p, data, size * sizeof(SUCOMPLEX));
+  } else {
+    chunk = ring->size - p;
+    if (chunk > size)
+      chunk = size;
+
+    memcpy(ring->buffer + p, data, chunk * sizeof(SUCOMPLEX));
+    memcpy(ring->buffer, data + chunk, (size - chunk) * sizeof(SUCOMPLEX));
+  }
+
+  __atomic_store_n(&ring->head, head + size, __ATOMIC_RELEASE);
+}
+
+SUSCOUNT
+su_specttuner_channel_peek(
+    const su_specttuner_channel_t *channel,
+    const SUCOMPLEX **data)
+{
+  const struct sigutils_specttuner_ring *ring = channel->ring;
+  SUSCOUNT head, tail, avail, p;
+
+  SU_TRYCATCH(ring != NULL, return 0);
+
+  head  = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  tail  = ring->tail;
+  avail = head - tail;
+  p     = tail & (ring->size - 1);
+
+  if (!ring->mirrored && p + avail > ring->size)
+    avail = ring->size - p;
+
+  *data = ring->buffer + p;
+
+  return avail;
+}
+
+void
+su_specttuner_channel_advance(
+    su_specttuner_channel_t *channel,
+    SUSCOUNT size)
+{
+  struct sigutils_specttuner_ring *ring = channel->ring;
+  SUSCOUNT head;
+
+  SU_TRYCATCH(ring != NULL, return);
+
+  head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+  if (size > head - ring->tail)
+    size = head - ring->tail;
+
+  __atomic_store_n(&ring->tail, ring->tail + size, __ATOMIC_RELEASE);
+}
+
+SUSCOUNT
+su_specttuner_channel_get_overruns(const su_specttuner_channel_t *channel)
+{
+  if (channel->ring == NULL)
+    return 0;
+
+  return __atomic_load_n(&channel->ring->overruns, __ATOMIC_RELAXED);
+}
+
+SUSCOUNT
+su_specttuner_channel_get_dropped(const su_specttuner_channel_t *channel)
+{
+  if (channel->ring == NULL)
+    return 0;
+
+  return __atomic_load_n(&channel->ring->dropped, __ATOMIC_RELAXED);
+}
+
+SUPRIVATE void
+su_specttuner_channel_destroy(su_specttuner_channel_t *channel)
+{
+  if (channel->plan != NULL)
+    su_fft_plan_release(channel->plan);
+
+  if (channel->ifft[SU_SPECTTUNER_STATE_EVEN] != NULL)
+    SU_FFTW(_free) (channel->ifft[SU_SPECTTUNER_STATE_EVEN]);
+
+  if (channel->ifft[SU_SPECTTUNER_STATE_ODD] != NULL)
+    SU_FFTW(_free) (channel->ifft[SU_SPECTTUNER_STATE_ODD]);
+
+  if (channel->fft != NULL)
+    SU_FFTW(_free) (channel->fft);
+
+  if (channel->window != NULL)
+    SU_FFTW(_free) (channel->window);
+
+  if (channel->filter != NULL)
+    su_specttuner_filter_release(channel->filter);
+
+  if (channel->ring != NULL)
+    su_specttuner_ring_destroy(channel->ring);
+
+  free(channel);
+}
 
 void
 su_specttuner_set_channel_freq(
@@ -145,7 +471,6 @@ su_specttuner_set_channel_freq(
     SUFLOAT f0)
 {
   unsigned int window_size = st->params.window_size;
-  su_ncqo_t lo = su_ncqo_INITIALIZER;
   SUFLOAT off;
 
   channel->params.f0 = f0;
@@ -159,20 +484,19 @@ su_specttuner_set_channel_freq(
   if (channel->params.precise) {
     off = channel->center * (2 * PI) / (SUFLOAT) window_size - f0;
     off *= channel->decimation;
-    su_ncqo_init_fixed(&channel->lo, SU_ANG2NORM_FREQ(off));
+    su_mixer_set_freq(&channel->lo, SU_ANG2NORM_FREQ(off));
   }
 }
 
-SUBOOL
-su_specttuner_set_channel_bandwidth(
+/* Returns the number of bins to copy for a given bandwidth, 0 if invalid */
+SUPRIVATE unsigned int
+su_specttuner_channel_bw_to_width(
     const su_specttuner_t *st,
-    su_specttuner_channel_t *channel,
+    const su_specttuner_channel_t *channel,
     SUFLOAT bw)
 {
   SUFLOAT k;
-  unsigned int min_size;
   unsigned int width;
-
   unsigned int window_size = st->params.window_size;
 
   if (bw > 2 * PI)
@@ -190,13 +514,64 @@ su_specttuner_set_channel_bandwidth(
   if (width > window_size)
     width = window_size;
 
-  SU_TRYCATCH(width <= channel->size, return SU_FALSE);
-  SU_TRYCATCH(width > 1, return SU_FALSE);
+  SU_TRYCATCH(width <= channel->size, return 0);
+  SU_TRYCATCH(width > 1, return 0);
+
+  return width;
+}
+
+/*
+ * Sets the channel width. If the filter changes, filter must be the one
+ * matching the new width. Returns the filter that is no longer needed by
+ * the channel (if any), which must be released by the caller.
+ */
+SUINLINE struct sigutils_specttuner_filter *
+__su_specttuner_channel_set_width(
+    su_specttuner_channel_t *channel,
+    unsigned int width,
+    struct sigutils_specttuner_filter *filter)
+{
+  struct sigutils_specttuner_filter *unused = filter;
+
+  if ((width >> 1) != channel->halfw) {
+    unused = channel->filter;
+    channel->filter = filter;
+
+    /* Bins outside the new width must not leak into the output */
+    memset(channel->fft, 0, channel->size * sizeof(SU_FFTW(_complex)));
+  }
 
   channel->width  = width;
   channel->halfw  = channel->width >> 1;
 
-  su_specttuner_update_channel_filter(st, channel);
+  return unused;
+}
+
+SUBOOL
+su_specttuner_set_channel_bandwidth(
+    const su_specttuner_t *st,
+    su_specttuner_channel_t *channel,
+    SUFLOAT bw)
+{
+  unsigned int width;
+  struct sigutils_specttuner_filter *filter = NULL;
+
+  SU_TRYCATCH(
+      width = su_specttuner_channel_bw_to_width(st, channel, bw),
+      return SU_FALSE);
+
+  if ((width >> 1) != channel->halfw)
+    SU_TRYCATCH(
+        filter = su_specttuner_filter_acquire(
+            st->params.window_size,
+            width >> 1,
+            channel->k),
+        return SU_FALSE);
+
+  filter = __su_specttuner_channel_set_width(channel, width, filter);
+
+  if (filter != NULL)
+    su_specttuner_filter_release(filter);
 
   return SU_TRUE;
 }
@@ -217,6 +592,7 @@ su_specttuner_channel_new(
   SUBOOL  full_spectrum = SU_FALSE;
   SU_TRYCATCH(params->guard >= 1, goto fail);
   SU_TRYCATCH(params->bw > 0, goto fail);
+  SU_TRYCATCH(params->on_data != NULL || params->ring_size > 0, goto fail);
   SU_TRYCATCH(params->f0 >= 0 && params->f0 < 2 * PI, goto fail);
 
   corrbw = params->bw;
@@ -281,7 +657,7 @@ su_specttuner_channel_new(
   if (params->precise) {
     off = new->center * (2 * PI) / (SUFLOAT) window_size - params->f0;
     off *= new->decimation;
-    su_ncqo_init_fixed(&new->lo, SU_ANG2NORM_FREQ(off));
+    su_mixer_init(&new->lo, SU_ANG2NORM_FREQ(off));
   }
 
   new->halfsz = new->size >> 1;
@@ -300,11 +676,12 @@ su_specttuner_channel_new(
       goto fail);
 
   SU_TRYCATCH(
-      new->h     = SU_FFTW(_malloc)(window_size * sizeof(SU_FFTW(_complex))),
+      new->filter = su_specttuner_filter_acquire(
+          window_size,
+          new->halfw,
+          new->k),
       goto fail);
 
-  SU_TRYCATCH(su_specttuner_init_filter_response(owner, new), goto fail);
-
   /*
    * Squared cosine window. Seems odd, right? Well, it turns out that
    * since we are storing the square of half a cycle, when we add the
@@ -352,25 +729,21 @@ su_specttuner_channel_new(
       0,
       new->size * sizeof(SU_FFTW(_complex)));
 
-  SU_TRYCATCH(
-      new->plan[SU_SPECTTUNER_STATE_EVEN] =
-          SU_FFTW(_plan_dft_1d)(
-              new->size,
-              new->fft,
-              new->ifft[SU_SPECTTUNER_STATE_EVEN],
-              FFTW_BACKWARD,
-              FFTW_ESTIMATE),
-          goto fail);
+  if (params->ring_size > 0)
+    SU_TRYCATCH(
+        new->ring = su_specttuner_ring_new(
+            params->ring_size,
+            params->ring_mmap),
+        goto fail);
 
+  /* Both IFFT buffers share placement and alignment: one plan suffices */
   SU_TRYCATCH(
-      new->plan[SU_SPECTTUNER_STATE_ODD] =
-          SU_FFTW(_plan_dft_1d)(
-              new->size,
-              new->fft,
-              new->ifft[SU_SPECTTUNER_STATE_ODD],
-              FFTW_BACKWARD,
-              FFTW_ESTIMATE),
-          goto fail);
+      new->plan = su_fft_plan_acquire(
+          new->size,
+          FFTW_BACKWARD,
+          new->fft,
+          new->ifft[SU_SPECTTUNER_STATE_EVEN]),
+      goto fail);
 
   return new;
 
@@ -381,37 +754,356 @@ fail:
   return NULL;
 }
 
-void
-su_specttuner_destroy(su_specttuner_t *st)
-{
-  unsigned int i;
+/**************************** Asynchronous requests ***************************/
+enum sigutils_specttuner_request_type {
+  SU_SPECTTUNER_REQUEST_OPEN,
+  SU_SPECTTUNER_REQUEST_CLOSE,
+  SU_SPECTTUNER_REQUEST_SET_FREQ,
+  SU_SPECTTUNER_REQUEST_SET_BANDWIDTH,
+};
 
-  for (i = 0; i < st->channel_count; ++i)
-    if (st->channel_list[i] != NULL)
-      su_specttuner_close_channel(st, st->channel_list[i]);
+struct sigutils_specttuner_request {
+  enum sigutils_specttuner_request_type type;
+  su_specttuner_channel_t *channel;
+  SUFLOAT f0;           /* SET_FREQ */
+  unsigned int width;   /* SET_BANDWIDTH */
 
-  if (st->channel_list != NULL)
-    free(st->channel_list);
+  /*
+   * SET_BANDWIDTH: filter for the new width, acquired by the requester.
+   * Once applied, the filter the channel no longer uses.
+   */
+  struct sigutils_specttuner_filter *filter;
 
-  if (st->plans[SU_SPECTTUNER_STATE_EVEN] != NULL)
-    SU_FFTW(_destroy_plan) (st->plans[SU_SPECTTUNER_STATE_EVEN]);
+  /*
+   * OPEN: channel list of list_size entries, allocated by the requester
+   * in case the current one is full. Once applied, the list the tuner no
+   * longer uses (if any).
+   */
+  su_specttuner_channel_t **list;
+  unsigned int list_size;
+
+  struct sigutils_specttuner_request *next;
+};
+
+/* Pushes the chain first -> ... -> last to a request stack */
+SUINLINE void
+su_specttuner_request_push(
+    struct sigutils_specttuner_request **stack,
+    struct sigutils_specttuner_request *first,
+    struct sigutils_specttuner_request *last)
+{
+  last->next = __atomic_load_n(stack, __ATOMIC_RELAXED);
+
+  while (!__atomic_compare_exchange_n(
+      stack,
+      &last->next,
+      first,
+      SU_TRUE,
+      __ATOMIC_RELEASE,
+      __ATOMIC_RELAXED));
+}
 
-  if (st->plans[SU_SPECTTUNER_STATE_ODD] != NULL)
-    SU_FFTW(_destroy_plan) (st->plans[SU_SPECTTUNER_STATE_ODD]);
+/* Takes the whole stack, in the order it was pushed */
+SUINLINE struct sigutils_specttuner_request *
+su_specttuner_request_take_all(struct sigutils_specttuner_request **stack)
+{
+  struct sigutils_specttuner_request *list, *fifo = NULL, *next;
 
-  if (st->fft != NULL)
-    SU_FFTW(_free) (st->fft);
+  if (__atomic_load_n(stack, __ATOMIC_RELAXED) == NULL)
+    return NULL;
 
-  if (st->window != NULL)
-    SU_FFTW(_free) (st->window);
+  list = __atomic_exchange_n(stack, NULL, __ATOMIC_ACQUIRE);
 
-  free(st);
+  while (list != NULL) {
+    next = list->next;
+    list->next = fifo;
+    fifo = list;
+    list = next;
+  }
+
+  return fifo;
 }
 
-su_specttuner_t *
-su_specttuner_new(const struct sigutils_specttuner_params *params)
+/*
+ * Puts a channel in the first free slot of the channel list. Never
+ * allocates: returns -1 if the list is full.
+ */
+SUPRIVATE int
+su_specttuner_insert_channel(
+    su_specttuner_t *st,
+    su_specttuner_channel_t *channel)
 {
-  su_specttuner_t *new = NULL;
+  unsigned int i;
+
+  for (i = 0; i < st->channel_count; ++i)
+    if (st->channel_list[i] == NULL)
+      break;
+
+  if (i == st->channel_count) {
+    if (st->channel_count == st->channel_alloc)
+      return -1;
+
+    /* Read by requesters to size their lists */
+    __atomic_store_n(&st->channel_count, i + 1, __ATOMIC_SEQ_CST);
+  }
+
+  st->channel_list[i] = channel;
+  channel->index = i;
+  ++st->count;
+
+  return i;
+}
+
+/* Runs in the feeding thread. Must neither block nor allocate */
+SUPRIVATE void
+su_specttuner_apply_request(
+    su_specttuner_t *st,
+    struct sigutils_specttuner_request *req)
+{
+  su_specttuner_channel_t *channel = req->channel;
+  su_specttuner_channel_t **old;
+  int index;
+
+  switch (req->type) {
+    case SU_SPECTTUNER_REQUEST_OPEN:
+      /*
+       * Move to a larger list provided by the requester right away, even
+       * if there is room left: other pending opens may rely on it.
+       */
+      if (req->list != NULL && req->list_size > st->channel_alloc) {
+        memcpy(
+            req->list,
+            st->channel_list,
+            st->channel_count * sizeof(su_specttuner_channel_t *));
+
+        old = st->channel_list;
+        st->channel_list = req->list;
+        req->list = old;
+
+        __atomic_store_n(&st->channel_alloc, req->list_size, __ATOMIC_SEQ_CST);
+      }
+
+      index = su_specttuner_insert_channel(st, channel);
+
+      /* Only after the channel count is up to date */
+      __atomic_sub_fetch(&st->opening, 1, __ATOMIC_SEQ_CST);
+
+      if (index == -1)
+        SU_WARNING("Cannot append channel, it will remain idle\n");
+      break;
+
+    case SU_SPECTTUNER_REQUEST_CLOSE:
+      /* Destroyed when collected */
+      if (channel->index >= 0) {
+        st->channel_list[channel->index] = NULL;
+        channel->index = -1;
+        --st->count;
+      }
+      break;
+
+    case SU_SPECTTUNER_REQUEST_SET_FREQ:
+      su_specttuner_set_channel_freq(st, channel, req->f0);
+      break;
+
+    case SU_SPECTTUNER_REQUEST_SET_BANDWIDTH:
+      req->filter = __su_specttuner_channel_set_width(
+          channel,
+          req->width,
+          req->filter);
+      break;
+  }
+}
+
+SUPRIVATE void
+su_specttuner_apply_requests(su_specttuner_t *st)
+{
+  struct sigutils_specttuner_request *list, *last;
+
+  if ((list = su_specttuner_request_take_all(&st->pending)) == NULL)
+    return;
+
+  for (last = list; ; last = last->next) {
+    su_specttuner_apply_request(st, last);
+    if (last->next == NULL)
+      break;
+  }
+
+  su_specttuner_request_push(&st->done, list, last);
+}
+
+SUPRIVATE void
+su_specttuner_request_destroy(struct sigutils_specttuner_request *req)
+{
+  if (req->filter != NULL)
+    su_specttuner_filter_release(req->filter);
+
+  if (req->list != NULL)
+    free(req->list);
+
+  free(req);
+}
+
+void
+su_specttuner_collect_requests(su_specttuner_t *st)
+{
+  struct sigutils_specttuner_request *list, *next;
+
+  list = su_specttuner_request_take_all(&st->done);
+
+  while (list != NULL) {
+    next = list->next;
+
+    if (list->type == SU_SPECTTUNER_REQUEST_CLOSE)
+      su_specttuner_channel_destroy(list->channel);
+
+    su_specttuner_request_destroy(list);
+    list = next;
+  }
+}
+
+SUPRIVATE struct sigutils_specttuner_request *
+su_specttuner_request_new(
+    enum sigutils_specttuner_request_type type,
+    su_specttuner_channel_t *channel)
+{
+  struct sigutils_specttuner_request *new = NULL;
+
+  SU_TRYCATCH(
+      new = calloc(1, sizeof(struct sigutils_specttuner_request)),
+      return NULL);
+
+  new->type = type;
+  new->channel = channel;
+
+  return new;
+}
+
+SUPRIVATE void
+su_specttuner_pool_finalize(su_specttuner_t *st)
+{
+  unsigned int i;
+
+  if (!st->pool_init)
+    return;
+
+  pthread_mutex_lock(&st->pool_mutex);
+  st->pool_halt = SU_TRUE;
+  pthread_cond_broadcast(&st->pool_go_cond);
+  pthread_mutex_unlock(&st->pool_mutex);
+
+  for (i = 1; i < st->threads; ++i)
+    if (st->worker_list[i].thread_running)
+      pthread_join(st->worker_list[i].thread, NULL);
+
+  pthread_cond_destroy(&st->pool_done_cond);
+  pthread_cond_destroy(&st->pool_go_cond);
+  pthread_mutex_destroy(&st->pool_mutex);
+
+  st->pool_init = SU_FALSE;
+}
+
+void
+su_specttuner_destroy(su_specttuner_t *st)
+{
+  unsigned int i;
+
+  su_specttuner_pool_finalize(st);
+
+  /* Nobody is feeding now: flush requests and free their resources */
+  su_specttuner_apply_requests(st);
+  su_specttuner_collect_requests(st);
+
+  if (st->worker_list != NULL)
+    free(st->worker_list);
+
+  for (i = 0; i < st->channel_count; ++i)
+    if (st->channel_list[i] != NULL)
+      su_specttuner_close_channel(st, st->channel_list[i]);
+
+  if (st->channel_list != NULL)
+    free(st->channel_list);
+
+  if (st->plans[SU_SPECTTUNER_STATE_EVEN] != NULL)
+    su_fft_plan_release(st->plans[SU_SPECTTUNER_STATE_EVEN]);
+
+  if (st->plans[SU_SPECTTUNER_STATE_ODD] != NULL)
+    su_fft_plan_release(st->plans[SU_SPECTTUNER_STATE_ODD]);
+
+  if (st->batch_plan != NULL)
+    su_fft_plan_release(st->batch_plan);
+
+  if (st->batch_in != NULL)
+    SU_FFTW(_free) (st->batch_in);
+
+  if (st->batch_out != NULL)
+    SU_FFTW(_free) (st->batch_out);
+
+  if (st->fft != NULL)
+    SU_FFTW(_free) (st->fft);
+
+  if (st->window != NULL)
+    SU_FFTW(_free) (st->window);
+
+  if (st->window_real != NULL)
+    SU_FFTW(_free) (st->window_real);
+
+  free(st);
+}
+
+SUPRIVATE void *su_specttuner_worker_thread(void *data);
+
+SUPRIVATE SUBOOL
+su_specttuner_pool_init(su_specttuner_t *st)
+{
+  unsigned int i;
+
+  SU_TRYCATCH(
+      st->worker_list = calloc(
+          st->threads,
+          sizeof(struct sigutils_specttuner_worker)),
+      return SU_FALSE);
+
+  for (i = 0; i < st->threads; ++i) {
+    st->worker_list[i].owner = st;
+    st->worker_list[i].id = i;
+  }
+
+  SU_TRYCATCH(pthread_mutex_init(&st->pool_mutex, NULL) == 0, return SU_FALSE);
+
+  if (pthread_cond_init(&st->pool_go_cond, NULL) != 0) {
+    pthread_mutex_destroy(&st->pool_mutex);
+    SU_ERROR("Failed to initialize worker pool condition\n");
+    return SU_FALSE;
+  }
+
+  if (pthread_cond_init(&st->pool_done_cond, NULL) != 0) {
+    pthread_cond_destroy(&st->pool_go_cond);
+    pthread_mutex_destroy(&st->pool_mutex);
+    SU_ERROR("Failed to initialize worker pool condition\n");
+    return SU_FALSE;
+  }
+
+  st->pool_init = SU_TRUE;
+
+  /* Worker 0 is the feeding thread itself */
+  for (i = 1; i < st->threads; ++i) {
+    SU_TRYCATCH(
+        pthread_create(
+            &st->worker_list[i].thread,
+            NULL,
+            su_specttuner_worker_thread,
+            st->worker_list + i) == 0,
+        return SU_FALSE);
+    st->worker_list[i].thread_running = SU_TRUE;
+  }
+
+  return SU_TRUE;
+}
+
+su_specttuner_t *
+su_specttuner_new(const struct sigutils_specttuner_params *params)
+{
+  su_specttuner_t *new = NULL;
 
   SU_TRYCATCH((params->window_size & 1) == 0, goto fail);
 
@@ -421,37 +1113,89 @@ su_specttuner_new(const struct sigutils_specttuner_params *params)
   new->half_size = params->window_size >> 1;
   new->full_size = 3 * params->window_size;
 
-  /* Window is 3/2 the FFT size */
-  SU_TRYCATCH(
-      new->window = SU_FFTW(_malloc(
-          new->full_size * sizeof(SU_FFTW(_complex)))),
-      goto fail);
-
   /* FFT is the size provided by params */
   SU_TRYCATCH(
       new->fft = SU_FFTW(_malloc(
           params->window_size * sizeof(SU_FFTW(_complex)))),
       goto fail);
 
-  /* Even plan starts at the beginning of the window */
-  SU_TRYCATCH(
-      new->plans[SU_SPECTTUNER_STATE_EVEN] = SU_FFTW(_plan_dft_1d)(
-          params->window_size,
-          new->window,
-          new->fft,
-          FFTW_FORWARD,
-          FFTW_ESTIMATE),
-      goto fail);
+  if (params->real) {
+    /* Window is 3/2 the FFT size */
+    SU_TRYCATCH(
+        new->window_real = SU_FFTW(_malloc(
+            new->full_size * sizeof(SUFLOAT))),
+        goto fail);
+
+    /* Even and odd plans, as below */
+    SU_TRYCATCH(
+        new->plans[SU_SPECTTUNER_STATE_EVEN] = su_fft_plan_acquire_r2c(
+            params->window_size,
+            new->window_real,
+            new->fft),
+        goto fail);
+
+    SU_TRYCATCH(
+        new->plans[SU_SPECTTUNER_STATE_ODD] = su_fft_plan_acquire_r2c(
+            params->window_size,
+            new->window_real + new->half_size,
+            new->fft),
+        goto fail);
+  } else {
+    /* Window is 3/2 the FFT size */
+    SU_TRYCATCH(
+        new->window = SU_FFTW(_malloc(
+            new->full_size * sizeof(SU_FFTW(_complex)))),
+        goto fail);
+
+    /* Even plan starts at the beginning of the window */
+    SU_TRYCATCH(
+        new->plans[SU_SPECTTUNER_STATE_EVEN] = su_fft_plan_acquire(
+            params->window_size,
+            FFTW_FORWARD,
+            new->window,
+            new->fft),
+        goto fail);
+
+    /* Odd plan stars at window_size / 2 */
+    SU_TRYCATCH(
+        new->plans[SU_SPECTTUNER_STATE_ODD] = su_fft_plan_acquire(
+            params->window_size,
+            FFTW_FORWARD,
+            new->window + new->half_size,
+            new->fft),
+        goto fail);
+  }
 
-  /* Odd plan stars at window_size / 2 */
-  SU_TRYCATCH(
-      new->plans[SU_SPECTTUNER_STATE_ODD] = SU_FFTW(_plan_dft_1d)(
-          params->window_size,
-          new->window + new->half_size,
-          new->fft,
-          FFTW_FORWARD,
-          FFTW_ESTIMATE),
-      goto fail);
+  /* Batch buffers: params->batch windows, one after another */
+  if (params->batch > 1 && !params->real) {
+    SU_TRYCATCH(
+        new->batch_in = SU_FFTW(_malloc(
+            params->batch
+            * params->window_size
+            * sizeof(SU_FFTW(_complex)))),
+        goto fail);
+
+    SU_TRYCATCH(
+        new->batch_out = SU_FFTW(_malloc(
+            params->batch
+            * params->window_size
+            * sizeof(SU_FFTW(_complex)))),
+        goto fail);
+
+    SU_TRYCATCH(
+        new->batch_plan = su_fft_plan_acquire_many(
+            params->window_size,
+            params->batch,
+            FFTW_FORWARD,
+            new->batch_in,
+            new->batch_out),
+        goto fail);
+  }
+
+  /* Worker pool, only if parallel processing was requested */
+  new->threads = params->threads > 1 ? params->threads : 1;
+  if (new->threads > 1)
+    SU_TRYCATCH(su_specttuner_pool_init(new), goto fail);
 
   return new;
 
@@ -462,11 +1206,17 @@ fail:
   return NULL;
 }
 
+/*
+ * Copies samples to the window, regardless of the sample type (elsize is
+ * the size of a sample in bytes). Returns the number of samples copied.
+ */
 SUINLINE SUSCOUNT
-__su_specttuner_feed_bulk(
+__su_specttuner_fill_window(
     su_specttuner_t *st,
-    const SUCOMPLEX *buf,
-    SUSCOUNT size)
+    char *window,
+    const void *buf,
+    SUSCOUNT size,
+    size_t elsize)
 {
   SUSDIFF halfsz;
   SUSDIFF p;
@@ -478,12 +1228,12 @@ __su_specttuner_feed_bulk(
   {
     case SU_SPECTTUNER_STATE_EVEN:
       /* Just copy at the beginning */
-      memcpy(st->window + st->p, buf, size * sizeof(SUCOMPLEX));
+      memcpy(window + st->p * elsize, buf, size * elsize);
       break;
 
     case SU_SPECTTUNER_STATE_ODD:
       /* Copy to the second third */
-      memcpy(st->window + st->p + st->half_size, buf, size * sizeof(SUCOMPLEX));
+      memcpy(window + (st->p + st->half_size) * elsize, buf, size * elsize);
 
       /* Did this copy populate the last third? */
       if (st->p + size > st->half_size) {
@@ -496,19 +1246,48 @@ __su_specttuner_feed_bulk(
         /* Copy to the first third */
         if (halfsz > 0)
           memcpy(
-              st->window + p - st->half_size,
-              st->window + p + st->half_size,
-              halfsz * sizeof(SUCOMPLEX));
+              window + (p - st->half_size) * elsize,
+              window + (p + st->half_size) * elsize,
+              halfsz * elsize);
       }
   }
 
   st->p += size;
 
+  return size;
+}
+
+/* Returns true if the window is full and must be transformed */
+SUINLINE SUBOOL
+__su_specttuner_window_full(su_specttuner_t *st)
+{
   if (st->p == st->params.window_size) {
     st->p = st->half_size;
+    return SU_TRUE;
+  }
+
+  return SU_FALSE;
+}
 
+SUINLINE SUSCOUNT
+__su_specttuner_feed_bulk(
+    su_specttuner_t *st,
+    const SUCOMPLEX *buf,
+    SUSCOUNT size)
+{
+  size = __su_specttuner_fill_window(
+      st,
+      (char *) st->window,
+      buf,
+      size,
+      sizeof(SUCOMPLEX));
+
+  if (__su_specttuner_window_full(st)) {
     /* Compute FFT */
-    SU_FFTW(_execute) (st->plans[st->state]);
+    su_fft_plan_execute(
+        st->plans[st->state],
+        st->window + st->state * st->half_size,
+        st->fft);
 
     /* Toggle state */
     st->state = !st->state;
@@ -518,17 +1297,80 @@ __su_specttuner_feed_bulk(
   return size;
 }
 
-SUINLINE SUBOOL
-__su_specttuner_feed_channel(
+SUINLINE SUSCOUNT
+__su_specttuner_feed_bulk_real(
+    su_specttuner_t *st,
+    const SUFLOAT *buf,
+    SUSCOUNT size)
+{
+  size = __su_specttuner_fill_window(
+      st,
+      (char *) st->window_real,
+      buf,
+      size,
+      sizeof(SUFLOAT));
+
+  if (__su_specttuner_window_full(st)) {
+    /* Compute half spectrum */
+    su_fft_plan_execute_r2c(
+        st->plans[st->state],
+        st->window_real + st->state * st->half_size,
+        st->fft);
+
+    /* Toggle state */
+    st->state = !st->state;
+    st->ready = SU_TRUE;
+  }
+
+  return size;
+}
+
+/*
+ * Copies len bins of the input spectrum starting from bin (without
+ * wrapping around). For real input, bins above window_size / 2 are
+ * computed from their Hermitian mirror: X[N - k] = conj(X[k]).
+ */
+SUINLINE void
+__su_specttuner_copy_bins(
+    const su_specttuner_t *st,
+    SUCOMPLEX *dest,
+    int bin,
+    int len)
+{
+  int nyquist = st->half_size;
+  int count;
+  int i;
+
+  if (!st->params.real) {
+    memcpy(dest, st->fft + bin, len * sizeof(SUCOMPLEX));
+    return;
+  }
+
+  if (bin <= nyquist) {
+    count = SU_MIN(len, nyquist + 1 - bin);
+    memcpy(dest, st->fft + bin, count * sizeof(SUCOMPLEX));
+    dest += count;
+    bin  += count;
+    len  -= count;
+  }
+
+  for (i = 0; i < len; ++i)
+    dest[i] = SU_C_CONJ(st->fft[st->params.window_size - bin - i]);
+}
+
+SUINLINE void
+__su_specttuner_process_channel(
     const su_specttuner_t *st,
     su_specttuner_channel_t *channel)
 {
   int p;
   int len;
   int window_size = st->params.window_size;
+#ifdef SU_SPECTTUNER_SQUARE_FILTER
   unsigned int i;
-  SUCOMPLEX phase;
-  SUFLOAT alpha, beta;
+#else
+  const SUCOMPLEX *resp;
+#endif /* SU_SPECTTUNER_SQUARE_FILTER */
   SUCOMPLEX *prev, *curr;
 
   p = channel->center;
@@ -539,17 +1381,15 @@ __su_specttuner_feed_channel(
     len = window_size - p;
 
   /* Copy to the end */
-  memcpy(
-      channel->fft,
-      st->fft + p,
-      len * sizeof(SUCOMPLEX));
+  __su_specttuner_copy_bins(st, channel->fft, p, len);
 
   /* Copy remaining part */
   if (len < channel->halfw)
-    memcpy(
+    __su_specttuner_copy_bins(
+        st,
         channel->fft + len,
-        st->fft,
-        (channel->halfw - len) * sizeof(SUCOMPLEX));
+        0,
+        channel->halfw - len);
 
   /***************************** Lower sideband ******************************/
   len = channel->halfw;
@@ -558,17 +1398,19 @@ __su_specttuner_feed_channel(
 
 
   /* Copy higher frequencies */
-  memcpy(
+  __su_specttuner_copy_bins(
+      st,
       channel->fft + channel->size - len,
-      st->fft + p - len,
-      len * sizeof(SUCOMPLEX));
+      p - len,
+      len);
 
   /* Copy remaining part */
   if (len < channel->halfw)
-    memcpy(
+    __su_specttuner_copy_bins(
+        st,
         channel->fft + channel->size - channel->halfw,
-        st->fft + window_size - (channel->halfw - len),
-        (channel->halfw - len) * sizeof(SUCOMPLEX));
+        window_size - (channel->halfw - len),
+        channel->halfw - len);
 
   /*********************** Apply filter and scaling **************************/
 #ifdef SU_SPECTTUNER_SQUARE_FILTER
@@ -578,47 +1420,150 @@ __su_specttuner_feed_channel(
   for (i = channel->size - channel->halfw; i < channel->size; ++i)
     channel->fft[i] *= channel->k;
 #else
-  for (i = 0; i < channel->halfsz; ++i) {
-    channel->fft[i] *= channel->k * channel->h[i];
-    channel->fft[channel->size - i - 1] *=
-        channel->k * channel->h[window_size - i - 1];
-  }
+  resp = channel->filter->resp;
+  su_simd_cmul(channel->fft, resp, channel->halfw);
+  su_simd_cmul(
+      channel->fft + channel->size - channel->halfw,
+      resp + channel->halfw,
+      channel->halfw);
 #endif
   /************************* Back to time domain******************************/
-  SU_FFTW(_execute) (channel->plan[channel->state]);
+  su_fft_plan_execute(
+      channel->plan,
+      channel->fft,
+      channel->ifft[channel->state]);
 
   curr = channel->ifft[channel->state];
   prev = channel->ifft[!channel->state] + channel->halfsz;
 
-  /* Glue buffers */
-  if (channel->params.precise) {
-    for (i = 0; i < channel->halfsz; ++i) {
-      alpha = channel->window[i]; /* Positive slope */
-      beta  = channel->window[i + channel->halfsz]; /* Negative slope */
-
-      phase = su_ncqo_read(&channel->lo);
+  /* Glue buffers: positive slope on curr, negative slope on prev */
+  su_simd_glue(
+      curr,
+      prev,
+      channel->window,
+      channel->window + channel->halfsz,
+      channel->gain,
+      channel->halfsz);
 
-      curr[i] = channel->gain * phase * (alpha * curr[i] + beta * prev[i]);
-    }
-  } else {
-    for (i = 0; i < channel->halfsz; ++i) {
-      alpha = channel->window[i]; /* Positive slope */
-      beta  = channel->window[i + channel->halfsz]; /* Negative slope */
+  if (channel->params.precise)
+    su_mixer_mix(&channel->lo, curr, curr, channel->halfsz);
 
-      curr[i] = channel->gain * (alpha * curr[i] + beta * prev[i]);
-    }
-  }
+  /* Pull mode channels are delivered right here, from the worker */
+  if (channel->ring != NULL)
+    su_specttuner_ring_write(channel->ring, curr, channel->halfsz);
 
   channel->state = !channel->state;
+}
 
-  /************************** Call user callback *****************************/
+SUINLINE SUBOOL
+__su_specttuner_deliver_channel(
+    const su_specttuner_t *st,
+    su_specttuner_channel_t *channel)
+{
+  /* Pull mode channels were already written to their rings */
+  if (channel->ring != NULL)
+    return SU_TRUE;
+
+  /* Last processed buffer is the one before the state toggle */
   return (channel->params.on_data) (
       channel,
       channel->params.privdata,
-      curr,
+      channel->ifft[!channel->state],
       channel->halfsz);
 }
 
+SUINLINE void
+__su_specttuner_process_worker_channels(
+    const su_specttuner_t *st,
+    unsigned int id)
+{
+  unsigned int i;
+
+  for (i = id; i < st->channel_count; i += st->threads)
+    if (st->channel_list[i] != NULL)
+      __su_specttuner_process_channel(st, st->channel_list[i]);
+}
+
+SUPRIVATE void *
+su_specttuner_worker_thread(void *data)
+{
+  struct sigutils_specttuner_worker *worker =
+      (struct sigutils_specttuner_worker *) data;
+  su_specttuner_t *st = worker->owner;
+  unsigned int epoch = 0;
+
+  pthread_mutex_lock(&st->pool_mutex);
+
+  for (;;) {
+    while (!st->pool_halt && st->pool_epoch == epoch)
+      pthread_cond_wait(&st->pool_go_cond, &st->pool_mutex);
+
+    if (st->pool_halt)
+      break;
+
+    epoch = st->pool_epoch;
+    pthread_mutex_unlock(&st->pool_mutex);
+
+    __su_specttuner_process_worker_channels(st, worker->id);
+
+    pthread_mutex_lock(&st->pool_mutex);
+    if (--st->pool_pending == 0)
+      pthread_cond_signal(&st->pool_done_cond);
+  }
+
+  pthread_mutex_unlock(&st->pool_mutex);
+
+  return NULL;
+}
+
+SUPRIVATE void
+su_specttuner_process_channels_parallel(su_specttuner_t *st)
+{
+  pthread_mutex_lock(&st->pool_mutex);
+  st->pool_pending = st->threads - 1;
+  ++st->pool_epoch;
+  pthread_cond_broadcast(&st->pool_go_cond);
+  pthread_mutex_unlock(&st->pool_mutex);
+
+  /* The feeding thread takes its share too */
+  __su_specttuner_process_worker_channels(st, 0);
+
+  /* Barrier: wait for the rest of the workers before the next window */
+  pthread_mutex_lock(&st->pool_mutex);
+  while (st->pool_pending > 0)
+    pthread_cond_wait(&st->pool_done_cond, &st->pool_mutex);
+  pthread_mutex_unlock(&st->pool_mutex);
+}
+
+SUPRIVATE SUBOOL
+su_specttuner_feed_channels(su_specttuner_t *st)
+{
+  SUBOOL ok = SU_TRUE;
+  unsigned int i;
+
+  /* Window boundary: apply channel changes requested by other threads */
+  su_specttuner_apply_requests(st);
+
+  if (st->on_spectrum != NULL)
+    ok = (st->on_spectrum)(st, st->spectrum_privdata, st->fft);
+
+  if (st->threads > 1 && st->count > 1) {
+    su_specttuner_process_channels_parallel(st);
+
+    for (i = 0; i < st->channel_count; ++i)
+      if (st->channel_list[i] != NULL)
+        ok = __su_specttuner_deliver_channel(st, st->channel_list[i]) && ok;
+  } else {
+    for (i = 0; i < st->channel_count; ++i)
+      if (st->channel_list[i] != NULL) {
+        __su_specttuner_process_channel(st, st->channel_list[i]);
+        ok = __su_specttuner_deliver_channel(st, st->channel_list[i]) && ok;
+      }
+  }
+
+  return ok;
+}
+
 SUSDIFF
 su_specttuner_feed_bulk_single(
     su_specttuner_t *st,
@@ -627,7 +1572,8 @@ su_specttuner_feed_bulk_single(
 {
   SUSDIFF got;
   SUSCOUNT ok = SU_TRUE;
-  unsigned int i;
+
+  SU_TRYCATCH(!st->params.real, return -1);
 
   if (st->ready)
     return 0;
@@ -636,13 +1582,72 @@ su_specttuner_feed_bulk_single(
 
   /* Buffer full, feed channels */
   if (st->ready)
-    for (i = 0; i < st->channel_count; ++i)
-      if (st->channel_list[i] != NULL)
-        ok = __su_specttuner_feed_channel(st, st->channel_list[i]) && ok;
+    ok = su_specttuner_feed_channels(st);
 
   return ok ? got : -1;
 }
 
+/*
+ * A full batch can be processed only at a window boundary (the first half
+ * of the next window is already in place) and if there are enough samples
+ * to complete every window of the batch.
+ */
+SUINLINE SUBOOL
+su_specttuner_can_batch(const su_specttuner_t *st, SUSCOUNT size)
+{
+  return st->batch_plan != NULL
+      && !st->ready
+      && st->p == st->half_size
+      && size >= st->params.batch * st->half_size;
+}
+
+SUPRIVATE SUSCOUNT
+su_specttuner_feed_batch(
+    su_specttuner_t *st,
+    const SUCOMPLEX *buf,
+    SUBOOL *ok)
+{
+  unsigned int window_size = st->params.window_size;
+  unsigned int half_size = st->half_size;
+  unsigned int batch = st->params.batch;
+  SU_FFTW(_complex) *prev;
+  unsigned int i;
+
+  /*
+   * Window i spans input samples [(i - 1) * half, (i + 1) * half). The
+   * first one starts with the half window retained from previous calls.
+   */
+  prev = st->window + st->state * half_size;
+  memcpy(st->batch_in, prev, half_size * sizeof(SUCOMPLEX));
+  memcpy(st->batch_in + half_size, buf, half_size * sizeof(SUCOMPLEX));
+
+  for (i = 1; i < batch; ++i)
+    memcpy(
+        st->batch_in + i * window_size,
+        buf + (i - 1) * half_size,
+        window_size * sizeof(SUCOMPLEX));
+
+  su_fft_plan_execute(st->batch_plan, st->batch_in, st->batch_out);
+
+  for (i = 0; i < batch; ++i) {
+    memcpy(
+        st->fft,
+        st->batch_out + i * window_size,
+        window_size * sizeof(SUCOMPLEX));
+
+    st->state = !st->state;
+    *ok = su_specttuner_feed_channels(st) && *ok;
+  }
+
+  /* Retain the last half window where the next window expects it */
+  memcpy(
+      st->window + st->state * half_size,
+      buf + (batch - 1) * half_size,
+      half_size * sizeof(SUCOMPLEX));
+
+  return batch * half_size;
+}
+
 SUBOOL
 su_specttuner_feed_bulk(
     su_specttuner_t *st,
@@ -652,7 +1657,16 @@ su_specttuner_feed_bulk(
   SUSDIFF got;
   SUBOOL ok = SU_TRUE;
 
+  SU_TRYCATCH(!st->params.real, return SU_FALSE);
+
   while (size > 0) {
+    if (su_specttuner_can_batch(st, size)) {
+      got = su_specttuner_feed_batch(st, buf, &ok);
+      buf += got;
+      size -= got;
+      continue;
+    }
+
     got = su_specttuner_feed_bulk_single(st, buf, size);
 
     if (su_specttuner_new_data(st))
@@ -668,23 +1682,108 @@ su_specttuner_feed_bulk(
   return ok;
 }
 
+SUSDIFF
+su_specttuner_feed_bulk_single_real(
+    su_specttuner_t *st,
+    const SUFLOAT *buf,
+    SUSCOUNT size)
+{
+  SUSDIFF got;
+  SUSCOUNT ok = SU_TRUE;
+
+  SU_TRYCATCH(st->params.real, return -1);
+
+  if (st->ready)
+    return 0;
+
+  got = __su_specttuner_feed_bulk_real(st, buf, size);
+
+  /* Buffer full, feed channels */
+  if (st->ready)
+    ok = su_specttuner_feed_channels(st);
+
+  return ok ? got : -1;
+}
+
+SUBOOL
+su_specttuner_feed_bulk_real(
+    su_specttuner_t *st,
+    const SUFLOAT *buf,
+    SUSCOUNT size)
+{
+  SUSDIFF got;
+  SUBOOL ok = SU_TRUE;
+
+  SU_TRYCATCH(st->params.real, return SU_FALSE);
+
+  while (size > 0) {
+    got = su_specttuner_feed_bulk_single_real(st, buf, size);
+
+    if (su_specttuner_new_data(st))
+      su_specttuner_ack_data(st);
+
+    if (got == -1)
+      ok = SU_FALSE;
+
+    buf += got;
+    size -= got;
+  }
+
+  return ok;
+}
+
+void
+su_specttuner_set_spectrum_cb(
+    su_specttuner_t *st,
+    su_specttuner_spectrum_cb_t on_spectrum,
+    void *privdata)
+{
+  st->on_spectrum       = on_spectrum;
+  st->spectrum_privdata = privdata;
+}
+
+/* Makes room for at least size channels. Feeding thread only */
+SUPRIVATE SUBOOL
+su_specttuner_grow_channel_list(su_specttuner_t *st, unsigned int size)
+{
+  su_specttuner_channel_t **list;
+
+  if (size <= st->channel_alloc)
+    return SU_TRUE;
+
+  if (size < 2 * st->channel_alloc)
+    size = 2 * st->channel_alloc;
+
+  SU_TRYCATCH(
+      list = realloc(
+          st->channel_list,
+          size * sizeof(su_specttuner_channel_t *)),
+      return SU_FALSE);
+
+  st->channel_list = list;
+  __atomic_store_n(&st->channel_alloc, size, __ATOMIC_SEQ_CST);
+
+  return SU_TRUE;
+}
+
 su_specttuner_channel_t *
 su_specttuner_open_channel(
     su_specttuner_t *st,
     const struct sigutils_specttuner_channel_params *params)
 {
   su_specttuner_channel_t *new = NULL;
-  int index;
 
   SU_TRYCATCH(new = su_specttuner_channel_new(st, params), goto fail);
 
+  /* Keep the room pending asynchronous opens were promised */
   SU_TRYCATCH(
-      (index = PTR_LIST_APPEND_CHECK(st->channel, new)) != -1,
+      su_specttuner_grow_channel_list(
+          st,
+          st->channel_count + 1
+          + __atomic_load_n(&st->opening, __ATOMIC_SEQ_CST)),
       goto fail);
 
-  new->index = index;
-
-  ++st->count;
+  SU_TRYCATCH(su_specttuner_insert_channel(st, new) != -1, goto fail);
 
   return new;
 
@@ -714,3 +1813,140 @@ su_specttuner_close_channel(
 
   return SU_TRUE;
 }
+
+/**************************** Asynchronous API ********************************/
+su_specttuner_channel_t *
+su_specttuner_open_channel_async(
+    su_specttuner_t *st,
+    const struct sigutils_specttuner_channel_params *params)
+{
+  su_specttuner_channel_t *new = NULL;
+  struct sigutils_specttuner_request *req = NULL;
+  unsigned int needed;
+
+  su_specttuner_collect_requests(st);
+
+  SU_TRYCATCH(new = su_specttuner_channel_new(st, params), goto fail);
+  SU_TRYCATCH(
+      req = su_specttuner_request_new(SU_SPECTTUNER_REQUEST_OPEN, new),
+      goto fail);
+
+  /*
+   * The feeding thread must not allocate, so make room here in case the
+   * channel list is full by the time the request is applied. Pending
+   * opens are counted before reading the channel count: whatever the
+   * interleaving, every channel that may be in the list by then is
+   * accounted for.
+   */
+  needed = __atomic_add_fetch(&st->opening, 1, __ATOMIC_SEQ_CST);
+  needed += __atomic_load_n(&st->channel_count, __ATOMIC_SEQ_CST);
+
+  if (needed > __atomic_load_n(&st->channel_alloc, __ATOMIC_SEQ_CST)) {
+    req->list_size = 2 * needed;
+    if ((req->list = malloc(
+        req->list_size * sizeof(su_specttuner_channel_t *))) == NULL) {
+      __atomic_sub_fetch(&st->opening, 1, __ATOMIC_SEQ_CST);
+      SU_ERROR("Cannot allocate channel list\n");
+      goto fail;
+    }
+  }
+
+  su_specttuner_request_push(&st->pending, req, req);
+
+  return new;
+
+fail:
+  if (req != NULL)
+    su_specttuner_request_destroy(req);
+
+  if (new != NULL)
+    su_specttuner_channel_destroy(new);
+
+  return NULL;
+}
+
+SUBOOL
+su_specttuner_set_channel_freq_async(
+    su_specttuner_t *st,
+    su_specttuner_channel_t *channel,
+    SUFLOAT f0)
+{
+  struct sigutils_specttuner_request *req = NULL;
+
+  su_specttuner_collect_requests(st);
+
+  SU_TRYCATCH(!channel->closing, return SU_FALSE);
+  SU_TRYCATCH(
+      req = su_specttuner_request_new(SU_SPECTTUNER_REQUEST_SET_FREQ, channel),
+      return SU_FALSE);
+
+  req->f0 = f0;
+
+  su_specttuner_request_push(&st->pending, req, req);
+
+  return SU_TRUE;
+}
+
+SUBOOL
+su_specttuner_set_channel_bandwidth_async(
+    su_specttuner_t *st,
+    su_specttuner_channel_t *channel,
+    SUFLOAT bw)
+{
+  struct sigutils_specttuner_request *req = NULL;
+
+  su_specttuner_collect_requests(st);
+
+  SU_TRYCATCH(!channel->closing, goto fail);
+  SU_TRYCATCH(
+      req = su_specttuner_request_new(
+          SU_SPECTTUNER_REQUEST_SET_BANDWIDTH,
+          channel),
+      goto fail);
+
+  SU_TRYCATCH(
+      req->width = su_specttuner_channel_bw_to_width(st, channel, bw),
+      goto fail);
+
+  /*
+   * The current width is only known by the feeding thread: acquire the
+   * filter anyway, it is handed back if the channel does not need it.
+   */
+  SU_TRYCATCH(
+      req->filter = su_specttuner_filter_acquire(
+          st->params.window_size,
+          req->width >> 1,
+          channel->k),
+      goto fail);
+
+  su_specttuner_request_push(&st->pending, req, req);
+
+  return SU_TRUE;
+
+fail:
+  if (req != NULL)
+    su_specttuner_request_destroy(req);
+
+  return SU_FALSE;
+}
+
+SUBOOL
+su_specttuner_close_channel_async(
+    su_specttuner_t *st,
+    su_specttuner_channel_t *channel)
+{
+  struct sigutils_specttuner_request *req = NULL;
+
+  su_specttuner_collect_requests(st);
+
+  SU_TRYCATCH(!channel->closing, return SU_FALSE);
+  SU_TRYCATCH(
+      req = su_specttuner_request_new(SU_SPECTTUNER_REQUEST_CLOSE, channel),
+      return SU_FALSE);
+
+  channel->closing = SU_TRUE;
+
+  su_specttuner_request_push(&st->pending, req, req);
+
+  return SU_TRUE;
+}
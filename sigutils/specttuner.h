@@ -21,16 +21,33 @@
 #ifndef _SIGUTILS_SPECTTUNER_H
 #define _SIGUTILS_SPECTTUNER_H
 
+#include <pthread.h>
+
 #include "types.h"
-#include "ncqo.h"
+#include "mixer.h"
+#include "fftplan.h"
 
 struct sigutils_specttuner_params {
   SUSCOUNT window_size;
+  unsigned int threads; /* Channel processing threads (0 or 1: serial) */
+  unsigned int batch;   /* Windows per FFT in feed_bulk (0 or 1: no batch) */
+  SUBOOL real;          /* Real input, use the feed_bulk_real functions */
 };
 
+/*
+ * Batching trades latency for throughput: channels get their output in
+ * bursts of batch windows. It is off by default: offline or bulk
+ * consumers may set batch to SU_SPECTTUNER_THROUGHPUT_BATCH.
+ */
+#define SU_SPECTTUNER_DEFAULT_BATCH    1
+#define SU_SPECTTUNER_THROUGHPUT_BATCH 8
+
 #define sigutils_specttuner_params_INITIALIZER  \
 {                                               \
   4096, /* window_size */                       \
+  0,    /* threads */                           \
+  SU_SPECTTUNER_DEFAULT_BATCH, /* batch */      \
+  SU_FALSE, /* real */                          \
 }
 
 enum sigutils_specttuner_state {
@@ -40,6 +57,19 @@ enum sigutils_specttuner_state {
 
 struct sigutils_specttuner_channel;
 
+/*
+ * Filter responses are shared among channels of the same width and
+ * scaling. Only the 2 * halfw bins actually copied by the channel are
+ * kept (upper sideband first, then lower sideband), already scaled.
+ */
+struct sigutils_specttuner_filter {
+  unsigned int window_size;
+  unsigned int halfw;
+  SUFLOAT k; /* Channel scaling factor */
+  unsigned int refcnt;
+  SU_FFTW(_complex) *resp;
+};
+
 struct sigutils_specttuner_channel_params {
   SUFLOAT f0;       /* Central frequency (angular frequency) */
   SUFLOAT bw;       /* Bandwidth (angular frequency) */
@@ -51,6 +81,8 @@ struct sigutils_specttuner_channel_params {
       void *privdata,
       const SUCOMPLEX *data, /* This pointer remains valid until the next call to feed */
       SUSCOUNT size);
+  SUSCOUNT ring_size; /* Output ring size in samples (0: use on_data) */
+  SUBOOL   ring_mmap; /* Map the ring twice for contiguous reads */
 };
 
 #define sigutils_specttuner_channel_params_INITIALIZER  \
@@ -61,8 +93,30 @@ struct sigutils_specttuner_channel_params {
   SU_FALSE, /* precise */                               \
   NULL,     /* private */                               \
   NULL,     /* on_data */                               \
+  0,        /* ring_size */                             \
+  SU_FALSE, /* ring_mmap */                             \
 }
 
+/*
+ * Pull-mode channel output. Instead of calling on_data, the tuner writes
+ * channel samples into a single-producer, single-consumer ring that a
+ * consumer thread reads with su_specttuner_channel_peek and
+ * su_specttuner_channel_advance. The tuner never blocks: samples that do
+ * not fit in the ring are dropped and accounted as overruns.
+ *
+ * If mirrored, the ring memory is mapped twice back to back, so every
+ * readable region is contiguous regardless of wrap-around.
+ */
+struct sigutils_specttuner_ring {
+  SUCOMPLEX *buffer;
+  SUSCOUNT  size;      /* Power of two */
+  SUBOOL    mirrored;
+  SUSCOUNT  head;      /* Samples written (producer side) */
+  SUSCOUNT  tail;      /* Samples read (consumer side) */
+  SUSCOUNT  overruns;  /* Writes that did not fit */
+  SUSCOUNT  dropped;   /* Samples lost in overruns */
+};
+
 struct sigutils_specttuner_channel {
   struct sigutils_specttuner_channel_params params;
   int index;           /* Back reference */
@@ -70,7 +124,7 @@ struct sigutils_specttuner_channel {
   SUFLOAT k;           /* Scaling factor */
   SUFLOAT gain;        /* Channel gain */
   SUFLOAT decimation;  /* Equivalent decimation */
-  su_ncqo_t lo;        /* Local oscilator to correct imprecise centering */
+  su_mixer_t lo;       /* Local oscillator to correct imprecise centering */
   unsigned int center; /* FFT center bin */
   unsigned int size;   /* FFT bins to allocate */
   unsigned int width;  /* FFT bins to copy (for guard bands, etc) */
@@ -84,13 +138,15 @@ struct sigutils_specttuner_channel {
    */
   enum sigutils_specttuner_state state;
   SU_FFTW(_complex) *fft;      /* Filtered spectrum */
-  SU_FFTW(_complex) *h;        /* Frequency response of filter */
-  SU_FFTW(_plan)     plan[2];  /* Even & Odd plans */
-  SU_FFTW(_plan)     forward;  /* Filter response forward plan */
-  SU_FFTW(_plan)     backward; /* Filter response backward plan */
+  su_fft_plan_t     *plan;     /* Shared backward plan (even & odd) */
+  struct sigutils_specttuner_filter *filter; /* Shared filter response */
 
   SU_FFTW(_complex) *ifft[2];  /* Even & Odd time-domain signal */
   SUFLOAT           *window;   /* Window function */
+
+  struct sigutils_specttuner_ring *ring; /* Only in pull mode */
+
+  SUBOOL closing;      /* Close requested (asynchronous API) */
 };
 
 typedef struct sigutils_specttuner_channel su_specttuner_channel_t;
@@ -114,6 +170,30 @@ su_specttuner_channel_get_f0(const su_specttuner_channel_t *channel)
   return channel->params.f0;
 }
 
+SUINLINE SUBOOL
+su_specttuner_channel_is_pull_mode(const su_specttuner_channel_t *channel)
+{
+  return channel->ring != NULL;
+}
+
+/*
+ * Pull-mode API. These functions may be called from a consumer thread
+ * other than the one feeding the tuner, but only from one.
+ */
+SUSCOUNT su_specttuner_channel_peek(
+    const su_specttuner_channel_t *channel,
+    const SUCOMPLEX **data);
+
+void su_specttuner_channel_advance(
+    su_specttuner_channel_t *channel,
+    SUSCOUNT size);
+
+SUSCOUNT su_specttuner_channel_get_overruns(
+    const su_specttuner_channel_t *channel);
+
+SUSCOUNT su_specttuner_channel_get_dropped(
+    const su_specttuner_channel_t *channel);
+
 /*
  * The spectral tuner leverages its 3/2-sized window buffer by keeping
  * two FFT plans (even & odd) and conditionally saving the same sample
@@ -139,14 +219,60 @@ su_specttuner_channel_get_f0(const su_specttuner_channel_t *channel)
  * odd plan is performed as well as the usual frequency filtering.
  */
 
+/*
+ * When more than one thread is requested, channel processing (bin copy,
+ * filtering, IFFT and glueing) is split among a pool of workers. Channel i
+ * is always processed by worker i % threads, being the feeding thread
+ * worker 0. Once all workers are done with the current window, user
+ * callbacks are called from the feeding thread in channel index order,
+ * exactly as in the serial case.
+ */
+struct sigutils_specttuner;
+
+/*
+ * Spectrum consumer. Called by the feeding thread on every window, after
+ * pending channel requests are applied and before channels are processed,
+ * with the unwindowed spectrum of the last window_size samples (only bins
+ * 0 to window_size / 2 in real mode). Channels may be opened and closed
+ * from here with the synchronous API.
+ */
+typedef SUBOOL (*su_specttuner_spectrum_cb_t) (
+    struct sigutils_specttuner *st,
+    void *privdata,
+    const SUCOMPLEX *fft);
+
+/*
+ * Channel changes requested through the asynchronous API. Requests are
+ * pushed to a lock-free stack by any thread and applied in order by the
+ * feeding thread before processing the next window. Applied requests are
+ * handed back through a second stack, so that everything that may block
+ * (allocation, plan and filter registries) happens outside the feeding
+ * thread.
+ */
+struct sigutils_specttuner_request;
+
+struct sigutils_specttuner_worker {
+  struct sigutils_specttuner *owner;
+  unsigned int id;
+  pthread_t thread;
+  SUBOOL thread_running;
+};
+
 struct sigutils_specttuner {
   struct sigutils_specttuner_params params;
 
   SU_FFTW(_complex) *window; /* 3/2 the space, double allocation trick */
+  SUFLOAT *window_real;      /* Same, for real input */
+
+  /*
+   * In real mode, only bins 0 to window_size / 2 are computed. The
+   * remaining ones are taken from the Hermitian mirror during channel
+   * extraction.
+   */
   SU_FFTW(_complex) *fft;
 
   enum sigutils_specttuner_state state;
-  SU_FFTW(_plan) plans[2]; /* Even and odd plans */
+  su_fft_plan_t *plans[2]; /* Even and odd plans (shared) */
 
   unsigned int half_size; /* 3/2 of window size */
   unsigned int full_size; /* 3/2 of window size */
@@ -156,8 +282,38 @@ struct sigutils_specttuner {
 
   SUBOOL ready; /* FFT ready */
 
-  /* Channel list */
+  /* Spectrum consumer (e.g. a channel detector sharing the FFT) */
+  su_specttuner_spectrum_cb_t on_spectrum;
+  void *spectrum_privdata;
+
+  /*
+   * Batch mode: when feed_bulk receives enough samples, consecutive
+   * (overlapping) windows are laid out contiguously and transformed with
+   * a single plan execution.
+   */
+  SU_FFTW(_complex) *batch_in;
+  SU_FFTW(_complex) *batch_out;
+  su_fft_plan_t *batch_plan;
+
+  /* Worker pool */
+  unsigned int threads;
+  struct sigutils_specttuner_worker *worker_list;
+  pthread_mutex_t pool_mutex;
+  pthread_cond_t  pool_go_cond;
+  pthread_cond_t  pool_done_cond;
+  SUBOOL          pool_init;
+  SUBOOL          pool_halt;
+  unsigned int    pool_epoch;   /* Incremented on every dispatched window */
+  unsigned int    pool_pending; /* Workers still processing the window */
+
+  /* Asynchronous requests */
+  struct sigutils_specttuner_request *pending; /* Not applied yet */
+  struct sigutils_specttuner_request *done;    /* Applied, to be freed */
+  unsigned int opening; /* Open requests not applied yet */
+
+  /* Channel list, with room for channel_alloc entries */
   PTR_LIST(struct sigutils_specttuner_channel, channel);
+  unsigned int channel_alloc;
 };
 
 typedef struct sigutils_specttuner su_specttuner_t;
@@ -195,6 +351,23 @@ SUBOOL su_specttuner_feed_bulk(
     const SUCOMPLEX *buf,
     SUSCOUNT size);
 
+/* Only for tuners created with params.real */
+SUSDIFF su_specttuner_feed_bulk_single_real(
+    su_specttuner_t *st,
+    const SUFLOAT *buf,
+    SUSCOUNT size);
+
+SUBOOL su_specttuner_feed_bulk_real(
+    su_specttuner_t *st,
+    const SUFLOAT *buf,
+    SUSCOUNT size);
+
+/* Replaces the spectrum consumer. NULL removes it. Feeding thread only */
+void su_specttuner_set_spectrum_cb(
+    su_specttuner_t *st,
+    su_specttuner_spectrum_cb_t on_spectrum,
+    void *privdata);
+
 su_specttuner_channel_t *su_specttuner_open_channel(
     su_specttuner_t *st,
     const struct sigutils_specttuner_channel_params *params);
@@ -213,4 +386,38 @@ SUBOOL su_specttuner_close_channel(
     su_specttuner_t *st,
     su_specttuner_channel_t *channel);
 
+/*
+ * Asynchronous channel API. Unlike the functions above, these may be
+ * called from any thread while another one feeds the tuner. Changes take
+ * effect at the next window boundary. A channel must not be used after
+ * requesting its closure.
+ */
+su_specttuner_channel_t *su_specttuner_open_channel_async(
+    su_specttuner_t *st,
+    const struct sigutils_specttuner_channel_params *params);
+
+SUBOOL su_specttuner_set_channel_freq_async(
+    su_specttuner_t *st,
+    su_specttuner_channel_t *channel,
+    SUFLOAT f0);
+
+SUBOOL su_specttuner_set_channel_bandwidth_async(
+    su_specttuner_t *st,
+    su_specttuner_channel_t *channel,
+    SUFLOAT bw);
+
+SUBOOL su_specttuner_close_channel_async(
+    su_specttuner_t *st,
+    su_specttuner_channel_t *channel);
+
+/*
+ * Releases the resources of applied requests (closed channels, replaced
+ * filters). Called by every asynchronous function, but may also be called
+ * on its own.
+ */
+void su_specttuner_collect_requests(su_specttuner_t *st);
+
+/* Number of filter responses currently shared among all tuners */
+unsigned int su_specttuner_get_filter_count(void);
+
 #endif /* _SIGUTILS_SPECTTUNER_H */
@@ -168,14 +168,31 @@ su_taps_normalize_L1(SUFLOAT *h, SUSCOUNT size)
 }
 
 /***************************** Hilbert transform *****************************/
+/*
+ * Designed filters are centered at (size - 1) / 2, just like the windows.
+ * This makes them exactly symmetric (or antisymmetric), which the FIR
+ * engine exploits to fold the delay line.
+ */
 void
 su_taps_hilbert_init(SUFLOAT *h, SUSCOUNT size)
 {
   unsigned int i;
-  int n = -size / 2;
+  int n;
 
-  for (i = 0; i < size; ++i, ++n)
-    h[i] = 2. / (M_PI * (n - .5f));
+  /*
+   * Samples of 2 (1 - cos(PI t)) / (PI t), with n = 2t. The factor 2 keeps
+   * the passband gain of 2 of the former half-sample design. For odd sizes,
+   * every other tap (including the central one) is exactly zero.
+   */
+  for (i = 0; i < size; ++i) {
+    n = 2 * (int) i - (int) (size - 1);
+    if (n % 4 == 0)
+      h[i] = 0;
+    else if (n % 2 == 0)
+      h[i] = 8. / (M_PI * n);
+    else
+      h[i] = 4. / (M_PI * n);
+  }
 
   su_taps_apply_hamming(h, size);
 }
@@ -191,7 +208,7 @@ su_taps_rrc_init(SUFLOAT *h, SUFLOAT T, SUFLOAT beta, SUSCOUNT size)
   SUFLOAT norm = 0;
 
   for (i = 0; i < size; ++i) {
-    r_t = (i - size / 2.) / T;
+    r_t = (i - .5 * (size - 1)) / T;
     f = 4 * beta * r_t;
     dem = M_PI * r_t * (1. - f * f);
     num = SU_SIN(M_PI * r_t * (1 - beta)) +
@@ -219,7 +236,7 @@ su_taps_brickwall_lp_init(SUFLOAT *h, SUFLOAT fc, SUSCOUNT size)
   SUFLOAT t = 0;
 
   for (i = 0; i < size; ++i) {
-    t = i - size / 2.;
+    t = i - .5 * (size - 1);
     h[i] = fc * su_sinc(fc * t);
   }
 
@@ -250,7 +267,7 @@ su_taps_brickwall_bp_init(SUFLOAT *h, SUFLOAT bw, SUFLOAT if_nor, SUSCOUNT size)
   } else {
 
     for (i = 0; i < size; ++i) {
-      t = i - .5 * size;
+      t = i - .5 * (size - 1);
       h[i] = bw * su_sinc(.5 * bw * t) * SU_COS(omega * t);
     }
 
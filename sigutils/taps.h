@@ -56,7 +56,7 @@ void su_taps_apply_flat_top_complex(SUCOMPLEX *h, SUSCOUNT size);
 void su_taps_apply_blackmann_harris(SUFLOAT *h, SUSCOUNT size);
 void su_taps_apply_blackmann_harris_complex(SUCOMPLEX *h, SUSCOUNT size);
 
-/* Hilbert transform */
+/* Hilbert transform (passband gain 2, delay (size - 1) / 2 samples) */
 void su_taps_hilbert_init(SUFLOAT *h, SUSCOUNT size);
 
 /* Get coefficients of a RRC filter */
@@ -44,6 +44,7 @@
 #  define SU_C_ABS(c)   std::abs(c)
 #  define SU_C_ARG(c)   std::arg(c)
 #  define SU_C_EXP(c)   std::exp(c)
+#  define SU_C_SQRT(c)  std::sqrt(c)
 #  define SU_C_CONJ(c)	std::conj(c)
 #  define SU_C_SGN(x) SUCOMPLEX(SU_SGN(SU_C_REAL(x)), SU_SGN(SU_C_IMAG(x)))
 #else
@@ -53,6 +54,7 @@
 #  define SU_C_ABS     SU_ADDSFX(cabs)
 #  define SU_C_ARG     SU_ADDSFX(carg)
 #  define SU_C_EXP     SU_ADDSFX(cexp)
+#  define SU_C_SQRT    SU_ADDSFX(csqrt)
 #  define SU_C_CONJ    SU_ADDSFX(conj)
 #  define SU_C_SGN(x)  (SU_SGN(SU_C_REAL(x)) + I * SU_SGN(SU_C_IMAG(x)))
 #endif
@@ -113,6 +115,7 @@
 #define SU_SIN    SU_ADDSFX(sin)
 #define SU_ASIN   SU_ADDSFX(asin)
 #define SU_TAN    SU_ADDSFX(tan)
+#define SU_ATAN   SU_ADDSFX(atan)
 #define SU_LOG    SU_ADDSFX(log10)
 #define SU_LN     SU_ADDSFX(log)
 #define SU_EXP    SU_ADDSFX(exp)
@@ -44,9 +44,47 @@ SUPRIVATE su_test_entry_t test_list[] = {
     SU_TEST_ENTRY(su_test_channel_detector_qpsk),
     SU_TEST_ENTRY(su_test_channel_detector_qpsk_noisy),
     SU_TEST_ENTRY(su_test_channel_detector_real_capture),
+    SU_TEST_ENTRY(su_test_channel_detector_batch),
+    SU_TEST_ENTRY(su_test_channel_detector_real),
     SU_TEST_ENTRY(su_test_diff_codec_binary),
     SU_TEST_ENTRY(su_test_diff_codec_quaternary),
     SU_TEST_ENTRY(su_test_specttuner_two_tones),
+    SU_TEST_ENTRY(su_test_specttuner_parallel),
+    SU_TEST_ENTRY(su_test_specttuner_simd),
+    SU_TEST_ENTRY(su_test_specttuner_ring),
+    SU_TEST_ENTRY(su_test_specttuner_batch),
+    SU_TEST_ENTRY(su_test_specttuner_real),
+    SU_TEST_ENTRY(su_test_specttuner_async),
+    SU_TEST_ENTRY(su_test_pfb_tone),
+    SU_TEST_ENTRY(su_test_pfb_tone_oversampled),
+    SU_TEST_ENTRY(su_test_pfb_benchmark),
+    SU_TEST_ENTRY(su_test_fir_direct_form),
+    SU_TEST_ENTRY(su_test_fir_overlap_save),
+    SU_TEST_ENTRY(su_test_fir_benchmark),
+    SU_TEST_ENTRY(su_test_sos_butterworth),
+    SU_TEST_ENTRY(su_test_sos_multichannel),
+    SU_TEST_ENTRY(su_test_fir_decimation),
+    SU_TEST_ENTRY(su_test_resampler_rational),
+    SU_TEST_ENTRY(su_test_resampler_arbitrary),
+    SU_TEST_ENTRY(su_test_cic),
+    SU_TEST_ENTRY(su_test_softtuner_cic),
+    SU_TEST_ENTRY(su_test_fir_fold),
+    SU_TEST_ENTRY(su_test_ncqo_integer),
+    SU_TEST_ENTRY(su_test_mixer),
+    SU_TEST_ENTRY(su_test_channel_detector_overlap),
+    SU_TEST_ENTRY(su_test_channel_detector_ingest),
+    SU_TEST_ENTRY(su_test_channel_detector_index),
+    SU_TEST_ENTRY(su_test_channel_detector_psd_track),
+    SU_TEST_ENTRY(su_test_channel_detector_order),
+    SU_TEST_ENTRY(su_test_peak_detector),
+    SU_TEST_ENTRY(su_test_peak_detector_benchmark),
+    SU_TEST_ENTRY(su_test_channel_detector_specttuner),
+    SU_TEST_ENTRY(su_test_softtuner_cic_large),
+    SU_TEST_ENTRY(su_test_pfb_close_from_callback),
+    SU_TEST_ENTRY(su_test_fft_plan_registry),
+    SU_TEST_ENTRY(su_test_fft_plan_wisdom),
+    SU_TEST_ENTRY(su_test_specttuner_filter_cache),
+    SU_TEST_ENTRY(su_test_tuner_decimation),
 };
 
 SUPRIVATE void
@@ -417,6 +417,90 @@ done:
   return ok;
 }
 
+/*
+ * Tuner block with its "decimation" property set: a tone of period T
+ * samples must come out with period T / decimation.
+ */
+SUBOOL
+su_test_tuner_decimation(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  su_block_t *siggen_block = NULL;
+  su_block_t *tuner_block = NULL;
+  su_block_port_t port = su_block_port_INITIALIZER;
+  SUCOMPLEX buffer[SU_TEST_TUNER_DECIM_SIZE];
+  unsigned int *decimation;
+  SUFLOAT omega;
+  SUSCOUNT p = 0;
+  SUSDIFF got;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  /* Casts are mandatory here */
+  siggen_block = su_block_new(
+      "siggen",
+      "cos",
+      (SUFLOAT)  1,
+      (SUSCOUNT) SU_TEST_TUNER_DECIM_PERIOD,
+      (SUSCOUNT) 0,
+      "sin",
+      (SUFLOAT)  1,
+      (SUSCOUNT) SU_TEST_TUNER_DECIM_PERIOD,
+      (SUSCOUNT) 0);
+  SU_TEST_ASSERT(siggen_block != NULL);
+
+  tuner_block = su_block_new(
+      "tuner",
+      (SUFLOAT)  0,
+      (SUFLOAT)  SU_TEST_TUNER_DECIM_BW,
+      (SUFLOAT)  0,
+      (SUSCOUNT) SU_TEST_TUNER_DECIM_TAPS);
+  SU_TEST_ASSERT(tuner_block != NULL);
+
+  decimation = su_block_get_property_ref(
+      tuner_block,
+      SU_PROPERTY_TYPE_INTEGER,
+      "decimation");
+  SU_TEST_ASSERT(decimation != NULL);
+  SU_TEST_ASSERT(*decimation == 1);
+
+  *decimation = SU_TEST_TUNER_DECIM_FACTOR;
+
+  SU_TEST_ASSERT(su_block_plug(siggen_block, 0, 0, tuner_block));
+  SU_TEST_ASSERT(su_block_port_plug(&port, tuner_block, 0));
+
+  SU_TEST_TICK(ctx);
+
+  while (p < SU_TEST_TUNER_DECIM_SIZE) {
+    got = su_block_port_read(&port, buffer + p, SU_TEST_TUNER_DECIM_SIZE - p);
+    SU_TEST_ASSERT(got > 0);
+    p += got;
+  }
+
+  /* Skip the filter transient */
+  omega = 2 * M_PI * SU_TEST_TUNER_DECIM_FACTOR / SU_TEST_TUNER_DECIM_PERIOD;
+  for (p = SU_TEST_TUNER_DECIM_TAPS; p < SU_TEST_TUNER_DECIM_SIZE; ++p)
+    SU_TEST_ASSERT(
+        SU_ABS(SU_C_ARG(buffer[p] * SU_C_CONJ(buffer[p - 1])) - omega)
+        < 1e-3);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (su_block_port_is_plugged(&port))
+    su_block_port_unplug(&port);
+
+  if (tuner_block != NULL)
+    su_block_destroy(tuner_block);
+
+  if (siggen_block != NULL)
+    su_block_destroy(siggen_block);
+
+  return ok;
+}
+
 SUBOOL
 su_test_costas_block(su_test_context_t *ctx)
 {
@@ -22,13 +22,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 #include <sigutils/sampling.h>
 #include <sigutils/sigutils.h>
 #include <sigutils/detect.h>
+#include <sigutils/simd.h>
+#include <sigutils/specttuner.h>
+#include <sigutils/taps.h>
 
 #include "test_list.h"
 #include "test_param.h"
@@ -437,3 +443,1868 @@ done:
 }
 
 
+SUBOOL
+su_test_channel_detector_batch(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *input = NULL;
+  struct sigutils_channel_detector_params params =
+      sigutils_channel_detector_params_INITIALIZER;
+  su_channel_detector_t *detector = NULL;
+  su_channel_detector_t *batch_det = NULL;
+  su_ncqo_t ncqo = su_ncqo_INITIALIZER;
+  SUFLOAT err, max_err = 0;
+  SUSCOUNT got;
+  SUSCOUNT p;
+  unsigned int i;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(input = su_test_ctx_getc(ctx, "x"));
+
+  /* Tone plus a DC offset, so that the DC estimate keeps changing */
+  su_ncqo_init(&ncqo, SU_TEST_CHANNEL_DETECTOR_SIGNAL_FREQ);
+
+  for (p = 0; p < ctx->params->buffer_size; ++p)
+    input[p] = su_ncqo_read(&ncqo) + .5 + .1 * su_c_awgn();
+
+  params.mode = SU_CHANNEL_DETECTOR_MODE_DISCOVERY;
+  params.samp_rate = 250000;
+  params.window_size = SU_TEST_CHANNEL_DETECTOR_BATCH_WINDOW_SIZE;
+
+  /* Reference: one FFT per window */
+  params.batch = 0;
+  SU_TEST_ASSERT(detector = su_channel_detector_new(&params));
+
+  params.batch = SU_TEST_CHANNEL_DETECTOR_BATCH_WINDOWS;
+  SU_TEST_ASSERT(batch_det = su_channel_detector_new(&params));
+
+  SU_TEST_TICK(ctx);
+
+  /* Arbitrary chunking exercises both paths */
+  for (p = 0; p < ctx->params->buffer_size; p += got) {
+    got = SU_MIN(
+        ctx->params->buffer_size - p,
+        SU_TEST_CHANNEL_DETECTOR_BATCH_CHUNK);
+
+    SU_TEST_ASSERT(
+        su_channel_detector_feed_bulk(detector, input + p, got) == got);
+    SU_TEST_ASSERT(
+        su_channel_detector_feed_bulk(batch_det, input + p, got) == got);
+  }
+
+  SU_TEST_ASSERT(detector->ptr == batch_det->ptr);
+  SU_TEST_ASSERT(SU_C_ABS(detector->dc - batch_det->dc) < 1e-5);
+
+  for (i = 0; i < params.window_size; ++i) {
+    err = SU_ABS(detector->spect[i] - batch_det->spect[i])
+        / (detector->spect[i] + 1e-6);
+    if (err > max_err)
+      max_err = err;
+  }
+
+  SU_INFO("Max relative PSD error: %g\n", max_err);
+  SU_TEST_ASSERT(max_err < SU_TEST_CHANNEL_DETECTOR_BATCH_MAX_ERROR);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (detector != NULL)
+    su_channel_detector_destroy(detector);
+
+  if (batch_det != NULL)
+    su_channel_detector_destroy(batch_det);
+
+  return ok;
+}
+
+SUBOOL
+su_test_channel_detector_real(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *input = NULL;
+  SUFLOAT *real = NULL;
+  struct sigutils_channel_detector_params params =
+      sigutils_channel_detector_params_INITIALIZER;
+  su_channel_detector_t *detector = NULL;
+  su_channel_detector_t *real_det = NULL;
+  su_ncqo_t ncqo = su_ncqo_INITIALIZER;
+  SUFLOAT err, max_err = 0;
+  SUSCOUNT p;
+  unsigned int i;
+  unsigned int found = 0;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(input = su_test_ctx_getc(ctx, "x"));
+  SU_TEST_ASSERT(real = su_test_ctx_getf(ctx, "xr"));
+
+  /* Real tone plus DC and noise, and its complex promotion */
+  su_ncqo_init(&ncqo, SU_TEST_CHANNEL_DETECTOR_SIGNAL_FREQ);
+
+  for (p = 0; p < ctx->params->buffer_size; ++p) {
+    real[p] = su_ncqo_read_i(&ncqo) + .5 + .1 * SU_C_REAL(su_c_awgn());
+    input[p] = real[p];
+  }
+
+  params.mode = SU_CHANNEL_DETECTOR_MODE_DISCOVERY;
+  params.samp_rate = 250000;
+  params.window_size = SU_TEST_CHANNEL_DETECTOR_BATCH_WINDOW_SIZE;
+
+  SU_TEST_ASSERT(detector = su_channel_detector_new(&params));
+
+  params.real = SU_TRUE;
+  SU_TEST_ASSERT(real_det = su_channel_detector_new(&params));
+
+  SU_TEST_TICK(ctx);
+
+  SU_TEST_ASSERT(
+      su_channel_detector_feed_bulk(
+          detector,
+          input,
+          ctx->params->buffer_size) == ctx->params->buffer_size);
+
+  SU_TEST_ASSERT(
+      su_channel_detector_feed_bulk_real(
+          real_det,
+          real,
+          ctx->params->buffer_size) == ctx->params->buffer_size);
+
+  /* Mirrored half included */
+  for (i = 0; i < params.window_size; ++i) {
+    err = SU_ABS(detector->spect[i] - real_det->spect[i])
+        / (detector->spect[i] + 1e-6);
+    if (err > max_err)
+      max_err = err;
+  }
+
+  SU_INFO("Max relative PSD error: %g\n", max_err);
+  SU_TEST_ASSERT(max_err < SU_TEST_CHANNEL_DETECTOR_REAL_MAX_ERROR);
+  SU_TEST_ASSERT(SU_C_ABS(detector->dc - real_det->dc) < 1e-5);
+
+  /* Channels are searched in the positive half only: no image channels */
+  for (i = 0; i < real_det->channel_count; ++i)
+    if (SU_CHANNEL_IS_VALID(real_det->channel_list[i])) {
+      SU_TEST_ASSERT(real_det->channel_list[i]->fc >= 0);
+      ++found;
+    }
+
+  SU_INFO("%d channels found in the real input\n", found);
+  SU_TEST_ASSERT(found > 0);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (detector != NULL)
+    su_channel_detector_destroy(detector);
+
+  if (real_det != NULL)
+    su_channel_detector_destroy(real_det);
+
+  return ok;
+}
+
+
+/* Mean PSD level, across all bins */
+SUPRIVATE SUFLOAT
+su_test_channel_detector_mean_psd(const su_channel_detector_t *detector)
+{
+  SUFLOAT sum = 0;
+  unsigned int i;
+
+  for (i = 0; i < detector->params.window_size; ++i)
+    sum += detector->spect[i];
+
+  return sum / detector->params.window_size;
+}
+
+/* Samples needed for the mean PSD to reach 90% of the input power */
+SUPRIVATE SUSCOUNT
+su_test_channel_detector_settle(
+    su_channel_detector_t *detector,
+    const SUCOMPLEX *input,
+    SUSCOUNT size,
+    SUSCOUNT step)
+{
+  SUSCOUNT p;
+
+  for (p = 0; p + step <= size; p += step) {
+    if (su_channel_detector_feed_bulk(detector, input + p, step) != step)
+      return 0;
+
+    if (su_test_channel_detector_mean_psd(detector) > .9)
+      return p + step;
+  }
+
+  return 0;
+}
+
+SUBOOL
+su_test_channel_detector_overlap(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *input = NULL;
+  SUFLOAT *real = NULL;
+  struct sigutils_channel_detector_params params =
+      sigutils_channel_detector_params_INITIALIZER;
+  su_channel_detector_t *detector = NULL;
+  su_channel_detector_t *ref_det = NULL;
+  SUSCOUNT size = ctx->params->buffer_size;
+  SUSCOUNT window_size = SU_TEST_CHANNEL_DETECTOR_BATCH_WINDOW_SIZE;
+  SUSCOUNT hop = window_size / SU_TEST_CHANNEL_DETECTOR_OVERLAP;
+  SUSCOUNT p, chunk, frames;
+  SUSCOUNT settle, settle_overlap;
+  SUFLOAT err, max_err = 0;
+  SUFLOAT mean = 0;
+  unsigned int i, iters = 0;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(input = su_test_ctx_getc(ctx, "x"));
+  SU_TEST_ASSERT(real = su_test_ctx_getf(ctx, "xr"));
+
+  /* Unit power white noise */
+  for (p = 0; p < size; ++p) {
+    input[p] = su_c_awgn();
+    real[p] = SU_SQRT2 * SU_C_REAL(input[p]);
+  }
+
+  params.mode = SU_CHANNEL_DETECTOR_MODE_SPECTRUM;
+  params.samp_rate = 250000;
+  params.window_size = window_size;
+  params.hop = hop;
+
+  /* Overlap is only available in PSD modes */
+  params.mode = SU_CHANNEL_DETECTOR_MODE_AUTOCORRELATION;
+  SU_TEST_ASSERT(su_channel_detector_new(&params) == NULL);
+  params.mode = SU_CHANNEL_DETECTOR_MODE_SPECTRUM;
+
+  SU_TEST_ASSERT(detector = su_channel_detector_new(&params));
+
+  SU_TEST_TICK(ctx);
+
+  /* One window every hop samples, whatever the chunking */
+  for (p = 0, chunk = 1; p < size; p += chunk, chunk += 2) {
+    if (chunk > size - p)
+      chunk = size - p;
+
+    SU_TEST_ASSERT(
+        su_channel_detector_feed_bulk(detector, input + p, chunk) == chunk);
+
+    if (detector->iters != iters) {
+      mean += su_test_channel_detector_mean_psd(detector);
+      ++iters;
+    }
+  }
+
+  frames = 1 + (size - window_size) / hop;
+  SU_TEST_ASSERT(detector->iters == frames);
+
+  /* Window energy normalization: white noise PSD is its power */
+  mean /= iters;
+  SU_INFO("Mean PSD of unit power noise: %g\n", mean);
+  SU_TEST_ASSERT(SU_ABS(mean - 1) < SU_TEST_CHANNEL_DETECTOR_OVERLAP_MAX_ERROR);
+
+  /* Last window must match that of a detector fed only with it */
+  params.hop = 0;
+  SU_TEST_ASSERT(ref_det = su_channel_detector_new(&params));
+
+  p = (frames - 1) * hop;
+  SU_TEST_ASSERT(
+      su_channel_detector_feed_bulk(ref_det, input + p, window_size)
+      == window_size);
+
+  for (i = 0; i < window_size; ++i) {
+    err = SU_ABS(detector->spect[i] - ref_det->spect[i])
+        / (ref_det->spect[i] + 1e-6);
+    if (err > max_err)
+      max_err = err;
+  }
+
+  su_channel_detector_destroy(detector);
+  detector = NULL;
+  su_channel_detector_destroy(ref_det);
+  ref_det = NULL;
+
+  /* Same with real input */
+  params.real = SU_TRUE;
+  params.hop = hop;
+  SU_TEST_ASSERT(detector = su_channel_detector_new(&params));
+  params.hop = 0;
+  SU_TEST_ASSERT(ref_det = su_channel_detector_new(&params));
+
+  SU_TEST_ASSERT(
+      su_channel_detector_feed_bulk_real(detector, real, size) == size);
+  SU_TEST_ASSERT(detector->iters == frames);
+  SU_TEST_ASSERT(
+      su_channel_detector_feed_bulk_real(ref_det, real + p, window_size)
+      == window_size);
+
+  for (i = 0; i < window_size; ++i) {
+    err = SU_ABS(detector->spect[i] - ref_det->spect[i])
+        / (ref_det->spect[i] + 1e-6);
+    if (err > max_err)
+      max_err = err;
+  }
+
+  SU_INFO("Max relative PSD error: %g\n", max_err);
+  SU_TEST_ASSERT(max_err < SU_TEST_CHANNEL_DETECTOR_BATCH_MAX_ERROR);
+
+  su_channel_detector_destroy(detector);
+  detector = NULL;
+  su_channel_detector_destroy(ref_det);
+  ref_det = NULL;
+
+  /* Same averaging ratio: overlapped windows converge sooner */
+  params.real = SU_FALSE;
+  params.mode = SU_CHANNEL_DETECTOR_MODE_DISCOVERY;
+  params.alpha = SU_TEST_CHANNEL_DETECTOR_OVERLAP_ALPHA;
+  SU_TEST_ASSERT(ref_det = su_channel_detector_new(&params));
+  params.hop = hop;
+  SU_TEST_ASSERT(detector = su_channel_detector_new(&params));
+
+  SU_TEST_ASSERT(
+      settle = su_test_channel_detector_settle(ref_det, input, size, hop));
+  SU_TEST_ASSERT(
+      settle_overlap = su_test_channel_detector_settle(
+          detector,
+          input,
+          size,
+          hop));
+
+  SU_INFO(
+      "Settling time: %lu samples (no overlap), %lu samples (hop %lu)\n",
+      (unsigned long) settle,
+      (unsigned long) settle_overlap,
+      (unsigned long) hop);
+  SU_TEST_ASSERT(
+      settle_overlap * SU_TEST_CHANNEL_DETECTOR_OVERLAP < 1.5 * settle);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (detector != NULL)
+    su_channel_detector_destroy(detector);
+
+  if (ref_det != NULL)
+    su_channel_detector_destroy(ref_det);
+
+  return ok;
+}
+
+/* Feed in growing odd chunks, so that spans straddle window boundaries */
+SUPRIVATE SUBOOL
+su_test_channel_detector_feed_chunks(
+    su_channel_detector_t *detector,
+    const SUCOMPLEX *input,
+    SUSCOUNT size)
+{
+  SUSCOUNT p, chunk;
+
+  for (p = 0, chunk = 1; p < size; p += chunk, chunk += 2) {
+    if (chunk > size - p)
+      chunk = size - p;
+
+    if (su_channel_detector_feed_bulk(detector, input + p, chunk) != chunk)
+      return SU_FALSE;
+  }
+
+  return SU_TRUE;
+}
+
+SUBOOL
+su_test_channel_detector_ingest(su_test_context_t *ctx)
+{
+  static const enum sigutils_channel_detector_mode modes[] = {
+      SU_CHANNEL_DETECTOR_MODE_SPECTRUM,
+      SU_CHANNEL_DETECTOR_MODE_DISCOVERY,
+      SU_CHANNEL_DETECTOR_MODE_AUTOCORRELATION,
+      SU_CHANNEL_DETECTOR_MODE_NONLINEAR_DIFF};
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *input = NULL;
+  struct sigutils_channel_detector_params params =
+      sigutils_channel_detector_params_INITIALIZER;
+  su_channel_detector_t *detector = NULL;
+  su_channel_detector_t *ref_det = NULL;
+  su_ncqo_t ncqo = su_ncqo_INITIALIZER;
+  SUSCOUNT size = ctx->params->buffer_size;
+  SUFLOAT err, max_err = 0;
+  SUSCOUNT p;
+  unsigned int i, j;
+  enum sigutils_simd_level saved = su_simd_get_level();
+  enum sigutils_simd_level level;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(input = su_test_ctx_getc(ctx, "x"));
+
+  su_ncqo_init(&ncqo, SU_TEST_CHANNEL_DETECTOR_SIGNAL_FREQ);
+
+  for (p = 0; p < size; ++p)
+    input[p] = su_ncqo_read(&ncqo) + .5 + .1 * su_c_awgn();
+
+  params.samp_rate = 250000;
+  params.window_size = SU_TEST_CHANNEL_DETECTOR_BATCH_WINDOW_SIZE;
+  params.batch = 0;
+
+  SU_TEST_TICK(ctx);
+
+  for (i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+    params.mode = modes[i];
+
+    /* Reference: sample by sample, scalar kernels */
+    su_simd_set_level(SU_SIMD_LEVEL_SCALAR);
+    SU_TEST_ASSERT(ref_det = su_channel_detector_new(&params));
+    for (p = 0; p < size; ++p)
+      SU_TEST_ASSERT(su_channel_detector_feed(ref_det, input[p]));
+
+    for (level = SU_SIMD_LEVEL_SCALAR;
+         level <= su_simd_get_max_level();
+         ++level) {
+      su_simd_set_level(level);
+
+      SU_TEST_ASSERT(detector = su_channel_detector_new(&params));
+      SU_TEST_ASSERT(
+          su_test_channel_detector_feed_chunks(detector, input, size));
+
+      SU_TEST_ASSERT(detector->ptr == ref_det->ptr);
+      SU_TEST_ASSERT(SU_C_ABS(detector->dc - ref_det->dc) < 1e-5);
+
+      /* spect and acorr share the same allocation */
+      for (j = 0; j < params.window_size; ++j) {
+        err = SU_ABS(detector->spect[j] - ref_det->spect[j])
+            / (SU_ABS(ref_det->spect[j]) + 1e-6);
+        if (err > max_err)
+          max_err = err;
+      }
+
+      su_channel_detector_destroy(detector);
+      detector = NULL;
+    }
+
+    su_channel_detector_destroy(ref_det);
+    ref_det = NULL;
+  }
+
+  SU_INFO("Max relative error: %g\n", max_err);
+  SU_TEST_ASSERT(max_err < SU_TEST_CHANNEL_DETECTOR_BATCH_MAX_ERROR);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_simd_set_level(saved);
+
+  if (detector != NULL)
+    su_channel_detector_destroy(detector);
+
+  if (ref_det != NULL)
+    su_channel_detector_destroy(ref_det);
+
+  return ok;
+}
+
+struct su_test_snapshot_reader {
+  su_channel_detector_t *detector;
+  volatile SUBOOL halt;
+  SUBOOL ok;
+  unsigned int reads;
+};
+
+/* Other thread: snapshots must always be sorted and never go back */
+SUPRIVATE void *
+su_test_channel_detector_reader(void *data)
+{
+  struct su_test_snapshot_reader *reader = data;
+  su_channel_snapshot_t snap = su_channel_snapshot_INITIALIZER;
+  unsigned int generation = 0;
+  unsigned int i;
+
+  reader->ok = SU_TRUE;
+
+  while (!reader->halt && reader->ok) {
+    if (!su_channel_detector_get_snapshot(reader->detector, &snap)) {
+      reader->ok = SU_FALSE;
+      break;
+    }
+
+    if (snap.generation < generation)
+      reader->ok = SU_FALSE;
+
+    if (snap.generation != generation)
+      ++reader->reads;
+
+    generation = snap.generation;
+
+    for (i = 1; i < snap.channel_count; ++i)
+      if (snap.channel_list[i - 1].fc > snap.channel_list[i].fc)
+        reader->ok = SU_FALSE;
+  }
+
+  su_channel_snapshot_finalize(&snap);
+
+  return NULL;
+}
+
+/* Reference lookup: linear scan with the same criterion */
+SUPRIVATE struct sigutils_channel *
+su_test_channel_detector_scan(
+    struct sigutils_channel **list,
+    unsigned int count,
+    SUFLOAT fc)
+{
+  struct sigutils_channel *best = NULL;
+  unsigned int i;
+
+  for (i = 0; i < count; ++i)
+    if (SU_ABS(fc - list[i]->fc) <= .5 * list[i]->bw)
+      if (best == NULL
+          || SU_ABS(fc - list[i]->fc) < SU_ABS(fc - best->fc))
+        best = list[i];
+
+  return best;
+}
+
+SUBOOL
+su_test_channel_detector_index(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SU_FFTW(_complex) *spectrum = NULL;
+  SU_FFTW(_complex) *window = NULL;
+  su_fft_plan_t *plan = NULL;
+  struct sigutils_channel_detector_params params =
+      sigutils_channel_detector_params_INITIALIZER;
+  su_channel_detector_t *detector = NULL;
+  su_channel_snapshot_t snap = su_channel_snapshot_INITIALIZER;
+  struct su_test_snapshot_reader reader;
+  struct sigutils_channel **list;
+  struct sigutils_channel *chan;
+  pthread_t thread;
+  SUBOOL running = SU_FALSE;
+  SUSCOUNT size = SU_TEST_CHANNEL_DETECTOR_BATCH_WINDOW_SIZE;
+  SUSCOUNT spacing = size / SU_TEST_CHANNEL_DETECTOR_INDEX_CARRIERS;
+  unsigned int count, found = 0;
+  unsigned int i, j, k;
+  SUFLOAT fc;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(
+      spectrum = SU_FFTW(_malloc)(size * sizeof(SU_FFTW(_complex))));
+  SU_TEST_ASSERT(
+      window = SU_FFTW(_malloc)(size * sizeof(SU_FFTW(_complex))));
+  SU_TEST_ASSERT(
+      plan = su_fft_plan_acquire(size, FFTW_BACKWARD, spectrum, window));
+
+  params.mode = SU_CHANNEL_DETECTOR_MODE_DISCOVERY;
+  params.samp_rate = 250000;
+  params.window_size = size;
+  params.window = SU_CHANNEL_DETECTOR_WINDOW_HANN;
+  params.alpha = .5;
+
+  SU_TEST_ASSERT(detector = su_channel_detector_new(&params));
+
+  memset(&reader, 0, sizeof(reader));
+  reader.detector = detector;
+  SU_TEST_ASSERT(
+      pthread_create(
+          &thread,
+          NULL,
+          su_test_channel_detector_reader,
+          &reader) == 0);
+  running = SU_TRUE;
+
+  SU_TEST_TICK(ctx);
+
+  /*
+   * Dense band: carriers 4 bins wide with random phases, spaced `spacing`
+   * bins, 40 dB above the noise floor. Windows are synthesized in
+   * frequency.
+   */
+  for (i = 0; i < SU_TEST_CHANNEL_DETECTOR_INDEX_WINDOWS; ++i) {
+    for (j = 0; j < size; ++j)
+      spectrum[j] = .1 * su_c_awgn();
+
+    for (k = 0; k < SU_TEST_CHANNEL_DETECTOR_INDEX_CARRIERS; ++k)
+      for (j = 0; j < 4; ++j)
+        spectrum[k * spacing + spacing / 2 + j] =
+            10 * SU_C_EXP(2 * I * PI * rand() / (SUFLOAT) RAND_MAX);
+
+    su_fft_plan_execute(plan, spectrum, window);
+
+    for (j = 0; j < size; ++j)
+      window[j] /= SU_SQRT(size);
+
+    SU_TEST_ASSERT(
+        su_channel_detector_feed_bulk(detector, window, size) == size);
+  }
+
+  su_channel_detector_get_channel_list(detector, &list, &count);
+  SU_INFO("%d channels in the index\n", count);
+
+  /* Sorted, without holes */
+  for (i = 0; i < count; ++i) {
+    SU_TEST_ASSERT(list[i] != NULL);
+    if (i > 0)
+      SU_TEST_ASSERT(list[i - 1]->fc <= list[i]->fc);
+  }
+
+  /* Every carrier is found */
+  for (k = 0; k < SU_TEST_CHANNEL_DETECTOR_INDEX_CARRIERS; ++k) {
+    j = k * spacing + spacing / 2 + 2;
+    fc = SU_CHANNEL_DETECTOR_IDX2ABS_FREQ(detector, j);
+    if (j > size / 2)
+      fc -= params.samp_rate;
+
+    if (su_channel_detector_lookup_valid_channel(detector, fc) != NULL)
+      ++found;
+  }
+
+  SU_INFO(
+      "%d/%d carriers found\n",
+      found,
+      SU_TEST_CHANNEL_DETECTOR_INDEX_CARRIERS);
+  SU_TEST_ASSERT(found == SU_TEST_CHANNEL_DETECTOR_INDEX_CARRIERS);
+
+  /* Binary search agrees with a linear scan, across the whole band */
+  for (i = 0; i < 4 * size; ++i) {
+    fc = params.samp_rate * ((SUFLOAT) i / (4 * size) - .5);
+    chan = su_test_channel_detector_scan(list, count, fc);
+    SU_TEST_ASSERT(su_channel_detector_lookup_channel(detector, fc) == chan);
+  }
+
+  /* Recycled channels: the pool does not grow with every discovery run */
+  SU_TEST_ASSERT(
+      detector->chan_slab_count * SU_CHANNEL_DETECTOR_POOL_SLAB
+      <= 2 * count + SU_CHANNEL_DETECTOR_POOL_SLAB);
+
+  reader.halt = SU_TRUE;
+  pthread_join(thread, NULL);
+  running = SU_FALSE;
+
+  SU_INFO("%d snapshots read by the other thread\n", reader.reads);
+  SU_TEST_ASSERT(reader.ok);
+
+  /* Snapshots match the live list */
+  SU_TEST_ASSERT(su_channel_detector_get_snapshot(detector, &snap));
+  SU_TEST_ASSERT(snap.channel_count == count);
+  for (i = 0; i < count; ++i)
+    SU_TEST_ASSERT(
+        memcmp(&snap.channel_list[i], list[i], sizeof(*list[i])) == 0);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (running) {
+    reader.halt = SU_TRUE;
+    pthread_join(thread, NULL);
+  }
+
+  su_channel_snapshot_finalize(&snap);
+
+  if (detector != NULL)
+    su_channel_detector_destroy(detector);
+
+  if (plan != NULL)
+    su_fft_plan_release(plan);
+
+  if (spectrum != NULL)
+    SU_FFTW(_free)(spectrum);
+
+  if (window != NULL)
+    SU_FFTW(_free)(window);
+
+  return ok;
+}
+
+/* Feeds the whole input, returns the output power after settling */
+SUPRIVATE SUFLOAT
+su_test_softtuner_run(
+    su_softtuner_t *tuner,
+    const SUCOMPLEX *x,
+    SUSCOUNT size,
+    SUCOMPLEX *y,
+    SUSCOUNT *out_size)
+{
+  SUSCOUNT p = 0;
+  SUSCOUNT n = 0;
+  SUSCOUNT settle = SU_TEST_SOFTTUNER_SETTLE;
+  SUSDIFF got;
+  SUFLOAT power = 0;
+
+  while (p < size) {
+    p += su_softtuner_feed(tuner, x + p, size - p);
+    while ((got = su_softtuner_read(tuner, y + n, size - n)) > 0)
+      n += got;
+  }
+
+  for (p = settle; p < n; ++p)
+    power += SU_C_REAL(y[p] * SU_C_CONJ(y[p]));
+
+  *out_size = n;
+
+  return n > settle ? power / (n - settle) : 0;
+}
+
+SUBOOL
+su_test_softtuner_cic(su_test_context_t *ctx)
+{
+  static const SUSCOUNT decimations[] = {25, 30, 32, 300};
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *y = NULL;
+  struct sigutils_softtuner_params params =
+      sigutils_softtuner_params_INITIALIZER;
+  su_softtuner_t tuner;
+  su_ncqo_t lo;
+  SUSCOUNT size = SU_TEST_SOFTTUNER_BUFFER_SIZE;
+  SUSCOUNT n, p;
+  SUFLOAT fs = SU_TEST_SOFTTUNER_SAMP_RATE;
+  SUFLOAT fout, power, alias;
+  SUFLOAT times[2];
+  struct timeval start, end, diff;
+  unsigned int i, k, mode;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  memset(&tuner, 0, sizeof(su_softtuner_t));
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(y = malloc(size * sizeof(SUCOMPLEX)));
+
+  SU_TEST_TICK(ctx);
+
+  params.samp_rate = SU_TEST_SOFTTUNER_SAMP_RATE;
+  params.fc = SU_TEST_SOFTTUNER_FC;
+
+  for (i = 0; i < sizeof(decimations) / sizeof(decimations[0]); ++i) {
+    params.decimation = decimations[i];
+    params.mode = SU_SOFTTUNER_MODE_CIC;
+
+    /* Channel bandwidth as su_softtuner_params_adjust_to_channel sets it */
+    params.bw = .3 * fs / params.decimation;
+    fout = fs / params.decimation;
+
+    /* In band tone, at a fraction of the channel bandwidth */
+    su_ncqo_init_fixed(
+        &lo,
+        SU_ABS2NORM_FREQ(fs, params.fc + SU_TEST_SOFTTUNER_OFFSET * params.bw));
+    for (p = 0; p < size; ++p)
+      x[p] = su_ncqo_read(&lo);
+
+    SU_TEST_ASSERT(su_softtuner_init(&tuner, &params));
+    power = su_test_softtuner_run(&tuner, x, size, y, &n);
+    su_softtuner_finalize(&tuner);
+
+    SU_TEST_ASSERT(n == size / params.decimation);
+    SU_TEST_ASSERT(SU_ABS(power - 1) < SU_TEST_SOFTTUNER_MAX_ERROR);
+
+    /* Tones that would alias onto it must be gone */
+    alias = 0;
+    for (k = 1; k <= SU_TEST_SOFTTUNER_ALIASES; ++k) {
+      su_ncqo_init_fixed(
+          &lo,
+          SU_ABS2NORM_FREQ(
+              fs,
+              params.fc + k * fout + SU_TEST_SOFTTUNER_OFFSET * params.bw));
+      for (p = 0; p < size; ++p)
+        x[p] = su_ncqo_read(&lo);
+
+      SU_TEST_ASSERT(su_softtuner_init(&tuner, &params));
+      power = su_test_softtuner_run(&tuner, x, size, y, &n);
+      su_softtuner_finalize(&tuner);
+
+      if (power > alias)
+        alias = power;
+    }
+
+    SU_TEST_ASSERT(SU_POWER_DB_RAW(alias) < SU_TEST_SOFTTUNER_MIN_REJECTION);
+
+    /* Same signal through both decimation chains */
+    for (mode = 0; mode < 2; ++mode) {
+      params.mode = mode == 0 ? SU_SOFTTUNER_MODE_SOS : SU_SOFTTUNER_MODE_CIC;
+      SU_TEST_ASSERT(su_softtuner_init(&tuner, &params));
+
+      gettimeofday(&start, NULL);
+      (void) su_test_softtuner_run(&tuner, x, size, y, &n);
+      gettimeofday(&end, NULL);
+
+      su_softtuner_finalize(&tuner);
+
+      timersub(&end, &start, &diff);
+      times[mode] = diff.tv_sec + 1e-6 * diff.tv_usec;
+    }
+
+    SU_INFO(
+        "Decimation %3d: worst alias %6.1f dB, speedup over SOS: %.2f\n",
+        decimations[i],
+        SU_POWER_DB_RAW(alias),
+        times[0] / times[1]);
+  }
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_softtuner_finalize(&tuner);
+
+  if (x != NULL)
+    free(x);
+
+  if (y != NULL)
+    free(y);
+
+  return ok;
+}
+
+/*
+ * Decimations whose CIC share does not fit SU_CIC_DEFAULT_STAGES stages.
+ * The input is synthesized and fed in chunks, as it is too large to keep.
+ */
+SUBOOL
+su_test_softtuner_cic_large(su_test_context_t *ctx)
+{
+  static const SUSCOUNT decimations[] = {4001, 20001};
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *y = NULL;
+  struct sigutils_softtuner_params params =
+      sigutils_softtuner_params_INITIALIZER;
+  struct sigutils_channel_detector_params det_params =
+      sigutils_channel_detector_params_INITIALIZER;
+  su_channel_detector_t *detector = NULL;
+  su_softtuner_t tuner;
+  su_ncqo_t lo;
+  SUSCOUNT chunk = SU_TEST_SOFTTUNER_BUFFER_SIZE;
+  SUSCOUNT outputs = SU_TEST_SOFTTUNER_SETTLE + SU_TEST_SOFTTUNER_LARGE_OUT;
+  SUSCOUNT n, p, fed, got, total;
+  SUFLOAT fs = SU_TEST_SOFTTUNER_SAMP_RATE;
+  SUFLOAT power;
+  unsigned int i, stages;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  memset(&tuner, 0, sizeof(su_softtuner_t));
+
+  SU_TEST_ASSERT(x = malloc(chunk * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(y = malloc(outputs * sizeof(SUCOMPLEX)));
+
+  SU_TEST_TICK(ctx);
+
+  params.samp_rate = SU_TEST_SOFTTUNER_SAMP_RATE;
+  params.fc = SU_TEST_SOFTTUNER_FC;
+
+  for (i = 0; i < sizeof(decimations) / sizeof(decimations[0]); ++i) {
+    params.decimation = decimations[i];
+    params.mode = SU_SOFTTUNER_MODE_CIC;
+    params.bw = .3 * fs / params.decimation;
+
+    SU_TEST_ASSERT(su_softtuner_init(&tuner, &params));
+    SU_TEST_ASSERT(tuner.params.mode == SU_SOFTTUNER_MODE_CIC);
+    SU_TEST_ASSERT((stages = tuner.cic.stages) < SU_CIC_DEFAULT_STAGES);
+
+    su_ncqo_init_fixed(
+        &lo,
+        SU_ABS2NORM_FREQ(fs, params.fc + SU_TEST_SOFTTUNER_OFFSET * params.bw));
+
+    n = 0;
+    total = outputs * params.decimation;
+    while (total > 0) {
+      got = MIN(chunk, total);
+      for (p = 0; p < got; ++p)
+        x[p] = su_ncqo_read(&lo);
+      total -= got;
+
+      for (fed = 0; fed < got; )
+        fed += su_softtuner_feed(&tuner, x + fed, got - fed);
+
+      n += su_softtuner_read(&tuner, y + n, outputs - n);
+    }
+
+    su_softtuner_finalize(&tuner);
+
+    SU_TEST_ASSERT(n == outputs);
+
+    power = 0;
+    for (p = SU_TEST_SOFTTUNER_SETTLE; p < n; ++p)
+      power += SU_C_REAL(y[p] * SU_C_CONJ(y[p]));
+    power /= n - SU_TEST_SOFTTUNER_SETTLE;
+
+    SU_INFO(
+        "Decimation %d: %d CIC stages, in-band power %g\n",
+        decimations[i],
+        stages,
+        power);
+    SU_TEST_ASSERT(SU_ABS(power - 1) < SU_TEST_SOFTTUNER_MAX_ERROR);
+  }
+
+  /* Beyond any CIC: SOS */
+  params.decimation = (SUSCOUNT) UINT_MAX * 8;
+  SU_TEST_ASSERT(su_softtuner_init(&tuner, &params));
+  SU_TEST_ASSERT(tuner.params.mode == SU_SOFTTUNER_MODE_SOS);
+  su_softtuner_finalize(&tuner);
+
+  /* Channel detectors tune through the same chain */
+  det_params.mode = SU_CHANNEL_DETECTOR_MODE_DISCOVERY;
+  det_params.samp_rate = SU_TEST_SOFTTUNER_SAMP_RATE;
+  det_params.window_size = 256;
+  det_params.tune = SU_TRUE;
+  det_params.fc = SU_TEST_SOFTTUNER_FC;
+  det_params.decimation = decimations[0];
+  det_params.bw = .3 * fs / det_params.decimation;
+
+  SU_TEST_ASSERT(detector = su_channel_detector_new(&det_params));
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_softtuner_finalize(&tuner);
+
+  if (detector != NULL)
+    su_channel_detector_destroy(detector);
+
+  if (x != NULL)
+    free(x);
+
+  if (y != NULL)
+    free(y);
+
+  return ok;
+}
+
+/* The original two-pass discovery stage */
+SUPRIVATE void
+su_test_psd_track_reference(
+    SUFLOAT *spect,
+    SUFLOAT *spmin,
+    SUFLOAT *spmax,
+    const SUCOMPLEX *fft,
+    SUFLOAT norm,
+    SUFLOAT alpha,
+    SUFLOAT beta,
+    SUFLOAT N0,
+    SUSCOUNT size,
+    su_simd_psd_stats_t *stats)
+{
+  SUSCOUNT i;
+  SUFLOAT psd;
+
+  if (fft != NULL)
+    for (i = 0; i < size; ++i) {
+      psd = norm * SU_C_REAL(fft[i] * SU_C_CONJ(fft[i]));
+      spect[i] += alpha * (psd - spect[i]);
+    }
+
+  stats->sum = 0;
+  stats->valid = 0;
+  stats->min = INFINITY;
+  stats->min_bin = -1;
+
+  for (i = 0; i < size; ++i) {
+    psd = spect[i];
+
+    if (psd < spmin[i])
+      spmin[i] = psd;
+    else
+      spmin[i] += beta * (psd - spmin[i]);
+
+    if (psd > spmax[i])
+      spmax[i] = psd;
+    else
+      spmax[i] += beta * (psd - spmax[i]);
+
+    if (spmin[i] < N0 && N0 < spmax[i]) {
+      stats->sum += psd;
+      ++stats->valid;
+    }
+
+    if (psd < stats->min) {
+      stats->min = psd;
+      stats->min_bin = i;
+    }
+  }
+}
+
+/* Real detectors only take the real part */
+SUPRIVATE SUBOOL
+su_test_channel_detector_feed_all(
+    su_channel_detector_t *detector,
+    const SUCOMPLEX *x,
+    const SUFLOAT *xr,
+    SUSCOUNT len)
+{
+  if (detector->params.real)
+    return su_channel_detector_feed_bulk_real(detector, xr, len) == len;
+
+  return su_channel_detector_feed_bulk(detector, x, len) == len;
+}
+
+SUBOOL
+su_test_channel_detector_psd_track(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SUFLOAT *buf = NULL;
+  SUFLOAT *init[3], *ref[3], *out[3];
+  SUCOMPLEX *fft = NULL;
+  SUCOMPLEX *input = NULL;
+  SUFLOAT *real = NULL;
+  su_simd_psd_stats_t ref_stats, stats;
+  struct sigutils_channel_detector_params params =
+      sigutils_channel_detector_params_INITIALIZER;
+  su_channel_detector_t *detector = NULL;
+  su_channel_detector_t *ref_det = NULL;
+  su_ncqo_t ncqo = su_ncqo_INITIALIZER;
+  SUSCOUNT size = SU_TEST_CHANNEL_DETECTOR_PSD_SIZE;
+  SUSCOUNT len = ctx->params->buffer_size;
+  SUSCOUNT i;
+  unsigned int j, k, pass;
+  enum sigutils_simd_level saved = su_simd_get_level();
+  enum sigutils_simd_level level;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(buf = malloc(9 * size * sizeof(SUFLOAT)));
+  SU_TEST_ASSERT(fft = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(input = su_test_ctx_getc(ctx, "x"));
+  SU_TEST_ASSERT(real = su_test_ctx_getf(ctx, "real"));
+
+  for (j = 0; j < 3; ++j) {
+    init[j] = buf + j * size;
+    ref[j]  = buf + (j + 3) * size;
+    out[j]  = buf + (j + 6) * size;
+  }
+
+  /* Extremes both above and below the spectrum, around N0 = 1 */
+  for (i = 0; i < size; ++i) {
+    fft[i] = su_c_awgn();
+    init[0][i] = SU_C_REAL(su_c_awgn() * SU_C_CONJ(su_c_awgn()));
+    init[0][i] = SU_ABS(init[0][i]);
+    init[1][i] = init[0][i] * (.5 + rand() / (SUFLOAT) RAND_MAX);
+    init[2][i] = init[0][i] * (.5 + rand() / (SUFLOAT) RAND_MAX);
+  }
+
+  /* Tied minimums, in different lanes: the first one must win */
+  for (i = 3; i < size; i += 997) {
+    fft[i] = 0;
+    init[0][i] = 0;
+  }
+
+  SU_TEST_TICK(ctx);
+
+  for (pass = 0; pass < 2; ++pass) {
+    for (j = 0; j < 3; ++j)
+      memcpy(ref[j], init[j], size * sizeof(SUFLOAT));
+
+    su_test_psd_track_reference(
+        ref[0], ref[1], ref[2],
+        pass == 0 ? fft : NULL,
+        .5, .25, 1e-3, 1,
+        size,
+        &ref_stats);
+
+    for (level = SU_SIMD_LEVEL_SCALAR;
+         level <= su_simd_get_max_level();
+         ++level) {
+      su_simd_set_level(level);
+
+      /* Odd sizes exercise the scalar tails */
+      for (k = 0; k < 3; ++k) {
+        for (j = 0; j < 3; ++j)
+          memcpy(out[j], init[j], size * sizeof(SUFLOAT));
+
+        su_simd_psd_track(
+            out[0], out[1], out[2],
+            pass == 0 ? fft : NULL,
+            .5, .25, 1e-3, 1,
+            size - k,
+            &stats);
+
+        if (k == 0) {
+          for (j = 0; j < 3; ++j)
+            SU_TEST_ASSERT(
+                memcmp(out[j], ref[j], size * sizeof(SUFLOAT)) == 0);
+
+          SU_TEST_ASSERT(stats.valid == ref_stats.valid);
+          SU_TEST_ASSERT(stats.min == ref_stats.min);
+          SU_TEST_ASSERT(stats.min_bin == ref_stats.min_bin);
+          SU_TEST_ASSERT(
+              SU_ABS(stats.sum - ref_stats.sum)
+              < SU_TEST_CHANNEL_DETECTOR_PSD_MAX_ERROR * ref_stats.sum);
+        } else {
+          for (j = 0; j < 3; ++j)
+            SU_TEST_ASSERT(
+                memcmp(out[j], ref[j], (size - k) * sizeof(SUFLOAT)) == 0);
+        }
+      }
+
+      SU_INFO(
+          "%s: %d valid bins, min at %d\n",
+          su_simd_level_to_string(level),
+          stats.valid,
+          stats.min_bin);
+    }
+  }
+
+  /* Whole detector, complex and real input */
+  su_ncqo_init(&ncqo, SU_TEST_CHANNEL_DETECTOR_SIGNAL_FREQ);
+
+  for (i = 0; i < len; ++i) {
+    input[i] = su_ncqo_read(&ncqo) + .1 * su_c_awgn();
+    real[i] = SU_C_REAL(input[i]);
+  }
+
+  params.mode = SU_CHANNEL_DETECTOR_MODE_DISCOVERY;
+  params.samp_rate = 250000;
+  params.window_size = SU_TEST_CHANNEL_DETECTOR_BATCH_WINDOW_SIZE;
+  params.batch = 0;
+
+  for (pass = 0; pass < 2; ++pass) {
+    params.real = pass == 1;
+
+    su_simd_set_level(SU_SIMD_LEVEL_SCALAR);
+    SU_TEST_ASSERT(ref_det = su_channel_detector_new(&params));
+    SU_TEST_ASSERT(su_test_channel_detector_feed_all(ref_det, input, real, len));
+
+    for (level = SU_SIMD_LEVEL_SCALAR + 1;
+         level <= su_simd_get_max_level();
+         ++level) {
+      su_simd_set_level(level);
+      SU_TEST_ASSERT(detector = su_channel_detector_new(&params));
+      SU_TEST_ASSERT(
+          su_test_channel_detector_feed_all(detector, input, real, len));
+
+      /* Extremes do not depend on N0: they must match exactly */
+      SU_TEST_ASSERT(
+          memcmp(
+              detector->spect,
+              ref_det->spect,
+              params.window_size * sizeof(SUFLOAT)) == 0);
+      SU_TEST_ASSERT(
+          memcmp(
+              detector->spmin,
+              ref_det->spmin,
+              params.window_size * sizeof(SUFLOAT)) == 0);
+      SU_TEST_ASSERT(
+          memcmp(
+              detector->spmax,
+              ref_det->spmax,
+              params.window_size * sizeof(SUFLOAT)) == 0);
+      SU_TEST_ASSERT(
+          SU_ABS(detector->N0 - ref_det->N0)
+          < SU_TEST_CHANNEL_DETECTOR_PSD_MAX_ERROR * ref_det->N0);
+
+      su_channel_detector_destroy(detector);
+      detector = NULL;
+    }
+
+    su_channel_detector_destroy(ref_det);
+    ref_det = NULL;
+  }
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_simd_set_level(saved);
+
+  if (detector != NULL)
+    su_channel_detector_destroy(detector);
+
+  if (ref_det != NULL)
+    su_channel_detector_destroy(ref_det);
+
+  if (buf != NULL)
+    free(buf);
+
+  if (fft != NULL)
+    free(fft);
+
+  return ok;
+}
+
+SUBOOL
+su_test_channel_detector_order(su_test_context_t *ctx)
+{
+  static const unsigned int orders[] = {2, 4, 8};
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *input = NULL;
+  struct sigutils_channel_detector_params params =
+      sigutils_channel_detector_params_INITIALIZER;
+  su_channel_detector_t *detector = NULL;
+  su_channel_detector_t *ref_det = NULL;
+  su_ncqo_t ncqo = su_ncqo_INITIALIZER;
+  SUSCOUNT size = ctx->params->buffer_size;
+  SUSCOUNT sps = SU_TEST_CHANNEL_DETECTOR_ORDER_SPS;
+  SUCOMPLEX symbol = 0;
+  SUFLOAT offset, err, max_err = 0;
+  SUSCOUNT p;
+  unsigned int i, j;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(input = su_test_ctx_getc(ctx, "x"));
+
+  params.samp_rate = 250000;
+  params.window_size = SU_TEST_CHANNEL_DETECTOR_BATCH_WINDOW_SIZE;
+  params.alpha = 1e-1;
+
+  offset = SU_TEST_CHANNEL_DETECTOR_ORDER_OFFSET;
+
+  SU_TEST_TICK(ctx);
+
+  for (i = 0; i < sizeof(orders) / sizeof(orders[0]); ++i) {
+    /* M-PSK, rectangular pulses, slightly off-tuned */
+    su_ncqo_init(&ncqo, SU_ABS2NORM_FREQ(params.samp_rate, offset));
+
+    for (p = 0; p < size; ++p) {
+      if (p % sps == 0)
+        symbol = SU_C_EXP(2 * I * PI * (rand() % orders[i]) / orders[i]);
+
+      input[p] = symbol * su_ncqo_read(&ncqo)
+          + SU_TEST_CHANNEL_DETECTOR_ORDER_NOISE * su_c_awgn();
+    }
+
+    params.mode = SU_CHANNEL_DETECTOR_MODE_ORDER_ESTIMATION;
+    SU_TEST_ASSERT(detector = su_channel_detector_new(&params));
+    SU_TEST_ASSERT(
+        su_test_channel_detector_feed_chunks(detector, input, size));
+
+    params.mode = SU_CHANNEL_DETECTOR_MODE_NONLINEAR_DIFF;
+    SU_TEST_ASSERT(ref_det = su_channel_detector_new(&params));
+    SU_TEST_ASSERT(
+        su_channel_detector_feed_bulk(ref_det, input, size) == size);
+
+    SU_INFO(
+        "%d-PSK: order %d, offset %g Hz, baud %g (nonlinear diff: %g)\n",
+        orders[i],
+        su_channel_detector_get_order(detector),
+        su_channel_detector_get_order_offset(detector),
+        su_channel_detector_get_baud(detector),
+        su_channel_detector_get_baud(ref_det));
+
+    SU_TEST_ASSERT(su_channel_detector_get_order(detector) == orders[i]);
+    SU_TEST_ASSERT(
+        SU_ABS(su_channel_detector_get_order_offset(detector) - offset)
+        <= params.samp_rate / (SUFLOAT) (params.window_size * orders[i]));
+
+    /* Row 0 is exactly the NONLINEAR_DIFF spectrum */
+    for (j = 0; j < params.window_size; ++j) {
+      err = SU_ABS(detector->spect[j] - ref_det->spect[j])
+          / (SU_ABS(ref_det->spect[j]) + 1e-6);
+      if (err > max_err)
+        max_err = err;
+    }
+
+    SU_TEST_ASSERT(
+        su_channel_detector_get_baud(detector)
+        == su_channel_detector_get_baud(ref_det));
+
+    su_channel_detector_destroy(detector);
+    detector = NULL;
+
+    su_channel_detector_destroy(ref_det);
+    ref_det = NULL;
+  }
+
+  SU_INFO("Max relative error of the nonlinear diff row: %g\n", max_err);
+  SU_TEST_ASSERT(max_err < SU_TEST_CHANNEL_DETECTOR_BATCH_MAX_ERROR);
+
+  /* Noise has no order */
+  for (p = 0; p < size; ++p)
+    input[p] = su_c_awgn();
+
+  params.mode = SU_CHANNEL_DETECTOR_MODE_ORDER_ESTIMATION;
+  SU_TEST_ASSERT(detector = su_channel_detector_new(&params));
+  SU_TEST_ASSERT(su_channel_detector_feed_bulk(detector, input, size) == size);
+  SU_TEST_ASSERT(su_channel_detector_get_order(detector) == 0);
+
+  /* Powers of two only */
+  su_channel_detector_destroy(detector);
+  params.max_order = 1;
+  SU_TEST_ASSERT((detector = su_channel_detector_new(&params)) == NULL);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (detector != NULL)
+    su_channel_detector_destroy(detector);
+
+  if (ref_det != NULL)
+    su_channel_detector_destroy(ref_det);
+
+  return ok;
+}
+
+/* The original peak detector: variance recomputed on every sample */
+struct su_test_peak_reference {
+  double *history;
+  unsigned int size;
+  unsigned int count;
+  unsigned int p;
+  double thr2;
+  double margin; /* Relative distance of x2 to the threshold */
+};
+
+SUPRIVATE int
+su_test_peak_reference_feed(struct su_test_peak_reference *ref, SUFLOAT x)
+{
+  double mean = 0, variance = 0, d, x2;
+  unsigned int i;
+  int peak = 0;
+
+  ref->margin = INFINITY;
+
+  if (ref->count < ref->size) {
+    ref->history[ref->count++] = x;
+    return 0;
+  }
+
+  for (i = 0; i < ref->size; ++i)
+    mean += ref->history[i];
+  mean /= ref->size;
+
+  for (i = 0; i < ref->size; ++i) {
+    d = ref->history[i] - mean;
+    variance += d * d;
+  }
+  variance /= ref->size;
+
+  x2 = (x - mean) * (x - mean);
+  if (x2 > ref->thr2 * variance)
+    peak = x > mean ? 1 : -1;
+
+  ref->margin = fabs(x2 - ref->thr2 * variance) / (ref->thr2 * variance);
+
+  ref->history[ref->p++] = x;
+  if (ref->p == ref->size)
+    ref->p = 0;
+
+  return peak;
+}
+
+/* Slow drift far from zero, noise and a few spikes */
+SUPRIVATE SUFLOAT
+su_test_peak_detector_sample(SUSCOUNT i)
+{
+  SUFLOAT x = SU_TEST_PEAK_DETECTOR_OFFSET
+      + 10 * SU_SIN(2e-5 * PI * i)
+      + SU_C_REAL(su_c_awgn());
+
+  if (i % 997 == 0)
+    x += 10;
+
+  return x;
+}
+
+SUBOOL
+su_test_peak_detector(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  su_peak_detector_t pd = su_peak_detector_INITIALIZER;
+  su_peak_detector_t bulk = su_peak_detector_INITIALIZER;
+  struct su_test_peak_reference ref;
+  SUFLOAT *x = NULL;
+  SUSCOUNT *peaks = NULL;
+  SUSCOUNT size = SU_TEST_PEAK_DETECTOR_SAMPLES;
+  SUSCOUNT i, p, n, chunk, count = 0, found = 0, spikes = 0;
+  unsigned int mismatches = 0;
+  int peak;
+
+  memset(&ref, 0, sizeof(ref));
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUFLOAT)));
+  SU_TEST_ASSERT(peaks = malloc(size * sizeof(SUSCOUNT)));
+  SU_TEST_ASSERT(
+      ref.history = malloc(SU_TEST_PEAK_DETECTOR_SIZE * sizeof(double)));
+
+  ref.size = SU_TEST_PEAK_DETECTOR_SIZE;
+  ref.thr2 = 3 * 3;
+
+  SU_TEST_ASSERT(su_peak_detector_init(&pd, SU_TEST_PEAK_DETECTOR_SIZE, 3));
+  SU_TEST_ASSERT(su_peak_detector_init(&bulk, SU_TEST_PEAK_DETECTOR_SIZE, 3));
+
+  for (i = 0; i < size; ++i)
+    x[i] = su_test_peak_detector_sample(i);
+
+  SU_TEST_TICK(ctx);
+
+  /* Running statistics vs. exact ones, away from the threshold */
+  for (i = 0; i < size; ++i) {
+    peak = su_peak_detector_feed(&pd, x[i]);
+
+    if (su_test_peak_reference_feed(&ref, x[i]) != peak
+        && ref.margin > SU_TEST_PEAK_DETECTOR_MARGIN)
+      ++mismatches;
+
+    if (peak > 0) {
+      ++count;
+      if (i % 997 == 0)
+        ++found;
+    }
+
+    if (i >= SU_TEST_PEAK_DETECTOR_SIZE && i % 997 == 0)
+      ++spikes;
+  }
+
+  SU_INFO(
+      "%d peaks, %d/%d spikes found, %d mismatches\n",
+      count,
+      found,
+      spikes,
+      mismatches);
+
+  SU_TEST_ASSERT(mismatches == 0);
+  SU_TEST_ASSERT(found == spikes);
+
+  /* Bulk feed, in odd chunks, stopping at every peak now and then */
+  n = 0;
+  for (p = 0, chunk = 1; p < size; p += chunk, chunk += 2) {
+    if (chunk > size - p)
+      chunk = size - p;
+
+    if (chunk % 3 == 0) {
+      /* One peak at a time */
+      for (i = 0; i < chunk; ++i) {
+        if (su_peak_detector_feed_bulk(
+            &bulk,
+            x + p + i,
+            chunk - i,
+            peaks + n,
+            1) == 0)
+          break;
+
+        peaks[n] += p + i;
+        i = peaks[n++] - p;
+      }
+    } else {
+      SU_TEST_ASSERT(
+          (i = su_peak_detector_feed_bulk(
+              &bulk,
+              x + p,
+              chunk,
+              peaks + n,
+              size)) <= chunk);
+
+      for (; i > 0; --i)
+        peaks[n++] += p;
+    }
+  }
+
+  SU_TEST_ASSERT(n == count);
+
+  /* Same peaks as sample by sample */
+  su_peak_detector_finalize(&pd);
+  SU_TEST_ASSERT(su_peak_detector_init(&pd, SU_TEST_PEAK_DETECTOR_SIZE, 3));
+
+  for (i = 0, n = 0; i < size; ++i)
+    if (su_peak_detector_feed(&pd, x[i]) > 0)
+      SU_TEST_ASSERT(peaks[n++] == i);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_peak_detector_finalize(&pd);
+  su_peak_detector_finalize(&bulk);
+
+  if (ref.history != NULL)
+    free(ref.history);
+
+  if (x != NULL)
+    free(x);
+
+  if (peaks != NULL)
+    free(peaks);
+
+  return ok;
+}
+
+SUBOOL
+su_test_peak_detector_benchmark(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  su_peak_detector_t pd = su_peak_detector_INITIALIZER;
+  struct su_test_peak_reference ref;
+  SUFLOAT *x = NULL;
+  SUSCOUNT *peaks = NULL;
+  SUSCOUNT size = SU_TEST_PEAK_DETECTOR_BENCH_SAMPLES;
+  SUSCOUNT i, pd_size;
+  struct timeval start, end, diff;
+  SUFLOAT ref_time, bulk_time;
+
+  memset(&ref, 0, sizeof(ref));
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUFLOAT)));
+  SU_TEST_ASSERT(peaks = malloc(size * sizeof(SUSCOUNT)));
+  SU_TEST_ASSERT(
+      ref.history = malloc(
+          SU_TEST_PEAK_DETECTOR_BENCH_MAX_SIZE * sizeof(double)));
+
+  for (i = 0; i < size; ++i)
+    x[i] = su_test_peak_detector_sample(i);
+
+  SU_TEST_TICK(ctx);
+
+  for (pd_size = SU_TEST_PEAK_DETECTOR_BENCH_MIN_SIZE;
+       pd_size <= SU_TEST_PEAK_DETECTOR_BENCH_MAX_SIZE;
+       pd_size <<= 2) {
+    ref.size = pd_size;
+    ref.count = 0;
+    ref.p = 0;
+    ref.thr2 = 3 * 3;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < size; ++i)
+      (void) su_test_peak_reference_feed(&ref, x[i]);
+    gettimeofday(&end, NULL);
+    timersub(&end, &start, &diff);
+    ref_time = diff.tv_sec + 1e-6 * diff.tv_usec;
+
+    SU_TEST_ASSERT(su_peak_detector_init(&pd, pd_size, 3));
+
+    gettimeofday(&start, NULL);
+    (void) su_peak_detector_feed_bulk(&pd, x, size, peaks, size);
+    gettimeofday(&end, NULL);
+    timersub(&end, &start, &diff);
+    bulk_time = diff.tv_sec + 1e-6 * diff.tv_usec;
+
+    su_peak_detector_finalize(&pd);
+    pd.history = NULL;
+
+    SU_INFO(
+        "pd_size %4d: recomputed %g Msps, running %g Msps (x%g)\n",
+        pd_size,
+        1e-6 * size / ref_time,
+        1e-6 * size / bulk_time,
+        ref_time / bulk_time);
+  }
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_peak_detector_finalize(&pd);
+
+  if (ref.history != NULL)
+    free(ref.history);
+
+  if (x != NULL)
+    free(x);
+
+  if (peaks != NULL)
+    free(peaks);
+
+  return ok;
+}
+
+/* Periodic Blackmann-Harris window, as applied by the shared FFT path */
+SUPRIVATE SUFLOAT
+su_test_channel_detector_periodic_bh(SUSCOUNT n, SUSCOUNT size)
+{
+  SUFLOAT t = 2 * PI * n / (SUFLOAT) size;
+
+  return SU_BLACKMANN_HARRIS_A0
+      - SU_BLACKMANN_HARRIS_A1 * SU_COS(t)
+      + SU_BLACKMANN_HARRIS_A2 * SU_COS(2 * t)
+      - SU_BLACKMANN_HARRIS_A3 * SU_COS(3 * t);
+}
+
+struct su_test_shared_channels {
+  SUSCOUNT samples[2 * SU_TEST_CHANNEL_DETECTOR_SHARED_CARRIERS];
+  unsigned int overflow;
+};
+
+SUPRIVATE SUBOOL
+su_test_channel_detector_shared_on_data(
+    const su_specttuner_channel_t *channel,
+    void *privdata,
+    const SUCOMPLEX *data,
+    SUSCOUNT size)
+{
+  struct su_test_shared_channels *channels =
+      (struct su_test_shared_channels *) privdata;
+
+  if (channel->index < 2 * SU_TEST_CHANNEL_DETECTOR_SHARED_CARRIERS)
+    channels->samples[channel->index] += size;
+  else
+    ++channels->overflow;
+
+  return SU_TRUE;
+}
+
+SUBOOL
+su_test_channel_detector_specttuner(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SU_FFTW(_complex) *spectrum = NULL;
+  SU_FFTW(_complex) *window = NULL;
+  SU_FFTW(_complex) *ref = NULL;
+  SUFLOAT *window_real = NULL;
+  SUCOMPLEX *x = NULL;
+  su_fft_plan_t *plan = NULL;
+  su_fft_plan_t *plan_fwd = NULL;
+  su_fft_plan_t *plan_r2c = NULL;
+  struct sigutils_channel_detector_params params =
+      sigutils_channel_detector_params_INITIALIZER;
+  struct sigutils_specttuner_params st_params =
+      sigutils_specttuner_params_INITIALIZER;
+  struct sigutils_specttuner_channel_params ch_params =
+      sigutils_specttuner_channel_params_INITIALIZER;
+  struct su_test_shared_channels channels;
+  su_channel_detector_t *detector = NULL;
+  su_channel_detector_t *ref_det = NULL;
+  su_specttuner_t *st = NULL;
+  const su_specttuner_channel_t *channel;
+  SUSCOUNT size = SU_TEST_CHANNEL_DETECTOR_BATCH_WINDOW_SIZE;
+  SUSCOUNT spacing = size / SU_TEST_CHANNEL_DETECTOR_SHARED_CARRIERS;
+  SUSCOUNT len = size * SU_TEST_CHANNEL_DETECTOR_SHARED_WINDOWS;
+  SUSCOUNT bins;
+  SUCOMPLEX dc;
+  SUFLOAT err, max_err, f0, delta;
+  unsigned int covering;
+  unsigned int i, j, k, real;
+
+  memset(&channels, 0, sizeof(channels));
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(
+      spectrum = SU_FFTW(_malloc)(size * sizeof(SU_FFTW(_complex))));
+  SU_TEST_ASSERT(
+      window = SU_FFTW(_malloc)(size * sizeof(SU_FFTW(_complex))));
+  SU_TEST_ASSERT(ref = SU_FFTW(_malloc)(size * sizeof(SU_FFTW(_complex))));
+  SU_TEST_ASSERT(window_real = SU_FFTW(_malloc)(size * sizeof(SUFLOAT)));
+  SU_TEST_ASSERT(x = malloc(len * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(
+      plan = su_fft_plan_acquire(size, FFTW_BACKWARD, spectrum, window));
+  SU_TEST_ASSERT(
+      plan_fwd = su_fft_plan_acquire(size, FFTW_FORWARD, window, ref));
+  SU_TEST_ASSERT(
+      plan_r2c = su_fft_plan_acquire_r2c(size, window_real, ref));
+
+  /* Same band as in the index test, with fewer carriers */
+  for (i = 0; i < SU_TEST_CHANNEL_DETECTOR_SHARED_WINDOWS; ++i) {
+    for (j = 0; j < size; ++j)
+      spectrum[j] = .1 * su_c_awgn();
+
+    for (k = 0; k < SU_TEST_CHANNEL_DETECTOR_SHARED_CARRIERS; ++k)
+      for (j = 0; j < 4; ++j)
+        spectrum[k * spacing + spacing / 2 + j] =
+            10 * SU_C_EXP(2 * I * PI * rand() / (SUFLOAT) RAND_MAX);
+
+    su_fft_plan_execute(plan, spectrum, window);
+
+    for (j = 0; j < size; ++j)
+      x[i * size + j] = window[j] / SU_SQRT(size);
+  }
+
+  SU_TEST_TICK(ctx);
+
+  /*
+   * Window correction: the spectrum of the unwindowed samples, once fed,
+   * must match the FFT of the samples with the DC removed and windowed.
+   */
+  params.mode = SU_CHANNEL_DETECTOR_MODE_SPECTRUM;
+  params.samp_rate = 250000;
+  params.window_size = size;
+  params.window = SU_CHANNEL_DETECTOR_WINDOW_BLACKMANN_HARRIS;
+
+  for (real = 0; real < 2; ++real) {
+    params.real = real;
+    SU_TEST_ASSERT(detector = su_channel_detector_new(&params));
+
+    dc = real ? .3 : .3 + .2 * I;
+    detector->dc = dc;
+
+    if (real) {
+      bins = size / 2 + 1;
+      for (j = 0; j < size; ++j)
+        window_real[j] = SU_C_REAL(x[j]);
+      su_fft_plan_execute_r2c(plan_r2c, window_real, spectrum);
+
+      for (j = 0; j < size; ++j)
+        window_real[j] = (window_real[j] - SU_C_REAL(dc))
+            * su_test_channel_detector_periodic_bh(j, size);
+      su_fft_plan_execute_r2c(plan_r2c, window_real, ref);
+    } else {
+      bins = size;
+      memcpy(window, x, size * sizeof(SUCOMPLEX));
+      su_fft_plan_execute(plan_fwd, window, spectrum);
+
+      for (j = 0; j < size; ++j)
+        window[j] = (x[j] - dc) * su_test_channel_detector_periodic_bh(j, size);
+      su_fft_plan_execute(plan_fwd, window, ref);
+    }
+
+    SU_TEST_ASSERT(su_channel_detector_feed_spectrum(detector, spectrum));
+
+    max_err = 0;
+    for (j = 0; j < bins; ++j) {
+      err = SU_C_ABS(detector->fft[j] - ref[j]);
+      if (err > max_err)
+        max_err = err;
+    }
+
+    SU_INFO(
+        "%s input: max windowing error %g\n",
+        real ? "Real" : "Complex",
+        max_err);
+    SU_TEST_ASSERT(max_err < SU_TEST_CHANNEL_DETECTOR_SHARED_MAX_ERROR);
+
+    su_channel_detector_destroy(detector);
+    detector = NULL;
+  }
+
+  SU_TEST_TICK(ctx);
+
+  /*
+   * Shared FFT against a detector of its own: the tuner transforms
+   * windows overlapped by half, as the detector does with hop = size / 2.
+   * Rectangular windows make both paths equivalent.
+   */
+  params.mode = SU_CHANNEL_DETECTOR_MODE_DISCOVERY;
+  params.window = SU_CHANNEL_DETECTOR_WINDOW_NONE;
+  params.real = SU_FALSE;
+  params.alpha = .5;
+
+  st_params.window_size = size;
+
+  SU_TEST_ASSERT(st = su_specttuner_new(&st_params));
+  SU_TEST_ASSERT(detector = su_channel_detector_new(&params));
+  SU_TEST_ASSERT(su_channel_detector_attach_specttuner(detector, st, NULL));
+
+  /* Attached detectors take no samples of their own */
+  SU_TEST_ASSERT(su_channel_detector_feed_bulk(detector, x, size) == 0);
+
+  params.hop = size / 2;
+  SU_TEST_ASSERT(ref_det = su_channel_detector_new(&params));
+
+  SU_TEST_ASSERT(su_specttuner_feed_bulk(st, x, len));
+  SU_TEST_ASSERT(su_channel_detector_feed_bulk(ref_det, x, len) == len);
+
+  SU_TEST_ASSERT(detector->iters == ref_det->iters);
+
+  max_err = 0;
+  for (j = 0; j < size; ++j) {
+    err = SU_ABS(detector->spect[j] - ref_det->spect[j]) / ref_det->spect[j];
+    if (err > max_err)
+      max_err = err;
+  }
+
+  SU_INFO("Shared FFT: max relative PSD error %g\n", max_err);
+  SU_TEST_ASSERT(max_err < SU_TEST_CHANNEL_DETECTOR_SHARED_MAX_ERROR);
+  SU_TEST_ASSERT(detector->channel_count == ref_det->channel_count);
+
+  su_channel_detector_destroy(detector);
+  detector = NULL;
+  su_specttuner_destroy(st);
+  st = NULL;
+
+  SU_TEST_TICK(ctx);
+
+  /* Detect and channelize: one tuner channel per carrier */
+  params.window = SU_CHANNEL_DETECTOR_WINDOW_HANN;
+  params.hop = 0;
+
+  ch_params.privdata = &channels;
+  ch_params.on_data = su_test_channel_detector_shared_on_data;
+
+  SU_TEST_ASSERT(st = su_specttuner_new(&st_params));
+  SU_TEST_ASSERT(detector = su_channel_detector_new(&params));
+  SU_TEST_ASSERT(
+      su_channel_detector_attach_specttuner(detector, st, &ch_params));
+
+  SU_TEST_ASSERT(su_specttuner_feed_bulk(st, x, len));
+
+  SU_INFO(
+      "%d channels opened for %d carriers\n",
+      su_specttuner_get_channel_count(st),
+      SU_TEST_CHANNEL_DETECTOR_SHARED_CARRIERS);
+
+  SU_TEST_ASSERT(
+      su_specttuner_get_channel_count(st)
+      == SU_TEST_CHANNEL_DETECTOR_SHARED_CARRIERS);
+  SU_TEST_ASSERT(channels.overflow == 0);
+
+  for (k = 0; k < SU_TEST_CHANNEL_DETECTOR_SHARED_CARRIERS; ++k) {
+    f0 = 2 * PI * (k * spacing + spacing / 2 + 1.5) / size;
+    covering = 0;
+
+    for (i = 0; i < st->channel_count; ++i) {
+      if ((channel = st->channel_list[i]) == NULL)
+        continue;
+
+      delta = SU_ABS(f0 - channel->params.f0);
+      if (delta > PI)
+        delta = 2 * PI - delta;
+
+      if (delta < .5 * channel->params.bw) {
+        SU_TEST_ASSERT(channels.samples[i] > 0);
+        ++covering;
+      }
+    }
+
+    SU_TEST_ASSERT(covering == 1);
+  }
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (detector != NULL)
+    su_channel_detector_destroy(detector);
+
+  if (ref_det != NULL)
+    su_channel_detector_destroy(ref_det);
+
+  if (st != NULL)
+    su_specttuner_destroy(st);
+
+  if (plan != NULL)
+    su_fft_plan_release(plan);
+
+  if (plan_fwd != NULL)
+    su_fft_plan_release(plan_fwd);
+
+  if (plan_r2c != NULL)
+    su_fft_plan_release(plan_r2c);
+
+  if (spectrum != NULL)
+    SU_FFTW(_free)(spectrum);
+
+  if (window != NULL)
+    SU_FFTW(_free)(window);
+
+  if (ref != NULL)
+    SU_FFTW(_free)(ref);
+
+  if (window_real != NULL)
+    SU_FFTW(_free)(window_real);
+
+  if (x != NULL)
+    free(x);
+
+  return ok;
+}
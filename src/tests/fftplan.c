@@ -0,0 +1,195 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <sigutils/fftplan.h>
+
+#include <sigutils/sigutils.h>
+
+#include "test_list.h"
+#include "test_param.h"
+
+/*
+ * Plans are shared by (size, direction, placement, alignment): equal
+ * requests get the same plan, and every other one a plan of its own.
+ */
+SUBOOL
+su_test_fft_plan_registry(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SU_FFTW(_complex) *in = NULL;
+  SU_FFTW(_complex) *out = NULL;
+  su_fft_plan_t *plan = NULL;
+  su_fft_plan_t *other[5] = {NULL, NULL, NULL, NULL, NULL};
+  su_fft_plan_t *again = NULL;
+  unsigned int size = SU_TEST_FFT_PLAN_SIZE;
+  unsigned int i, j;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  /* One extra element, so that in + 1 is a valid unaligned buffer */
+  SU_TEST_ASSERT(
+      in = SU_FFTW(_malloc)(2 * (size + 1) * sizeof(SU_FFTW(_complex))));
+  SU_TEST_ASSERT(
+      out = SU_FFTW(_malloc)(2 * (size + 1) * sizeof(SU_FFTW(_complex))));
+
+  SU_TEST_TICK(ctx);
+
+  SU_TEST_ASSERT(plan = su_fft_plan_acquire(size, FFTW_FORWARD, in, out));
+  SU_TEST_ASSERT(plan->refcnt == 1);
+
+  /* Same key: same plan, one more reference */
+  SU_TEST_ASSERT(
+      (again = su_fft_plan_acquire(size, FFTW_FORWARD, in, out)) == plan);
+  SU_TEST_ASSERT(plan->refcnt == 2);
+
+  /* Any change in the key gives a different plan */
+  SU_TEST_ASSERT(
+      other[0] = su_fft_plan_acquire(size + 2, FFTW_FORWARD, in, out));
+  SU_TEST_ASSERT(
+      other[1] = su_fft_plan_acquire(size, FFTW_BACKWARD, in, out));
+  SU_TEST_ASSERT(
+      other[2] = su_fft_plan_acquire(size, FFTW_FORWARD, in, in));
+  SU_TEST_ASSERT(
+      other[3] = su_fft_plan_acquire(size, FFTW_FORWARD, in + 1, out + 1));
+  SU_TEST_ASSERT(
+      other[4] = su_fft_plan_acquire_many(size, 2, FFTW_FORWARD, in, out));
+
+  SU_TEST_ASSERT(other[2]->key.inplace);
+  SU_TEST_ASSERT(other[3]->key.unaligned);
+  SU_TEST_ASSERT(!plan->key.inplace && !plan->key.unaligned);
+
+  for (i = 0; i < 5; ++i) {
+    SU_TEST_ASSERT(other[i] != plan);
+    SU_TEST_ASSERT(other[i]->refcnt == 1);
+    for (j = 0; j < i; ++j)
+      SU_TEST_ASSERT(other[i] != other[j]);
+  }
+
+  /* Releases drop references, but the plan stays registered */
+  su_fft_plan_release(again);
+  again = NULL;
+  SU_TEST_ASSERT(plan->refcnt == 1);
+
+  su_fft_plan_release(plan);
+  SU_TEST_ASSERT(plan->refcnt == 0);
+
+  SU_TEST_ASSERT(
+      (again = su_fft_plan_acquire(size, FFTW_FORWARD, in, out)) == plan);
+  SU_TEST_ASSERT(plan->refcnt == 1);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (again != NULL)
+    su_fft_plan_release(again);
+
+  for (i = 0; i < 5; ++i)
+    if (other[i] != NULL)
+      su_fft_plan_release(other[i]);
+
+  if (in != NULL)
+    SU_FFTW(_free) (in);
+
+  if (out != NULL)
+    SU_FFTW(_free) (out);
+
+  return ok;
+}
+
+/*
+ * Measured plans are saved as wisdom in the configured file, which
+ * su_fft_plan_init loads back.
+ */
+SUBOOL
+su_test_fft_plan_wisdom(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SU_FFTW(_complex) *in = NULL;
+  SU_FFTW(_complex) *out = NULL;
+  su_fft_plan_t *plan = NULL;
+  struct sigutils_fft_plan_config saved =
+      sigutils_fft_plan_config_INITIALIZER;
+  struct sigutils_fft_plan_config config =
+      sigutils_fft_plan_config_INITIALIZER;
+  struct stat sbuf;
+  SUBOOL restore = SU_FALSE;
+  unsigned int size = SU_TEST_FFT_PLAN_WISDOM_SIZE;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(in = SU_FFTW(_malloc)(size * sizeof(SU_FFTW(_complex))));
+  SU_TEST_ASSERT(out = SU_FFTW(_malloc)(size * sizeof(SU_FFTW(_complex))));
+
+  su_fft_plan_get_config(&saved);
+  SU_TEST_ASSERT(saved.wisdom_file == NULL);
+
+  (void) remove(SU_TEST_FFT_PLAN_WISDOM_FILE);
+
+  config.mode = SU_FFT_PLAN_MODE_MEASURE;
+  config.wisdom_file = SU_TEST_FFT_PLAN_WISDOM_FILE;
+  SU_TEST_ASSERT(su_fft_plan_set_config(&config));
+  restore = SU_TRUE;
+
+  /* A missing wisdom file is not an error */
+  SU_TEST_ASSERT(su_fft_plan_init());
+
+  SU_TEST_TICK(ctx);
+
+  /* Planning in measure mode saves the wisdom right away */
+  SU_TEST_ASSERT(plan = su_fft_plan_acquire(size, FFTW_FORWARD, in, out));
+  SU_TEST_ASSERT(stat(SU_TEST_FFT_PLAN_WISDOM_FILE, &sbuf) == 0);
+  SU_TEST_ASSERT(sbuf.st_size > 0);
+
+  SU_TEST_ASSERT(su_fft_plan_save_wisdom());
+
+  /* Forget it, and get it back from the file */
+  SU_FFTW(_forget_wisdom) ();
+  SU_TEST_ASSERT(su_fft_plan_init());
+  SU_TEST_ASSERT(
+      SU_FFTW(_import_wisdom_from_filename) (SU_TEST_FFT_PLAN_WISDOM_FILE));
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (plan != NULL)
+    su_fft_plan_release(plan);
+
+  if (restore)
+    (void) su_fft_plan_set_config(&saved);
+
+  (void) remove(SU_TEST_FFT_PLAN_WISDOM_FILE);
+
+  if (in != NULL)
+    SU_FFTW(_free) (in);
+
+  if (out != NULL)
+    SU_FFTW(_free) (out);
+
+  return ok;
+}
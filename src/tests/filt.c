@@ -21,10 +21,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include <sigutils/sampling.h>
 #include <sigutils/ncqo.h>
 #include <sigutils/iir.h>
+#include <sigutils/fir.h>
+#include <sigutils/sos.h>
+#include <sigutils/cic.h>
+#include <sigutils/taps.h>
+#include <sigutils/simd.h>
 #include <sigutils/agc.h>
 #include <sigutils/pll.h>
 
@@ -88,4 +94,869 @@ done:
   return ok;
 }
 
+SUBOOL
+su_test_fir_direct_form(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *y = NULL;
+  SUCOMPLEX *ref = NULL;
+  SUFLOAT *b = NULL;
+  SUSCOUNT size = SU_TEST_FIR_BUFFER_SIZE;
+  SUSCOUNT taps = SU_TEST_FIR_TAPS;
+  SUSCOUNT chunk, p, i;
+  enum sigutils_simd_level saved = su_simd_get_level();
+  enum sigutils_simd_level level;
+  su_fir_filt_t fir = su_fir_filt_INITIALIZER;
+  su_iir_filt_t iir = su_iir_filt_INITIALIZER;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(y = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(ref = calloc(size, sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(b = malloc(taps * sizeof(SUFLOAT)));
+
+  su_taps_rrc_init(b, SU_TEST_MF_SYMBOL_SPAN, SU_TEST_COSTAS_BETA, taps);
+
+  for (p = 0; p < size; ++p)
+    x[p] = su_c_awgn();
+
+  /* Reference: textbook convolution */
+  for (p = 0; p < size; ++p)
+    for (i = 0; i < taps && i <= p; ++i)
+      ref[p] += b[i] * x[p - i];
+
+  SU_TEST_TICK(ctx);
+
+  for (level = SU_SIMD_LEVEL_SCALAR;
+       level <= su_simd_get_max_level();
+       ++level) {
+    su_simd_set_level(level);
+
+    /* Sample by sample */
+    SU_TEST_ASSERT(su_fir_filt_init(&fir, b, taps));
+    for (p = 0; p < size; ++p)
+      SU_TEST_ASSERT(SU_C_ABS(su_fir_filt_feed(&fir, x[p]) - ref[p])
+          < SU_TEST_FIR_MAX_ERROR);
+    su_fir_filt_finalize(&fir);
+
+    /* In place, growing chunks that straddle the delay line rewinds */
+    SU_TEST_ASSERT(su_fir_filt_init(&fir, b, taps));
+    memcpy(y, x, size * sizeof(SUCOMPLEX));
+    for (p = 0, chunk = 1; p < size; p += chunk, chunk = 2 * chunk + 1) {
+      if (chunk > size - p)
+        chunk = size - p;
+      su_fir_filt_feed_bulk(&fir, y + p, y + p, chunk);
+    }
+
+    for (p = 0; p < size; ++p)
+      SU_TEST_ASSERT(SU_C_ABS(y[p] - ref[p]) < SU_TEST_FIR_MAX_ERROR);
+    su_fir_filt_finalize(&fir);
+
+    /* Through the IIR wrapper, which must delegate to the FIR engine */
+    SU_TEST_ASSERT(su_iir_filt_init(&iir, 0, NULL, taps, b));
+    SU_TEST_ASSERT(iir.fir != NULL);
+    su_iir_filt_set_gain(&iir, 2);
+    su_iir_filt_feed_bulk(&iir, x, y, size);
+    for (p = 0; p < size; ++p)
+      SU_TEST_ASSERT(SU_C_ABS(y[p] - 2 * ref[p]) < 2 * SU_TEST_FIR_MAX_ERROR);
+    SU_TEST_ASSERT(su_iir_filt_get(&iir) == y[size - 1]);
+    su_iir_filt_finalize(&iir);
+
+    /* Bulk and single feeds, mixed: gain must be applied exactly once */
+    SU_TEST_ASSERT(su_iir_filt_init(&iir, 0, NULL, taps, b));
+    su_iir_filt_set_gain(&iir, 2);
+    su_iir_filt_feed_bulk(&iir, x, y, size / 2);
+    for (p = size / 2; p < size; ++p) {
+      y[p] = su_iir_filt_feed(&iir, x[p]);
+      SU_TEST_ASSERT(su_iir_filt_get(&iir) == y[p]);
+    }
+    for (p = 0; p < size; ++p)
+      SU_TEST_ASSERT(SU_C_ABS(y[p] - 2 * ref[p]) < 2 * SU_TEST_FIR_MAX_ERROR);
+    su_iir_filt_finalize(&iir);
+    iir = (su_iir_filt_t) su_iir_filt_INITIALIZER;
+
+    SU_INFO(
+        "%s: %d taps match the reference\n",
+        su_simd_level_to_string(level),
+        taps);
+  }
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_simd_set_level(saved);
+
+  su_fir_filt_finalize(&fir);
+  su_iir_filt_finalize(&iir);
+
+  if (x != NULL)
+    free(x);
+
+  if (y != NULL)
+    free(y);
+
+  if (ref != NULL)
+    free(ref);
+
+  if (b != NULL)
+    free(b);
+
+  return ok;
+}
+
+SUBOOL
+su_test_fir_overlap_save(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *y = NULL;
+  SUCOMPLEX *ref = NULL;
+  SUFLOAT *b = NULL;
+  SUSCOUNT size = SU_TEST_FIR_FFT_BUFFER_SIZE;
+  SUSCOUNT taps = SU_TEST_FIR_FFT_TAPS;
+  SUSCOUNT latency;
+  SUSCOUNT chunk, p;
+  su_fir_filt_t direct = su_fir_filt_INITIALIZER;
+  su_fir_filt_t fft = su_fir_filt_INITIALIZER;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(y = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(ref = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(b = malloc(taps * sizeof(SUFLOAT)));
+
+  su_taps_brickwall_bp_init(b, .01, .2, taps);
+
+  for (p = 0; p < size; ++p)
+    x[p] = su_c_awgn();
+
+  SU_TEST_ASSERT(su_fir_filt_init(&direct, b, taps));
+  su_fir_filt_feed_bulk(&direct, x, ref, size);
+
+  SU_TEST_ASSERT(
+      su_fir_filt_init_ex(&fft, b, taps, SU_FIR_FILT_MODE_AUTO));
+  SU_TEST_ASSERT(su_fir_filt_is_fft(&fft));
+
+  latency = su_fir_filt_get_latency(&fft);
+  SU_TEST_ASSERT(latency > 0 && latency < size);
+
+  SU_INFO(
+      "%d taps: FFT size %d, latency %d samples\n",
+      taps,
+      fft.fft_size,
+      latency);
+
+  SU_TEST_TICK(ctx);
+
+  /* In place, odd chunk sizes */
+  memcpy(y, x, size * sizeof(SUCOMPLEX));
+  for (p = 0, chunk = 1; p < size; p += chunk, chunk = 3 * chunk + 1) {
+    if (chunk > size - p)
+      chunk = size - p;
+    su_fir_filt_feed_bulk(&fft, y + p, y + p, chunk);
+  }
+
+  for (p = 0; p < latency; ++p)
+    SU_TEST_ASSERT(y[p] == 0);
+
+  for (p = latency; p < size; ++p)
+    SU_TEST_ASSERT(
+        SU_C_ABS(y[p] - ref[p - latency]) < SU_TEST_FIR_FFT_MAX_ERROR);
+
+  /* Sample by sample, after a reset */
+  su_fir_filt_reset(&fft);
+  for (p = 0; p < size; ++p)
+    y[p] = su_fir_filt_feed(&fft, x[p]);
+
+  for (p = latency; p < size; ++p)
+    SU_TEST_ASSERT(
+        SU_C_ABS(y[p] - ref[p - latency]) < SU_TEST_FIR_FFT_MAX_ERROR);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_fir_filt_finalize(&direct);
+  su_fir_filt_finalize(&fft);
+
+  if (x != NULL)
+    free(x);
+
+  if (y != NULL)
+    free(y);
+
+  if (ref != NULL)
+    free(ref);
+
+  if (b != NULL)
+    free(b);
+
+  return ok;
+}
+
+SUPRIVATE SUFLOAT
+su_fir_bench_run(
+    const SUFLOAT *b,
+    SUSCOUNT taps,
+    enum sigutils_fir_filt_mode mode,
+    SUCOMPLEX *x,
+    SUSCOUNT size)
+{
+  su_fir_filt_t fir = su_fir_filt_INITIALIZER;
+  struct timeval start, end, diff;
+  SUFLOAT t, best = -1;
+  unsigned int i;
+
+  if (!su_fir_filt_init_ex(&fir, b, taps, mode))
+    return -1;
+
+  /* Best of several runs, to leave cache misses and page faults out */
+  for (i = 0; i < SU_TEST_FIR_BENCH_RUNS; ++i) {
+    gettimeofday(&start, NULL);
+    su_fir_filt_feed_bulk(&fir, x, x, size);
+    gettimeofday(&end, NULL);
+
+    timersub(&end, &start, &diff);
+
+    t = diff.tv_sec + 1e-6 * diff.tv_usec;
+    if (best < 0 || t < best)
+      best = t;
+  }
+
+  su_fir_filt_finalize(&fir);
+
+  return best;
+}
+
+SUBOOL
+su_test_fir_benchmark(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *x = NULL;
+  SUFLOAT *b = NULL;
+  SUSCOUNT size = SU_TEST_FIR_BENCH_SAMPLES;
+  SUSCOUNT taps;
+  SUSCOUNT crossover = 0;
+  SUFLOAT direct_time, fft_time;
+  SUSCOUNT p;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(b = malloc(SU_TEST_FIR_BENCH_MAX_TAPS * sizeof(SUFLOAT)));
+
+  for (p = 0; p < size; ++p)
+    x[p] = su_c_awgn();
+
+  SU_TEST_TICK(ctx);
+
+  for (taps = SU_TEST_FIR_BENCH_MIN_TAPS;
+       taps <= SU_TEST_FIR_BENCH_MAX_TAPS;
+       taps <<= 1) {
+    su_taps_brickwall_lp_init(b, .1, taps);
+
+    SU_TEST_ASSERT(
+        (direct_time = su_fir_bench_run(
+            b,
+            taps,
+            SU_FIR_FILT_MODE_DIRECT,
+            x,
+            size)) >= 0);
+
+    SU_TEST_ASSERT(
+        (fft_time = su_fir_bench_run(
+            b,
+            taps,
+            SU_FIR_FILT_MODE_FFT,
+            x,
+            size)) >= 0);
+
+    if (crossover == 0 && fft_time < direct_time)
+      crossover = taps;
+
+    SU_INFO(
+        "%4d taps: direct %g Msps, overlap-save %g Msps (x%g)\n",
+        taps,
+        1e-6 * size / direct_time,
+        1e-6 * size / fft_time,
+        direct_time / fft_time);
+  }
+
+  if (crossover > 0)
+    SU_INFO(
+        "Overlap-save wins from %d taps (threshold: %d)\n",
+        crossover,
+        su_fir_filt_get_fft_threshold());
+  else
+    SU_INFO("Overlap-save never wins on this machine\n");
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (x != NULL)
+    free(x);
+
+  if (b != NULL)
+    free(b);
+
+  return ok;
+}
+
+/* Steady state gain for a tone of normalized frequency f */
+SUPRIVATE SUFLOAT
+su_sos_test_tone_gain(su_sos_filt_t *filt, SUFLOAT f, SUSCOUNT size)
+{
+  su_ncqo_t ncqo = su_ncqo_INITIALIZER;
+  SUSCOUNT p;
+  SUCOMPLEX y = 0;
+
+  su_ncqo_init(&ncqo, f);
+  su_sos_filt_reset(filt);
+
+  for (p = 0; p < size; ++p)
+    y = su_sos_filt_feed(filt, su_ncqo_read(&ncqo));
+
+  return SU_C_ABS(y);
+}
+
+SUBOOL
+su_test_sos_butterworth(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SUSCOUNT size = SU_TEST_SOS_BUFFER_SIZE;
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *y = NULL;
+  SUCOMPLEX ref;
+  SUFLOAT max_err;
+  SUFLOAT expected;
+  SUSCOUNT p;
+  su_iir_filt_t iir = su_iir_filt_INITIALIZER;
+  su_sos_filt_t sos = su_sos_filt_INITIALIZER;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(y = malloc(size * sizeof(SUCOMPLEX)));
+
+  for (p = 0; p < size; ++p)
+    x[p] = su_c_awgn();
+
+  SU_TEST_TICK(ctx);
+
+  /* Low pass: must match the direct form polynomial */
+  SU_TEST_ASSERT(su_iir_bwlpf_init(&iir, SU_TEST_SOS_ORDER, .25));
+  SU_TEST_ASSERT(su_sos_bwlpf_init(&sos, SU_TEST_SOS_ORDER, .25, 1));
+
+  su_sos_filt_feed_bulk(&sos, x, y, size);
+
+  max_err = 0;
+  for (p = 0; p < size; ++p) {
+    ref = su_iir_filt_feed(&iir, x[p]);
+    if (SU_C_ABS(y[p] - ref) > max_err)
+      max_err = SU_C_ABS(y[p] - ref);
+  }
+
+  SU_INFO("Low pass, order %d: max error %g\n", SU_TEST_SOS_ORDER, max_err);
+  SU_TEST_ASSERT(max_err < SU_TEST_SOS_MAX_ERROR);
+
+  su_iir_filt_finalize(&iir);
+  iir = (su_iir_filt_t) su_iir_filt_INITIALIZER;
+  su_sos_filt_finalize(&sos);
+
+  /* Band pass, odd order: -3 dB at the edges */
+  SU_TEST_ASSERT(
+      su_sos_bwbpf_init(&sos, SU_TEST_SOS_ORDER - 1, .2, .3, 1));
+
+  for (p = 0; p < 3; ++p) {
+    expected = p == 1 ? 1 : 1 / SU_SQRT2;
+    max_err = SU_ABS(
+        su_sos_test_tone_gain(&sos, .2 + .05 * p, size) - expected);
+
+    SU_INFO(
+        "Band pass, order %d, f = %g: gain error %g\n",
+        SU_TEST_SOS_ORDER - 1,
+        .2 + .05 * p,
+        max_err);
+    SU_TEST_ASSERT(max_err < SU_TEST_SOS_MAX_ERROR);
+  }
+
+  su_sos_filt_finalize(&sos);
+
+  /*
+   * Very narrow low pass: must remain stable and let DC through. Rounding
+   * in single precision sections still leaves a small DC gain error.
+   */
+  SU_TEST_ASSERT(
+      su_sos_bwlpf_init(
+          &sos,
+          SU_TEST_SOS_NARROW_ORDER,
+          SU_TEST_SOS_NARROW_FC,
+          1));
+
+  for (p = 0; p < size; ++p)
+    y[p] = 1;
+
+  su_sos_filt_feed_bulk(&sos, y, y, size);
+
+  SU_INFO(
+      "Narrow low pass, order %d, fc = %g: DC gain %g\n",
+      SU_TEST_SOS_NARROW_ORDER,
+      SU_TEST_SOS_NARROW_FC,
+      SU_C_REAL(y[size - 1]));
+  SU_TEST_ASSERT(
+      SU_C_ABS(y[size - 1] - 1) < SU_TEST_SOS_NARROW_MAX_ERROR);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_iir_filt_finalize(&iir);
+  su_sos_filt_finalize(&sos);
+
+  if (x != NULL)
+    free(x);
 
+  if (y != NULL)
+    free(y);
+
+  return ok;
+}
+
+SUBOOL
+su_test_sos_multichannel(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SUSCOUNT size = SU_TEST_SOS_BUFFER_SIZE;
+  unsigned int channels = SU_TEST_SOS_CHANNELS;
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *y = NULL;
+  SUCOMPLEX *ref = NULL;
+  enum sigutils_simd_level saved = su_simd_get_level();
+  enum sigutils_simd_level level;
+  su_sos_filt_t bank = su_sos_filt_INITIALIZER;
+  su_sos_filt_t single = su_sos_filt_INITIALIZER;
+  SUSCOUNT p;
+  unsigned int c;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(x = malloc(size * channels * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(y = malloc(size * channels * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(ref = malloc(size * channels * sizeof(SUCOMPLEX)));
+
+  for (p = 0; p < size * channels; ++p)
+    x[p] = su_c_awgn();
+
+  /* Reference: every channel on its own, sample by sample */
+  for (c = 0; c < channels; ++c) {
+    SU_TEST_ASSERT(su_sos_bwlpf_init(&single, SU_TEST_SOS_ORDER, .1, 1));
+    for (p = 0; p < size; ++p)
+      ref[p * channels + c] = su_sos_filt_feed(&single, x[p * channels + c]);
+    su_sos_filt_finalize(&single);
+  }
+
+  SU_TEST_TICK(ctx);
+
+  for (level = SU_SIMD_LEVEL_SCALAR;
+       level <= su_simd_get_max_level();
+       ++level) {
+    su_simd_set_level(level);
+
+    SU_TEST_ASSERT(
+        su_sos_bwlpf_init(&bank, SU_TEST_SOS_ORDER, .1, channels));
+
+    /* Two calls, so the state is carried across */
+    su_sos_filt_feed_bulk(&bank, x, y, size / 2);
+    su_sos_filt_feed_bulk(
+        &bank,
+        x + (size / 2) * channels,
+        y + (size / 2) * channels,
+        size - size / 2);
+
+    for (p = 0; p < size * channels; ++p)
+      SU_TEST_ASSERT(SU_C_ABS(y[p] - ref[p]) < SU_TEST_SOS_MAX_ERROR);
+
+    su_sos_filt_finalize(&bank);
+
+    SU_INFO(
+        "%s: %d channels match the reference\n",
+        su_simd_level_to_string(level),
+        channels);
+  }
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_simd_set_level(saved);
+
+  su_sos_filt_finalize(&bank);
+  su_sos_filt_finalize(&single);
+
+  if (x != NULL)
+    free(x);
+
+  if (y != NULL)
+    free(y);
+
+  if (ref != NULL)
+    free(ref);
+
+  return ok;
+}
+
+SUBOOL
+su_test_fir_decimation(su_test_context_t *ctx)
+{
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *y = NULL;
+  SUCOMPLEX *ref = NULL;
+  SUFLOAT *b = NULL;
+  SUSCOUNT size = SU_TEST_FIR_BUFFER_SIZE;
+  SUSCOUNT taps = SU_TEST_FIR_TAPS;
+  SUSCOUNT chunk, p, n, got;
+  unsigned int decim;
+  su_fir_filt_t fir = su_fir_filt_INITIALIZER;
+  su_iir_filt_t iir = su_iir_filt_INITIALIZER;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(y = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(ref = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(b = malloc(taps * sizeof(SUFLOAT)));
+
+  su_taps_brickwall_lp_init(b, 1. / SU_TEST_FIR_DECIM_MAX, taps);
+
+  for (p = 0; p < size; ++p)
+    x[p] = su_c_awgn();
+
+  /* Reference: full rate output */
+  SU_TEST_ASSERT(su_fir_filt_init(&fir, b, taps));
+  su_fir_filt_feed_bulk(&fir, x, ref, size);
+  su_fir_filt_finalize(&fir);
+
+  SU_TEST_TICK(ctx);
+
+  /* Overlap-save computes whole blocks, it cannot skip outputs */
+  SU_TEST_ASSERT(su_fir_filt_init_ex(&fir, b, taps, SU_FIR_FILT_MODE_FFT));
+  SU_TEST_ASSERT(!su_fir_filt_set_decimation(&fir, 2));
+  SU_TEST_ASSERT(su_fir_filt_set_decimation(&fir, 1));
+  su_fir_filt_finalize(&fir);
+
+  for (decim = 2; decim <= SU_TEST_FIR_DECIM_MAX; ++decim) {
+    /* In place, odd chunks so that phase is carried across calls */
+    SU_TEST_ASSERT(su_fir_filt_init(&fir, b, taps));
+    SU_TEST_ASSERT(su_fir_filt_set_decimation(&fir, decim));
+    memcpy(y, x, size * sizeof(SUCOMPLEX));
+
+    for (p = 0, n = 0, chunk = 1; p < size; p += chunk, chunk += 2) {
+      if (chunk > size - p)
+        chunk = size - p;
+      n += su_fir_filt_feed_bulk_decim(&fir, y + p, y + n, chunk);
+    }
+
+    SU_TEST_ASSERT(n == size / decim);
+    for (p = 0; p < n; ++p)
+      SU_TEST_ASSERT(
+          SU_C_ABS(y[p] - ref[(p + 1) * decim - 1]) < SU_TEST_FIR_MAX_ERROR);
+    su_fir_filt_finalize(&fir);
+
+    /* Through the IIR wrapper, which keeps decimation across mode changes */
+    SU_TEST_ASSERT(su_iir_filt_init(&iir, 0, NULL, taps, b));
+    SU_TEST_ASSERT(su_iir_filt_set_decimation(&iir, decim));
+    SU_TEST_ASSERT(su_iir_filt_set_fir_mode(&iir, SU_FIR_FILT_MODE_DIRECT));
+    got = su_iir_filt_feed_bulk_decim(&iir, x, y, size);
+    SU_TEST_ASSERT(got == size / decim);
+    for (p = 0; p < got; ++p)
+      SU_TEST_ASSERT(
+          SU_C_ABS(y[p] - ref[(p + 1) * decim - 1]) < SU_TEST_FIR_MAX_ERROR);
+    su_iir_filt_finalize(&iir);
+    iir = (su_iir_filt_t) su_iir_filt_INITIALIZER;
+  }
+
+  SU_INFO(
+      "Decimation 2 to %d matches the subsampled output\n",
+      SU_TEST_FIR_DECIM_MAX);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_fir_filt_finalize(&fir);
+  su_iir_filt_finalize(&iir);
+
+  if (x != NULL)
+    free(x);
+
+  if (y != NULL)
+    free(y);
+
+  if (ref != NULL)
+    free(ref);
+
+  if (b != NULL)
+    free(b);
+
+  return ok;
+}
+
+SUBOOL
+su_test_cic(su_test_context_t *ctx)
+{
+  static const unsigned int decimations[] = {1, 5, 16, 250};
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *y = NULL;
+  SUCOMPLEX *ref = NULL;
+  SUFLOAT h[SU_TEST_CIC_COMP_TAPS];
+  SUSCOUNT size = SU_TEST_CIC_BUFFER_SIZE;
+  SUSCOUNT chunk, p, n;
+  SUCOMPLEX acc;
+  SUFLOAT f, gain;
+  SUFLOAT max_dev = 0;
+  unsigned int decim, i, s;
+  su_cic_filt_t cic = su_cic_filt_INITIALIZER;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(y = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(ref = malloc(size * sizeof(SUCOMPLEX)));
+
+  for (p = 0; p < size; ++p)
+    x[p] = su_c_awgn();
+
+  SU_TEST_TICK(ctx);
+
+  /* Cannot keep enough fractional bits */
+  SU_TEST_ASSERT(!su_cic_filt_init(&cic, 1 << 12, SU_CIC_DEFAULT_STAGES));
+
+  for (i = 0; i < sizeof(decimations) / sizeof(decimations[0]); ++i) {
+    decim = decimations[i];
+
+    /* Reference: cascade of moving sums */
+    memcpy(ref, x, size * sizeof(SUCOMPLEX));
+    for (s = 0; s < SU_CIC_DEFAULT_STAGES; ++s)
+      for (p = size - 1; p + 1 > 0; --p) {
+        acc = 0;
+        for (n = 0; n < decim && n <= p; ++n)
+          acc += ref[p - n];
+        ref[p] = acc / decim;
+      }
+
+    /* In place, odd chunks */
+    SU_TEST_ASSERT(su_cic_filt_init(&cic, decim, SU_CIC_DEFAULT_STAGES));
+    memcpy(y, x, size * sizeof(SUCOMPLEX));
+
+    for (p = 0, n = 0, chunk = 1; p < size; p += chunk, chunk += 2) {
+      if (chunk > size - p)
+        chunk = size - p;
+      n += su_cic_filt_feed_bulk(&cic, y + p, chunk, y + n);
+    }
+
+    SU_TEST_ASSERT(n == size / decim);
+    for (p = 0; p < n; ++p)
+      SU_TEST_ASSERT(
+          SU_C_ABS(y[p] - ref[(p + 1) * decim - 1]) < SU_TEST_CIC_MAX_ERROR);
+
+    /* Compensated response must be flat up to the cutoff */
+    su_cic_comp_init(h, SU_TEST_CIC_COMP_TAPS, &cic, SU_TEST_CIC_COMP_FC);
+
+    for (f = 0; f < SU_TEST_CIC_COMP_FLAT * SU_TEST_CIC_COMP_FC; f += 1e-2) {
+      acc = 0;
+      for (p = 0; p < SU_TEST_CIC_COMP_TAPS; ++p)
+        acc += h[p] * SU_C_EXP(-I * PI * f * p);
+
+      gain = SU_C_ABS(acc) * su_cic_filt_get_response(&cic, f);
+      if (SU_ABS(gain - 1) > max_dev)
+        max_dev = SU_ABS(gain - 1);
+    }
+
+    su_cic_filt_finalize(&cic);
+  }
+
+  SU_INFO("CIC matches the reference, passband deviation: %g\n", max_dev);
+
+  SU_TEST_ASSERT(max_dev < SU_TEST_CIC_COMP_MAX_DEV);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_cic_filt_finalize(&cic);
+
+  if (x != NULL)
+    free(x);
+
+  if (y != NULL)
+    free(y);
+
+  if (ref != NULL)
+    free(ref);
+
+  return ok;
+}
+
+SUBOOL
+su_test_fir_fold(su_test_context_t *ctx)
+{
+  static const struct {
+    const char *name;
+    SUSCOUNT taps;
+    enum sigutils_fir_filt_symmetry symmetry;
+    unsigned int stride;
+  } designs[] = {
+    {"RRC", SU_TEST_FIR_FOLD_TAPS, SU_FIR_FILT_SYMMETRY_EVEN, 1},
+    {"RRC", SU_TEST_FIR_FOLD_TAPS - 1, SU_FIR_FILT_SYMMETRY_EVEN, 1},
+    {"Half-band", SU_TEST_FIR_FOLD_HB_TAPS, SU_FIR_FILT_SYMMETRY_EVEN, 2},
+    {"Half-band", SU_TEST_FIR_FOLD_HB_TAPS + 2, SU_FIR_FILT_SYMMETRY_EVEN, 2},
+    {"Hilbert", SU_TEST_FIR_FOLD_HB_TAPS, SU_FIR_FILT_SYMMETRY_ODD, 2},
+    {"Hilbert", SU_TEST_FIR_FOLD_HB_TAPS + 1, SU_FIR_FILT_SYMMETRY_ODD, 1},
+    {"Random", SU_TEST_FIR_FOLD_TAPS, SU_FIR_FILT_SYMMETRY_NONE, 1},
+  };
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *y = NULL;
+  SUCOMPLEX *ref = NULL;
+  SUFLOAT *b = NULL;
+  SUSCOUNT size = SU_TEST_FIR_BUFFER_SIZE;
+  SUSCOUNT taps, products, max_products;
+  SUSCOUNT chunk, p, i, n;
+  unsigned int d;
+  enum sigutils_simd_level saved = su_simd_get_level();
+  enum sigutils_simd_level level;
+  su_fir_filt_t fir = su_fir_filt_INITIALIZER;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(y = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(ref = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(b = malloc(SU_TEST_FIR_FOLD_TAPS * sizeof(SUFLOAT)));
+
+  for (p = 0; p < size; ++p)
+    x[p] = su_c_awgn();
+
+  SU_TEST_TICK(ctx);
+
+  for (d = 0; d < sizeof(designs) / sizeof(designs[0]); ++d) {
+    taps = designs[d].taps;
+
+    switch (d) {
+      case 0:
+      case 1:
+        su_taps_rrc_init(b, SU_TEST_MF_SYMBOL_SPAN, SU_TEST_COSTAS_BETA, taps);
+        break;
+
+      case 2:
+      case 3:
+        su_taps_brickwall_lp_init(b, .5, taps);
+        break;
+
+      case 4:
+      case 5:
+        su_taps_hilbert_init(b, taps);
+        break;
+
+      default:
+        for (i = 0; i < taps; ++i)
+          b[i] = SU_C_REAL(su_c_awgn());
+    }
+
+    /* Reference: textbook convolution */
+    for (p = 0; p < size; ++p) {
+      ref[p] = 0;
+      for (i = 0; i < taps && i <= p; ++i)
+        ref[p] += b[i] * x[p - i];
+    }
+
+    /* Products are halved, or quartered if every other tap is zero */
+    if (designs[d].symmetry == SU_FIR_FILT_SYMMETRY_NONE)
+      max_products = taps;
+    else if (designs[d].stride == 1)
+      max_products = (taps + 1) / 2;
+    else
+      max_products = (taps + 1) / 4 + 1;
+
+    for (level = SU_SIMD_LEVEL_SCALAR;
+         level <= su_simd_get_max_level();
+         ++level) {
+      su_simd_set_level(level);
+
+      SU_TEST_ASSERT(su_fir_filt_init(&fir, b, taps));
+      SU_TEST_ASSERT(
+          su_fir_filt_get_symmetry(&fir) == designs[d].symmetry);
+      SU_TEST_ASSERT(fir.fold_stride == designs[d].stride);
+      products = su_fir_filt_get_products(&fir);
+      SU_TEST_ASSERT(products <= max_products);
+
+      /* In place, growing chunks that straddle the delay line rewinds */
+      memcpy(y, x, size * sizeof(SUCOMPLEX));
+      for (p = 0, chunk = 1; p < size; p += chunk, chunk = 2 * chunk + 1) {
+        if (chunk > size - p)
+          chunk = size - p;
+        su_fir_filt_feed_bulk(&fir, y + p, y + p, chunk);
+      }
+
+      for (p = 0; p < size; ++p)
+        SU_TEST_ASSERT(SU_C_ABS(y[p] - ref[p]) < SU_TEST_FIR_MAX_ERROR);
+
+      /* Decimated outputs go through the same kernels */
+      su_fir_filt_reset(&fir);
+      SU_TEST_ASSERT(
+          su_fir_filt_set_decimation(&fir, SU_TEST_FIR_FOLD_DECIM));
+      n = su_fir_filt_feed_bulk_decim(&fir, x, y, size);
+      SU_TEST_ASSERT(n == size / SU_TEST_FIR_FOLD_DECIM);
+
+      for (p = 0; p < n; ++p)
+        SU_TEST_ASSERT(
+            SU_C_ABS(y[p] - ref[(p + 1) * SU_TEST_FIR_FOLD_DECIM - 1])
+            < SU_TEST_FIR_MAX_ERROR);
+
+      su_fir_filt_finalize(&fir);
+    }
+
+    SU_INFO(
+        "%s, %d taps: %d products per output\n",
+        designs[d].name,
+        taps,
+        products);
+  }
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_simd_set_level(saved);
+
+  su_fir_filt_finalize(&fir);
+
+  if (x != NULL)
+    free(x);
+
+  if (y != NULL)
+    free(y);
+
+  if (ref != NULL)
+    free(ref);
+
+  if (b != NULL)
+    free(b);
+
+  return ok;
+}
@@ -0,0 +1,166 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sigutils/mixer.h>
+#include <sigutils/simd.h>
+
+#include <sigutils/sigutils.h>
+
+#include "test_list.h"
+#include "test_param.h"
+
+/*
+ * Mix x in growing odd chunks with the current mixer frequency, and
+ * compare against exp(j phi) computed in double precision. Returns the
+ * largest error relative to |x|, and advances phi.
+ */
+SUPRIVATE SUFLOAT
+su_test_mixer_run(
+    su_mixer_t *mixer,
+    const SUCOMPLEX *x,
+    SUCOMPLEX *y,
+    SUSCOUNT size,
+    double *phi)
+{
+  double omega = SU_NORM2ANG_FREQ(su_mixer_get_freq(mixer));
+  SUCOMPLEX ref;
+  SUFLOAT err, max_err = 0;
+  SUSCOUNT p, chunk;
+
+  for (p = 0, chunk = 1; p < size; p += chunk, chunk += 2) {
+    if (chunk > size - p)
+      chunk = size - p;
+
+    if (x == y)
+      su_mixer_mix(mixer, y + p, y + p, chunk);
+    else
+      su_mixer_mix(mixer, x + p, y + p, chunk);
+  }
+
+  for (p = 0; p < size; ++p) {
+    ref = x[p] * (cos(*phi) + I * sin(*phi));
+    err = SU_C_ABS(y[p] - ref) / SU_C_ABS(x[p]);
+    if (err > max_err)
+      max_err = err;
+
+    *phi += omega;
+  }
+
+  /* Reference phase grows big in long runs: keep it accurate */
+  *phi = fmod(*phi, 2 * M_PI);
+
+  return max_err;
+}
+
+SUBOOL
+su_test_mixer(su_test_context_t *ctx)
+{
+  static const SUFLOAT freqs[] = {0, 1, -1, .1, -.37, 1e-5, .999};
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *y = NULL;
+  SUCOMPLEX *z = NULL;
+  SUSCOUNT size = SU_TEST_MIXER_BUFFER_SIZE;
+  SUSCOUNT p, n;
+  SUFLOAT err, max_err = 0;
+  double phi;
+  unsigned int i;
+  unsigned int nfreqs = sizeof(freqs) / sizeof(freqs[0]);
+  enum sigutils_simd_level saved = su_simd_get_level();
+  enum sigutils_simd_level level;
+  su_mixer_t mixer = su_mixer_INITIALIZER;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(y = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(z = malloc(size * sizeof(SUCOMPLEX)));
+
+  for (p = 0; p < size; ++p)
+    x[p] = su_c_awgn();
+
+  SU_TEST_TICK(ctx);
+
+  for (level = SU_SIMD_LEVEL_SCALAR;
+       level <= su_simd_get_max_level();
+       ++level) {
+    su_simd_set_level(level);
+
+    for (i = 0; i < nfreqs; ++i) {
+      /* Out of place */
+      su_mixer_init(&mixer, freqs[i]);
+      phi = 0;
+      err = su_test_mixer_run(&mixer, x, y, size, &phi);
+      if (err > max_err)
+        max_err = err;
+
+      /* In place, same result */
+      su_mixer_init(&mixer, freqs[i]);
+      phi = 0;
+      memcpy(z, x, size * sizeof(SUCOMPLEX));
+      su_test_mixer_run(&mixer, z, z, size, &phi);
+      SU_TEST_ASSERT(memcmp(y, z, size * sizeof(SUCOMPLEX)) == 0);
+
+      /* Changes are applied on the next block, without phase jumps */
+      su_mixer_set_freq(&mixer, freqs[(i + 1) % nfreqs]);
+      su_mixer_inc_phase(&mixer, 1);
+      SU_TEST_ASSERT(su_mixer_get_freq(&mixer) == freqs[(i + 1) % nfreqs]);
+      phi += 1;
+      err = su_test_mixer_run(&mixer, x, y, size, &phi);
+      if (err > max_err)
+        max_err = err;
+    }
+  }
+
+  SU_INFO("Mixer max error: %g\n", max_err);
+  SU_TEST_ASSERT(max_err < SU_TEST_MIXER_MAX_ERROR);
+
+  /* Long run: the recursive phasor does not drift */
+  su_simd_set_level(saved);
+  su_mixer_init(&mixer, freqs[3]);
+  phi = 0;
+  for (n = 0; n < SU_TEST_MIXER_LONG_RUN; n += size)
+    err = su_test_mixer_run(&mixer, x, y, size, &phi);
+
+  SU_INFO("Mixer error after %lu samples: %g\n", (unsigned long) n, err);
+  SU_TEST_ASSERT(err < SU_TEST_MIXER_MAX_ERROR);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_simd_set_level(saved);
+
+  if (x != NULL)
+    free(x);
+
+  if (y != NULL)
+    free(y);
+
+  if (z != NULL)
+    free(z);
+
+  return ok;
+}
@@ -27,6 +27,7 @@
 #include <sigutils/iir.h>
 #include <sigutils/agc.h>
 #include <sigutils/pll.h>
+#include <sigutils/simd.h>
 
 #include <sigutils/sigutils.h>
 
@@ -119,3 +120,130 @@ done:
   return ok;
 }
 
+/* Exact oscillator output for an accumulator value */
+SUPRIVATE SUCOMPLEX
+su_test_ncqo_integer_ref(uint32_t acc)
+{
+  double phi = acc * (2 * M_PI / 4294967296.);
+
+  return cos(phi) + I * sin(phi);
+}
+
+SUBOOL
+su_test_ncqo_integer(su_test_context_t *ctx)
+{
+  static const SUFLOAT freqs[] = {0, 1, -1, .1, -.37, 1e-5};
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *y = NULL;
+  SUCOMPLEX *ref = NULL;
+  SUSCOUNT size = SU_TEST_NCQO_BULK_SIZE;
+  SUSCOUNT chunk, p, n;
+  SUFLOAT err, max_err = 0;
+  uint64_t acc;
+  unsigned int i;
+  enum sigutils_simd_level saved = su_simd_get_level();
+  enum sigutils_simd_level level;
+  su_ncqo_t ncqo = su_ncqo_INITIALIZER;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(y = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(ref = malloc(size * sizeof(SUCOMPLEX)));
+
+  for (p = 0; p < size; ++p)
+    x[p] = su_c_awgn();
+
+  SU_TEST_TICK(ctx);
+
+  for (i = 0; i < sizeof(freqs) / sizeof(freqs[0]); ++i) {
+    /* Sample by sample, against the exact phase */
+    su_ncqo_init_integer(&ncqo, freqs[i]);
+    su_ncqo_set_phase(&ncqo, 1);
+
+    for (p = 0; p < size; ++p) {
+      ref[p] = su_test_ncqo_integer_ref(ncqo.acc);
+      SU_TEST_ASSERT(SU_C_ABS(su_ncqo_get(&ncqo) - ref[p]) < 1e-6);
+      err = SU_C_ABS(su_ncqo_read(&ncqo) - ref[p]);
+      if (err > max_err)
+        max_err = err;
+    }
+
+    /* Bulk, odd chunks, every vector level */
+    for (level = SU_SIMD_LEVEL_SCALAR;
+         level <= su_simd_get_max_level();
+         ++level) {
+      su_simd_set_level(level);
+
+      su_ncqo_init_integer(&ncqo, freqs[i]);
+      su_ncqo_set_phase(&ncqo, 1);
+      for (p = 0, chunk = 1; p < size; p += chunk, chunk = 2 * chunk + 1) {
+        if (chunk > size - p)
+          chunk = size - p;
+        su_ncqo_read_bulk(&ncqo, y + p, chunk);
+      }
+
+      for (p = 0; p < size; ++p)
+        SU_TEST_ASSERT(
+            SU_C_ABS(y[p] - ref[p]) < SU_TEST_NCQO_LUT_MAX_ERROR);
+
+      /* In place */
+      su_ncqo_init_integer(&ncqo, freqs[i]);
+      su_ncqo_set_phase(&ncqo, 1);
+      memcpy(y, x, size * sizeof(SUCOMPLEX));
+      for (p = 0, chunk = 1; p < size; p += chunk, chunk = 2 * chunk + 1) {
+        if (chunk > size - p)
+          chunk = size - p;
+        su_ncqo_mix_bulk(&ncqo, y + p, y + p, chunk);
+      }
+
+      for (p = 0; p < size; ++p)
+        SU_TEST_ASSERT(
+            SU_C_ABS(y[p] - x[p] * ref[p])
+            < SU_TEST_NCQO_LUT_MAX_ERROR * SU_C_ABS(x[p]) * 2);
+    }
+  }
+
+  SU_INFO("LUT oscillator max error: %g\n", max_err);
+  SU_TEST_ASSERT(max_err < SU_TEST_NCQO_LUT_MAX_ERROR);
+
+  /* Long run: the phase is exact, and so is the last output */
+  su_ncqo_init_integer(&ncqo, freqs[3]);
+  for (n = 0; n < SU_TEST_NCQO_LONG_RUN; n += size)
+    su_ncqo_read_bulk(&ncqo, y, size);
+
+  acc = (uint64_t) su_ncqo_angle_to_acc(SU_NORM2ANG_FREQ(freqs[3])) * n;
+  SU_TEST_ASSERT(ncqo.acc == (uint32_t) acc);
+  SU_TEST_ASSERT(
+      SU_C_ABS(
+          y[size - 1]
+          - su_test_ncqo_integer_ref((uint32_t) (acc - ncqo.inc)))
+      < SU_TEST_NCQO_LUT_MAX_ERROR);
+
+  /* Fixed oscillators keep their frequency */
+  su_ncqo_init_fixed(&ncqo, freqs[3]);
+  su_ncqo_set_freq(&ncqo, freqs[4]);
+  SU_TEST_ASSERT(su_ncqo_get_freq(&ncqo) == freqs[3]);
+
+  /* No per-instance tables */
+  SU_TEST_ASSERT(sizeof(su_ncqo_t) < 64);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_simd_set_level(saved);
+
+  if (x != NULL)
+    free(x);
+
+  if (y != NULL)
+    free(y);
+
+  if (ref != NULL)
+    free(ref);
+
+  return ok;
+}
@@ -0,0 +1,417 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sigutils/pfb.h>
+#include <sigutils/specttuner.h>
+#include <sigutils/ncqo.h>
+
+#include <sigutils/sigutils.h>
+
+#include "test_list.h"
+#include "test_param.h"
+
+struct su_pfb_test_channel {
+  SUCOMPLEX *output;
+  SUSCOUNT size;
+  SUSCOUNT p;
+};
+
+SUPRIVATE SUBOOL
+su_pfb_test_append(
+    const su_pfb_channel_t *channel,
+    void *private,
+    const SUCOMPLEX *data,
+    SUSCOUNT size)
+{
+  struct su_pfb_test_channel *ctx = (struct su_pfb_test_channel *) private;
+
+  if (ctx->p + size > ctx->size)
+    size = ctx->size - ctx->p;
+
+  memcpy(ctx->output + ctx->p, data, size * sizeof(SUCOMPLEX));
+  ctx->p += size;
+
+  return SU_TRUE;
+}
+
+/*
+ * Feed a tone centered in one channel. The tone must come out of that
+ * channel as a constant of unit magnitude, and must not leak into the
+ * adjacent channels.
+ */
+SUPRIVATE SUBOOL
+__su_test_pfb_tone(su_test_context_t *ctx, SUBOOL oversample)
+{
+  SUCOMPLEX *input = NULL;
+  SUCOMPLEX *output = NULL;
+  struct sigutils_pfb_channelizer_params params =
+      sigutils_pfb_channelizer_params_INITIALIZER;
+  struct sigutils_pfb_channel_params ch_params =
+      sigutils_pfb_channel_params_INITIALIZER;
+  struct su_pfb_test_channel chans[3];
+  su_pfb_channelizer_t *pfb = NULL;
+  su_ncqo_t lo;
+  SUSCOUNT size = ctx->params->buffer_size;
+  SUSCOUNT out_size;
+  SUSCOUNT settle;
+  SUFLOAT mag, leak;
+  unsigned int i;
+  SUSCOUNT p;
+  SUBOOL ok = SU_FALSE;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  params.channels = SU_TEST_PFB_CHANNELS;
+  params.oversample = oversample;
+
+  SU_TEST_ASSERT(pfb = su_pfb_channelizer_new(&params));
+
+  out_size = size / su_pfb_channelizer_get_decimation(pfb);
+
+  SU_TEST_ASSERT(input = su_test_ctx_getc(ctx, "x"));
+  SU_TEST_ASSERT(output = su_test_ctx_getc(ctx, "y"));
+  SU_TEST_ASSERT(out_size * 3 <= size);
+
+  su_ncqo_init_fixed(
+      &lo,
+      SU_ANG2NORM_FREQ(
+          su_pfb_channelizer_get_channel_freq(
+              pfb,
+              SU_TEST_PFB_TONE_CHANNEL)));
+
+  for (p = 0; p < size; ++p)
+    input[p] = su_ncqo_read(&lo);
+
+  /* Tone channel and both neighbours */
+  for (i = 0; i < 3; ++i) {
+    chans[i].output = output + i * out_size;
+    chans[i].size = out_size;
+    chans[i].p = 0;
+
+    ch_params.index = SU_TEST_PFB_TONE_CHANNEL + i - 1;
+    ch_params.privdata = chans + i;
+    ch_params.on_data = su_pfb_test_append;
+
+    SU_TEST_ASSERT(su_pfb_channelizer_open_channel(pfb, &ch_params));
+  }
+
+  SU_TEST_TICK(ctx);
+
+  SU_TEST_ASSERT(su_pfb_channelizer_feed_bulk(pfb, input, size));
+
+  /* Skip prototype transient */
+  settle = 2 * params.taps_per_branch;
+  SU_TEST_ASSERT(chans[1].p == out_size);
+
+  for (p = settle; p < out_size; ++p) {
+    mag = SU_C_ABS(chans[1].output[p]);
+    SU_TEST_ASSERT(SU_ABS(mag - 1) < 1e-2);
+
+    /* Constant output means the oversampling correction is right */
+    SU_TEST_ASSERT(
+        SU_C_ABS(chans[1].output[p] - chans[1].output[p - 1]) < 1e-2);
+
+    leak = SU_C_ABS(chans[0].output[p]) + SU_C_ABS(chans[2].output[p]);
+    SU_TEST_ASSERT(leak < 1e-2);
+  }
+
+  SU_INFO(
+      "Channel %d: %g dB, neighbours: %g dB, %g dB\n",
+      SU_TEST_PFB_TONE_CHANNEL,
+      SU_POWER_DB_RAW(SU_C_ABS(chans[1].output[out_size - 1])),
+      SU_POWER_DB_RAW(SU_C_ABS(chans[0].output[out_size - 1])),
+      SU_POWER_DB_RAW(SU_C_ABS(chans[2].output[out_size - 1])));
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (pfb != NULL)
+    su_pfb_channelizer_destroy(pfb);
+
+  return ok;
+}
+
+SUBOOL
+su_test_pfb_tone(su_test_context_t *ctx)
+{
+  return __su_test_pfb_tone(ctx, SU_FALSE);
+}
+
+SUBOOL
+su_test_pfb_tone_oversampled(su_test_context_t *ctx)
+{
+  return __su_test_pfb_tone(ctx, SU_TRUE);
+}
+
+struct su_pfb_test_closer {
+  su_pfb_channelizer_t *pfb;
+  su_pfb_channel_t *self;   /* Closed on the first callback */
+  su_pfb_channel_t *victim; /* Closed on the first callback, too */
+  unsigned int calls;
+  SUSCOUNT got;
+};
+
+SUPRIVATE SUBOOL
+su_pfb_test_close(
+    const su_pfb_channel_t *channel,
+    void *private,
+    const SUCOMPLEX *data,
+    SUSCOUNT size)
+{
+  struct su_pfb_test_closer *closer = (struct su_pfb_test_closer *) private;
+  SUBOOL ok = SU_TRUE;
+
+  ++closer->calls;
+  closer->got += size;
+
+  if (closer->self != NULL) {
+    ok = su_pfb_channelizer_close_channel(closer->pfb, closer->self) && ok;
+    closer->self = NULL;
+  }
+
+  if (closer->victim != NULL) {
+    ok = su_pfb_channelizer_close_channel(closer->pfb, closer->victim) && ok;
+    closer->victim = NULL;
+  }
+
+  return ok;
+}
+
+/*
+ * Callbacks may close channels, including their own. Closed channels
+ * must not see any more data, and the rest must go on undisturbed.
+ */
+SUBOOL
+su_test_pfb_close_from_callback(su_test_context_t *ctx)
+{
+  SUCOMPLEX *input = NULL;
+  struct sigutils_pfb_channelizer_params params =
+      sigutils_pfb_channelizer_params_INITIALIZER;
+  struct sigutils_pfb_channel_params ch_params =
+      sigutils_pfb_channel_params_INITIALIZER;
+  struct su_pfb_test_closer chans[3];
+  su_pfb_channel_t *channel[3];
+  su_pfb_channelizer_t *pfb = NULL;
+  SUSCOUNT size = SU_TEST_PFB_CHANNELS * SU_TEST_PFB_CLOSE_OUTPUTS;
+  SUSCOUNT p;
+  unsigned int i;
+  SUBOOL ok = SU_FALSE;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  params.channels = SU_TEST_PFB_CHANNELS;
+  params.buffer_size = SU_TEST_PFB_CLOSE_BUFFER_SIZE;
+
+  SU_TEST_ASSERT(pfb = su_pfb_channelizer_new(&params));
+  SU_TEST_ASSERT(input = malloc(size * sizeof(SUCOMPLEX)));
+
+  for (p = 0; p < size; ++p)
+    input[p] = su_c_awgn();
+
+  memset(chans, 0, sizeof(chans));
+
+  for (i = 0; i < 3; ++i) {
+    chans[i].pfb = pfb;
+
+    ch_params.index = i + 1;
+    ch_params.privdata = chans + i;
+    ch_params.on_data = su_pfb_test_close;
+
+    SU_TEST_ASSERT(
+        channel[i] = su_pfb_channelizer_open_channel(pfb, &ch_params));
+  }
+
+  /* The first channel closes itself and the second one */
+  chans[0].self = channel[0];
+  chans[0].victim = channel[1];
+
+  SU_TEST_TICK(ctx);
+
+  for (i = 0; i < 2; ++i)
+    SU_TEST_ASSERT(su_pfb_channelizer_feed_bulk(pfb, input, size));
+
+  SU_TEST_ASSERT(su_pfb_channelizer_get_channel_count(pfb) == 1);
+
+  SU_TEST_ASSERT(chans[0].calls == 1);
+  SU_TEST_ASSERT(chans[0].got == SU_TEST_PFB_CLOSE_BUFFER_SIZE);
+  SU_TEST_ASSERT(chans[1].calls == 0);
+  SU_TEST_ASSERT(chans[2].got == 2 * SU_TEST_PFB_CLOSE_OUTPUTS);
+
+  /* Outside a callback, channels are released right away */
+  SU_TEST_ASSERT(su_pfb_channelizer_close_channel(pfb, channel[2]));
+  SU_TEST_ASSERT(su_pfb_channelizer_get_channel_count(pfb) == 0);
+  SU_TEST_ASSERT(su_pfb_channelizer_feed_bulk(pfb, input, size));
+  SU_TEST_ASSERT(chans[2].got == 2 * SU_TEST_PFB_CLOSE_OUTPUTS);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (input != NULL)
+    free(input);
+
+  if (pfb != NULL)
+    su_pfb_channelizer_destroy(pfb);
+
+  return ok;
+}
+
+SUPRIVATE SUBOOL
+su_pfb_bench_discard_pfb(
+    const su_pfb_channel_t *channel,
+    void *private,
+    const SUCOMPLEX *data,
+    SUSCOUNT size)
+{
+  *(SUSCOUNT *) private += size;
+
+  return SU_TRUE;
+}
+
+SUPRIVATE SUBOOL
+su_pfb_bench_discard_specttuner(
+    const su_specttuner_channel_t *channel,
+    void *private,
+    const SUCOMPLEX *data,
+    SUSCOUNT size)
+{
+  *(SUSCOUNT *) private += size;
+
+  return SU_TRUE;
+}
+
+SUPRIVATE SUFLOAT
+su_pfb_bench_elapsed(const struct timeval *start)
+{
+  struct timeval end, diff;
+
+  gettimeofday(&end, NULL);
+  timersub(&end, start, &diff);
+
+  return diff.tv_sec + 1e-6 * diff.tv_usec;
+}
+
+SUBOOL
+su_test_pfb_benchmark(su_test_context_t *ctx)
+{
+  SUCOMPLEX *input = NULL;
+  struct sigutils_pfb_channelizer_params params =
+      sigutils_pfb_channelizer_params_INITIALIZER;
+  struct sigutils_pfb_channel_params ch_params =
+      sigutils_pfb_channel_params_INITIALIZER;
+  struct sigutils_specttuner_params st_params =
+      sigutils_specttuner_params_INITIALIZER;
+  struct sigutils_specttuner_channel_params st_ch_params =
+      sigutils_specttuner_channel_params_INITIALIZER;
+  su_pfb_channelizer_t *pfb = NULL;
+  su_specttuner_t *st = NULL;
+  struct timeval start;
+  SUSCOUNT size = ctx->params->buffer_size;
+  SUSCOUNT pfb_samples, st_samples;
+  SUFLOAT pfb_time, st_time;
+  unsigned int channels;
+  unsigned int i;
+  SUSCOUNT p;
+  SUBOOL ok = SU_FALSE;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(input = su_test_ctx_getc(ctx, "x"));
+
+  for (p = 0; p < size; ++p)
+    input[p] = su_c_awgn();
+
+  SU_TEST_TICK(ctx);
+
+  for (channels = SU_TEST_PFB_MIN_BENCH_CHANNELS;
+       channels <= SU_TEST_PFB_MAX_BENCH_CHANNELS;
+       channels <<= 2) {
+    /* Polyphase filter bank, all channels open */
+    params.channels = channels;
+    SU_TEST_ASSERT(pfb = su_pfb_channelizer_new(&params));
+
+    pfb_samples = 0;
+    ch_params.privdata = &pfb_samples;
+    ch_params.on_data = su_pfb_bench_discard_pfb;
+    for (i = 0; i < channels; ++i) {
+      ch_params.index = i;
+      SU_TEST_ASSERT(su_pfb_channelizer_open_channel(pfb, &ch_params));
+    }
+
+    gettimeofday(&start, NULL);
+    SU_TEST_ASSERT(su_pfb_channelizer_feed_bulk(pfb, input, size));
+    pfb_time = su_pfb_bench_elapsed(&start);
+
+    su_pfb_channelizer_destroy(pfb);
+    pfb = NULL;
+
+    /* Spectral tuner, same raster */
+    st_params.window_size = 4 * channels;
+    if (st_params.window_size < 4096)
+      st_params.window_size = 4096;
+
+    SU_TEST_ASSERT(st = su_specttuner_new(&st_params));
+
+    st_samples = 0;
+    st_ch_params.privdata = &st_samples;
+    st_ch_params.on_data = su_pfb_bench_discard_specttuner;
+    st_ch_params.bw = 2 * PI / channels;
+    for (i = 0; i < channels; ++i) {
+      st_ch_params.f0 = 2 * PI * i / channels;
+      SU_TEST_ASSERT(su_specttuner_open_channel(st, &st_ch_params));
+    }
+
+    gettimeofday(&start, NULL);
+    SU_TEST_ASSERT(su_specttuner_feed_bulk(st, input, size));
+    st_time = su_pfb_bench_elapsed(&start);
+
+    su_specttuner_destroy(st);
+    st = NULL;
+
+    SU_INFO(
+        "%4d channels: PFB %g Msps (%d out), specttuner %g Msps (%d out), x%g\n",
+        channels,
+        1e-6 * size / pfb_time,
+        pfb_samples,
+        1e-6 * size / st_time,
+        st_samples,
+        st_time / pfb_time);
+  }
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (pfb != NULL)
+    su_pfb_channelizer_destroy(pfb);
+
+  if (st != NULL)
+    su_specttuner_destroy(st);
+
+  return ok;
+}
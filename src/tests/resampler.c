@@ -0,0 +1,269 @@
+/*
+
+  Copyright (C) 2019 Gonzalo José Carracedo Carballal
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this program.  If not, see
+  <http://www.gnu.org/licenses/>
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sigutils/resampler.h>
+#include <sigutils/ncqo.h>
+
+#include <sigutils/sigutils.h>
+
+#include "test_list.h"
+#include "test_param.h"
+
+/* Feed x in growing odd chunks, so that state is carried across calls */
+SUPRIVATE SUSCOUNT
+su_resampler_test_feed(
+    su_resampler_t *resampler,
+    const SUCOMPLEX *x,
+    SUSCOUNT size,
+    SUCOMPLEX *y)
+{
+  SUSCOUNT p, chunk;
+  SUSCOUNT n = 0;
+
+  for (p = 0, chunk = 1; p < size; p += chunk, chunk += 2) {
+    if (chunk > size - p)
+      chunk = size - p;
+    n += su_resampler_feed_bulk(resampler, x + p, chunk, y + n);
+  }
+
+  return n;
+}
+
+/* Power of y[settle..size - 1] */
+SUPRIVATE SUFLOAT
+su_resampler_test_power(const SUCOMPLEX *y, SUSCOUNT settle, SUSCOUNT size)
+{
+  SUFLOAT power = 0;
+  SUSCOUNT p;
+
+  for (p = settle; p < size; ++p)
+    power += SU_C_REAL(y[p] * SU_C_CONJ(y[p]));
+
+  return power / (size - settle);
+}
+
+SUBOOL
+su_test_resampler_rational(su_test_context_t *ctx)
+{
+  static const unsigned int ratios[][2] = {{3, 2}, {2, 3}, {1, 4}, {5, 1}};
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *y = NULL;
+  SUCOMPLEX *ref = NULL;
+  SUSCOUNT size = SU_TEST_RESAMPLER_BUFFER_SIZE;
+  SUSCOUNT max, n, got, p;
+  SUSCOUNT settle;
+  SUFLOAT omega, expected, power;
+  unsigned int interp, decim, i;
+  su_resampler_t resampler = su_resampler_INITIALIZER;
+  su_ncqo_t lo;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  max = size * SU_TEST_RESAMPLER_MAX_RATIO + 1;
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(y = malloc(max * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(ref = malloc(max * sizeof(SUCOMPLEX)));
+
+  SU_TEST_TICK(ctx);
+
+  for (i = 0; i < sizeof(ratios) / sizeof(ratios[0]); ++i) {
+    interp = ratios[i][0];
+    decim  = ratios[i][1];
+
+    /* In band tone: unit magnitude, frequency scaled by M / L */
+    su_ncqo_init_fixed(&lo, SU_TEST_RESAMPLER_TONE_FREQ);
+    for (p = 0; p < size; ++p)
+      x[p] = su_ncqo_read(&lo);
+
+    SU_TEST_ASSERT(
+        su_resampler_init_rational(
+            &resampler,
+            interp,
+            decim,
+            SU_RESAMPLER_DEFAULT_TAPS));
+
+    /* Skip the prototype transient */
+    settle = resampler.taps * interp / decim + 1;
+
+    SU_TEST_ASSERT(
+        su_resampler_get_max_output(&resampler, size) <= max);
+    n = su_resampler_feed_bulk(&resampler, x, size, ref);
+    SU_TEST_ASSERT(n == (size * interp + decim - 1) / decim);
+
+    omega = SU_NORM2ANG_FREQ(SU_TEST_RESAMPLER_TONE_FREQ) * decim / interp;
+    for (p = settle; p < n; ++p) {
+      SU_TEST_ASSERT(
+          SU_ABS(SU_C_ABS(ref[p]) - 1) < SU_TEST_RESAMPLER_MAX_ERROR);
+      SU_TEST_ASSERT(
+          SU_C_ABS(ref[p] - ref[p - 1] * SU_C_EXP(I * omega))
+          < SU_TEST_RESAMPLER_MAX_ERROR);
+    }
+
+    /* Same output in small chunks */
+    su_resampler_reset(&resampler);
+    got = su_resampler_test_feed(&resampler, x, size, y);
+    SU_TEST_ASSERT(got == n);
+
+    for (p = 0; p < n; ++p)
+      SU_TEST_ASSERT(SU_C_ABS(y[p] - ref[p]) < SU_TEST_RESAMPLER_MAX_ERROR);
+
+    /* Out of band tone: must be rejected when decimating */
+    if (decim > interp) {
+      expected = .5 * (1 + (SUFLOAT) interp / decim);
+      su_ncqo_init_fixed(&lo, expected);
+      for (p = 0; p < size; ++p)
+        x[p] = su_ncqo_read(&lo);
+
+      su_resampler_reset(&resampler);
+      n = su_resampler_feed_bulk(&resampler, x, size, y);
+      power = su_resampler_test_power(y, settle, n);
+      SU_TEST_ASSERT(SU_POWER_DB_RAW(power) < SU_TEST_RESAMPLER_MIN_REJECTION);
+
+      SU_INFO(
+          "%d/%d: alias at %g rejected by %g dB\n",
+          interp,
+          decim,
+          expected,
+          -SU_POWER_DB_RAW(power));
+    } else {
+      SU_INFO("%d/%d: in band tone preserved\n", interp, decim);
+    }
+
+    su_resampler_finalize(&resampler);
+  }
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_resampler_finalize(&resampler);
+
+  if (x != NULL)
+    free(x);
+
+  if (y != NULL)
+    free(y);
+
+  if (ref != NULL)
+    free(ref);
+
+  return ok;
+}
+
+SUBOOL
+su_test_resampler_arbitrary(su_test_context_t *ctx)
+{
+  static const SUFLOAT ratios[] = {1.37, .73, 1.001, .5};
+  SUBOOL ok = SU_FALSE;
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *y = NULL;
+  SUSCOUNT size = SU_TEST_RESAMPLER_BUFFER_SIZE;
+  SUSCOUNT chunk = SU_TEST_RESAMPLER_CHUNK;
+  SUSCOUNT max, n, got, p, q;
+  SUFLOAT omega = SU_NORM2ANG_FREQ(SU_TEST_RESAMPLER_TONE_FREQ);
+  SUFLOAT max_err = 0;
+  SUFLOAT err;
+  SUFLOAT step;
+  double t; /* Too far from 0 for SUFLOAT */
+  unsigned int i = 0;
+  su_resampler_t resampler = su_resampler_INITIALIZER;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  max = size * SU_TEST_RESAMPLER_MAX_RATIO + 1;
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(y = malloc(max * sizeof(SUCOMPLEX)));
+
+  for (p = 0; p < size; ++p)
+    x[p] = SU_C_EXP(I * (SUFLOAT) fmod(omega * (double) p, 2 * PI));
+
+  SU_TEST_TICK(ctx);
+
+  SU_TEST_ASSERT(su_resampler_init_arbitrary(&resampler, ratios[0], 0));
+  SU_TEST_ASSERT(!su_resampler_set_ratio(&resampler, 0));
+
+  /*
+   * The ratio changes after every chunk. Output n sits at input time
+   * t_n, lagging 2 samples behind the interpolator input, and the step
+   * of every output is the one in effect when it was computed.
+   */
+  t = -2;
+  n = 0;
+  for (p = 0; p < size; p += chunk) {
+    /* Same rounding as the resampler */
+    step = 1. / ratios[i];
+
+    SU_TEST_ASSERT(
+        su_resampler_get_max_output(&resampler, chunk) + n <= max);
+    got = su_resampler_feed_bulk(&resampler, x + p, chunk, y + n);
+    SU_TEST_ASSERT(got <= su_resampler_get_max_output(&resampler, chunk));
+
+    for (q = n; q < n + got; ++q, t += step) {
+      /* Skip the first outputs, computed from the initial zeroes */
+      if (t < 1)
+        continue;
+
+      err = SU_C_ABS(y[q] - SU_C_EXP(I * (SUFLOAT) fmod(omega * t, 2 * PI)));
+      if (err > max_err)
+        max_err = err;
+    }
+
+    n += got;
+
+    i = (i + 1) % (sizeof(ratios) / sizeof(ratios[0]));
+    SU_TEST_ASSERT(su_resampler_set_ratio(&resampler, ratios[i]));
+  }
+
+  SU_INFO(
+      "%d samples interpolated, max error: %g\n",
+      n,
+      max_err);
+
+  SU_TEST_ASSERT(max_err < SU_TEST_RESAMPLER_FARROW_MAX_ERROR);
+
+  /* Rational resamplers have a fixed ratio */
+  su_resampler_finalize(&resampler);
+  SU_TEST_ASSERT(su_resampler_init_rational(&resampler, 4, 6, 8));
+  SU_TEST_ASSERT(resampler.interp == 2 && resampler.decim == 3);
+  SU_TEST_ASSERT(!su_resampler_set_ratio(&resampler, 1));
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_resampler_finalize(&resampler);
+
+  if (x != NULL)
+    free(x);
+
+  if (y != NULL)
+    free(y);
+
+  return ok;
+}
@@ -21,9 +21,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include <sigutils/specttuner.h>
+#include <sigutils/simd.h>
 #include <sigutils/ncqo.h>
+#include <sigutils/taps.h>
 
 #include <sigutils/sigutils.h>
 
@@ -135,3 +139,1079 @@ done:
 
   return ok;
 }
+
+struct su_specttuner_bench_channel {
+  unsigned int index;
+  SUCOMPLEX *output;
+  SUSCOUNT p;
+  SUSCOUNT size;
+  int *last_index; /* Shared by all channels */
+  SUBOOL *in_order; /* Shared by all channels */
+};
+
+SUPRIVATE SUBOOL
+su_specttuner_bench_append(
+    const su_specttuner_channel_t *channel,
+    void *private,
+    const SUCOMPLEX *data,
+    SUSCOUNT size)
+{
+  struct su_specttuner_bench_channel *ctx =
+      (struct su_specttuner_bench_channel *) private;
+
+  /* Callbacks must be delivered in channel index order on every window */
+  if (ctx->index != 0 && (int) ctx->index <= *ctx->last_index)
+    *ctx->in_order = SU_FALSE;
+
+  *ctx->last_index = ctx->index;
+
+  if (ctx->p + size > ctx->size)
+    size = ctx->size - ctx->p;
+
+  memcpy(ctx->output + ctx->p, data, size * sizeof(SUCOMPLEX));
+  ctx->p += size;
+
+  return SU_TRUE;
+}
+
+SUPRIVATE SUBOOL
+su_specttuner_bench_run(
+    su_test_context_t *ctx,
+    const SUCOMPLEX *input,
+    unsigned int threads,
+    unsigned int batch,
+    struct su_specttuner_bench_channel *chans,
+    SUFLOAT *elapsed)
+{
+  struct sigutils_specttuner_params st_params =
+      sigutils_specttuner_params_INITIALIZER;
+  struct sigutils_specttuner_channel_params ch_params =
+      sigutils_specttuner_channel_params_INITIALIZER;
+  su_specttuner_t *st = NULL;
+  struct timeval start, end, diff;
+  int last_index = -1;
+  SUBOOL in_order = SU_TRUE;
+  unsigned int i;
+  SUBOOL ok = SU_FALSE;
+
+  st_params.threads = threads;
+  st_params.batch = batch;
+
+  SU_TEST_ASSERT(st = su_specttuner_new(&st_params));
+
+  ch_params.on_data = su_specttuner_bench_append;
+  ch_params.bw = 2 * PI / (2 * SU_TEST_SPECTTUNER_BENCH_CHANNELS);
+
+  for (i = 0; i < SU_TEST_SPECTTUNER_BENCH_CHANNELS; ++i) {
+    chans[i].p = 0;
+    chans[i].last_index = &last_index;
+    chans[i].in_order = &in_order;
+
+    ch_params.privdata = chans + i;
+    ch_params.f0 = 2 * PI * (i + .5) / SU_TEST_SPECTTUNER_BENCH_CHANNELS;
+
+    SU_TEST_ASSERT(su_specttuner_open_channel(st, &ch_params) != NULL);
+  }
+
+  gettimeofday(&start, NULL);
+  SU_TEST_ASSERT(su_specttuner_feed_bulk(st, input, ctx->params->buffer_size));
+  gettimeofday(&end, NULL);
+
+  SU_TEST_ASSERT(in_order);
+
+  timersub(&end, &start, &diff);
+  *elapsed = diff.tv_sec + 1e-6 * diff.tv_usec;
+
+  ok = SU_TRUE;
+
+done:
+  if (st != NULL)
+    su_specttuner_destroy(st);
+
+  return ok;
+}
+
+SUBOOL
+su_test_specttuner_parallel(su_test_context_t *ctx)
+{
+  SUCOMPLEX *input = NULL;
+  SUCOMPLEX *ref = NULL;
+  SUCOMPLEX *output = NULL;
+  struct su_specttuner_bench_channel ref_chans[SU_TEST_SPECTTUNER_BENCH_CHANNELS];
+  struct su_specttuner_bench_channel chans[SU_TEST_SPECTTUNER_BENCH_CHANNELS];
+  SUSCOUNT chan_size = ctx->params->buffer_size;
+  SUFLOAT elapsed, serial_elapsed;
+  unsigned int threads;
+  unsigned int i;
+  SUSCOUNT p;
+  SUBOOL ok = SU_FALSE;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(input = su_test_ctx_getc(ctx, "x"));
+
+  for (p = 0; p < ctx->params->buffer_size; ++p)
+    input[p] = su_c_awgn();
+
+  SU_TEST_ASSERT(
+      ref = calloc(
+          SU_TEST_SPECTTUNER_BENCH_CHANNELS * chan_size,
+          sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(
+      output = calloc(
+          SU_TEST_SPECTTUNER_BENCH_CHANNELS * chan_size,
+          sizeof(SUCOMPLEX)));
+
+  for (i = 0; i < SU_TEST_SPECTTUNER_BENCH_CHANNELS; ++i) {
+    ref_chans[i].index = chans[i].index = i;
+    ref_chans[i].size  = chans[i].size  = chan_size;
+    ref_chans[i].output = ref + i * chan_size;
+    chans[i].output = output + i * chan_size;
+  }
+
+  SU_TEST_TICK(ctx);
+
+  /* Serial run, used as reference */
+  SU_TEST_ASSERT(
+      su_specttuner_bench_run(
+          ctx,
+          input,
+          1,
+          SU_SPECTTUNER_THROUGHPUT_BATCH,
+          ref_chans,
+          &serial_elapsed));
+
+  SU_INFO(
+      "%d channels, 1 thread: %g Msps\n",
+      SU_TEST_SPECTTUNER_BENCH_CHANNELS,
+      1e-6 * ctx->params->buffer_size / serial_elapsed);
+
+  for (threads = 2;
+       threads <= SU_TEST_SPECTTUNER_BENCH_MAX_THREADS;
+       threads <<= 1) {
+    SU_TEST_ASSERT(
+        su_specttuner_bench_run(
+            ctx,
+            input,
+            threads,
+            SU_SPECTTUNER_THROUGHPUT_BATCH,
+            chans,
+            &elapsed));
+
+    SU_INFO(
+        "%d channels, %d threads: %g Msps (x%g)\n",
+        SU_TEST_SPECTTUNER_BENCH_CHANNELS,
+        threads,
+        1e-6 * ctx->params->buffer_size / elapsed,
+        serial_elapsed / elapsed);
+
+    /* Parallel processing must not change the result */
+    for (i = 0; i < SU_TEST_SPECTTUNER_BENCH_CHANNELS; ++i) {
+      SU_TEST_ASSERT(chans[i].p == ref_chans[i].p);
+      SU_TEST_ASSERT(
+          memcmp(
+              chans[i].output,
+              ref_chans[i].output,
+              chans[i].p * sizeof(SUCOMPLEX)) == 0);
+    }
+  }
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (ref != NULL)
+    free(ref);
+
+  if (output != NULL)
+    free(output);
+
+  return ok;
+}
+
+SUBOOL
+su_test_specttuner_batch(su_test_context_t *ctx)
+{
+  SUCOMPLEX *input = NULL;
+  SUCOMPLEX *ref = NULL;
+  SUCOMPLEX *output = NULL;
+  struct su_specttuner_bench_channel ref_chans[SU_TEST_SPECTTUNER_BENCH_CHANNELS];
+  struct su_specttuner_bench_channel chans[SU_TEST_SPECTTUNER_BENCH_CHANNELS];
+  SUSCOUNT chan_size = ctx->params->buffer_size;
+  SUFLOAT elapsed, single_elapsed;
+  SUFLOAT err, max_err = 0;
+  unsigned int i;
+  SUSCOUNT p;
+  SUBOOL ok = SU_FALSE;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(input = su_test_ctx_getc(ctx, "x"));
+
+  for (p = 0; p < ctx->params->buffer_size; ++p)
+    input[p] = su_c_awgn();
+
+  SU_TEST_ASSERT(
+      ref = calloc(
+          SU_TEST_SPECTTUNER_BENCH_CHANNELS * chan_size,
+          sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(
+      output = calloc(
+          SU_TEST_SPECTTUNER_BENCH_CHANNELS * chan_size,
+          sizeof(SUCOMPLEX)));
+
+  for (i = 0; i < SU_TEST_SPECTTUNER_BENCH_CHANNELS; ++i) {
+    ref_chans[i].index = chans[i].index = i;
+    ref_chans[i].size  = chans[i].size  = chan_size;
+    ref_chans[i].output = ref + i * chan_size;
+    chans[i].output = output + i * chan_size;
+  }
+
+  SU_TEST_TICK(ctx);
+
+  /* One FFT per window, used as reference */
+  SU_TEST_ASSERT(
+      su_specttuner_bench_run(ctx, input, 1, 0, ref_chans, &single_elapsed));
+
+  SU_TEST_ASSERT(
+      su_specttuner_bench_run(
+          ctx,
+          input,
+          1,
+          SU_TEST_SPECTTUNER_BATCH_WINDOWS,
+          chans,
+          &elapsed));
+
+  SU_INFO(
+      "%d channels, single: %g Msps, batch of %d: %g Msps (x%g)\n",
+      SU_TEST_SPECTTUNER_BENCH_CHANNELS,
+      1e-6 * ctx->params->buffer_size / single_elapsed,
+      SU_TEST_SPECTTUNER_BATCH_WINDOWS,
+      1e-6 * ctx->params->buffer_size / elapsed,
+      single_elapsed / elapsed);
+
+  /* Batched transforms may round differently, but nothing else changes */
+  for (i = 0; i < SU_TEST_SPECTTUNER_BENCH_CHANNELS; ++i) {
+    SU_TEST_ASSERT(chans[i].p == ref_chans[i].p);
+
+    for (p = 0; p < chans[i].p; ++p) {
+      err = SU_C_ABS(chans[i].output[p] - ref_chans[i].output[p]);
+      if (err > max_err)
+        max_err = err;
+    }
+  }
+
+  SU_INFO("Max batch error: %g\n", max_err);
+  SU_TEST_ASSERT(max_err < SU_TEST_SPECTTUNER_BATCH_MAX_ERROR);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (ref != NULL)
+    free(ref);
+
+  if (output != NULL)
+    free(output);
+
+  return ok;
+}
+
+/*
+ * Runs the channel kernels (filter, glue and rotation) of a channel of the
+ * given size. Returns the elapsed time.
+ */
+SUPRIVATE SUFLOAT
+su_specttuner_simd_run(
+    SUCOMPLEX *x,
+    const SUCOMPLEX *h,
+    const SUCOMPLEX *prev,
+    const SUFLOAT *window,
+    SUSCOUNT size,
+    unsigned int iters)
+{
+  struct timeval start, end, diff;
+  SUCOMPLEX phase = 1;
+  SUCOMPLEX step = SU_C_EXP(I * 1e-3);
+  SUSCOUNT halfsz = size >> 1;
+  unsigned int i;
+
+  gettimeofday(&start, NULL);
+
+  for (i = 0; i < iters; ++i) {
+    su_simd_cmul(x, h, size);
+    su_simd_glue(x, prev, window, window + halfsz, 1, halfsz);
+    su_simd_rotate(x, halfsz, &phase, step);
+  }
+
+  gettimeofday(&end, NULL);
+
+  timersub(&end, &start, &diff);
+
+  return diff.tv_sec + 1e-6 * diff.tv_usec;
+}
+
+SUBOOL
+su_test_specttuner_simd(su_test_context_t *ctx)
+{
+  SUCOMPLEX *x = NULL;
+  SUCOMPLEX *ref = NULL;
+  SUCOMPLEX *h = NULL;
+  SUCOMPLEX *prev = NULL;
+  SUFLOAT *window = NULL;
+  SUFLOAT elapsed[SU_SIMD_LEVEL_COUNT];
+  enum sigutils_simd_level saved = su_simd_get_level();
+  enum sigutils_simd_level max = su_simd_get_max_level();
+  enum sigutils_simd_level level;
+  SUSCOUNT size = SU_TEST_SPECTTUNER_SIMD_MAX_SIZE;
+  unsigned int iters;
+  unsigned int i;
+  SUBOOL ok = SU_FALSE;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(x = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(ref = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(h = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(prev = malloc(size * sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(window = malloc(size * sizeof(SUFLOAT)));
+
+  for (i = 0; i < size; ++i) {
+    h[i] = su_c_awgn();
+    prev[i] = su_c_awgn();
+    window[i] = SU_SIN(PI * (SUFLOAT) i / size);
+  }
+
+  SU_INFO("Best SIMD level: %s\n", su_simd_level_to_string(max));
+
+  SU_TEST_TICK(ctx);
+
+  for (size = SU_TEST_SPECTTUNER_SIMD_MIN_SIZE;
+       size <= SU_TEST_SPECTTUNER_SIMD_MAX_SIZE;
+       size <<= 2) {
+    iters = SU_TEST_SPECTTUNER_SIMD_ITERS / size;
+
+    for (level = SU_SIMD_LEVEL_SCALAR; level <= max; ++level) {
+      su_simd_set_level(level);
+
+      /* Single run, compared against the scalar implementation */
+      for (i = 0; i < size; ++i)
+        x[i] = su_c_awgn();
+      memcpy(ref, x, size * sizeof(SUCOMPLEX));
+
+      su_simd_set_level(SU_SIMD_LEVEL_SCALAR);
+      su_specttuner_simd_run(ref, h, prev, window, size, 1);
+      su_simd_set_level(level);
+      su_specttuner_simd_run(x, h, prev, window, size, 1);
+
+      for (i = 0; i < size; ++i)
+        SU_TEST_ASSERT(SU_C_ABS(x[i] - ref[i]) < 1e-4);
+
+      elapsed[level] =
+          su_specttuner_simd_run(x, h, prev, window, size, iters);
+
+      SU_INFO(
+          "Channel size %4d, %-6s: %g Msps (x%g)\n",
+          size,
+          su_simd_level_to_string(level),
+          1e-6 * size * iters / elapsed[level],
+          elapsed[SU_SIMD_LEVEL_SCALAR] / elapsed[level]);
+    }
+  }
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  su_simd_set_level(saved);
+
+  if (x != NULL)
+    free(x);
+
+  if (ref != NULL)
+    free(ref);
+
+  if (h != NULL)
+    free(h);
+
+  if (prev != NULL)
+    free(prev);
+
+  if (window != NULL)
+    free(window);
+
+  return ok;
+}
+
+struct su_specttuner_ring_consumer {
+  su_specttuner_channel_t *channel;
+  SUCOMPLEX *output;
+  SUSCOUNT size;
+  SUSCOUNT p;
+  SUBOOL done;
+};
+
+SUPRIVATE void *
+su_specttuner_ring_consumer_thread(void *data)
+{
+  struct su_specttuner_ring_consumer *consumer =
+      (struct su_specttuner_ring_consumer *) data;
+  const SUCOMPLEX *samples;
+  SUSCOUNT avail;
+
+  for (;;) {
+    avail = su_specttuner_channel_peek(consumer->channel, &samples);
+
+    if (avail == 0) {
+      if (__atomic_load_n(&consumer->done, __ATOMIC_ACQUIRE)) {
+        /* Producer is gone. Check once more before leaving */
+        if (su_specttuner_channel_peek(consumer->channel, &samples) == 0)
+          break;
+      } else {
+        sched_yield();
+      }
+
+      continue;
+    }
+
+    if (consumer->p + avail > consumer->size)
+      avail = consumer->size - consumer->p;
+
+    memcpy(consumer->output + consumer->p, samples, avail * sizeof(SUCOMPLEX));
+    consumer->p += avail;
+
+    su_specttuner_channel_advance(consumer->channel, avail);
+  }
+
+  return NULL;
+}
+
+SUBOOL
+su_test_specttuner_ring(su_test_context_t *ctx)
+{
+  SUCOMPLEX *input = NULL;
+  SUCOMPLEX *output = NULL;
+  SUCOMPLEX *pulled = NULL;
+  struct sigutils_specttuner_params st_params =
+      sigutils_specttuner_params_INITIALIZER;
+  struct sigutils_specttuner_channel_params ch_params =
+      sigutils_specttuner_channel_params_INITIALIZER;
+  struct su_specttuner_context out_ctx;
+  struct su_specttuner_ring_consumer consumer;
+  su_specttuner_channel_t *small = NULL;
+  su_specttuner_t *st = NULL;
+  pthread_t thread;
+  SUBOOL thread_running = SU_FALSE;
+  SUSCOUNT size = ctx->params->buffer_size;
+  SUSCOUNT chunk;
+  SUSCOUNT p;
+  SUBOOL ok = SU_FALSE;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(input = su_test_ctx_getc(ctx, "x"));
+  SU_TEST_ASSERT(output = su_test_ctx_getc(ctx, "y"));
+  SU_TEST_ASSERT(pulled = calloc(size, sizeof(SUCOMPLEX)));
+
+  for (p = 0; p < size; ++p)
+    input[p] = su_c_awgn();
+
+  SU_TEST_ASSERT(st = su_specttuner_new(&st_params));
+
+  /* Reference channel, callback mode */
+  memset(output, 0, sizeof(SUCOMPLEX) * size);
+  out_ctx.output = output;
+  out_ctx.p = 0;
+
+  ch_params.privdata = &out_ctx;
+  ch_params.on_data = su_specttuner_append;
+  ch_params.bw = SU_NORM2ANG_FREQ(
+      SU_ABS2NORM_FREQ(SU_TEST_SPECTTUNER_SAMP_RATE, 100));
+  ch_params.f0 = SU_NORM2ANG_FREQ(
+      SU_ABS2NORM_FREQ(SU_TEST_SPECTTUNER_SAMP_RATE, SU_TEST_SPECTTUNER_FREQ1));
+
+  SU_TEST_ASSERT(su_specttuner_open_channel(st, &ch_params));
+
+  /* Same channel, pull mode. Big enough to never overrun */
+  ch_params.privdata = NULL;
+  ch_params.on_data = NULL;
+  ch_params.ring_size = size;
+  ch_params.ring_mmap = SU_TRUE;
+
+  memset(&consumer, 0, sizeof(struct su_specttuner_ring_consumer));
+  SU_TEST_ASSERT(consumer.channel = su_specttuner_open_channel(st, &ch_params));
+  consumer.output = pulled;
+  consumer.size = size;
+
+  /* Same channel, tiny ring that nobody reads */
+  ch_params.ring_size = SU_TEST_SPECTTUNER_RING_SMALL_SIZE;
+  ch_params.ring_mmap = SU_FALSE;
+  SU_TEST_ASSERT(small = su_specttuner_open_channel(st, &ch_params));
+
+  SU_TEST_ASSERT(
+      pthread_create(
+          &thread,
+          NULL,
+          su_specttuner_ring_consumer_thread,
+          &consumer) == 0);
+  thread_running = SU_TRUE;
+
+  SU_TEST_TICK(ctx);
+
+  for (p = 0; p < size; p += chunk) {
+    chunk = size - p;
+    if (chunk > SU_TEST_SPECTTUNER_RING_CHUNK)
+      chunk = SU_TEST_SPECTTUNER_RING_CHUNK;
+
+    SU_TEST_ASSERT(su_specttuner_feed_bulk(st, input + p, chunk));
+  }
+
+  __atomic_store_n(&consumer.done, SU_TRUE, __ATOMIC_RELEASE);
+  pthread_join(thread, NULL);
+  thread_running = SU_FALSE;
+
+  SU_INFO(
+      "Pulled %d samples, %d expected\n",
+      consumer.p,
+      out_ctx.p);
+
+  /* Pull mode must deliver exactly what the callback got */
+  SU_TEST_ASSERT(consumer.p == out_ctx.p);
+  SU_TEST_ASSERT(
+      memcmp(pulled, output, consumer.p * sizeof(SUCOMPLEX)) == 0);
+  SU_TEST_ASSERT(su_specttuner_channel_get_overruns(consumer.channel) == 0);
+
+  /* Unread ring must overrun, never block */
+  SU_INFO(
+      "Small ring: %d overruns, %d samples dropped\n",
+      su_specttuner_channel_get_overruns(small),
+      su_specttuner_channel_get_dropped(small));
+
+  SU_TEST_ASSERT(su_specttuner_channel_get_overruns(small) > 0);
+  SU_TEST_ASSERT(
+      su_specttuner_channel_get_dropped(small)
+      == out_ctx.p - SU_TEST_SPECTTUNER_RING_SMALL_SIZE);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (thread_running) {
+    __atomic_store_n(&consumer.done, SU_TRUE, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+  }
+
+  if (st != NULL)
+    su_specttuner_destroy(st);
+
+  if (pulled != NULL)
+    free(pulled);
+
+  return ok;
+}
+
+SUPRIVATE SUBOOL
+su_specttuner_real_open_channels(
+    su_specttuner_t *st,
+    struct su_specttuner_bench_channel *chans)
+{
+  struct sigutils_specttuner_channel_params ch_params =
+      sigutils_specttuner_channel_params_INITIALIZER;
+  unsigned int i;
+
+  ch_params.on_data = su_specttuner_bench_append;
+  ch_params.bw = 2 * PI / SU_TEST_SPECTTUNER_REAL_CHANNELS;
+
+  /*
+   * Evenly spaced from DC, so that channels wrap around the origin, sit
+   * on the Nyquist frequency and lie on the mirrored half.
+   */
+  for (i = 0; i < SU_TEST_SPECTTUNER_REAL_CHANNELS; ++i) {
+    ch_params.privdata = chans + i;
+    ch_params.f0 = 2 * PI * i / SU_TEST_SPECTTUNER_REAL_CHANNELS;
+
+    if (su_specttuner_open_channel(st, &ch_params) == NULL)
+      return SU_FALSE;
+  }
+
+  return SU_TRUE;
+}
+
+SUBOOL
+su_test_specttuner_real(su_test_context_t *ctx)
+{
+  SUCOMPLEX *input = NULL;
+  SUFLOAT *real = NULL;
+  SUCOMPLEX *ref = NULL;
+  SUCOMPLEX *output = NULL;
+  struct sigutils_specttuner_params st_params =
+      sigutils_specttuner_params_INITIALIZER;
+  struct su_specttuner_bench_channel ref_chans[SU_TEST_SPECTTUNER_REAL_CHANNELS];
+  struct su_specttuner_bench_channel chans[SU_TEST_SPECTTUNER_REAL_CHANNELS];
+  su_specttuner_t *st = NULL;
+  su_specttuner_t *real_st = NULL;
+  su_ncqo_t lo = su_ncqo_INITIALIZER;
+  SUSCOUNT chan_size = ctx->params->buffer_size;
+  int last_index = -1;
+  SUBOOL in_order = SU_TRUE;
+  SUFLOAT err, max_err = 0;
+  unsigned int i;
+  SUSCOUNT p;
+  SUBOOL ok = SU_FALSE;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(input = su_test_ctx_getc(ctx, "x"));
+  SU_TEST_ASSERT(real = su_test_ctx_getf(ctx, "xr"));
+
+  su_ncqo_init(
+      &lo,
+      SU_ABS2NORM_FREQ(SU_TEST_SPECTTUNER_SAMP_RATE, SU_TEST_SPECTTUNER_FREQ1));
+
+  /* Real tone plus noise, and its complex promotion */
+  for (p = 0; p < ctx->params->buffer_size; ++p) {
+    real[p] = su_ncqo_read_i(&lo) + SU_C_REAL(su_c_awgn());
+    input[p] = real[p];
+  }
+
+  SU_TEST_ASSERT(
+      ref = calloc(
+          SU_TEST_SPECTTUNER_REAL_CHANNELS * chan_size,
+          sizeof(SUCOMPLEX)));
+  SU_TEST_ASSERT(
+      output = calloc(
+          SU_TEST_SPECTTUNER_REAL_CHANNELS * chan_size,
+          sizeof(SUCOMPLEX)));
+
+  for (i = 0; i < SU_TEST_SPECTTUNER_REAL_CHANNELS; ++i) {
+    ref_chans[i].index = chans[i].index = i;
+    ref_chans[i].size  = chans[i].size  = chan_size;
+    ref_chans[i].p     = chans[i].p     = 0;
+    ref_chans[i].last_index = chans[i].last_index = &last_index;
+    ref_chans[i].in_order   = chans[i].in_order   = &in_order;
+    ref_chans[i].output = ref + i * chan_size;
+    chans[i].output = output + i * chan_size;
+  }
+
+  /* Reference: complex input */
+  SU_TEST_ASSERT(st = su_specttuner_new(&st_params));
+  SU_TEST_ASSERT(su_specttuner_real_open_channels(st, ref_chans));
+
+  st_params.real = SU_TRUE;
+  SU_TEST_ASSERT(real_st = su_specttuner_new(&st_params));
+  SU_TEST_ASSERT(su_specttuner_real_open_channels(real_st, chans));
+
+  /* Complex feeds are not allowed here */
+  SU_TEST_ASSERT(!su_specttuner_feed_bulk(real_st, input, 1));
+
+  SU_TEST_TICK(ctx);
+
+  SU_TEST_ASSERT(
+      su_specttuner_feed_bulk(st, input, ctx->params->buffer_size));
+  SU_TEST_ASSERT(
+      su_specttuner_feed_bulk_real(real_st, real, ctx->params->buffer_size));
+
+  for (i = 0; i < SU_TEST_SPECTTUNER_REAL_CHANNELS; ++i) {
+    SU_TEST_ASSERT(chans[i].p == ref_chans[i].p);
+
+    for (p = 0; p < chans[i].p; ++p) {
+      err = SU_C_ABS(chans[i].output[p] - ref_chans[i].output[p]);
+      if (err > max_err)
+        max_err = err;
+    }
+  }
+
+  SU_INFO("Max real input error: %g (%d samples)\n", max_err, chans[0].p);
+  SU_TEST_ASSERT(max_err < SU_TEST_SPECTTUNER_REAL_MAX_ERROR);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (st != NULL)
+    su_specttuner_destroy(st);
+
+  if (real_st != NULL)
+    su_specttuner_destroy(real_st);
+
+  if (ref != NULL)
+    free(ref);
+
+  if (output != NULL)
+    free(output);
+
+  return ok;
+}
+
+struct su_specttuner_async_control {
+  su_specttuner_t *st;
+  SUBOOL done;
+  SUBOOL ok;
+  unsigned int ops;
+};
+
+SUPRIVATE SUBOOL
+su_specttuner_async_discard(
+    const su_specttuner_channel_t *channel,
+    void *private,
+    const SUCOMPLEX *data,
+    SUSCOUNT size)
+{
+  return SU_TRUE;
+}
+
+/* Keeps opening, retuning and closing channels until told to stop */
+SUPRIVATE void *
+su_specttuner_async_control_thread(void *data)
+{
+  struct su_specttuner_async_control *control =
+      (struct su_specttuner_async_control *) data;
+  struct sigutils_specttuner_channel_params ch_params =
+      sigutils_specttuner_channel_params_INITIALIZER;
+  su_specttuner_channel_t *channel;
+  unsigned int i = 0;
+
+  ch_params.on_data = su_specttuner_async_discard;
+  ch_params.bw = 2 * PI / SU_TEST_SPECTTUNER_ASYNC_SLOTS;
+
+  while (!__atomic_load_n(&control->done, __ATOMIC_ACQUIRE)) {
+    ch_params.f0 = 2 * PI * (i % SU_TEST_SPECTTUNER_ASYNC_SLOTS)
+        / SU_TEST_SPECTTUNER_ASYNC_SLOTS;
+
+    if ((channel = su_specttuner_open_channel_async(
+        control->st,
+        &ch_params)) == NULL) {
+      control->ok = SU_FALSE;
+      break;
+    }
+
+    control->ok = control->ok
+        && su_specttuner_set_channel_freq_async(
+            control->st,
+            channel,
+            2 * PI * ((i + 1) % SU_TEST_SPECTTUNER_ASYNC_SLOTS)
+            / SU_TEST_SPECTTUNER_ASYNC_SLOTS)
+        && su_specttuner_set_channel_bandwidth_async(
+            control->st,
+            channel,
+            ch_params.bw / (1 + (i & 1)))
+        && su_specttuner_close_channel_async(control->st, channel);
+
+    if (!control->ok)
+      break;
+
+    control->ops += 4;
+    ++i;
+
+    sched_yield();
+  }
+
+  su_specttuner_collect_requests(control->st);
+
+  return NULL;
+}
+
+SUBOOL
+su_test_specttuner_async(su_test_context_t *ctx)
+{
+  SUCOMPLEX *input = NULL;
+  SUCOMPLEX *ref = NULL;
+  SUCOMPLEX *output = NULL;
+  struct sigutils_specttuner_params st_params =
+      sigutils_specttuner_params_INITIALIZER;
+  struct sigutils_specttuner_channel_params ch_params =
+      sigutils_specttuner_channel_params_INITIALIZER;
+  struct su_specttuner_context ref_ctx, out_ctx;
+  struct su_specttuner_async_control control;
+  su_specttuner_t *ref_st = NULL;
+  su_specttuner_t *st = NULL;
+  pthread_t thread;
+  SUBOOL thread_running = SU_FALSE;
+  SUSCOUNT size = ctx->params->buffer_size;
+  SUSCOUNT chunk;
+  SUSCOUNT p;
+  SUBOOL ok = SU_FALSE;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(input = su_test_ctx_getc(ctx, "x"));
+  SU_TEST_ASSERT(ref = su_test_ctx_getc(ctx, "ref"));
+  SU_TEST_ASSERT(output = su_test_ctx_getc(ctx, "y"));
+
+  /* Trailing window of zeros, fed after the control thread is gone */
+  for (p = 0; p < size; ++p)
+    input[p] = p < size - st_params.window_size ? su_c_awgn() : 0;
+
+  ch_params.on_data = su_specttuner_append;
+  ch_params.bw = SU_NORM2ANG_FREQ(
+      SU_ABS2NORM_FREQ(SU_TEST_SPECTTUNER_SAMP_RATE, 100));
+  ch_params.f0 = SU_NORM2ANG_FREQ(
+      SU_ABS2NORM_FREQ(SU_TEST_SPECTTUNER_SAMP_RATE, SU_TEST_SPECTTUNER_FREQ1));
+
+  /* Reference: channel opened synchronously, no other activity */
+  ref_ctx.output = ref;
+  ref_ctx.p = 0;
+  ch_params.privdata = &ref_ctx;
+
+  SU_TEST_ASSERT(ref_st = su_specttuner_new(&st_params));
+  SU_TEST_ASSERT(su_specttuner_open_channel(ref_st, &ch_params));
+  SU_TEST_ASSERT(su_specttuner_feed_bulk(ref_st, input, size));
+
+  /* Same channel, opened asynchronously and surrounded by retunes */
+  out_ctx.output = output;
+  out_ctx.p = 0;
+  ch_params.privdata = &out_ctx;
+
+  SU_TEST_ASSERT(st = su_specttuner_new(&st_params));
+  SU_TEST_ASSERT(su_specttuner_open_channel_async(st, &ch_params));
+
+  control.st = st;
+  control.done = SU_FALSE;
+  control.ok = SU_TRUE;
+  control.ops = 0;
+
+  SU_TEST_ASSERT(
+      pthread_create(
+          &thread,
+          NULL,
+          su_specttuner_async_control_thread,
+          &control) == 0);
+  thread_running = SU_TRUE;
+
+  SU_TEST_TICK(ctx);
+
+  for (p = 0; p < size - st_params.window_size; p += chunk) {
+    chunk = size - st_params.window_size - p;
+    if (chunk > SU_TEST_SPECTTUNER_RING_CHUNK)
+      chunk = SU_TEST_SPECTTUNER_RING_CHUNK;
+
+    SU_TEST_ASSERT(su_specttuner_feed_bulk(st, input + p, chunk));
+  }
+
+  __atomic_store_n(&control.done, SU_TRUE, __ATOMIC_RELEASE);
+  pthread_join(thread, NULL);
+  thread_running = SU_FALSE;
+
+  SU_TEST_ASSERT(control.ok);
+
+  /* Applies the remaining requests */
+  SU_TEST_ASSERT(su_specttuner_feed_bulk(st, input + p, size - p));
+  su_specttuner_collect_requests(st);
+
+  SU_INFO(
+      "%d asynchronous requests, %d channels left\n",
+      control.ops,
+      su_specttuner_get_channel_count(st));
+
+  SU_TEST_ASSERT(su_specttuner_get_channel_count(st) == 1);
+
+  /* Other channels must not disturb this one */
+  SU_TEST_ASSERT(out_ctx.p == ref_ctx.p);
+  SU_TEST_ASSERT(memcmp(output, ref, out_ctx.p * sizeof(SUCOMPLEX)) == 0);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (thread_running) {
+    __atomic_store_n(&control.done, SU_TRUE, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+  }
+
+  if (ref_st != NULL)
+    su_specttuner_destroy(ref_st);
+
+  if (st != NULL)
+    su_specttuner_destroy(st);
+
+  return ok;
+}
+
+/*
+ * Filter response of a channel, computed for the channel alone just like
+ * su_specttuner_update_channel_filter did before responses were shared.
+ * Only the bins applied by the tuner are kept, in the cache layout.
+ */
+SUPRIVATE SUBOOL
+su_specttuner_filter_ref(
+    const su_specttuner_t *st,
+    const su_specttuner_channel_t *channel,
+    SUCOMPLEX *resp)
+{
+  SU_FFTW(_complex) *h = NULL;
+  su_fft_plan_t *forward = NULL;
+  su_fft_plan_t *backward = NULL;
+  unsigned int window_size = st->params.window_size;
+  unsigned int window_half = window_size / 2;
+  unsigned int halfw = channel->halfw;
+  SUCOMPLEX tmp;
+  unsigned int i;
+  SUBOOL ok = SU_FALSE;
+
+  SU_TRYCATCH(
+      h = SU_FFTW(_malloc)(window_size * sizeof(SU_FFTW(_complex))),
+      goto done);
+  SU_TRYCATCH(
+      forward = su_fft_plan_acquire(window_size, FFTW_FORWARD, h, h),
+      goto done);
+  SU_TRYCATCH(
+      backward = su_fft_plan_acquire(window_size, FFTW_BACKWARD, h, h),
+      goto done);
+
+  memset(h, 0, window_size * sizeof(SU_FFTW(_complex)));
+
+  for (i = 0; i < halfw; ++i) {
+    h[i] = 1;
+    h[window_size - i - 1] = 1;
+  }
+
+  su_fft_plan_execute(backward, h, h);
+
+  for (i = 0; i < window_half; ++i) {
+    tmp = h[i];
+    h[i] = channel->k * h[window_half + i];
+    h[window_half + i] = channel->k * tmp;
+  }
+
+  su_taps_apply_blackmann_harris_complex(h, window_size);
+
+  for (i = 0; i < window_half; ++i) {
+    tmp = h[i];
+    h[i] = h[window_half + i];
+    h[window_half + i] = tmp;
+  }
+
+  su_fft_plan_execute(forward, h, h);
+
+  for (i = 0; i < halfw; ++i) {
+    resp[i] = channel->k * h[i];
+    resp[halfw + i] = channel->k * h[window_size - halfw + i];
+  }
+
+  ok = SU_TRUE;
+
+done:
+  if (backward != NULL)
+    su_fft_plan_release(backward);
+
+  if (forward != NULL)
+    su_fft_plan_release(forward);
+
+  if (h != NULL)
+    SU_FFTW(_free) (h);
+
+  return ok;
+}
+
+/*
+ * Channels of equal width share one refcounted filter response, which is
+ * freed with its last user and matches the one a channel would compute
+ * on its own.
+ */
+SUBOOL
+su_test_specttuner_filter_cache(su_test_context_t *ctx)
+{
+  struct sigutils_specttuner_params st_params =
+      sigutils_specttuner_params_INITIALIZER;
+  struct sigutils_specttuner_channel_params ch_params =
+      sigutils_specttuner_channel_params_INITIALIZER;
+  su_specttuner_t *st = NULL;
+  su_specttuner_channel_t *a = NULL;
+  su_specttuner_channel_t *b = NULL;
+  su_specttuner_channel_t *c = NULL;
+  SUCOMPLEX *ref = NULL;
+  su_specttuner_channel_t *channel;
+  unsigned int base;
+  SUFLOAT err, max_err = 0, max_ref = 0;
+  unsigned int i, p;
+  SUBOOL ok = SU_FALSE;
+
+  SU_TEST_START_TICKLESS(ctx);
+
+  SU_TEST_ASSERT(st = su_specttuner_new(&st_params));
+  SU_TEST_ASSERT(
+      ref = malloc(st_params.window_size * sizeof(SUCOMPLEX)));
+
+  base = su_specttuner_get_filter_count();
+
+  SU_TEST_TICK(ctx);
+
+  ch_params.on_data = su_specttuner_async_discard;
+
+  /* Same width, different frequencies: one shared entry */
+  ch_params.bw = SU_TEST_SPECTTUNER_CACHE_BW;
+  ch_params.f0 = PI / 4;
+  SU_TEST_ASSERT(a = su_specttuner_open_channel(st, &ch_params));
+  ch_params.f0 = 5 * PI / 4;
+  SU_TEST_ASSERT(b = su_specttuner_open_channel(st, &ch_params));
+
+  SU_TEST_ASSERT(a->filter == b->filter);
+  SU_TEST_ASSERT(a->filter->refcnt == 2);
+  SU_TEST_ASSERT(su_specttuner_get_filter_count() == base + 1);
+
+  /* Another width, another entry */
+  ch_params.bw = 2 * SU_TEST_SPECTTUNER_CACHE_BW;
+  SU_TEST_ASSERT(c = su_specttuner_open_channel(st, &ch_params));
+
+  SU_TEST_ASSERT(c->filter != a->filter);
+  SU_TEST_ASSERT(c->filter->refcnt == 1);
+  SU_TEST_ASSERT(su_specttuner_get_filter_count() == base + 2);
+
+  /* Cached responses match the ones rebuilt for each channel */
+  for (i = 0; i < 2; ++i) {
+    channel = i == 0 ? a : c;
+    SU_TEST_ASSERT(su_specttuner_filter_ref(st, channel, ref));
+
+    for (p = 0; p < 2 * channel->halfw; ++p) {
+      err = SU_C_ABS(channel->filter->resp[p] - ref[p]);
+      if (err > max_err)
+        max_err = err;
+      if (SU_C_ABS(ref[p]) > max_ref)
+        max_ref = SU_C_ABS(ref[p]);
+    }
+  }
+
+  SU_INFO("Cached filter error: %g (relative)\n", max_err / max_ref);
+  SU_TEST_ASSERT(max_err < SU_TEST_SPECTTUNER_CACHE_MAX_ERROR * max_ref);
+
+  /* Narrowing c to the width of a moves it to the shared entry */
+  SU_TEST_ASSERT(
+      su_specttuner_set_channel_bandwidth(
+          st,
+          c,
+          SU_TEST_SPECTTUNER_CACHE_BW));
+  SU_TEST_ASSERT(c->filter == a->filter);
+  SU_TEST_ASSERT(a->filter->refcnt == 3);
+  SU_TEST_ASSERT(su_specttuner_get_filter_count() == base + 1);
+
+  /* The entry lives as long as any of its channels */
+  SU_TEST_ASSERT(su_specttuner_close_channel(st, a));
+  a = NULL;
+  SU_TEST_ASSERT(su_specttuner_close_channel(st, b));
+  b = NULL;
+  SU_TEST_ASSERT(c->filter->refcnt == 1);
+  SU_TEST_ASSERT(su_specttuner_get_filter_count() == base + 1);
+
+  SU_TEST_ASSERT(su_specttuner_close_channel(st, c));
+  c = NULL;
+  SU_TEST_ASSERT(su_specttuner_get_filter_count() == base);
+
+  ok = SU_TRUE;
+
+done:
+  SU_TEST_END(ctx);
+
+  if (st != NULL)
+    su_specttuner_destroy(st);
+
+  if (ref != NULL)
+    free(ref);
+
+  return ok;
+}
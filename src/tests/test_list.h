@@ -25,9 +25,19 @@
 
 /* NCQO tests */
 SUBOOL su_test_ncqo(su_test_context_t *ctx);
+SUBOOL su_test_ncqo_integer(su_test_context_t *ctx);
+SUBOOL su_test_mixer(su_test_context_t *ctx);
 
 /* Filtering tests */
 SUBOOL su_test_butterworth_lpf(su_test_context_t *ctx);
+SUBOOL su_test_fir_direct_form(su_test_context_t *ctx);
+SUBOOL su_test_fir_overlap_save(su_test_context_t *ctx);
+SUBOOL su_test_fir_benchmark(su_test_context_t *ctx);
+SUBOOL su_test_sos_butterworth(su_test_context_t *ctx);
+SUBOOL su_test_sos_multichannel(su_test_context_t *ctx);
+SUBOOL su_test_fir_decimation(su_test_context_t *ctx);
+SUBOOL su_test_cic(su_test_context_t *ctx);
+SUBOOL su_test_fir_fold(su_test_context_t *ctx);
 
 /* AGC tests */
 SUBOOL su_test_agc_transient(su_test_context_t *ctx);
@@ -42,6 +52,7 @@ SUBOOL su_test_block(su_test_context_t *ctx);
 SUBOOL su_test_block_plugging(su_test_context_t *ctx);
 SUBOOL su_test_block_flow_control(su_test_context_t *ctx);
 SUBOOL su_test_tuner(su_test_context_t *ctx);
+SUBOOL su_test_tuner_decimation(su_test_context_t *ctx);
 SUBOOL su_test_costas_block(su_test_context_t *ctx);
 SUBOOL su_test_rrc_block(su_test_context_t *ctx);
 SUBOOL su_test_rrc_block_with_if(su_test_context_t *ctx);
@@ -61,6 +72,18 @@ SUBOOL su_test_clock_recovery_noisy(su_test_context_t *ctx);
 SUBOOL su_test_channel_detector_qpsk(su_test_context_t *ctx);
 SUBOOL su_test_channel_detector_qpsk_noisy(su_test_context_t *ctx);
 SUBOOL su_test_channel_detector_real_capture(su_test_context_t *ctx);
+SUBOOL su_test_channel_detector_batch(su_test_context_t *ctx);
+SUBOOL su_test_channel_detector_real(su_test_context_t *ctx);
+SUBOOL su_test_channel_detector_overlap(su_test_context_t *ctx);
+SUBOOL su_test_channel_detector_ingest(su_test_context_t *ctx);
+SUBOOL su_test_channel_detector_index(su_test_context_t *ctx);
+SUBOOL su_test_channel_detector_psd_track(su_test_context_t *ctx);
+SUBOOL su_test_channel_detector_order(su_test_context_t *ctx);
+SUBOOL su_test_peak_detector(su_test_context_t *ctx);
+SUBOOL su_test_peak_detector_benchmark(su_test_context_t *ctx);
+SUBOOL su_test_channel_detector_specttuner(su_test_context_t *ctx);
+SUBOOL su_test_softtuner_cic_large(su_test_context_t *ctx);
+SUBOOL su_test_softtuner_cic(su_test_context_t *ctx);
 
 /* Encoder tests */
 SUBOOL su_test_diff_codec_binary(su_test_context_t *ctx);
@@ -68,5 +91,26 @@ SUBOOL su_test_diff_codec_quaternary(su_test_context_t *ctx);
 
 /* Spectral tuner tests */
 SUBOOL su_test_specttuner_two_tones(su_test_context_t *ctx);
+SUBOOL su_test_specttuner_parallel(su_test_context_t *ctx);
+SUBOOL su_test_specttuner_simd(su_test_context_t *ctx);
+SUBOOL su_test_specttuner_ring(su_test_context_t *ctx);
+SUBOOL su_test_specttuner_batch(su_test_context_t *ctx);
+SUBOOL su_test_specttuner_real(su_test_context_t *ctx);
+SUBOOL su_test_specttuner_async(su_test_context_t *ctx);
+SUBOOL su_test_specttuner_filter_cache(su_test_context_t *ctx);
+
+/* Polyphase channelizer tests */
+SUBOOL su_test_pfb_tone(su_test_context_t *ctx);
+SUBOOL su_test_pfb_tone_oversampled(su_test_context_t *ctx);
+SUBOOL su_test_pfb_benchmark(su_test_context_t *ctx);
+SUBOOL su_test_pfb_close_from_callback(su_test_context_t *ctx);
+
+/* FFT plan registry tests */
+SUBOOL su_test_fft_plan_registry(su_test_context_t *ctx);
+SUBOOL su_test_fft_plan_wisdom(su_test_context_t *ctx);
+
+/* Resampler tests */
+SUBOOL su_test_resampler_rational(su_test_context_t *ctx);
+SUBOOL su_test_resampler_arbitrary(su_test_context_t *ctx);
 
 #endif /* _SRC_TESTS_TEST_LIST_H */
@@ -25,12 +25,82 @@
 #define SU_TEST_BLOCK_SAWTOOTH_WIDTH 119
 #define SU_TEST_BLOCK_READ_WAIT_MS   25
 
+/* Decimating tuner block params */
+#define SU_TEST_TUNER_DECIM_PERIOD 64
+#define SU_TEST_TUNER_DECIM_FACTOR 4
+#define SU_TEST_TUNER_DECIM_TAPS   64
+#define SU_TEST_TUNER_DECIM_BW     .5
+#define SU_TEST_TUNER_DECIM_SIZE   1024
+
 /* Preferred matched filter span (in symbol periods) */
 #define SU_TEST_MF_SYMBOL_SPAN 6
 
 /* Default test buffer size */
 #define SU_TEST_SIGNAL_BUFFER_SIZE (32 * 4096)
 
+/* Integer NCQO params */
+#define SU_TEST_NCQO_BULK_SIZE      4099
+#define SU_TEST_NCQO_LUT_MAX_ERROR  5e-7
+#define SU_TEST_NCQO_LONG_RUN       (1 << 24)
+
+/* FIR engine params */
+#define SU_TEST_FIR_TAPS        129
+#define SU_TEST_FIR_BUFFER_SIZE 8192
+#define SU_TEST_FIR_MAX_ERROR   1e-4
+
+#define SU_TEST_FIR_FFT_TAPS        1001
+#define SU_TEST_FIR_FFT_BUFFER_SIZE 32768
+#define SU_TEST_FIR_FFT_MAX_ERROR   1e-3
+
+#define SU_TEST_FIR_BENCH_SAMPLES  (1 << 16)
+#define SU_TEST_FIR_BENCH_MIN_TAPS 2
+#define SU_TEST_FIR_BENCH_MAX_TAPS 2048
+#define SU_TEST_FIR_BENCH_RUNS     5
+
+#define SU_TEST_FIR_DECIM_MAX 8
+
+#define SU_TEST_FIR_FOLD_TAPS    129
+#define SU_TEST_FIR_FOLD_HB_TAPS 65
+#define SU_TEST_FIR_FOLD_DECIM   3
+
+#define SU_TEST_RESAMPLER_BUFFER_SIZE       8192
+#define SU_TEST_RESAMPLER_CHUNK             128
+#define SU_TEST_RESAMPLER_MAX_RATIO         5
+#define SU_TEST_RESAMPLER_TONE_FREQ         5e-2
+#define SU_TEST_RESAMPLER_MAX_ERROR         1e-2
+#define SU_TEST_RESAMPLER_MIN_REJECTION     -40
+#define SU_TEST_RESAMPLER_FARROW_MAX_ERROR  1e-4
+
+#define SU_TEST_MIXER_BUFFER_SIZE 8191
+#define SU_TEST_MIXER_MAX_ERROR   2e-5
+#define SU_TEST_MIXER_LONG_RUN    (1 << 23)
+
+#define SU_TEST_CIC_BUFFER_SIZE  8000
+#define SU_TEST_CIC_MAX_ERROR    1e-4
+#define SU_TEST_CIC_COMP_TAPS    31
+#define SU_TEST_CIC_COMP_FC      .5
+#define SU_TEST_CIC_COMP_FLAT    .7
+#define SU_TEST_CIC_COMP_MAX_DEV 2e-2
+
+#define SU_TEST_SOFTTUNER_BUFFER_SIZE   (1 << 18)
+#define SU_TEST_SOFTTUNER_SAMP_RATE     250000
+#define SU_TEST_SOFTTUNER_FC            30000
+#define SU_TEST_SOFTTUNER_OFFSET        .2
+#define SU_TEST_SOFTTUNER_SETTLE        64
+#define SU_TEST_SOFTTUNER_ALIASES       8
+#define SU_TEST_SOFTTUNER_MAX_ERROR     5e-2
+#define SU_TEST_SOFTTUNER_MIN_REJECTION -40
+#define SU_TEST_SOFTTUNER_LARGE_OUT     128
+
+/* Second order sections params */
+#define SU_TEST_SOS_ORDER            6
+#define SU_TEST_SOS_CHANNELS         7
+#define SU_TEST_SOS_BUFFER_SIZE      16384
+#define SU_TEST_SOS_MAX_ERROR        1e-3
+#define SU_TEST_SOS_NARROW_ORDER     8
+#define SU_TEST_SOS_NARROW_FC        2e-3
+#define SU_TEST_SOS_NARROW_MAX_ERROR 2e-2
+
 /* AGC params */
 #define SU_TEST_AGC_SIGNAL_FREQ 0.025
 #define SU_TEST_AGC_WINDOW (1. / SU_TEST_AGC_SIGNAL_FREQ)
@@ -56,6 +126,33 @@
   "su_test_channel_detector_qpsk/tx-complex.raw"
 #endif
 
+#define SU_TEST_CHANNEL_DETECTOR_BATCH_WINDOW_SIZE 1024
+#define SU_TEST_CHANNEL_DETECTOR_BATCH_WINDOWS     8
+#define SU_TEST_CHANNEL_DETECTOR_BATCH_CHUNK       10000
+#define SU_TEST_CHANNEL_DETECTOR_BATCH_MAX_ERROR   1e-3
+#define SU_TEST_CHANNEL_DETECTOR_REAL_MAX_ERROR    1e-3
+#define SU_TEST_CHANNEL_DETECTOR_OVERLAP          4
+#define SU_TEST_CHANNEL_DETECTOR_OVERLAP_ALPHA    5e-2
+#define SU_TEST_CHANNEL_DETECTOR_OVERLAP_MAX_ERROR 5e-2
+#define SU_TEST_CHANNEL_DETECTOR_INDEX_CARRIERS   100
+#define SU_TEST_CHANNEL_DETECTOR_INDEX_WINDOWS    200
+#define SU_TEST_CHANNEL_DETECTOR_PSD_SIZE         65541
+#define SU_TEST_CHANNEL_DETECTOR_PSD_MAX_ERROR    1e-4
+#define SU_TEST_CHANNEL_DETECTOR_ORDER_SPS        8
+#define SU_TEST_CHANNEL_DETECTOR_ORDER_OFFSET     1000
+#define SU_TEST_CHANNEL_DETECTOR_ORDER_NOISE      .1
+#define SU_TEST_CHANNEL_DETECTOR_SHARED_CARRIERS  8
+#define SU_TEST_CHANNEL_DETECTOR_SHARED_WINDOWS   64
+#define SU_TEST_CHANNEL_DETECTOR_SHARED_MAX_ERROR 1e-3
+
+#define SU_TEST_PEAK_DETECTOR_SAMPLES        (1 << 18)
+#define SU_TEST_PEAK_DETECTOR_SIZE           64
+#define SU_TEST_PEAK_DETECTOR_OFFSET         1000
+#define SU_TEST_PEAK_DETECTOR_MARGIN         1e-3
+#define SU_TEST_PEAK_DETECTOR_BENCH_SAMPLES  (1 << 16)
+#define SU_TEST_PEAK_DETECTOR_BENCH_MIN_SIZE 16
+#define SU_TEST_PEAK_DETECTOR_BENCH_MAX_SIZE 4096
+
 /* Encoder parameters */
 #define SU_TEST_ENCODER_NUM_SYMS 32
 
@@ -66,4 +163,32 @@
 #define SU_TEST_SPECTTUNER_SAMP_RATE 8000.
 #define SU_TEST_SPECTTUNER_N0        2e-2
 
+#define SU_TEST_SPECTTUNER_BENCH_CHANNELS    128
+#define SU_TEST_SPECTTUNER_BENCH_MAX_THREADS 8
+#define SU_TEST_SPECTTUNER_SIMD_MIN_SIZE     64
+#define SU_TEST_SPECTTUNER_SIMD_MAX_SIZE     4096
+#define SU_TEST_SPECTTUNER_SIMD_ITERS        (1 << 22)
+#define SU_TEST_SPECTTUNER_RING_CHUNK        1024
+#define SU_TEST_SPECTTUNER_RING_SMALL_SIZE   256
+#define SU_TEST_SPECTTUNER_BATCH_WINDOWS     16
+#define SU_TEST_SPECTTUNER_BATCH_MAX_ERROR   1e-5
+#define SU_TEST_SPECTTUNER_REAL_CHANNELS     16
+#define SU_TEST_SPECTTUNER_REAL_MAX_ERROR    1e-4
+#define SU_TEST_SPECTTUNER_ASYNC_SLOTS       32
+#define SU_TEST_SPECTTUNER_CACHE_BW          (2 * PI / 32)
+#define SU_TEST_SPECTTUNER_CACHE_MAX_ERROR   1e-5
+
+/* Polyphase channelizer */
+#define SU_TEST_PFB_CHANNELS          64
+#define SU_TEST_PFB_TONE_CHANNEL      5
+#define SU_TEST_PFB_MIN_BENCH_CHANNELS 64
+#define SU_TEST_PFB_MAX_BENCH_CHANNELS 1024
+#define SU_TEST_PFB_CLOSE_OUTPUTS     100
+#define SU_TEST_PFB_CLOSE_BUFFER_SIZE 16
+
+/* FFT plan registry. Sizes no other test uses */
+#define SU_TEST_FFT_PLAN_SIZE        1000
+#define SU_TEST_FFT_PLAN_WISDOM_SIZE 1320
+#define SU_TEST_FFT_PLAN_WISDOM_FILE "sutest_wisdom.dat"
+
 #endif /* _SRC_TEST_PARAM */